@@ -22,6 +22,7 @@
     SOFTWARE.
 */
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -30,6 +31,7 @@
 #endif
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "FDP.h"
@@ -87,6 +89,25 @@ void* OpenSHM(const char *name, size_t size)
     return buf;
 }
 
+static size_t GetSHMSize(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, S_IRUSR | S_IWUSR);
+    if (fd == -1)
+    {
+        return 0;
+    }
+
+    struct stat ShmStat;
+    size_t size = 0;
+    if (fstat(fd, &ShmStat) == 0)
+    {
+        size = (size_t)ShmStat.st_size;
+    }
+
+    close(fd);
+    return size;
+}
+
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 
@@ -217,6 +238,241 @@ __inline static uint32_t ReadFDPData(FDP_SHM_CANAL* pFDPCanal, uint8_t* buffer)
     return ReadFDPDataWithStatus(pFDPCanal, buffer, &bIsSuccess);
 }
 
+//
+// Memory hashing, shared by FDPCMD_HASH_RANGE and the client side
+//
+#define FDP_XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define FDP_XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define FDP_XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define FDP_XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define FDP_XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+typedef struct FDP_HASH_STATE_
+{
+    FDP_HashAlgorithm   Algorithm;
+    uint64_t            TotalSize;
+    uint64_t            Acc[4];         //xxh64 lanes, Acc[0] alone for crc32c
+    uint8_t             Pending[32];    //xxh64 stripe not yet consumed
+    uint32_t            PendingSize;
+} FDP_HASH_STATE;
+
+__inline static uint64_t FDP_XXH64Rotl(uint64_t Value, int Count)
+{
+    return (Value << Count) | (Value >> (64 - Count));
+}
+
+__inline static uint64_t FDP_XXH64Read64(const uint8_t *p)
+{
+    uint64_t Value;
+    memcpy(&Value, p, sizeof(Value));
+    return Value;
+}
+
+__inline static uint32_t FDP_XXH64Read32(const uint8_t *p)
+{
+    uint32_t Value;
+    memcpy(&Value, p, sizeof(Value));
+    return Value;
+}
+
+__inline static uint64_t FDP_XXH64Round(uint64_t Acc, uint64_t Input)
+{
+    Acc += Input * FDP_XXH_PRIME64_2;
+    Acc = FDP_XXH64Rotl(Acc, 31);
+    return Acc * FDP_XXH_PRIME64_1;
+}
+
+__inline static uint64_t FDP_XXH64MergeRound(uint64_t Acc, uint64_t Value)
+{
+    Acc ^= FDP_XXH64Round(0, Value);
+    return Acc * FDP_XXH_PRIME64_1 + FDP_XXH_PRIME64_4;
+}
+
+__inline static void FDP_XXH64Stripe(uint64_t *pAcc, const uint8_t *p)
+{
+    pAcc[0] = FDP_XXH64Round(pAcc[0], FDP_XXH64Read64(p));
+    pAcc[1] = FDP_XXH64Round(pAcc[1], FDP_XXH64Read64(p + 8));
+    pAcc[2] = FDP_XXH64Round(pAcc[2], FDP_XXH64Read64(p + 16));
+    pAcc[3] = FDP_XXH64Round(pAcc[3], FDP_XXH64Read64(p + 24));
+}
+
+static uint32_t FDP_Crc32cTable[256];
+static bool FDP_Crc32cHasSse42 = false;
+static pthread_once_t FDP_Crc32cOnce = PTHREAD_ONCE_INIT;
+
+//Run once by FDP_Crc32cUpdate, the hashes can come from several threads
+static void FDP_Crc32cInit()
+{
+#if defined(__x86_64__)
+    FDP_Crc32cHasSse42 = __builtin_cpu_supports("sse4.2");
+#endif
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t Crc = i;
+        for (int j = 0; j < 8; j++)
+        {
+            Crc = (Crc >> 1) ^ (0x82F63B78 & (0 - (Crc & 1)));
+        }
+        FDP_Crc32cTable[i] = Crc;
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t FDP_Crc32cHardware(uint32_t Crc, const uint8_t *p, uint64_t Size)
+{
+    uint64_t Crc64 = Crc;
+    while (Size >= 8)
+    {
+        Crc64 = __builtin_ia32_crc32di(Crc64, FDP_XXH64Read64(p));
+        p += 8;
+        Size -= 8;
+    }
+    Crc = (uint32_t)Crc64;
+    while (Size > 0)
+    {
+        Crc = __builtin_ia32_crc32qi(Crc, *p);
+        p++;
+        Size--;
+    }
+    return Crc;
+}
+#endif
+
+static uint32_t FDP_Crc32cUpdate(uint32_t Crc, const uint8_t *p, uint64_t Size)
+{
+    pthread_once(&FDP_Crc32cOnce, FDP_Crc32cInit);
+#if defined(__x86_64__)
+    if (FDP_Crc32cHasSse42)
+    {
+        return FDP_Crc32cHardware(Crc, p, Size);
+    }
+#endif
+    while (Size > 0)
+    {
+        Crc = FDP_Crc32cTable[(Crc ^ *p) & 0xFF] ^ (Crc >> 8);
+        p++;
+        Size--;
+    }
+    return Crc;
+}
+
+static bool FDP_HashInit(FDP_HASH_STATE *pState, FDP_HashAlgorithm Algorithm)
+{
+    memset(pState, 0, sizeof(FDP_HASH_STATE));
+    pState->Algorithm = Algorithm;
+    switch (Algorithm)
+    {
+    case FDP_HASH_XXH64:
+        pState->Acc[0] = FDP_XXH_PRIME64_1 + FDP_XXH_PRIME64_2;
+        pState->Acc[1] = FDP_XXH_PRIME64_2;
+        pState->Acc[2] = 0;
+        pState->Acc[3] = 0 - FDP_XXH_PRIME64_1;
+        return true;
+    case FDP_HASH_CRC32C:
+        pState->Acc[0] = 0xFFFFFFFF;
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+static void FDP_HashUpdate(FDP_HASH_STATE *pState, const uint8_t *pData, uint64_t Size)
+{
+    pState->TotalSize += Size;
+    if (pState->Algorithm == FDP_HASH_CRC32C)
+    {
+        pState->Acc[0] = FDP_Crc32cUpdate((uint32_t)pState->Acc[0], pData, Size);
+        return;
+    }
+    if (pState->PendingSize > 0)
+    {
+        uint32_t CopySize = (uint32_t)MIN(Size, sizeof(pState->Pending) - pState->PendingSize);
+        memcpy(pState->Pending + pState->PendingSize, pData, CopySize);
+        pState->PendingSize += CopySize;
+        pData += CopySize;
+        Size -= CopySize;
+        if (pState->PendingSize < sizeof(pState->Pending))
+        {
+            return;
+        }
+        FDP_XXH64Stripe(pState->Acc, pState->Pending);
+        pState->PendingSize = 0;
+    }
+    while (Size >= 32)
+    {
+        FDP_XXH64Stripe(pState->Acc, pData);
+        pData += 32;
+        Size -= 32;
+    }
+    memcpy(pState->Pending, pData, Size);
+    pState->PendingSize = (uint32_t)Size;
+}
+
+static uint64_t FDP_HashDigest(FDP_HASH_STATE *pState)
+{
+    if (pState->Algorithm == FDP_HASH_CRC32C)
+    {
+        return (uint32_t)pState->Acc[0] ^ 0xFFFFFFFF;
+    }
+    uint64_t Hash;
+    if (pState->TotalSize >= 32)
+    {
+        Hash = FDP_XXH64Rotl(pState->Acc[0], 1) + FDP_XXH64Rotl(pState->Acc[1], 7)
+               + FDP_XXH64Rotl(pState->Acc[2], 12) + FDP_XXH64Rotl(pState->Acc[3], 18);
+        for (int i = 0; i < 4; i++)
+        {
+            Hash = FDP_XXH64MergeRound(Hash, pState->Acc[i]);
+        }
+    }
+    else
+    {
+        Hash = FDP_XXH_PRIME64_5;
+    }
+    Hash += pState->TotalSize;
+
+    const uint8_t *p = pState->Pending;
+    const uint8_t *pEnd = pState->Pending + pState->PendingSize;
+    while (p + 8 <= pEnd)
+    {
+        Hash ^= FDP_XXH64Round(0, FDP_XXH64Read64(p));
+        Hash = FDP_XXH64Rotl(Hash, 27) * FDP_XXH_PRIME64_1 + FDP_XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= pEnd)
+    {
+        Hash ^= (uint64_t)FDP_XXH64Read32(p) * FDP_XXH_PRIME64_1;
+        Hash = FDP_XXH64Rotl(Hash, 23) * FDP_XXH_PRIME64_2 + FDP_XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < pEnd)
+    {
+        Hash ^= (*p) * FDP_XXH_PRIME64_5;
+        Hash = FDP_XXH64Rotl(Hash, 11) * FDP_XXH_PRIME64_1;
+        p++;
+    }
+
+    Hash ^= Hash >> 33;
+    Hash *= FDP_XXH_PRIME64_2;
+    Hash ^= Hash >> 29;
+    Hash *= FDP_XXH_PRIME64_3;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
+
+FDP_EXPORTED
+uint64_t FDP_HashBuffer(FDP_HashAlgorithm Algorithm, const uint8_t *pBuffer, uint64_t BufferSize)
+{
+    FDP_HASH_STATE HashState;
+    if (FDP_HashInit(&HashState, Algorithm) == false)
+    {
+        return 0;
+    }
+    FDP_HashUpdate(&HashState, pBuffer, BufferSize);
+    return FDP_HashDigest(&HashState);
+}
+
 FDP_EXPORTED
 FDP_SHM* FDP_CreateSHM(char* shmName)
 {
@@ -226,7 +482,7 @@ FDP_SHM* FDP_CreateSHM(char* shmName)
     }
     //Clear SHM
     memset(pBuf, 0, FDP_SHM_SHARED_SIZE);
-    FDP_SHM* pFDPSHM = (FDP_SHM*)malloc(sizeof(FDP_SHM));
+    FDP_SHM* pFDPSHM = (FDP_SHM*)calloc(1, sizeof(FDP_SHM));
     //TODO: check !
     pFDPSHM->pSharedFDPSHM = (FDP_SHM_SHARED*)pBuf;
     return pFDPSHM;
@@ -244,13 +500,19 @@ FDP_EXPORTED FDP_SHM* FDP_OpenSHM(const char* pShmName)
     strcpy(aCpuShmName, "CPU_");
     strcat(aCpuShmName, pShmName);
 
-    void* pCpuShm = OpenSHM(aCpuShmName, sizeof(FDP_CPU_CTX));
+    //The server creates one FDP_CPU_CTX per vCPU
+    size_t CpuShmSize = GetSHMSize(aCpuShmName);
+    void* pCpuShm = NULL;
+    if (CpuShmSize >= sizeof(FDP_CPU_CTX))
+    {
+        pCpuShm = OpenSHM(aCpuShmName, CpuShmSize);
+    }
     if (pCpuShm == NULL)
     {
         printf("Failed to OpenShm(%s)\n", aCpuShmName);
         return NULL;
     }
-    FDP_SHM* pFDPSHM = (FDP_SHM*)malloc(sizeof(FDP_SHM));
+    FDP_SHM* pFDPSHM = (FDP_SHM*)calloc(1, sizeof(FDP_SHM));
     if (pFDPSHM == NULL)
     {
         //TODO : CloseShm
@@ -258,786 +520,6475 @@ FDP_EXPORTED FDP_SHM* FDP_OpenSHM(const char* pShmName)
     }
     pFDPSHM->pSharedFDPSHM = (FDP_SHM_SHARED*)pSharedFDPSHM;
     pFDPSHM->pCpuShm = (FDP_CPU_CTX *)pCpuShm;
+    pFDPSHM->CpuShmCount = (uint32_t)(CpuShmSize / sizeof(FDP_CPU_CTX));
+
+    //The hit log is optional, older servers don't create it
+    char aHitLogShmName[512] = {0};
+    snprintf(aHitLogShmName, sizeof(aHitLogShmName), "LOG_%s", pShmName);
+    size_t HitLogShmSize = GetSHMSize(aHitLogShmName);
+    if (HitLogShmSize > sizeof(FDP_HIT_LOG))
+    {
+        FDP_HIT_LOG* pHitLog = (FDP_HIT_LOG*)OpenSHM(aHitLogShmName, HitLogShmSize);
+        if (pHitLog != NULL
+            && pHitLog->RecordCount != 0
+            && (pHitLog->RecordCount & (pHitLog->RecordCount - 1)) == 0
+            && sizeof(FDP_HIT_LOG) + pHitLog->RecordCount * sizeof(FDP_HIT_LOG_SLOT) <= HitLogShmSize)
+        {
+            pFDPSHM->pHitLog = pHitLog;
+        }
+    }
     return pFDPSHM;
 }
 
-
 FDP_EXPORTED
-bool FDP_Pause(FDP_SHM* pFDP)
+FDP_CPU_CTX* FDP_CreateCpuSHM(FDP_SHM* pFDP, const char* pShmName, uint32_t CpuCount)
 {
-    if (pFDP == NULL)
+    if (pFDP == NULL || pShmName == NULL || CpuCount == 0)
     {
-        return false;
+        return NULL;
     }
-    bool bReturnValue = false;
-    uint32_t InputBufferSize = 0;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_PAUSE_VM;
-    LockSHM(pFDP->pSharedFDPSHM);
+    char aCpuShmName[512] = {0};
+    snprintf(aCpuShmName, sizeof(aCpuShmName), "CPU_%s", pShmName);
+
+    void* pCpuShm = CreateSHM(aCpuShmName, CpuCount * sizeof(FDP_CPU_CTX));
+    if (pCpuShm == NULL)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        return NULL;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    //Clear SHM, no context is valid yet
+    memset(pCpuShm, 0, CpuCount * sizeof(FDP_CPU_CTX));
+    pFDP->pCpuShm = (FDP_CPU_CTX*)pCpuShm;
+    pFDP->CpuShmCount = CpuCount;
+    return pFDP->pCpuShm;
 }
 
+#define FDP_HIT_LOG_MAX_RECORD_COUNT    (1 << 24)
+
+//RecordCount is rounded up to a power of two, 0 => FDP_HIT_LOG_DEFAULT_RECORD_COUNT
 FDP_EXPORTED
-bool FDP_Resume(FDP_SHM* pFDP)
+FDP_HIT_LOG* FDP_CreateHitLogSHM(FDP_SHM* pFDP, const char* pShmName, uint32_t RecordCount)
 {
-    if (pFDP == NULL)
+    if (pFDP == NULL || pShmName == NULL || RecordCount > FDP_HIT_LOG_MAX_RECORD_COUNT)
     {
-        return false;
+        return NULL;
     }
-    bool bReturnValue = false;
-    uint32_t InputBufferSize = 0;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_RESUME_VM;
-    LockSHM(pFDP->pSharedFDPSHM);
+    uint32_t PowerOfTwoCount = 1;
+    while (PowerOfTwoCount < (RecordCount != 0 ? RecordCount : FDP_HIT_LOG_DEFAULT_RECORD_COUNT))
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        PowerOfTwoCount <<= 1;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    char aHitLogShmName[512] = {0};
+    snprintf(aHitLogShmName, sizeof(aHitLogShmName), "LOG_%s", pShmName);
+
+    size_t HitLogShmSize = sizeof(FDP_HIT_LOG) + (size_t)PowerOfTwoCount * sizeof(FDP_HIT_LOG_SLOT);
+    FDP_HIT_LOG* pHitLog = (FDP_HIT_LOG*)CreateSHM(aHitLogShmName, (int)HitLogShmSize);
+    if (pHitLog == NULL)
+    {
+        return NULL;
+    }
+    memset(pHitLog, 0, HitLogShmSize);
+    for (uint32_t i = 0; i < PowerOfTwoCount; i++)
+    {
+        pHitLog->Slots[i].Sequence = i;
+    }
+    pHitLog->RecordCount = PowerOfTwoCount;
+    pFDP->pHitLog = pHitLog;
+    return pHitLog;
 }
 
-FDP_EXPORTED
-bool FDP_Reboot(FDP_SHM* pFDP)
+
+//
+// Per-vCPU register contexts. The server fills a context through
+// pfnReadRegister once its vCPU is known to be paused and clears every
+// context before the VM can run again, clients read valid ones directly.
+// Each context is a seqlock: writers (the server, the VMM) make Sequence odd
+// for the time of an update, readers retry when it changed under them.
+//
+static const FDP_Register FDP_CpuCtxRegisters[] =
 {
-    if (pFDP == NULL)
+    FDP_RIP_REGISTER, FDP_RAX_REGISTER, FDP_RCX_REGISTER, FDP_RDX_REGISTER, FDP_RBX_REGISTER,
+    FDP_RSP_REGISTER, FDP_RBP_REGISTER, FDP_RSI_REGISTER, FDP_RDI_REGISTER,
+    FDP_R8_REGISTER, FDP_R9_REGISTER, FDP_R10_REGISTER, FDP_R11_REGISTER,
+    FDP_R12_REGISTER, FDP_R13_REGISTER, FDP_R14_REGISTER, FDP_R15_REGISTER,
+    FDP_ES_REGISTER, FDP_CS_REGISTER, FDP_SS_REGISTER, FDP_DS_REGISTER, FDP_FS_REGISTER, FDP_GS_REGISTER,
+    FDP_RFLAGS_REGISTER,
+    FDP_CR0_REGISTER, FDP_CR2_REGISTER, FDP_CR3_REGISTER, FDP_CR4_REGISTER, FDP_CR8_REGISTER,
+    FDP_DR0_REGISTER, FDP_DR1_REGISTER, FDP_DR2_REGISTER, FDP_DR3_REGISTER, FDP_DR6_REGISTER, FDP_DR7_REGISTER,
+    FDP_GDTRB_REGISTER, FDP_GDTRL_REGISTER, FDP_IDTRB_REGISTER, FDP_IDTRL_REGISTER,
+};
+
+static uint64_t* FDP_CpuCtxRegister(FDP_CPU_CTX* pCpuCtx, FDP_Register RegisterId)
+{
+    switch (RegisterId)
     {
-        return false;
+    case FDP_RIP_REGISTER: return &pCpuCtx->rip;
+    case FDP_RAX_REGISTER: return &pCpuCtx->rax;
+    case FDP_RCX_REGISTER: return &pCpuCtx->rcx;
+    case FDP_RDX_REGISTER: return &pCpuCtx->rdx;
+    case FDP_RBX_REGISTER: return &pCpuCtx->rbx;
+    case FDP_RSP_REGISTER: return &pCpuCtx->rsp;
+    case FDP_RBP_REGISTER: return &pCpuCtx->rbp;
+    case FDP_RSI_REGISTER: return &pCpuCtx->rsi;
+    case FDP_RDI_REGISTER: return &pCpuCtx->rdi;
+    case FDP_R8_REGISTER: return &pCpuCtx->r8;
+    case FDP_R9_REGISTER: return &pCpuCtx->r9;
+    case FDP_R10_REGISTER: return &pCpuCtx->r10;
+    case FDP_R11_REGISTER: return &pCpuCtx->r11;
+    case FDP_R12_REGISTER: return &pCpuCtx->r12;
+    case FDP_R13_REGISTER: return &pCpuCtx->r13;
+    case FDP_R14_REGISTER: return &pCpuCtx->r14;
+    case FDP_R15_REGISTER: return &pCpuCtx->r15;
+    case FDP_ES_REGISTER: return &pCpuCtx->es;
+    case FDP_CS_REGISTER: return &pCpuCtx->cs;
+    case FDP_SS_REGISTER: return &pCpuCtx->ss;
+    case FDP_DS_REGISTER: return &pCpuCtx->ds;
+    case FDP_FS_REGISTER: return &pCpuCtx->fs;
+    case FDP_GS_REGISTER: return &pCpuCtx->gs;
+    case FDP_RFLAGS_REGISTER: return &pCpuCtx->rflags;
+    case FDP_CR0_REGISTER: return &pCpuCtx->cr0;
+    case FDP_CR2_REGISTER: return &pCpuCtx->cr2;
+    case FDP_CR3_REGISTER: return &pCpuCtx->cr3;
+    case FDP_CR4_REGISTER: return &pCpuCtx->cr4;
+    case FDP_CR8_REGISTER: return &pCpuCtx->cr8;
+    case FDP_DR0_REGISTER: return &pCpuCtx->dr0;
+    case FDP_DR1_REGISTER: return &pCpuCtx->dr1;
+    case FDP_DR2_REGISTER: return &pCpuCtx->dr2;
+    case FDP_DR3_REGISTER: return &pCpuCtx->dr3;
+    case FDP_DR6_REGISTER: return &pCpuCtx->dr6;
+    case FDP_DR7_REGISTER: return &pCpuCtx->dr7;
+    case FDP_GDTRB_REGISTER: return &pCpuCtx->gdtrb;
+    case FDP_GDTRL_REGISTER: return &pCpuCtx->gdtrl;
+    case FDP_IDTRB_REGISTER: return &pCpuCtx->idtrb;
+    case FDP_IDTRL_REGISTER: return &pCpuCtx->idtrl;
+    default: return NULL;
     }
-    bool bReturnValue = false;
-    uint32_t InputBufferSize = 0;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_REBOOT;
-    LockSHM(pFDP->pSharedFDPSHM);
+}
+
+static void FDP_CpuCtxWriteBegin(FDP_CPU_CTX* pCpuCtx)
+{
+    //Also serializes writers
+    for (;;)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        uint64_t Sequence = pCpuCtx->Sequence & ~1ULL;
+        if (__sync_bool_compare_and_swap(&pCpuCtx->Sequence, Sequence, Sequence + 1))
+        {
+            return;
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
 }
 
-bool FDP_ReadPhysicalMemoryInternal(FDP_SHM* pFDP, uint8_t* pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress)
+__inline static void FDP_CpuCtxWriteEnd(FDP_CPU_CTX* pCpuCtx)
 {
-    uint64_t ReceivedSize = 0;
-    bool bReturnCode = false;
-    FDP_READ_PHYSICAL_MEMORY_PKT_REQ tmpPkt;
-    tmpPkt.Type = FDPCMD_READ_PHYSICAL;
-    tmpPkt.PhysicalAddress = PhysicalAddress;
-    tmpPkt.ReadSize = ReadSize;
-    LockSHM(pFDP->pSharedFDPSHM);
+    __sync_fetch_and_add(&pCpuCtx->Sequence, 1);
+}
+
+__inline static uint64_t FDP_CpuCtxReadBegin(FDP_CPU_CTX* pCpuCtx)
+{
+    uint64_t Sequence;
+    while ((Sequence = pCpuCtx->Sequence) & 1)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&tmpPkt, sizeof(FDP_READ_PHYSICAL_MEMORY_PKT_REQ));
-        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pDstBuffer, &bReturnCode);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnCode;
+    __sync_synchronize();
+    return Sequence;
 }
 
-FDP_EXPORTED
-bool FDP_ReadPhysicalMemory(FDP_SHM* pFDP, uint8_t* pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress)
+__inline static bool FDP_CpuCtxReadRetry(FDP_CPU_CTX* pCpuCtx, uint64_t Sequence)
 {
-    if (pFDP == NULL)
+    __sync_synchronize();
+    return pCpuCtx->Sequence != Sequence;
+}
+
+static void FDP_ServerRefreshCpuCtx(FDP_SHM* pFDP, uint32_t CpuId)
+{
+    if (pFDP->pCpuShm == NULL || CpuId >= pFDP->CpuShmCount || pFDP->pCpuShm[CpuId].Valid)
     {
-        return false;
+        return;
     }
-    uint32_t CurrentOffset = 0;
-    do
+    FDP_CPU_CTX* pCpuCtx = &pFDP->pCpuShm[CpuId];
+    FDP_CpuCtxWriteBegin(pCpuCtx);
+    for (uint32_t i = 0; i < sizeof(FDP_CpuCtxRegisters) / sizeof(FDP_CpuCtxRegisters[0]); i++)
     {
-        uint32_t CurrentReadSize = MIN(ReadSize, FDP_MAX_DATA_SIZE - 1);
-        if (FDP_ReadPhysicalMemoryInternal(pFDP, pDstBuffer + CurrentOffset, CurrentReadSize,
-                                           PhysicalAddress + CurrentOffset) == false)
+        uint64_t RegisterValue;
+        if (pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CpuCtxRegisters[i],
+                                              &RegisterValue) == false)
         {
-            return false;
+            FDP_CpuCtxWriteEnd(pCpuCtx);
+            return;
         }
-        CurrentOffset += CurrentReadSize;
+        *FDP_CpuCtxRegister(pCpuCtx, FDP_CpuCtxRegisters[i]) = RegisterValue;
     }
-    while (CurrentOffset < ReadSize);
-    return true;
+    pCpuCtx->Valid = 1;
+    FDP_CpuCtxWriteEnd(pCpuCtx);
 }
 
-bool FDP_ReadVirtualMemoryInternal(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pDstBuffer, uint32_t ReadSize,
-                                   uint64_t VirtualAddress)
+static void FDP_ServerRefreshAllCpuCtx(FDP_SHM* pFDP)
 {
-    uint32_t ReceivedSize = 0;
-    bool bReturnCode = false;
-    FDP_READ_VIRTUAL_MEMORY_PKT_REQ tmpPkt;
-    tmpPkt.Type = FDPCMD_READ_VIRTUAL;
-    tmpPkt.CpuId = CpuId;
-    tmpPkt.VirtualAddress = VirtualAddress;
-    tmpPkt.ReadSize = ReadSize;
-    LockSHM(pFDP->pSharedFDPSHM);
+    for (uint32_t CpuId = 0; CpuId < pFDP->CpuShmCount; CpuId++)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&tmpPkt, sizeof(FDP_READ_PHYSICAL_MEMORY_PKT_REQ));
-        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pDstBuffer, &bReturnCode);
+        FDP_ServerRefreshCpuCtx(pFDP, CpuId);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnCode;
 }
 
-FDP_EXPORTED
-bool FDP_ReadVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pDstBuffer, uint32_t ReadSize,
-                           uint64_t VirtualAddress)
+static void FDP_ServerInvalidateCpuCtx(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL || ReadSize <= 0)
+    for (uint32_t CpuId = 0; CpuId < pFDP->CpuShmCount; CpuId++)
     {
-        return false;
+        FDP_CpuCtxWriteBegin(&pFDP->pCpuShm[CpuId]);
+        pFDP->pCpuShm[CpuId].Valid = 0;
+        FDP_CpuCtxWriteEnd(&pFDP->pCpuShm[CpuId]);
     }
-    uint32_t CurrentOffset = 0;
-    do
+}
+
+//Fill the context so that the next reads don't need a round trip
+static void FDP_ServerRefreshPausedCpuCtx(FDP_SHM* pFDP, uint32_t CpuId)
+{
+    if (CpuId < pFDP->CpuShmCount && pFDP->pCpuShm[CpuId].Valid == 0)
     {
-        uint32_t CurrentReadSize = MIN(ReadSize, FDP_MAX_DATA_SIZE - 1);
-        if (FDP_ReadVirtualMemoryInternal(pFDP, CpuId, pDstBuffer + CurrentOffset, CurrentReadSize,
-                                          VirtualAddress + CurrentOffset) == false)
+        uint8_t CurrentState = 0;
+        if (pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &CurrentState)
+            && (CurrentState & FDP_STATE_PAUSED))
         {
-            return false;
+            FDP_ServerRefreshCpuCtx(pFDP, CpuId);
         }
-        CurrentOffset += CurrentReadSize;
     }
-    while (CurrentOffset < ReadSize);
-    return true;
 }
 
-FDP_EXPORTED
-bool FDP_WritePhysicalMemory(FDP_SHM* pFDP, uint8_t* pSrcBuffer, uint32_t WriteSize, uint64_t PhysicalAddress)
+static void FDP_ServerUpdateCpuCtx(FDP_SHM* pFDP, uint32_t CpuId, FDP_Register RegisterId, uint64_t RegisterValue)
 {
-    if (pFDP == NULL)
+    if (CpuId >= pFDP->CpuShmCount)
     {
-        return false;
+        return;
     }
-    uint32_t InputBufferSize = 0;
-    bool bReturnValue = false;
-    LockSHM(pFDP->pSharedFDPSHM);
+    FDP_CPU_CTX* pCpuCtx = &pFDP->pCpuShm[CpuId];
+    uint64_t* pCachedRegister = FDP_CpuCtxRegister(pCpuCtx, RegisterId);
+    if (pCachedRegister != NULL)
     {
-        FDP_WRITE_PHYSICAL_MEMORY_PKT_REQ* TempPkt = (FDP_WRITE_PHYSICAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
-        TempPkt->Type = FDPCMD_WRITE_PHYSICAL;
-        TempPkt->PhysicalAddress = PhysicalAddress;
-        TempPkt->WriteSize = WriteSize;
-        if (WriteSize < FDP_MAX_DATA_SIZE - sizeof(*TempPkt))
-        {
-            memcpy(TempPkt->Data, pSrcBuffer, WriteSize);
-            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)TempPkt,
-                         sizeof(FDP_READ_PHYSICAL_MEMORY_PKT_REQ) + WriteSize);
-            InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
-        }
+        FDP_CpuCtxWriteBegin(pCpuCtx);
+        *pCachedRegister = RegisterValue;
+        FDP_CpuCtxWriteEnd(pCpuCtx);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
 }
 
 
+//
+// Client side readahead for virtual memory reads. Pages are only cached while
+// the VM is known to be stopped, and every command that can change memory,
+// registers or execution state starts a new generation.
+//
+#define FDP_READAHEAD_PAGE_SIZE         4096
+#define FDP_READAHEAD_CACHE_PAGES       1024    //4MB of cached pages
+#define FDP_READAHEAD_STREAMS           8       //Address spaces tracked at once
+#define FDP_READAHEAD_MIN_WINDOW        4       //Pages
+#define FDP_READAHEAD_MAX_WINDOW        64
+#define FDP_READAHEAD_MAX_JOBS          16
+#define FDP_READAHEAD_MAX_CACHED_READ   (16 * FDP_READAHEAD_PAGE_SIZE)  //Bigger reads bypass the cache
+
+typedef struct FDP_READAHEAD_PAGE_
+{
+    uint64_t    Cr3;
+    uint64_t    VirtualPage;
+    uint64_t    Generation;
+    bool        bValid;
+    bool        bPrefetched;
+} FDP_READAHEAD_PAGE;
+
+typedef struct FDP_READAHEAD_STREAM_
+{
+    uint64_t    Cr3;
+    uint64_t    LastPage;
+    uint64_t    PrefetchEnd;    //First page not requested yet
+    uint32_t    Window;
+    uint64_t    LastUse;
+    bool        bValid;
+} FDP_READAHEAD_STREAM;
+
+typedef struct FDP_READAHEAD_JOB_
+{
+    uint32_t    CpuId;
+    uint64_t    Cr3;
+    uint64_t    FirstPage;
+    uint32_t    PageCount;
+    uint64_t    Generation;
+} FDP_READAHEAD_JOB;
+
+struct FDP_READAHEAD_
+{
+    pthread_mutex_t         Mutex;
+    pthread_cond_t          JobCond;
+    pthread_t               Thread;
+    bool                    bExitThread;
+    bool                    bVmStopped;
+    uint64_t                Generation;
+    uint64_t                Tick;
+    FDP_READAHEAD_PAGE      Pages[FDP_READAHEAD_CACHE_PAGES];
+    uint8_t                 *pPageData;
+    uint8_t                 *pPrefetchBuffer;
+    FDP_READAHEAD_STREAM    Streams[FDP_READAHEAD_STREAMS];
+    FDP_READAHEAD_JOB       Jobs[FDP_READAHEAD_MAX_JOBS];
+    uint32_t                JobHead;
+    uint32_t                JobCount;
+    FDP_READAHEAD_STATS     Stats;
+};
+
+bool FDP_ReadVirtualMemoryInternal(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pDstBuffer, uint32_t ReadSize,
+                                   uint64_t VirtualAddress);
+
+__inline static uint32_t FDP_ReadaheadSlot(uint64_t Cr3, uint64_t VirtualPage)
+{
+    return (uint32_t)((VirtualPage ^ ((Cr3 >> 12) * FDP_XXH_PRIME64_1)) % FDP_READAHEAD_CACHE_PAGES);
+}
+
+//Caller holds the mutex
+static uint8_t* FDP_ReadaheadLookup(FDP_READAHEAD* pReadahead, uint64_t Cr3, uint64_t VirtualPage, bool* pbPrefetched)
+{
+    uint32_t Slot = FDP_ReadaheadSlot(Cr3, VirtualPage);
+    FDP_READAHEAD_PAGE* pPage = &pReadahead->Pages[Slot];
+    if (pPage->bValid == false || pPage->Generation != pReadahead->Generation
+        || pPage->Cr3 != Cr3 || pPage->VirtualPage != VirtualPage)
+    {
+        return NULL;
+    }
+    if (pbPrefetched != NULL)
+    {
+        *pbPrefetched = pPage->bPrefetched;
+        pPage->bPrefetched = false;
+    }
+    return pReadahead->pPageData + (uint64_t)Slot * FDP_READAHEAD_PAGE_SIZE;
+}
+
+//Caller holds the mutex. Data read for an older generation is dropped.
+static bool FDP_ReadaheadInsert(FDP_READAHEAD* pReadahead, uint64_t Cr3, uint64_t VirtualPage, const uint8_t* pData,
+                                uint64_t Generation, bool bPrefetched)
+{
+    if (Generation != pReadahead->Generation)
+    {
+        return false;
+    }
+    uint32_t Slot = FDP_ReadaheadSlot(Cr3, VirtualPage);
+    FDP_READAHEAD_PAGE* pPage = &pReadahead->Pages[Slot];
+    memcpy(pReadahead->pPageData + (uint64_t)Slot * FDP_READAHEAD_PAGE_SIZE, pData, FDP_READAHEAD_PAGE_SIZE);
+    pPage->Cr3 = Cr3;
+    pPage->VirtualPage = VirtualPage;
+    pPage->Generation = Generation;
+    pPage->bPrefetched = bPrefetched;
+    pPage->bValid = true;
+    return true;
+}
+
+static void FDP_ReadaheadReset(FDP_SHM* pFDP, bool bVmStopped)
+{
+    FDP_READAHEAD* pReadahead = pFDP->pReadahead;
+    if (pReadahead == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pReadahead->Mutex);
+    {
+        pReadahead->Generation++;
+        pReadahead->bVmStopped = bVmStopped;
+        pReadahead->JobCount = 0;
+        memset(pReadahead->Streams, 0, sizeof(pReadahead->Streams));
+    }
+    pthread_mutex_unlock(&pReadahead->Mutex);
+}
+
+//Memory, registers or the current instruction may have changed, the VM stays where it was
+static void FDP_ReadaheadInvalidate(FDP_SHM* pFDP)
+{
+    if (pFDP->pReadahead != NULL)
+    {
+        FDP_ReadaheadReset(pFDP, pFDP->pReadahead->bVmStopped);
+    }
+}
+
+static void FDP_ReadaheadSetVmStopped(FDP_SHM* pFDP, bool bVmStopped)
+{
+    FDP_READAHEAD* pReadahead = pFDP->pReadahead;
+    if (pReadahead != NULL && pReadahead->bVmStopped != bVmStopped)
+    {
+        FDP_ReadaheadReset(pFDP, bVmStopped);
+    }
+}
+
+static void* FDP_ReadaheadThread(void* lpParameter)
+{
+    FDP_SHM* pFDP = (FDP_SHM*)lpParameter;
+    FDP_READAHEAD* pReadahead = pFDP->pReadahead;
+    while (true)
+    {
+        FDP_READAHEAD_JOB Job;
+        pthread_mutex_lock(&pReadahead->Mutex);
+        while (pReadahead->bExitThread == false && pReadahead->JobCount == 0)
+        {
+            pthread_cond_wait(&pReadahead->JobCond, &pReadahead->Mutex);
+        }
+        if (pReadahead->bExitThread)
+        {
+            pthread_mutex_unlock(&pReadahead->Mutex);
+            break;
+        }
+        Job = pReadahead->Jobs[pReadahead->JobHead];
+        pReadahead->JobHead = (pReadahead->JobHead + 1) % FDP_READAHEAD_MAX_JOBS;
+        pReadahead->JobCount--;
+        //Skip what is already there
+        while (Job.PageCount > 0 && FDP_ReadaheadLookup(pReadahead, Job.Cr3, Job.FirstPage, NULL) != NULL)
+        {
+            Job.FirstPage++;
+            Job.PageCount--;
+        }
+        pthread_mutex_unlock(&pReadahead->Mutex);
+        if (Job.PageCount == 0)
+        {
+            continue;
+        }
+
+        uint32_t ReadPageCount = Job.PageCount;
+        if (FDP_ReadVirtualMemoryInternal(pFDP, Job.CpuId, pReadahead->pPrefetchBuffer,
+                                          ReadPageCount * FDP_READAHEAD_PAGE_SIZE,
+                                          Job.FirstPage * FDP_READAHEAD_PAGE_SIZE) == false)
+        {
+            //Stop at the first unmapped page
+            for (ReadPageCount = 0; ReadPageCount < Job.PageCount; ReadPageCount++)
+            {
+                if (FDP_ReadVirtualMemoryInternal(pFDP, Job.CpuId,
+                                                  pReadahead->pPrefetchBuffer + ReadPageCount * FDP_READAHEAD_PAGE_SIZE,
+                                                  FDP_READAHEAD_PAGE_SIZE,
+                                                  (Job.FirstPage + ReadPageCount) * FDP_READAHEAD_PAGE_SIZE) == false)
+                {
+                    break;
+                }
+            }
+        }
+
+        pthread_mutex_lock(&pReadahead->Mutex);
+        for (uint32_t i = 0; i < ReadPageCount; i++)
+        {
+            if (FDP_ReadaheadInsert(pReadahead, Job.Cr3, Job.FirstPage + i,
+                                    pReadahead->pPrefetchBuffer + i * FDP_READAHEAD_PAGE_SIZE, Job.Generation, true) == false)
+            {
+                break;
+            }
+            pReadahead->Stats.PrefetchedPageCount++;
+        }
+        pthread_mutex_unlock(&pReadahead->Mutex);
+    }
+    return NULL;
+}
+
+//Caller holds the mutex. Grow the window while reads keep moving forward.
+static void FDP_ReadaheadTrack(FDP_READAHEAD* pReadahead, uint32_t CpuId, uint64_t Cr3, uint64_t FirstPage,
+                               uint64_t LastPage)
+{
+    FDP_READAHEAD_STREAM* pStream = NULL;
+    FDP_READAHEAD_STREAM* pOldestStream = &pReadahead->Streams[0];
+    for (int i = 0; i < FDP_READAHEAD_STREAMS; i++)
+    {
+        FDP_READAHEAD_STREAM* pCurrentStream = &pReadahead->Streams[i];
+        if (pCurrentStream->bValid && pCurrentStream->Cr3 == Cr3)
+        {
+            pStream = pCurrentStream;
+            break;
+        }
+        if (pCurrentStream->bValid == false || pCurrentStream->LastUse < pOldestStream->LastUse)
+        {
+            pOldestStream = pCurrentStream;
+        }
+    }
+    pReadahead->Tick++;
+    if (pStream == NULL)
+    {
+        memset(pOldestStream, 0, sizeof(FDP_READAHEAD_STREAM));
+        pOldestStream->bValid = true;
+        pOldestStream->Cr3 = Cr3;
+        pOldestStream->LastPage = LastPage;
+        pOldestStream->LastUse = pReadahead->Tick;
+        return;
+    }
+    pStream->LastUse = pReadahead->Tick;
+
+    if (FirstPage == pStream->LastPage + 1)
+    {
+        pStream->Window = pStream->Window ? MIN(pStream->Window * 2, FDP_READAHEAD_MAX_WINDOW) : FDP_READAHEAD_MIN_WINDOW;
+    }
+    else if (FirstPage != pStream->LastPage)
+    {
+        pStream->Window = 0;
+        pStream->PrefetchEnd = 0;
+    }
+    pStream->LastPage = LastPage;
+    if (pStream->Window == 0)
+    {
+        return;
+    }
+
+    //Refill in batches, once half of the window has been consumed
+    if (pStream->PrefetchEnd > LastPage + 1 + pStream->Window / 2)
+    {
+        return;
+    }
+    uint64_t PrefetchStart = pStream->PrefetchEnd > LastPage + 1 ? pStream->PrefetchEnd : LastPage + 1;
+    uint64_t PrefetchEnd = LastPage + 1 + pStream->Window;
+    if (PrefetchStart >= PrefetchEnd || pReadahead->JobCount == FDP_READAHEAD_MAX_JOBS)
+    {
+        return;
+    }
+    FDP_READAHEAD_JOB* pJob = &pReadahead->Jobs[(pReadahead->JobHead + pReadahead->JobCount) % FDP_READAHEAD_MAX_JOBS];
+    pJob->CpuId = CpuId;
+    pJob->Cr3 = Cr3;
+    pJob->FirstPage = PrefetchStart;
+    pJob->PageCount = (uint32_t)(PrefetchEnd - PrefetchStart);
+    pJob->Generation = pReadahead->Generation;
+    pReadahead->JobCount++;
+    pStream->PrefetchEnd = PrefetchEnd;
+    pthread_cond_signal(&pReadahead->JobCond);
+}
+
+//Copy the part of VirtualPage that belongs to the read
+__inline static void FDP_ReadaheadCopy(uint8_t* pDstBuffer, uint64_t VirtualAddress, uint32_t ReadSize,
+                                       uint64_t VirtualPage, const uint8_t* pPageData)
+{
+    uint64_t PageAddress = VirtualPage * FDP_READAHEAD_PAGE_SIZE;
+    uint64_t CopyStart = PageAddress > VirtualAddress ? PageAddress : VirtualAddress;
+    uint64_t CopyEnd = MIN(PageAddress + FDP_READAHEAD_PAGE_SIZE, VirtualAddress + ReadSize);
+    memcpy(pDstBuffer + (CopyStart - VirtualAddress), pPageData + (CopyStart - PageAddress), CopyEnd - CopyStart);
+}
+
+static bool FDP_ReadVirtualMemoryCached(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pDstBuffer, uint32_t ReadSize,
+                                        uint64_t VirtualAddress)
+{
+    FDP_READAHEAD* pReadahead = pFDP->pReadahead;
+    uint64_t Cr3 = 0;
+    FDP_ReadRegister(pFDP, CpuId, FDP_CR3_REGISTER, &Cr3);
+    uint64_t FirstPage = VirtualAddress / FDP_READAHEAD_PAGE_SIZE;
+    uint64_t LastPage = (VirtualAddress + ReadSize - 1) / FDP_READAHEAD_PAGE_SIZE;
+    uint32_t PageCount = (uint32_t)(LastPage - FirstPage + 1);
+    bool bHit[FDP_READAHEAD_MAX_CACHED_READ / FDP_READAHEAD_PAGE_SIZE + 1];
+    uint32_t MissCount = 0;
+    uint64_t Generation;
+
+    pthread_mutex_lock(&pReadahead->Mutex);
+    Generation = pReadahead->Generation;
+    for (uint32_t i = 0; i < PageCount; i++)
+    {
+        bool bPrefetched = false;
+        uint8_t* pPageData = FDP_ReadaheadLookup(pReadahead, Cr3, FirstPage + i, &bPrefetched);
+        bHit[i] = pPageData != NULL;
+        if (bHit[i] == false)
+        {
+            MissCount++;
+            continue;
+        }
+        FDP_ReadaheadCopy(pDstBuffer, VirtualAddress, ReadSize, FirstPage + i, pPageData);
+        pReadahead->Stats.PrefetchHitPageCount += bPrefetched ? 1 : 0;
+    }
+    pthread_mutex_unlock(&pReadahead->Mutex);
+
+    uint8_t* pReadBuffer = NULL;
+    if (MissCount > 0)
+    {
+        pReadBuffer = (uint8_t*)malloc(PageCount * FDP_READAHEAD_PAGE_SIZE);
+        if (pReadBuffer == NULL)
+        {
+            return FDP_ReadVirtualMemoryInternal(pFDP, CpuId, pDstBuffer, ReadSize, VirtualAddress);
+        }
+        //One round trip per run of missing pages
+        for (uint32_t i = 0; i < PageCount; i++)
+        {
+            if (bHit[i])
+            {
+                continue;
+            }
+            uint32_t RunEnd = i;
+            while (RunEnd < PageCount && bHit[RunEnd] == false)
+            {
+                RunEnd++;
+            }
+            if (FDP_ReadVirtualMemoryInternal(pFDP, CpuId, pReadBuffer + i * FDP_READAHEAD_PAGE_SIZE,
+                                              (RunEnd - i) * FDP_READAHEAD_PAGE_SIZE,
+                                              (FirstPage + i) * FDP_READAHEAD_PAGE_SIZE) == false)
+            {
+                free(pReadBuffer);
+                return false;
+            }
+            for (; i < RunEnd; i++)
+            {
+                FDP_ReadaheadCopy(pDstBuffer, VirtualAddress, ReadSize, FirstPage + i, pReadBuffer + i * FDP_READAHEAD_PAGE_SIZE);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&pReadahead->Mutex);
+    {
+        for (uint32_t i = 0; i < PageCount && MissCount > 0; i++)
+        {
+            if (bHit[i] == false)
+            {
+                FDP_ReadaheadInsert(pReadahead, Cr3, FirstPage + i, pReadBuffer + i * FDP_READAHEAD_PAGE_SIZE, Generation, false);
+            }
+        }
+        pReadahead->Stats.ReadCount++;
+        if (MissCount == 0)
+        {
+            pReadahead->Stats.HitCount++;
+            pReadahead->Stats.BytesSaved += ReadSize;
+        }
+        if (Generation == pReadahead->Generation)
+        {
+            FDP_ReadaheadTrack(pReadahead, CpuId, Cr3, FirstPage, LastPage);
+        }
+    }
+    pthread_mutex_unlock(&pReadahead->Mutex);
+    free(pReadBuffer);
+    return true;
+}
+
 FDP_EXPORTED
-bool FDP_WriteVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pSrcBuffer, uint32_t WriteSize,
-                            uint64_t VirtualAddress)
+bool FDP_SetReadahead(FDP_SHM* pFDP, bool bEnable)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_READAHEAD* pReadahead = pFDP->pReadahead;
+    if (bEnable == false)
+    {
+        if (pReadahead != NULL)
+        {
+            pthread_mutex_lock(&pReadahead->Mutex);
+            pReadahead->bExitThread = true;
+            pthread_cond_signal(&pReadahead->JobCond);
+            pthread_mutex_unlock(&pReadahead->Mutex);
+            pthread_join(pReadahead->Thread, NULL);
+            pFDP->pReadahead = NULL;
+            pthread_cond_destroy(&pReadahead->JobCond);
+            pthread_mutex_destroy(&pReadahead->Mutex);
+            free(pReadahead->pPageData);
+            free(pReadahead->pPrefetchBuffer);
+            free(pReadahead);
+        }
+        return true;
+    }
+    if (pReadahead != NULL)
+    {
+        return true;
+    }
+    pReadahead = (FDP_READAHEAD*)calloc(1, sizeof(FDP_READAHEAD));
+    if (pReadahead == NULL)
+    {
+        return false;
+    }
+    pReadahead->pPageData = (uint8_t*)malloc(FDP_READAHEAD_CACHE_PAGES * FDP_READAHEAD_PAGE_SIZE);
+    pReadahead->pPrefetchBuffer = (uint8_t*)malloc(FDP_READAHEAD_MAX_WINDOW * FDP_READAHEAD_PAGE_SIZE);
+    if (pReadahead->pPageData == NULL || pReadahead->pPrefetchBuffer == NULL)
+    {
+        free(pReadahead->pPageData);
+        free(pReadahead->pPrefetchBuffer);
+        free(pReadahead);
+        return false;
+    }
+    pthread_mutex_init(&pReadahead->Mutex, NULL);
+    pthread_cond_init(&pReadahead->JobCond, NULL);
+    pFDP->pReadahead = pReadahead;
+    if (pthread_create(&pReadahead->Thread, NULL, FDP_ReadaheadThread, pFDP) != 0)
+    {
+        pFDP->pReadahead = NULL;
+        pthread_cond_destroy(&pReadahead->JobCond);
+        pthread_mutex_destroy(&pReadahead->Mutex);
+        free(pReadahead->pPageData);
+        free(pReadahead->pPrefetchBuffer);
+        free(pReadahead);
+        return false;
+    }
+    //Only cache once the VM is known to be stopped
+    FDP_State State = 0;
+    FDP_GetState(pFDP, &State);
+    return true;
+}
+
+//For changes made behind this client's back (another client, the VM console...)
+FDP_EXPORTED
+void FDP_InvalidateReadahead(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+}
+
+FDP_EXPORTED
+bool FDP_GetReadaheadStats(FDP_SHM* pFDP, FDP_READAHEAD_STATS* pStats)
+{
+    if (pFDP == NULL || pFDP->pReadahead == NULL || pStats == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&pFDP->pReadahead->Mutex);
+    *pStats = pFDP->pReadahead->Stats;
+    pthread_mutex_unlock(&pFDP->pReadahead->Mutex);
+    return true;
+}
+
+
+//
+// Client side register cache. While the VM is known to be stopped, register
+// values are kept per vCPU and register writes are held back. Pending writes
+// go out as one FDP_WriteRegisters per vCPU before any command that depends on
+// them (execution, virtual memory accesses, breakpoints...).
+//
+typedef struct FDP_REGISTER_CACHE_CPU_
+{
+    uint64_t    Values[FDP_MAX_REGISTER_MASK_COUNT];
+    uint64_t    ValidMask;
+    uint64_t    DirtyMask;
+    uint64_t    PendingWriteCount;      //Write requests since the last flush
+} FDP_REGISTER_CACHE_CPU;
+
+struct FDP_REGISTER_CACHE_
+{
+    pthread_mutex_t             Mutex;
+    bool                        bVmStopped;
+    uint32_t                    CpuCount;
+    FDP_REGISTER_CACHE_CPU      *pCpus;
+    FDP_REGISTER_CACHE_STATS    Stats;
+};
+
+bool FDP_ReadRegistersInternal(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, uint64_t* pRegisterValues);
+bool FDP_WriteRegistersInternal(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, const uint64_t* pRegisterValues);
+
+//pValues is indexed by FDP_Register, returns the registers that aren't cached
+static uint64_t FDP_RegisterCacheLookup(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, uint64_t* pValues)
+{
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (pRegisterCache == NULL || CpuId >= pRegisterCache->CpuCount)
+    {
+        return RegisterMask;
+    }
+    uint64_t HitMask = 0;
+    pthread_mutex_lock(&pRegisterCache->Mutex);
+    {
+        FDP_REGISTER_CACHE_CPU* pCpu = &pRegisterCache->pCpus[CpuId];
+        if (pRegisterCache->bVmStopped)
+        {
+            HitMask = RegisterMask & pCpu->ValidMask;
+        }
+        for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+        {
+            if (HitMask & FDP_REGISTER_MASK(RegisterId))
+            {
+                pValues[RegisterId] = pCpu->Values[RegisterId];
+            }
+        }
+        pRegisterCache->Stats.ReadCount += __builtin_popcountll(RegisterMask);
+        pRegisterCache->Stats.HitCount += __builtin_popcountll(HitMask);
+    }
+    pthread_mutex_unlock(&pRegisterCache->Mutex);
+    return RegisterMask & ~HitMask;
+}
+
+//pValues is indexed by FDP_Register
+static void FDP_RegisterCacheStore(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, const uint64_t* pValues)
+{
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (pRegisterCache == NULL || CpuId >= pRegisterCache->CpuCount)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pRegisterCache->Mutex);
+    if (pRegisterCache->bVmStopped)
+    {
+        FDP_REGISTER_CACHE_CPU* pCpu = &pRegisterCache->pCpus[CpuId];
+        for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+        {
+            //Never overwrite a pending write
+            if ((RegisterMask & FDP_REGISTER_MASK(RegisterId)) && (pCpu->DirtyMask & FDP_REGISTER_MASK(RegisterId)) == 0)
+            {
+                pCpu->Values[RegisterId] = pValues[RegisterId];
+                pCpu->ValidMask |= FDP_REGISTER_MASK(RegisterId);
+            }
+        }
+    }
+    pthread_mutex_unlock(&pRegisterCache->Mutex);
+}
+
+//pValues is indexed by FDP_Register, returns false if the write must be sent right away
+static bool FDP_RegisterCacheWrite(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, const uint64_t* pValues)
+{
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (pRegisterCache == NULL || CpuId >= pRegisterCache->CpuCount)
+    {
+        return false;
+    }
+    bool bDeferred = false;
+    pthread_mutex_lock(&pRegisterCache->Mutex);
+    if (pRegisterCache->bVmStopped)
+    {
+        FDP_REGISTER_CACHE_CPU* pCpu = &pRegisterCache->pCpus[CpuId];
+        for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+        {
+            if (RegisterMask & FDP_REGISTER_MASK(RegisterId))
+            {
+                pCpu->Values[RegisterId] = pValues[RegisterId];
+            }
+        }
+        pCpu->ValidMask |= RegisterMask;
+        pCpu->DirtyMask |= RegisterMask;
+        pCpu->PendingWriteCount++;
+        pRegisterCache->Stats.WriteCount++;
+        bDeferred = true;
+    }
+    pthread_mutex_unlock(&pRegisterCache->Mutex);
+    return bDeferred;
+}
+
+static bool FDP_RegisterCacheFlush(FDP_SHM* pFDP)
+{
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (pRegisterCache == NULL)
+    {
+        return true;
+    }
+    bool bReturnValue = true;
+    for (uint32_t CpuId = 0; CpuId < pRegisterCache->CpuCount; CpuId++)
+    {
+        uint64_t DirtyMask;
+        uint64_t RegisterValues[FDP_MAX_REGISTER_MASK_COUNT];
+        uint32_t ValueCount = 0;
+        pthread_mutex_lock(&pRegisterCache->Mutex);
+        {
+            FDP_REGISTER_CACHE_CPU* pCpu = &pRegisterCache->pCpus[CpuId];
+            DirtyMask = pCpu->DirtyMask;
+            for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+            {
+                if (DirtyMask & FDP_REGISTER_MASK(RegisterId))
+                {
+                    RegisterValues[ValueCount++] = pCpu->Values[RegisterId];
+                }
+            }
+            if (DirtyMask != 0)
+            {
+                pRegisterCache->Stats.FlushCount++;
+                pRegisterCache->Stats.WritesSaved += pCpu->PendingWriteCount - 1;
+            }
+            pCpu->DirtyMask = 0;
+            pCpu->PendingWriteCount = 0;
+        }
+        pthread_mutex_unlock(&pRegisterCache->Mutex);
+        if (DirtyMask != 0 && FDP_WriteRegistersInternal(pFDP, CpuId, DirtyMask, RegisterValues) == false)
+        {
+            //Don't keep values the VM doesn't have
+            pthread_mutex_lock(&pRegisterCache->Mutex);
+            pRegisterCache->pCpus[CpuId].ValidMask = 0;
+            pthread_mutex_unlock(&pRegisterCache->Mutex);
+            bReturnValue = false;
+        }
+    }
+    return bReturnValue;
+}
+
+//Returns false if one of the pending writes failed, the cache is reset anyway
+static bool FDP_RegisterCacheReset(FDP_SHM* pFDP, bool bVmStopped)
+{
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (pRegisterCache == NULL)
+    {
+        return true;
+    }
+    bool bReturnValue = FDP_RegisterCacheFlush(pFDP);
+    pthread_mutex_lock(&pRegisterCache->Mutex);
+    {
+        pRegisterCache->bVmStopped = bVmStopped;
+        for (uint32_t CpuId = 0; CpuId < pRegisterCache->CpuCount; CpuId++)
+        {
+            pRegisterCache->pCpus[CpuId].ValidMask = 0;
+        }
+    }
+    pthread_mutex_unlock(&pRegisterCache->Mutex);
+    return bReturnValue;
+}
+
+//Pending writes are sent, then cached values are dropped
+static bool FDP_RegisterCacheInvalidate(FDP_SHM* pFDP)
+{
+    if (pFDP->pRegisterCache == NULL)
+    {
+        return true;
+    }
+    return FDP_RegisterCacheReset(pFDP, pFDP->pRegisterCache->bVmStopped);
+}
+
+static bool FDP_RegisterCacheSetVmStopped(FDP_SHM* pFDP, bool bVmStopped)
+{
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (pRegisterCache == NULL || pRegisterCache->bVmStopped == bVmStopped)
+    {
+        return true;
+    }
+    return FDP_RegisterCacheReset(pFDP, bVmStopped);
+}
+
+FDP_EXPORTED
+bool FDP_SetRegisterCache(FDP_SHM* pFDP, bool bEnable)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_REGISTER_CACHE* pRegisterCache = pFDP->pRegisterCache;
+    if (bEnable == false)
+    {
+        if (pRegisterCache != NULL)
+        {
+            FDP_RegisterCacheFlush(pFDP);
+            pFDP->pRegisterCache = NULL;
+            pthread_mutex_destroy(&pRegisterCache->Mutex);
+            free(pRegisterCache->pCpus);
+            free(pRegisterCache);
+        }
+        return true;
+    }
+    if (pRegisterCache != NULL)
+    {
+        return true;
+    }
+    uint32_t CpuCount = 0;
+    if (FDP_GetCpuCount(pFDP, &CpuCount) == false || CpuCount == 0)
+    {
+        return false;
+    }
+    pRegisterCache = (FDP_REGISTER_CACHE*)calloc(1, sizeof(FDP_REGISTER_CACHE));
+    if (pRegisterCache == NULL)
+    {
+        return false;
+    }
+    pRegisterCache->pCpus = (FDP_REGISTER_CACHE_CPU*)calloc(CpuCount, sizeof(FDP_REGISTER_CACHE_CPU));
+    if (pRegisterCache->pCpus == NULL)
+    {
+        free(pRegisterCache);
+        return false;
+    }
+    pRegisterCache->CpuCount = CpuCount;
+    pthread_mutex_init(&pRegisterCache->Mutex, NULL);
+    pFDP->pRegisterCache = pRegisterCache;
+    //Only cache once the VM is known to be stopped
+    FDP_State State = 0;
+    FDP_GetState(pFDP, &State);
+    return true;
+}
+
+//Sends pending register writes now, returns false if one of them failed
+FDP_EXPORTED
+bool FDP_FlushRegisterCache(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    return FDP_RegisterCacheFlush(pFDP);
+}
+
+//For registers changed behind this client's back (another client, the VM console...)
+FDP_EXPORTED
+void FDP_InvalidateRegisterCache(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+}
+
+FDP_EXPORTED
+bool FDP_GetRegisterCacheStats(FDP_SHM* pFDP, FDP_REGISTER_CACHE_STATS* pStats)
+{
+    if (pFDP == NULL || pFDP->pRegisterCache == NULL || pStats == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&pFDP->pRegisterCache->Mutex);
+    *pStats = pFDP->pRegisterCache->Stats;
+    pthread_mutex_unlock(&pFDP->pRegisterCache->Mutex);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_Pause(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    uint32_t InputBufferSize = 0;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_PAUSE_VM;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnValue)
+    {
+        FDP_ReadaheadSetVmStopped(pFDP, true);
+        FDP_RegisterCacheSetVmStopped(pFDP, true);
+    }
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_Resume(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    //The guest must not run without the registers written while it was paused
+    if (FDP_RegisterCacheSetVmStopped(pFDP, false) == false)
+    {
+        return false;
+    }
+    FDP_ReadaheadSetVmStopped(pFDP, false);
+    bool bReturnValue = false;
+    uint32_t InputBufferSize = 0;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_RESUME_VM;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_Reboot(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheSetVmStopped(pFDP, false);
+    FDP_ReadaheadSetVmStopped(pFDP, false);
+    bool bReturnValue = false;
+    uint32_t InputBufferSize = 0;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_REBOOT;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+bool FDP_ReadPhysicalMemoryInternal(FDP_SHM* pFDP, uint8_t* pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress)
+{
+    uint64_t ReceivedSize = 0;
+    bool bReturnCode = false;
+    FDP_READ_PHYSICAL_MEMORY_PKT_REQ tmpPkt;
+    tmpPkt.Type = FDPCMD_READ_PHYSICAL;
+    tmpPkt.PhysicalAddress = PhysicalAddress;
+    tmpPkt.ReadSize = ReadSize;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&tmpPkt, sizeof(FDP_READ_PHYSICAL_MEMORY_PKT_REQ));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pDstBuffer, &bReturnCode);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnCode;
+}
+
+FDP_EXPORTED
+bool FDP_ReadPhysicalMemory(FDP_SHM* pFDP, uint8_t* pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    uint32_t CurrentOffset = 0;
+    do
+    {
+        uint32_t CurrentReadSize = MIN(ReadSize, FDP_MAX_DATA_SIZE - 1);
+        if (FDP_ReadPhysicalMemoryInternal(pFDP, pDstBuffer + CurrentOffset, CurrentReadSize,
+                                           PhysicalAddress + CurrentOffset) == false)
+        {
+            return false;
+        }
+        CurrentOffset += CurrentReadSize;
+    }
+    while (CurrentOffset < ReadSize);
+    return true;
+}
+
+bool FDP_ReadVirtualMemoryInternal(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pDstBuffer, uint32_t ReadSize,
+                                   uint64_t VirtualAddress)
+{
+    uint32_t ReceivedSize = 0;
+    bool bReturnCode = false;
+    FDP_READ_VIRTUAL_MEMORY_PKT_REQ tmpPkt;
+    tmpPkt.Type = FDPCMD_READ_VIRTUAL;
+    tmpPkt.CpuId = CpuId;
+    tmpPkt.VirtualAddress = VirtualAddress;
+    tmpPkt.ReadSize = ReadSize;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&tmpPkt, sizeof(FDP_READ_PHYSICAL_MEMORY_PKT_REQ));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pDstBuffer, &bReturnCode);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnCode;
+}
+
+FDP_EXPORTED
+bool FDP_ReadVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pDstBuffer, uint32_t ReadSize,
+                           uint64_t VirtualAddress)
+{
+    if (pFDP == NULL || ReadSize <= 0)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    if (pFDP->pReadahead != NULL && pFDP->pReadahead->bVmStopped && ReadSize <= FDP_READAHEAD_MAX_CACHED_READ)
+    {
+        return FDP_ReadVirtualMemoryCached(pFDP, CpuId, pDstBuffer, ReadSize, VirtualAddress);
+    }
+    uint32_t CurrentOffset = 0;
+    do
+    {
+        uint32_t CurrentReadSize = MIN(ReadSize, FDP_MAX_DATA_SIZE - 1);
+        if (FDP_ReadVirtualMemoryInternal(pFDP, CpuId, pDstBuffer + CurrentOffset, CurrentReadSize,
+                                          VirtualAddress + CurrentOffset) == false)
+        {
+            return false;
+        }
+        CurrentOffset += CurrentReadSize;
+    }
+    while (CurrentOffset < ReadSize);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_WritePhysicalMemory(FDP_SHM* pFDP, uint8_t* pSrcBuffer, uint32_t WriteSize, uint64_t PhysicalAddress)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    uint32_t InputBufferSize = 0;
+    bool bReturnValue = false;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_WRITE_PHYSICAL_MEMORY_PKT_REQ* TempPkt = (FDP_WRITE_PHYSICAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_WRITE_PHYSICAL;
+        TempPkt->PhysicalAddress = PhysicalAddress;
+        TempPkt->WriteSize = WriteSize;
+        if (WriteSize < FDP_MAX_DATA_SIZE - sizeof(*TempPkt))
+        {
+            memcpy(TempPkt->Data, pSrcBuffer, WriteSize);
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)TempPkt,
+                         sizeof(FDP_READ_PHYSICAL_MEMORY_PKT_REQ) + WriteSize);
+            InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+
+FDP_EXPORTED
+bool FDP_WriteVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, uint8_t* pSrcBuffer, uint32_t WriteSize,
+                            uint64_t VirtualAddress)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    uint32_t InputBufferSize = 0;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_WRITE_VIRTUAL_MEMORY_PKT_REQ* TempPkt = (FDP_WRITE_VIRTUAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_WRITE_VIRTUAL;
+        TempPkt->CpuId = CpuId;
+        TempPkt->VirtualAddress = VirtualAddress;
+        TempPkt->WriteSize = WriteSize;
+        if (WriteSize < FDP_MAX_DATA_SIZE - sizeof(*TempPkt))
+        {
+            memcpy(TempPkt->Data, pSrcBuffer, WriteSize);
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                         sizeof(FDP_WRITE_VIRTUAL_MEMORY_PKT_REQ) + WriteSize);
+            InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+uint64_t FDP_SearchPhysicalMemory(FDP_SHM* pFDP, const void* pPatternData, uint32_t PatternSize, uint64_t StartOffset)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    uint64_t FoundAddress = 0x0;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_SEARCH_PHYSICAL_MEMORY_PKT_REQ* TempPkt = (FDP_SEARCH_PHYSICAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_SEARCH_PHYSICAL_MEMORY;
+        TempPkt->PatternSize = PatternSize;
+        TempPkt->StartOffset = StartOffset;
+        memcpy(TempPkt->PatternData, pPatternData, PatternSize);
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_SEARCH_PHYSICAL_MEMORY_PKT_REQ) + PatternSize);
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&FoundAddress); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return FoundAddress;
+}
+
+//TODO !
+FDP_EXPORTED
+bool FDP_SearchVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, const void* pPatternData, uint32_t PatternSize,
+                             uint64_t StartOffset)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    uint64_t FoundAddress = 0x0;
+    bool bReturnCode = false;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_SEARCH_VIRTUAL_MEMORY_PKT_REQ* TempPkt = (FDP_SEARCH_VIRTUAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_SEARCH_VIRTUAL_MEMORY;
+        TempPkt->CpuId = CpuId;
+        TempPkt->PatternSize = PatternSize;
+        TempPkt->StartOffset = StartOffset;
+        memcpy(TempPkt->PatternData, pPatternData, PatternSize);
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_SEARCH_VIRTUAL_MEMORY_PKT_REQ) + PatternSize);
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&FoundAddress); //TODO: return success/fail !
+        bReturnCode = true;
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnCode;
+}
+
+FDP_EXPORTED
+bool FDP_ReadRegister(FDP_SHM* pFDP, uint32_t CpuId, FDP_Register RegisterId, uint64_t* pRegisterValue)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bCacheable = pFDP->pRegisterCache != NULL && RegisterId < FDP_MAX_REGISTER_MASK_COUNT;
+    uint64_t CachedValues[FDP_MAX_REGISTER_MASK_COUNT];
+    if (bCacheable && FDP_RegisterCacheLookup(pFDP, CpuId, FDP_REGISTER_MASK(RegisterId), CachedValues) == 0)
+    {
+        *pRegisterValue = CachedValues[RegisterId];
+        return true;
+    }
+    //Fast way, the server keeps a context for each paused vCPU
+    if (CpuId < pFDP->CpuShmCount)
+    {
+        FDP_CPU_CTX* pCpuCtx = &pFDP->pCpuShm[CpuId];
+        volatile uint64_t* pCachedRegister = FDP_CpuCtxRegister(pCpuCtx, RegisterId);
+        if (pCachedRegister != NULL)
+        {
+            uint64_t Sequence;
+            uint64_t RegisterValue;
+            bool bValid;
+            do
+            {
+                Sequence = FDP_CpuCtxReadBegin(pCpuCtx);
+                bValid = pCpuCtx->Valid != 0;
+                RegisterValue = *pCachedRegister;
+            } while (FDP_CpuCtxReadRetry(pCpuCtx, Sequence));
+            if (bValid)
+            {
+                *pRegisterValue = RegisterValue;
+                return true;
+            }
+        }
+    }
+    //Old version => low performance
+    FDP_READ_REGISTER_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_READ_REGISTER;
+    TempPkt.CpuId = CpuId;
+    TempPkt.RegisterId = RegisterId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_READ_REGISTER_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pRegisterValue); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bCacheable)
+    {
+        CachedValues[RegisterId] = *pRegisterValue;
+        FDP_RegisterCacheStore(pFDP, CpuId, FDP_REGISTER_MASK(RegisterId), CachedValues);
+    }
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_GetCpuContext(FDP_SHM* pFDP, uint32_t CpuId, FDP_CPU_CTX* pCpuCtx)
+{
+    if (pFDP == NULL || pCpuCtx == NULL || CpuId >= pFDP->CpuShmCount)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    FDP_CPU_CTX* pSharedCpuCtx = &pFDP->pCpuShm[CpuId];
+    for (int Attempt = 0; Attempt < 2; Attempt++)
+    {
+        uint64_t Sequence;
+        do
+        {
+            Sequence = FDP_CpuCtxReadBegin(pSharedCpuCtx);
+            memcpy(pCpuCtx, (const void*)pSharedCpuCtx, sizeof(FDP_CPU_CTX));
+        } while (FDP_CpuCtxReadRetry(pSharedCpuCtx, Sequence));
+        if (pCpuCtx->Valid)
+        {
+            return true;
+        }
+        //A register read makes the server fill the context if the vCPU is paused
+        uint64_t Rip;
+        if (Attempt > 0 || FDP_ReadRegister(pFDP, CpuId, FDP_RIP_REGISTER, &Rip) == false)
+        {
+            break;
+        }
+    }
+    return false;
+}
+
+FDP_EXPORTED
+bool FDP_ReadMsr(FDP_SHM* pFDP, uint32_t CpuId, uint64_t MsrId, uint64_t* pMsrValue)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    FDP_READ_MSR_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_READ_MSR;
+    TempPkt.CpuId = CpuId;
+    TempPkt.MsrId = MsrId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_READ_MSR_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pMsrValue); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_WriteMsr(FDP_SHM* pFDP, uint32_t CpuId, uint64_t MsrId, uint64_t MsrValue)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    uint32_t InputBufferSize = 0;
+    FDP_WRITE_MSR_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_WRITE_MSR;
+    TempPkt.CpuId = CpuId;
+    TempPkt.MsrId = MsrId;
+    TempPkt.MsrValue = MsrValue;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_WRITE_MSR_PKT_REQ));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+#define FDP_MSRS_MAX_ENTRIES_PER_REQUEST \
+    ((FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_MSRS_PKT_REQ)) / sizeof(FDP_MSR_ENTRY))
+
+static bool FDP_TransferMsrs(FDP_SHM* pFDP, uint8_t Type, FDP_MSR_ENTRY* pEntries, uint32_t EntryCount)
+{
+    bool bReturnValue = true;
+    uint32_t CurrentEntry = 0;
+    while (CurrentEntry < EntryCount)
+    {
+        uint32_t CurrentEntryCount = MIN(EntryCount - CurrentEntry, FDP_MSRS_MAX_ENTRIES_PER_REQUEST);
+        uint32_t ReceivedSize = 0;
+        bool bReturnCode = false;
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            FDP_MSRS_PKT_REQ* TempPkt = (FDP_MSRS_PKT_REQ*)pFDP->OutputBuffer;
+            TempPkt->Type = Type;
+            TempPkt->EntryCount = CurrentEntryCount;
+            memcpy(TempPkt->Entries, pEntries + CurrentEntry, CurrentEntryCount * sizeof(FDP_MSR_ENTRY));
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                         sizeof(FDP_MSRS_PKT_REQ) + CurrentEntryCount * sizeof(FDP_MSR_ENTRY));
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (ReceivedSize == CurrentEntryCount * sizeof(FDP_MSR_ENTRY))
+            {
+                memcpy(pEntries + CurrentEntry, pFDP->InputBuffer, ReceivedSize);
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (ReceivedSize != CurrentEntryCount * sizeof(FDP_MSR_ENTRY))
+        {
+            for (uint32_t i = 0; i < CurrentEntryCount; i++)
+            {
+                pEntries[CurrentEntry + i].Status = FDP_MSR_FAILED;
+            }
+            bReturnCode = false;
+        }
+        bReturnValue = bReturnValue && bReturnCode;
+        CurrentEntry += CurrentEntryCount;
+    }
+    return bReturnValue;
+}
+
+//Returns true if every entry was read, see each entry Status otherwise
+FDP_EXPORTED
+bool FDP_ReadMsrs(FDP_SHM* pFDP, FDP_MSR_ENTRY* pEntries, uint32_t EntryCount)
+{
+    if (pFDP == NULL || pEntries == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    return FDP_TransferMsrs(pFDP, FDPCMD_READ_MSRS, pEntries, EntryCount);
+}
+
+//Entries are written in order, returns true if every entry was written
+FDP_EXPORTED
+bool FDP_WriteMsrs(FDP_SHM* pFDP, FDP_MSR_ENTRY* pEntries, uint32_t EntryCount)
+{
+    if (pFDP == NULL || pEntries == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    return FDP_TransferMsrs(pFDP, FDPCMD_WRITE_MSRS, pEntries, EntryCount);
+}
+
+FDP_EXPORTED
+bool FDP_WriteRegister(FDP_SHM* pFDP, uint32_t CpuId, FDP_Register RegisterId, uint64_t RegisterValue)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    if (pFDP->pRegisterCache != NULL && RegisterId < FDP_MAX_REGISTER_MASK_COUNT)
+    {
+        uint64_t CachedValues[FDP_MAX_REGISTER_MASK_COUNT];
+        CachedValues[RegisterId] = RegisterValue;
+        if (FDP_RegisterCacheWrite(pFDP, CpuId, FDP_REGISTER_MASK(RegisterId), CachedValues))
+        {
+            return true;
+        }
+    }
+    uint32_t InputBufferSize = 0;
+    bool bReturnValue = false;
+    FDP_WRITE_REGISTER_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_WRITE_REGISTER;
+    TempPkt.CpuId = CpuId;
+    TempPkt.RegisterId = RegisterId;
+    TempPkt.RegisterValue = RegisterValue;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_WRITE_REGISTER_PKT_REQ));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+bool FDP_ReadRegistersInternal(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, uint64_t* pRegisterValues)
+{
+    //Registers held by a valid shared context don't need a round trip
+    FDP_CPU_CTX CpuCtx;
+    uint64_t RemoteMask = RegisterMask;
+    if (CpuId < pFDP->CpuShmCount)
+    {
+        FDP_CPU_CTX* pSharedCpuCtx = &pFDP->pCpuShm[CpuId];
+        uint64_t Sequence;
+        do
+        {
+            Sequence = FDP_CpuCtxReadBegin(pSharedCpuCtx);
+            memcpy(&CpuCtx, (const void*)pSharedCpuCtx, sizeof(FDP_CPU_CTX));
+        } while (FDP_CpuCtxReadRetry(pSharedCpuCtx, Sequence));
+        if (CpuCtx.Valid)
+        {
+            for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+            {
+                if ((RegisterMask & FDP_REGISTER_MASK(RegisterId)) && FDP_CpuCtxRegister(&CpuCtx, RegisterId) != NULL)
+                {
+                    RemoteMask &= ~FDP_REGISTER_MASK(RegisterId);
+                }
+            }
+        }
+    }
+    uint64_t RemoteValues[FDP_MAX_REGISTER_MASK_COUNT];
+    if (RemoteMask != 0)
+    {
+        uint32_t ExpectedSize = __builtin_popcountll(RemoteMask) * sizeof(uint64_t);
+        uint32_t ReceivedSize = 0;
+        bool bReturnCode = false;
+        FDP_READ_REGISTERS_PKT_REQ TempPkt;
+        TempPkt.Type = FDPCMD_READ_REGISTERS;
+        TempPkt.CpuId = CpuId;
+        TempPkt.RegisterMask = RemoteMask;
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_READ_REGISTERS_PKT_REQ));
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (ReceivedSize == ExpectedSize)
+            {
+                memcpy(RemoteValues, pFDP->InputBuffer, ReceivedSize);
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (bReturnCode == false || ReceivedSize != ExpectedSize)
+        {
+            return false;
+        }
+    }
+    uint32_t ValueIndex = 0;
+    uint32_t RemoteIndex = 0;
+    for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+    {
+        if ((RegisterMask & FDP_REGISTER_MASK(RegisterId)) == 0)
+        {
+            continue;
+        }
+        if (RemoteMask & FDP_REGISTER_MASK(RegisterId))
+        {
+            pRegisterValues[ValueIndex++] = RemoteValues[RemoteIndex++];
+        }
+        else
+        {
+            pRegisterValues[ValueIndex++] = *FDP_CpuCtxRegister(&CpuCtx, RegisterId);
+        }
+    }
+    return true;
+}
+
+bool FDP_WriteRegistersInternal(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, const uint64_t* pRegisterValues)
+{
+    bool bReturnValue = false;
+    uint32_t ValueCount = __builtin_popcountll(RegisterMask);
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_WRITE_REGISTERS_PKT_REQ* TempPkt = (FDP_WRITE_REGISTERS_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_WRITE_REGISTERS;
+        TempPkt->CpuId = CpuId;
+        TempPkt->RegisterMask = RegisterMask;
+        memcpy(TempPkt->RegisterValues, pRegisterValues, ValueCount * sizeof(uint64_t));
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_WRITE_REGISTERS_PKT_REQ) + ValueCount * sizeof(uint64_t));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//pRegisterValues holds one value per bit set in RegisterMask, lowest FDP_Register first
+FDP_EXPORTED
+bool FDP_ReadRegisters(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, uint64_t* pRegisterValues)
+{
+    if (pFDP == NULL || pRegisterValues == NULL)
+    {
+        return false;
+    }
+    if (pFDP->pRegisterCache == NULL)
+    {
+        return FDP_ReadRegistersInternal(pFDP, CpuId, RegisterMask, pRegisterValues);
+    }
+    uint64_t CachedValues[FDP_MAX_REGISTER_MASK_COUNT];
+    uint64_t MissMask = FDP_RegisterCacheLookup(pFDP, CpuId, RegisterMask, CachedValues);
+    if (MissMask != 0)
+    {
+        uint64_t MissValues[FDP_MAX_REGISTER_MASK_COUNT];
+        if (FDP_ReadRegistersInternal(pFDP, CpuId, MissMask, MissValues) == false)
+        {
+            return false;
+        }
+        uint32_t MissIndex = 0;
+        for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+        {
+            if (MissMask & FDP_REGISTER_MASK(RegisterId))
+            {
+                CachedValues[RegisterId] = MissValues[MissIndex++];
+            }
+        }
+        FDP_RegisterCacheStore(pFDP, CpuId, MissMask, CachedValues);
+    }
+    uint32_t ValueIndex = 0;
+    for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+    {
+        if (RegisterMask & FDP_REGISTER_MASK(RegisterId))
+        {
+            pRegisterValues[ValueIndex++] = CachedValues[RegisterId];
+        }
+    }
+    return true;
+}
+
+//pRegisterValues holds one value per bit set in RegisterMask, lowest FDP_Register first
+FDP_EXPORTED
+bool FDP_WriteRegisters(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, const uint64_t* pRegisterValues)
+{
+    if (pFDP == NULL || pRegisterValues == NULL)
+    {
+        return false;
+    }
+    if (RegisterMask == 0)
+    {
+        return true;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    if (pFDP->pRegisterCache != NULL)
+    {
+        uint64_t CachedValues[FDP_MAX_REGISTER_MASK_COUNT];
+        uint32_t ValueIndex = 0;
+        for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+        {
+            if (RegisterMask & FDP_REGISTER_MASK(RegisterId))
+            {
+                CachedValues[RegisterId] = pRegisterValues[ValueIndex++];
+            }
+        }
+        if (FDP_RegisterCacheWrite(pFDP, CpuId, RegisterMask, CachedValues))
+        {
+            return true;
+        }
+    }
+    return FDP_WriteRegistersInternal(pFDP, CpuId, RegisterMask, pRegisterValues);
+}
+
+//Refused for the backend breakpoints of execute breakpoints and of the coverage, see FDP_RemoveExecuteBreakpoint
+FDP_EXPORTED
+bool FDP_UnsetBreakpoint(FDP_SHM* pFDP, uint8_t BreakpointId)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    uint32_t InputBufferSize = 0;
+    bool bReturnValue = false;
+    FDP_CLEAR_BREAKPOINT_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_UNSET_BP;
+    TempPkt.BreakpointId = BreakpointId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_CLEAR_BREAKPOINT_PKT_REQ));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+
+FDP_EXPORTED
+int FDP_SetBreakpoint(
+    FDP_SHM*             pFDP,
+    uint32_t            CpuId,
+    FDP_BreakpointType  BreakpointType,
+    uint8_t             BreakpointId,
+    FDP_Access          BreakpointAccessType,
+    FDP_AddressType     BreakpointAddressType,
+    uint64_t            BreakpointAddress,
+    uint64_t            BreakpointLength,
+    uint64_t            BreakpointCr3)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    uint32_t InputBufferSize = 0;
+    int iReturnedBreakpointId;
+    FDP_SET_BREAKPOINT_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_SET_BP;
+    TempPkt.CpuId = CpuId;
+    TempPkt.BreakpointType = BreakpointType;
+    TempPkt.BreakpointId = BreakpointId;
+    TempPkt.BreakpointAccessType = BreakpointAccessType;
+    TempPkt.BreakpointAddressType = BreakpointAddressType;
+    TempPkt.BreakpointAddress = BreakpointAddress;
+    TempPkt.BreakpointLength = BreakpointLength;
+    TempPkt.BreakpointCr3 = BreakpointCr3;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SET_BREAKPOINT_PKT_REQ));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&iReturnedBreakpointId);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return iReturnedBreakpointId;
+}
+
+#define FDP_SET_BREAKPOINTS_MAX_ENTRIES_PER_REQUEST \
+    ((FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_SET_BREAKPOINTS_PKT_REQ)) / sizeof(FDP_BREAKPOINT_ENTRY))
+#define FDP_UNSET_BREAKPOINTS_MAX_IDS_PER_REQUEST \
+    (FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_UNSET_BREAKPOINTS_PKT_REQ))
+
+//One command for many FDP_SetBreakpoint, returns true if every breakpoint was set, see each entry BreakpointId otherwise
+FDP_EXPORTED
+bool FDP_SetBreakpoints(FDP_SHM* pFDP, FDP_BREAKPOINT_ENTRY* pEntries, uint32_t EntryCount)
+{
+    if (pFDP == NULL || (pEntries == NULL && EntryCount > 0))
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = true;
+    uint32_t CurrentEntry = 0;
+    while (CurrentEntry < EntryCount)
+    {
+        uint32_t CurrentEntryCount = MIN(EntryCount - CurrentEntry, FDP_SET_BREAKPOINTS_MAX_ENTRIES_PER_REQUEST);
+        uint32_t ReceivedSize = 0;
+        bool bReturnCode = false;
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            FDP_SET_BREAKPOINTS_PKT_REQ* TempPkt = (FDP_SET_BREAKPOINTS_PKT_REQ*)pFDP->OutputBuffer;
+            TempPkt->Type = FDPCMD_SET_BREAKPOINTS;
+            TempPkt->EntryCount = CurrentEntryCount;
+            memcpy(TempPkt->Entries, pEntries + CurrentEntry, CurrentEntryCount * sizeof(FDP_BREAKPOINT_ENTRY));
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                         sizeof(FDP_SET_BREAKPOINTS_PKT_REQ) + CurrentEntryCount * sizeof(FDP_BREAKPOINT_ENTRY));
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (ReceivedSize == CurrentEntryCount * sizeof(FDP_BREAKPOINT_ENTRY))
+            {
+                memcpy(pEntries + CurrentEntry, pFDP->InputBuffer, ReceivedSize);
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (ReceivedSize != CurrentEntryCount * sizeof(FDP_BREAKPOINT_ENTRY))
+        {
+            for (uint32_t i = 0; i < CurrentEntryCount; i++)
+            {
+                pEntries[CurrentEntry + i].BreakpointId = -1;
+            }
+            bReturnCode = false;
+        }
+        bReturnValue = bReturnValue && bReturnCode;
+        CurrentEntry += CurrentEntryCount;
+    }
+    return bReturnValue;
+}
+
+//One command for many FDP_UnsetBreakpoint, pbUnset (optional) gets the result of each one
+FDP_EXPORTED
+bool FDP_UnsetBreakpoints(FDP_SHM* pFDP, const uint8_t* pBreakpointIds, uint32_t BreakpointCount, bool* pbUnset)
+{
+    if (pFDP == NULL || (pBreakpointIds == NULL && BreakpointCount > 0))
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = true;
+    uint32_t CurrentId = 0;
+    while (CurrentId < BreakpointCount)
+    {
+        uint32_t CurrentIdCount = MIN(BreakpointCount - CurrentId, FDP_UNSET_BREAKPOINTS_MAX_IDS_PER_REQUEST);
+        uint32_t ReceivedSize = 0;
+        bool bReturnCode = false;
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            FDP_UNSET_BREAKPOINTS_PKT_REQ* TempPkt = (FDP_UNSET_BREAKPOINTS_PKT_REQ*)pFDP->OutputBuffer;
+            TempPkt->Type = FDPCMD_UNSET_BREAKPOINTS;
+            TempPkt->BreakpointCount = CurrentIdCount;
+            memcpy(TempPkt->BreakpointIds, pBreakpointIds + CurrentId, CurrentIdCount);
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                         sizeof(FDP_UNSET_BREAKPOINTS_PKT_REQ) + CurrentIdCount);
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (ReceivedSize == CurrentIdCount * sizeof(bool) && pbUnset != NULL)
+            {
+                memcpy(pbUnset + CurrentId, pFDP->InputBuffer, ReceivedSize);
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (ReceivedSize != CurrentIdCount * sizeof(bool))
+        {
+            if (pbUnset != NULL)
+            {
+                memset(pbUnset + CurrentId, 0, CurrentIdCount * sizeof(bool));
+            }
+            bReturnCode = false;
+        }
+        bReturnValue = bReturnValue && bReturnCode;
+        CurrentId += CurrentIdCount;
+    }
+    return bReturnValue;
+}
+
+//Removes every breakpoint, execute breakpoints included, in one command
+FDP_EXPORTED
+bool FDP_UnsetAllBreakpoints(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_UNSET_ALL_BREAKPOINTS;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//The breakpoint only stops the VM when all conditions hold, ConditionCount 0 removes them
+FDP_EXPORTED
+bool FDP_SetBreakpointCondition(FDP_SHM* pFDP, int BreakpointId, const FDP_BREAKPOINT_CONDITION* pConditions, uint32_t ConditionCount)
+{
+    if (pFDP == NULL
+        || ConditionCount > FDP_MAX_BREAKPOINT_CONDITIONS
+        || (pConditions == NULL && ConditionCount > 0))
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_SET_BREAKPOINT_CONDITION_PKT_REQ* TempPkt = (FDP_SET_BREAKPOINT_CONDITION_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_SET_BREAKPOINT_CONDITION;
+        TempPkt->BreakpointId = BreakpointId;
+        TempPkt->ConditionCount = ConditionCount;
+        if (ConditionCount > 0)
+        {
+            memcpy(TempPkt->Conditions, pConditions, ConditionCount * sizeof(FDP_BREAKPOINT_CONDITION));
+        }
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_SET_BREAKPOINT_CONDITION_PKT_REQ) + ConditionCount * sizeof(FDP_BREAKPOINT_CONDITION));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//Hits before the conditions are installed stop the VM, set it while the VM is paused
+FDP_EXPORTED
+int FDP_SetConditionalBreakpoint(
+    FDP_SHM*                        pFDP,
+    uint32_t                        CpuId,
+    FDP_BreakpointType              BreakpointType,
+    uint8_t                         BreakpointId,
+    FDP_Access                      BreakpointAccessType,
+    FDP_AddressType                 BreakpointAddressType,
+    uint64_t                        BreakpointAddress,
+    uint64_t                        BreakpointLength,
+    uint64_t                        BreakpointCr3,
+    const FDP_BREAKPOINT_CONDITION* pConditions,
+    uint32_t                        ConditionCount)
+{
+    int iBreakpointId = FDP_SetBreakpoint(pFDP, CpuId, BreakpointType, BreakpointId, BreakpointAccessType,
+                                          BreakpointAddressType, BreakpointAddress, BreakpointLength, BreakpointCr3);
+    if (iBreakpointId < 0)
+    {
+        return iBreakpointId;
+    }
+    if (FDP_SetBreakpointCondition(pFDP, iBreakpointId, pConditions, ConditionCount) == false)
+    {
+        FDP_UnsetBreakpoint(pFDP, (uint8_t)iBreakpointId);
+        return -1;
+    }
+    return iBreakpointId;
+}
+
+FDP_EXPORTED
+bool FDP_VirtualToPhysical(FDP_SHM* pFDP, uint32_t CpuId, uint64_t VirtualAddress, uint64_t* PhysicalAddress)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    FDP_VIRTUAL_PHYSICAL_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_VIRTUAL_PHYSICAL;
+    TempPkt.CpuId = CpuId;
+    TempPkt.VirtualAddress = VirtualAddress;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_VIRTUAL_PHYSICAL_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)PhysicalAddress); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_GetState(FDP_SHM* pFDP, FDP_State* DebuggeeState)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_GET_STATE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_GET_STATE;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_GET_STATE_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)DebuggeeState); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    FDP_ReadaheadSetVmStopped(pFDP, (*DebuggeeState & FDP_STATE_PAUSED) != 0);
+    FDP_RegisterCacheSetVmStopped(pFDP, (*DebuggeeState & FDP_STATE_PAUSED) != 0);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_WaitForStateChanged(FDP_SHM *pFDP, FDP_State *DebuggeeState)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    while (true)
+    {
+        usleep(0);
+        if (FDP_GetStateChanged(pFDP) == true)
+        {
+            return FDP_GetState(pFDP, DebuggeeState);
+        }
+    }
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_Init(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = true;
+    memset(pFDP->pSharedFDPSHM, 0, FDP_SHM_SHARED_SIZE);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_SingleStep(FDP_SHM* pFDP, uint32_t CpuId)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    if (FDP_RegisterCacheInvalidate(pFDP) == false)
+    {
+        return false;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    uint32_t InputBufferSize = 0;
+    FDP_SINGLE_STEP_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_SINGLE_STEP;
+    TempPkt.CpuId = CpuId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SINGLE_STEP_PKT_REQ));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//Steps CpuId StepCount times in the server, or until all the stop conditions hold after a step.
+//pTrace (optional) gets RIP then the RegisterMask registers after each step, lowest FDP_Register first.
+//A CPU that can't be stepped ends the trace with FDP_STEP_END_ERROR, the steps made so far are kept
+FDP_EXPORTED
+bool FDP_SingleStepN(FDP_SHM* pFDP, uint32_t CpuId, uint32_t StepCount, uint64_t RegisterMask,
+                     const FDP_BREAKPOINT_CONDITION* pStopConditions, uint32_t StopConditionCount, uint64_t* pTrace,
+                     uint32_t* pStepCount, uint32_t* pEndReason)
+{
+    if (pFDP == NULL || pStepCount == NULL || StopConditionCount > FDP_MAX_BREAKPOINT_CONDITIONS
+        || (pStopConditions == NULL && StopConditionCount > 0))
+    {
+        return false;
+    }
+    if (FDP_RegisterCacheInvalidate(pFDP) == false)
+    {
+        return false;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    uint32_t ValueCount = pTrace != NULL ? 1 + __builtin_popcountll(RegisterMask) : 0;
+    uint32_t EndReason = FDP_STEP_END_COUNT;
+    *pStepCount = 0;
+    while (*pStepCount < StepCount)
+    {
+        bool bReturnCode = false;
+        uint32_t ReceivedSize = 0;
+        FDP_SINGLE_STEP_N_PKT_RSP Rsp = { 0, FDP_STEP_END_ERROR };
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            FDP_SINGLE_STEP_N_PKT_REQ* TempPkt = (FDP_SINGLE_STEP_N_PKT_REQ*)pFDP->OutputBuffer;
+            TempPkt->Type = FDPCMD_SINGLE_STEP_N;
+            TempPkt->CpuId = CpuId;
+            TempPkt->StepCount = StepCount - *pStepCount;
+            TempPkt->bTrace = ValueCount > 0;
+            TempPkt->RegisterMask = RegisterMask;
+            TempPkt->ConditionCount = StopConditionCount;
+            memcpy(TempPkt->Conditions, pStopConditions, StopConditionCount * sizeof(FDP_BREAKPOINT_CONDITION));
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                         sizeof(FDP_SINGLE_STEP_N_PKT_REQ) + StopConditionCount * sizeof(FDP_BREAKPOINT_CONDITION));
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (bReturnCode && ReceivedSize >= sizeof(Rsp))
+            {
+                memcpy(&Rsp, pFDP->InputBuffer, sizeof(Rsp));
+                uint64_t TraceSize = (uint64_t)Rsp.StepCount * ValueCount * sizeof(uint64_t);
+                if (Rsp.StepCount > StepCount - *pStepCount || ReceivedSize != sizeof(Rsp) + TraceSize)
+                {
+                    bReturnCode = false;
+                }
+                else if (TraceSize > 0)
+                {
+                    memcpy(pTrace + (uint64_t)*pStepCount * ValueCount, pFDP->InputBuffer + sizeof(Rsp), TraceSize);
+                }
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (bReturnCode == false || ReceivedSize < sizeof(Rsp))
+        {
+            return false;
+        }
+        *pStepCount += Rsp.StepCount;
+        EndReason = Rsp.EndReason;
+        if (EndReason != FDP_STEP_END_COUNT || Rsp.StepCount == 0)
+        {
+            break;
+        }
+    }
+    if (pEndReason != NULL)
+    {
+        *pEndReason = EndReason;
+    }
+    return true;
+}
+
+//Steps CpuId until one of the Flags predicates holds or MaxStepCount steps are made, the RIP range is only used
+//by FDP_STEP_UNTIL_RIP_INSIDE and FDP_STEP_UNTIL_RIP_OUTSIDE
+FDP_EXPORTED
+bool FDP_StepUntil(FDP_SHM* pFDP, uint32_t CpuId, uint32_t Flags, uint64_t RangeStart, uint64_t RangeEnd,
+                   uint32_t MaxStepCount, FDP_STEP_UNTIL_RESULT* pResult)
+{
+    if (pFDP == NULL || pResult == NULL)
+    {
+        return false;
+    }
+    if (FDP_RegisterCacheInvalidate(pFDP) == false)
+    {
+        return false;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnCode = false;
+    uint32_t ReceivedSize = 0;
+    FDP_STEP_UNTIL_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_STEP_UNTIL;
+    TempPkt.CpuId = CpuId;
+    TempPkt.Flags = Flags;
+    TempPkt.MaxStepCount = MaxStepCount;
+    TempPkt.RangeStart = RangeStart;
+    TempPkt.RangeEnd = RangeEnd;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_STEP_UNTIL_PKT_REQ));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+        if (bReturnCode && ReceivedSize == sizeof(FDP_STEP_UNTIL_RESULT))
+        {
+            memcpy(pResult, pFDP->InputBuffer, sizeof(FDP_STEP_UNTIL_RESULT));
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnCode && ReceivedSize == sizeof(FDP_STEP_UNTIL_RESULT);
+}
+
+uint8_t FDP_Test(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    uint8_t DebuggeState;
+    FDP_GET_STATE_PKT_REQ* tmpPkt = (FDP_GET_STATE_PKT_REQ*)pFDP->OutputBuffer;
+    tmpPkt->Type = FDPCMD_TEST;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_GET_STATE_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&DebuggeState); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return DebuggeState;
+}
+
+
+FDP_EXPORTED
+bool FDP_GetFxState64(FDP_SHM* pFDP, uint32_t CpuId, FDP_XSAVE_FORMAT64_T* pFxState)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_GET_STATE_PKT_REQ* TempPkt = (FDP_GET_STATE_PKT_REQ*)pFDP->OutputBuffer;
+    TempPkt->Type = FDPCMD_GET_FXSTATE;
+    TempPkt->CpuId = CpuId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_GET_STATE_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pFxState); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_SetFxState64(FDP_SHM* pFDP, uint32_t CpuId, FDP_XSAVE_FORMAT64_T* pFxState64)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    FDP_SET_FX_STATE_REQ* TempPkt = (FDP_SET_FX_STATE_REQ*)pFDP->OutputBuffer;
+    TempPkt->Type = FDPCMD_SET_FXSTATE;
+    TempPkt->CpuId = CpuId;
+    memcpy(&TempPkt->FxState64, pFxState64, sizeof(FDP_XSAVE_FORMAT64_T));
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_SET_FX_STATE_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//
+// XSAVE state. Components use the standard (non compacted) layout, and the
+// client keeps the last state read from each vCPU so that the server only
+// sends back components whose hash changed.
+//
+typedef struct FDP_XSTATE_COMPONENT_
+{
+    uint64_t    Mask;
+    uint32_t    Offset;
+    uint32_t    Size;
+} FDP_XSTATE_COMPONENT;
+
+static const FDP_XSTATE_COMPONENT FDP_XStateComponents[] =
+{
+    { FDP_XSTATE_X87 | FDP_XSTATE_SSE, 0, 512 },    //x87 and SSE share the legacy region (MXCSR)
+    { FDP_XSTATE_AVX, 576, 256 },
+    { FDP_XSTATE_BNDREGS, 960, 64 },
+    { FDP_XSTATE_BNDCSR, 1024, 16 },
+    { FDP_XSTATE_OPMASK, 1088, 64 },
+    { FDP_XSTATE_ZMM_HI256, 1152, 512 },
+    { FDP_XSTATE_HI16_ZMM, 1664, 1024 },
+    { FDP_XSTATE_PKRU, 2688, 8 },
+};
+
+#define FDP_XSTATE_COMPONENT_COUNT  (sizeof(FDP_XStateComponents) / sizeof(FDP_XStateComponents[0]))
+#define FDP_XSTATE_MAX_CACHED_CPUS  256     //Reads from other vCPUs always carry every component
+
+struct FDP_XSTATE_CACHE_
+{
+    uint64_t    ValidMask;
+    uint64_t    Hashes[FDP_XSTATE_COMPONENT_COUNT];
+    uint8_t     XsaveArea[FDP_XSAVE_AREA_SIZE];
+};
+
+FDP_EXPORTED
+bool FDP_GetXStateLayout(uint32_t Component, uint32_t* pOffset, uint32_t* pSize)
+{
+    if (Component >= 64 || pOffset == NULL || pSize == NULL)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+    {
+        if (FDP_XStateComponents[i].Mask & (1ULL << Component))
+        {
+            *pOffset = FDP_XStateComponents[i].Offset;
+            *pSize = FDP_XStateComponents[i].Size;
+            return true;
+        }
+    }
+    return false;
+}
+
+static FDP_XSTATE_CACHE* FDP_XStateCacheGet(FDP_SHM* pFDP, uint32_t CpuId)
+{
+    if (CpuId >= FDP_XSTATE_MAX_CACHED_CPUS)
+    {
+        return NULL;
+    }
+    if (CpuId >= pFDP->XStateCacheCount)
+    {
+        FDP_XSTATE_CACHE* pXStateCache = (FDP_XSTATE_CACHE*)realloc(pFDP->pXStateCache,
+                                         (CpuId + 1) * sizeof(FDP_XSTATE_CACHE));
+        if (pXStateCache == NULL)
+        {
+            return NULL;
+        }
+        memset(pXStateCache + pFDP->XStateCacheCount, 0,
+               (CpuId + 1 - pFDP->XStateCacheCount) * sizeof(FDP_XSTATE_CACHE));
+        pFDP->pXStateCache = pXStateCache;
+        pFDP->XStateCacheCount = CpuId + 1;
+    }
+    return &pFDP->pXStateCache[CpuId];
+}
+
+static void FDP_XStateCacheUpdate(FDP_XSTATE_CACHE* pXStateCache, uint32_t Index, const uint8_t* pComponent)
+{
+    const FDP_XSTATE_COMPONENT* pComponentInfo = &FDP_XStateComponents[Index];
+    memcpy(pXStateCache->XsaveArea + pComponentInfo->Offset, pComponent, pComponentInfo->Size);
+    pXStateCache->Hashes[Index] = FDP_HashBuffer(FDP_HASH_XXH64, pComponent, pComponentInfo->Size);
+    pXStateCache->ValidMask |= pComponentInfo->Mask;
+}
+
+//pXsaveArea is FDP_XSAVE_AREA_SIZE bytes, components that aren't present are left untouched
+FDP_EXPORTED
+bool FDP_GetXState(FDP_SHM* pFDP, uint32_t CpuId, uint64_t ComponentMask, uint8_t* pXsaveArea, uint64_t* pPresentMask)
+{
+    if (pFDP == NULL || pXsaveArea == NULL)
+    {
+        return false;
+    }
+    FDP_XSTATE_CACHE* pXStateCache = FDP_XStateCacheGet(pFDP, CpuId);
+    uint64_t KnownMask = pXStateCache != NULL ? pXStateCache->ValidMask & ComponentMask : 0;
+    bool bReturnValue = false;
+    uint64_t PresentMask = 0;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_GET_XSTATE_PKT_REQ* TempPkt = (FDP_GET_XSTATE_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_GET_XSTATE;
+        TempPkt->CpuId = CpuId;
+        TempPkt->ComponentMask = ComponentMask;
+        TempPkt->KnownMask = KnownMask;
+        uint32_t KnownCount = 0;
+        for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+        {
+            if (FDP_XStateComponents[i].Mask & KnownMask)
+            {
+                TempPkt->KnownHashes[KnownCount++] = pXStateCache->Hashes[i];
+            }
+        }
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_GET_XSTATE_PKT_REQ) + KnownCount * sizeof(uint64_t));
+        uint32_t ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnValue);
+        FDP_GET_XSTATE_PKT_RSP* TempRsp = (FDP_GET_XSTATE_PKT_RSP*)pFDP->InputBuffer;
+        uint32_t ExpectedSize = sizeof(FDP_GET_XSTATE_PKT_RSP);
+        if (bReturnValue && ReceivedSize >= sizeof(FDP_GET_XSTATE_PKT_RSP))
+        {
+            for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+            {
+                if (FDP_XStateComponents[i].Mask & TempRsp->SentMask)
+                {
+                    ExpectedSize += FDP_XStateComponents[i].Size;
+                }
+            }
+        }
+        if (bReturnValue && ReceivedSize >= sizeof(FDP_GET_XSTATE_PKT_RSP) && ReceivedSize == ExpectedSize)
+        {
+            const uint8_t* pComponent = pFDP->InputBuffer + sizeof(FDP_GET_XSTATE_PKT_RSP);
+            PresentMask = TempRsp->PresentMask;
+            for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+            {
+                const FDP_XSTATE_COMPONENT* pComponentInfo = &FDP_XStateComponents[i];
+                if (pComponentInfo->Mask & TempRsp->SentMask)
+                {
+                    memcpy(pXsaveArea + pComponentInfo->Offset, pComponent, pComponentInfo->Size);
+                    if (pXStateCache != NULL)
+                    {
+                        FDP_XStateCacheUpdate(pXStateCache, i, pComponent);
+                    }
+                    pComponent += pComponentInfo->Size;
+                }
+                else if (pComponentInfo->Mask & KnownMask & PresentMask)
+                {
+                    //Unchanged since the last read
+                    memcpy(pXsaveArea + pComponentInfo->Offset, pXStateCache->XsaveArea + pComponentInfo->Offset,
+                           pComponentInfo->Size);
+                }
+            }
+        }
+        else
+        {
+            bReturnValue = false;
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnValue == false)
+    {
+        return false;
+    }
+    *(uint64_t*)(pXsaveArea + FDP_XSAVE_HEADER_OFFSET) = ComponentMask & PresentMask;
+    if (pPresentMask != NULL)
+    {
+        *pPresentMask = PresentMask;
+    }
+    return true;
+}
+
+//pXsaveArea is FDP_XSAVE_AREA_SIZE bytes
+FDP_EXPORTED
+bool FDP_SetXState(FDP_SHM* pFDP, uint32_t CpuId, uint64_t ComponentMask, const uint8_t* pXsaveArea)
+{
+    if (pFDP == NULL || pXsaveArea == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_SET_XSTATE_PKT_REQ* TempPkt = (FDP_SET_XSTATE_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_SET_XSTATE;
+        TempPkt->CpuId = CpuId;
+        TempPkt->ComponentMask = ComponentMask;
+        uint8_t* pComponent = pFDP->OutputBuffer + sizeof(FDP_SET_XSTATE_PKT_REQ);
+        for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+        {
+            if (FDP_XStateComponents[i].Mask & ComponentMask)
+            {
+                memcpy(pComponent, pXsaveArea + FDP_XStateComponents[i].Offset, FDP_XStateComponents[i].Size);
+                pComponent += FDP_XStateComponents[i].Size;
+            }
+        }
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, (uint32_t)(pComponent - pFDP->OutputBuffer));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    FDP_XSTATE_CACHE* pXStateCache = FDP_XStateCacheGet(pFDP, CpuId);
+    for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT && pXStateCache != NULL; i++)
+    {
+        if (FDP_XStateComponents[i].Mask & ComponentMask)
+        {
+            if (bReturnValue)
+            {
+                //The next read only needs to confirm what was written
+                FDP_XStateCacheUpdate(pXStateCache, i, pXsaveArea + FDP_XStateComponents[i].Offset);
+            }
+            else
+            {
+                pXStateCache->ValidMask &= ~FDP_XStateComponents[i].Mask;
+            }
+        }
+    }
+    return bReturnValue;
+}
+
+
+FDP_EXPORTED
+bool FDP_GetPhysicalMemorySize(FDP_SHM* pFDP, uint64_t* PhysicalMemorySize)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = true;
+    uint32_t InputBufferSize = 0;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_GET_MEMORYSIZE;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)PhysicalMemorySize);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    //TODO return bool !
+    return bReturnValue;
+}
+
+
+FDP_EXPORTED
+bool FDP_GetCpuCount(FDP_SHM* pFDP, uint32_t* CPUCount)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = true;
+    uint32_t InputBufferSize = 0;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_GET_CPU_COUNT;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)CPUCount);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_GetCpuState(FDP_SHM* pFDP, uint32_t CpuId, FDP_State* pDebuggeeState)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_GET_CPU_STATE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_GET_CPU_STATE;
+    TempPkt.CpuId = CpuId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_GET_CPU_STATE_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pDebuggeeState); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return true;
+}
+
+//State, RIP, RSP, CR3 and hit breakpoint of every CPU in one round trip, pState can be NULL
+FDP_EXPORTED
+bool FDP_GetAllCpuStates(FDP_SHM* pFDP, FDP_State* pState, FDP_CPU_STATE_ENTRY* pCpuStates, uint32_t MaxCpuCount,
+                         uint32_t* pCpuCount)
+{
+    if (pFDP == NULL || pCpuStates == NULL || pCpuCount == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_GET_ALL_CPU_STATES;
+    uint32_t ReceivedSize = 0;
+    uint8_t State = 0;
+    bool bReturnCode = false;
+    FDP_GET_ALL_CPU_STATES_PKT_RSP* pRsp = (FDP_GET_ALL_CPU_STATES_PKT_RSP*)pFDP->InputBuffer;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SIMPLE_PKT_REQ));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+        if (bReturnCode == false
+            || ReceivedSize < sizeof(FDP_GET_ALL_CPU_STATES_PKT_RSP)
+            || ReceivedSize != sizeof(FDP_GET_ALL_CPU_STATES_PKT_RSP) + pRsp->CpuCount * sizeof(FDP_CPU_STATE_ENTRY))
+        {
+            bReturnCode = false;
+        }
+        else
+        {
+            memcpy(pCpuStates, pRsp->CpuStates, MIN(pRsp->CpuCount, MaxCpuCount) * sizeof(FDP_CPU_STATE_ENTRY));
+            *pCpuCount = pRsp->CpuCount;
+            State = pRsp->State;
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnCode == false)
+    {
+        return false;
+    }
+    if (pState != NULL)
+    {
+        *pState = State;
+    }
+    FDP_ReadaheadSetVmStopped(pFDP, (State & FDP_STATE_PAUSED) != 0);
+    FDP_RegisterCacheSetVmStopped(pFDP, (State & FDP_STATE_PAUSED) != 0);
+    //*pCpuCount is the real count, only MaxCpuCount entries were filled
+    return *pCpuCount <= MaxCpuCount;
+}
+
+
+//
+// Tracepoints. A tracepoint is a breakpoint that appends a FDP_HIT_RECORD to
+// the shared hit log and lets the guest go on, the backend asks
+// FDP_ServerBreakpointHit at each hit whether the VM has to stop. Any number
+// of vCPUs append concurrently, one client at a time drains the log.
+//
+static bool FDP_HitLogAppend(FDP_HIT_LOG* pHitLog, const FDP_HIT_RECORD* pRecord)
+{
+    uint64_t Mask = pHitLog->RecordCount - 1;
+    uint64_t Position = pHitLog->WriteIndex;
+    for (;;)
+    {
+        FDP_HIT_LOG_SLOT* pSlot = &pHitLog->Slots[Position & Mask];
+        int64_t Difference = (int64_t)(pSlot->Sequence - Position);
+        if (Difference == 0)
+        {
+            if (__sync_bool_compare_and_swap(&pHitLog->WriteIndex, Position, Position + 1))
+            {
+                memcpy(&pSlot->Record, pRecord, sizeof(FDP_HIT_RECORD));
+                __sync_synchronize();
+                pSlot->Sequence = Position + 1;
+                return true;
+            }
+        }
+        else if (Difference < 0)
+        {
+            //The client doesn't drain fast enough
+            __sync_fetch_and_add(&pHitLog->DroppedCount, 1);
+            return false;
+        }
+        Position = pHitLog->WriteIndex;
+    }
+}
+
+//Flags 0 turns the tracepoint back into a regular breakpoint
+FDP_EXPORTED
+bool FDP_SetTracepoint(FDP_SHM* pFDP, int BreakpointId, uint32_t Flags, uint64_t RegisterMask)
+{
+    if (pFDP == NULL || __builtin_popcountll(RegisterMask) > FDP_HIT_LOG_MAX_REGISTERS)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    FDP_SET_TRACEPOINT_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_SET_TRACEPOINT;
+    TempPkt.BreakpointId = BreakpointId;
+    TempPkt.Flags = Flags;
+    TempPkt.RegisterMask = RegisterMask;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SET_TRACEPOINT_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+static bool FDP_SendAggregationRequest(FDP_SHM* pFDP, uint8_t Type, int AggregationId, int BreakpointId)
+{
+    bool bReturnValue = false;
+    FDP_AGGREGATION_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = Type;
+    TempPkt.AggregationId = AggregationId;
+    TempPkt.BreakpointId = BreakpointId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_AGGREGATION_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//Counts the hits of the breakpoints it is attached to by KeyType, the hits then only stop the VM with
+//FDP_TRACEPOINT_STOP. Returns the aggregation id, or -1 on failure
+FDP_EXPORTED
+int FDP_CreateAggregation(FDP_SHM* pFDP, uint32_t KeyType, int32_t StackOffset, uint32_t MaxKeyCount)
+{
+    if (pFDP == NULL)
+    {
+        return -1;
+    }
+    int AggregationId = -1;
+    FDP_AGGREGATION_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = FDPCMD_CREATE_AGGREGATION;
+    TempPkt.KeyType = KeyType;
+    TempPkt.StackOffset = StackOffset;
+    TempPkt.MaxKeyCount = MaxKeyCount;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_AGGREGATION_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&AggregationId);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return AggregationId;
+}
+
+//The aggregation is detached from all its breakpoints first
+FDP_EXPORTED
+bool FDP_DeleteAggregation(FDP_SHM* pFDP, int AggregationId)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    return FDP_SendAggregationRequest(pFDP, FDPCMD_DELETE_AGGREGATION, AggregationId, -1);
+}
+
+//AggregationId -1 detaches the current aggregation, several breakpoints can share one
+FDP_EXPORTED
+bool FDP_AttachAggregation(FDP_SHM* pFDP, int BreakpointId, int AggregationId)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    return FDP_SendAggregationRequest(pFDP, FDPCMD_ATTACH_AGGREGATION, AggregationId, BreakpointId);
+}
+
+//Fails with more than MaxCount keys, size pEntries for the MaxKeyCount of the aggregation. bReset clears the
+//counts in the same request so no hit is lost or counted twice. pDroppedCount receives the hits that found the
+//aggregation full or had an unreadable key
+FDP_EXPORTED
+bool FDP_GetAggregation(FDP_SHM* pFDP, int AggregationId, bool bReset, FDP_AGGREGATION_ENTRY* pEntries, uint32_t MaxCount,
+                        uint32_t* pEntryCount, uint64_t* pDroppedCount)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnCode = false;
+    uint32_t ReceivedSize = 0;
+    FDP_GET_AGGREGATION_PKT_RSP Rsp;
+    memset(&Rsp, 0, sizeof(Rsp));
+    FDP_AGGREGATION_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = FDPCMD_GET_AGGREGATION;
+    TempPkt.AggregationId = AggregationId;
+    TempPkt.bReset = bReset;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_AGGREGATION_PKT_REQ));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+        if (bReturnCode && ReceivedSize >= sizeof(FDP_GET_AGGREGATION_PKT_RSP))
+        {
+            memcpy(&Rsp, pFDP->InputBuffer, sizeof(FDP_GET_AGGREGATION_PKT_RSP));
+            if (pEntries != NULL && Rsp.EntryCount <= MaxCount)
+            {
+                memcpy(pEntries, pFDP->InputBuffer + sizeof(FDP_GET_AGGREGATION_PKT_RSP), Rsp.EntryCount * sizeof(FDP_AGGREGATION_ENTRY));
+            }
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnCode == false
+        || ReceivedSize != sizeof(FDP_GET_AGGREGATION_PKT_RSP) + Rsp.EntryCount * sizeof(FDP_AGGREGATION_ENTRY))
+    {
+        return false;
+    }
+    if (pEntryCount != NULL)
+    {
+        *pEntryCount = Rsp.EntryCount;
+    }
+    if (pDroppedCount != NULL)
+    {
+        *pDroppedCount = Rsp.DroppedCount;
+    }
+    return pEntries == NULL || Rsp.EntryCount <= MaxCount;
+}
+
+FDP_EXPORTED
+bool FDP_ResetAggregation(FDP_SHM* pFDP, int AggregationId)
+{
+    return FDP_GetAggregation(pFDP, AggregationId, true, NULL, 0, NULL, NULL);
+}
+
+//Page breakpoint on [Address, Address + Length), the server drops the hits outside of the range. Flags are
+//FDP_TracepointFlags, 0 stops the VM at each hit. Unset it with FDP_UnsetBreakpoint
+FDP_EXPORTED
+int FDP_SetWatchpoint(FDP_SHM* pFDP, uint32_t CpuId, FDP_Access Access, FDP_AddressType AddressType, uint64_t Address,
+                      uint64_t Length, uint64_t Cr3, uint32_t Flags)
+{
+    if (pFDP == NULL)
+    {
+        return -1;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    int iReturnedBreakpointId = -1;
+    FDP_SET_WATCHPOINT_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_SET_WATCHPOINT;
+    TempPkt.CpuId = CpuId;
+    TempPkt.Access = Access;
+    TempPkt.AddressType = AddressType;
+    TempPkt.Flags = Flags;
+    TempPkt.Address = Address;
+    TempPkt.Length = Length;
+    TempPkt.Cr3 = Cr3;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SET_WATCHPOINT_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&iReturnedBreakpointId);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return iReturnedBreakpointId;
+}
+
+//Returns the number of records copied to pRecords, oldest first
+FDP_EXPORTED
+uint32_t FDP_DrainHitLog(FDP_SHM* pFDP, FDP_HIT_RECORD* pRecords, uint32_t MaxCount)
+{
+    if (pFDP == NULL || pFDP->pHitLog == NULL || pRecords == NULL)
+    {
+        return 0;
+    }
+    FDP_HIT_LOG* pHitLog = pFDP->pHitLog;
+    uint64_t Mask = pHitLog->RecordCount - 1;
+    uint32_t Count = 0;
+    ttas_spinlock_lock(&pHitLog->DrainLock);
+    {
+        uint64_t Position = pHitLog->ReadIndex;
+        while (Count < MaxCount)
+        {
+            FDP_HIT_LOG_SLOT* pSlot = &pHitLog->Slots[Position & Mask];
+            if ((int64_t)(pSlot->Sequence - (Position + 1)) < 0)
+            {
+                //Not written yet
+                break;
+            }
+            __sync_synchronize();
+            memcpy(&pRecords[Count++], &pSlot->Record, sizeof(FDP_HIT_RECORD));
+            __sync_synchronize();
+            pSlot->Sequence = Position + pHitLog->RecordCount;
+            Position++;
+        }
+        pHitLog->ReadIndex = Position;
+    }
+    ttas_spinlock_unlock(&pHitLog->DrainLock);
+    return Count;
+}
+
+FDP_EXPORTED
+bool FDP_GetHitLogStats(FDP_SHM* pFDP, FDP_HIT_LOG_STATS* pStats)
+{
+    if (pFDP == NULL || pFDP->pHitLog == NULL || pStats == NULL)
+    {
+        return false;
+    }
+    FDP_HIT_LOG* pHitLog = pFDP->pHitLog;
+    pStats->HitCount = pHitLog->HitCount;
+    pStats->LoggedCount = pHitLog->WriteIndex;
+    pStats->DroppedCount = pHitLog->DroppedCount;
+    pStats->PendingCount = pStats->LoggedCount - pHitLog->ReadIndex;
+    pStats->RecordCount = pHitLog->RecordCount;
+    return true;
+}
+
+
+//
+// Breakpoint programs. A small register machine run by the server at each
+// hit of the breakpoints it is attached to. Programs are checked when loaded
+// so that running one can't read or jump out of bounds, and each run is
+// bounded by FDP_PROGRAM_MAX_STEPS.
+//
+static bool FDP_IsProgramJump(uint8_t Opcode)
+{
+    uint8_t Operation = Opcode & ~FDP_OP_IMM;
+    return Operation >= FDP_OP_JA && Operation <= FDP_OP_JSET;
+}
+
+FDP_EXPORTED
+bool FDP_VerifyProgram(const FDP_PROGRAM_INSTRUCTION* pInstructions, uint32_t InstructionCount)
+{
+    if (pInstructions == NULL || InstructionCount == 0 || InstructionCount > FDP_PROGRAM_MAX_INSTRUCTIONS)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < InstructionCount; i++)
+    {
+        const FDP_PROGRAM_INSTRUCTION* pInstruction = &pInstructions[i];
+        bool bImm = (pInstruction->Opcode & FDP_OP_IMM) != 0;
+        uint8_t Operation = pInstruction->Opcode & ~FDP_OP_IMM;
+        if (Operation == FDP_OP_CALL || Operation == FDP_OP_EXIT)
+        {
+            if (bImm || (Operation == FDP_OP_CALL && (pInstruction->Imm < 0 || pInstruction->Imm > FDP_HELPER_GET_TIMESTAMP)))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (Operation > FDP_OP_NEG && FDP_IsProgramJump(pInstruction->Opcode) == false)
+        {
+            return false;
+        }
+        if (pInstruction->Dst >= FDP_PROGRAM_REGISTER_COUNT
+            || (bImm == false && pInstruction->Src >= FDP_PROGRAM_REGISTER_COUNT))
+        {
+            return false;
+        }
+        if (FDP_IsProgramJump(pInstruction->Opcode))
+        {
+            int64_t Target = (int64_t)i + 1 + pInstruction->Offset;
+            if (Target < 0 || Target >= InstructionCount)
+            {
+                return false;
+            }
+        }
+    }
+    //Runs can't fall off the end
+    uint8_t LastOpcode = pInstructions[InstructionCount - 1].Opcode;
+    return LastOpcode == FDP_OP_EXIT || LastOpcode == FDP_OP_JA;
+}
+
+//Returns the program id, or -1 on failure
+FDP_EXPORTED
+int FDP_LoadProgram(FDP_SHM* pFDP, const FDP_PROGRAM_INSTRUCTION* pInstructions, uint32_t InstructionCount)
+{
+    if (pFDP == NULL || FDP_VerifyProgram(pInstructions, InstructionCount) == false)
+    {
+        return -1;
+    }
+    int ProgramId = -1;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_LOAD_PROGRAM_PKT_REQ* TempPkt = (FDP_LOAD_PROGRAM_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_LOAD_PROGRAM;
+        TempPkt->InstructionCount = InstructionCount;
+        memcpy(TempPkt->Instructions, pInstructions, InstructionCount * sizeof(FDP_PROGRAM_INSTRUCTION));
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_LOAD_PROGRAM_PKT_REQ) + InstructionCount * sizeof(FDP_PROGRAM_INSTRUCTION));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&ProgramId);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return ProgramId;
+}
+
+static bool FDP_SendProgramRequest(FDP_SHM* pFDP, uint8_t Type, int ProgramId, int BreakpointId)
+{
+    bool bReturnValue = false;
+    FDP_PROGRAM_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = Type;
+    TempPkt.ProgramId = ProgramId;
+    TempPkt.BreakpointId = BreakpointId;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_PROGRAM_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//The program is detached from all its breakpoints first
+FDP_EXPORTED
+bool FDP_UnloadProgram(FDP_SHM* pFDP, int ProgramId)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    return FDP_SendProgramRequest(pFDP, FDPCMD_UNLOAD_PROGRAM, ProgramId, -1);
+}
+
+//ProgramId -1 detaches the current program, a breakpoint runs at most one program
+FDP_EXPORTED
+bool FDP_AttachProgram(FDP_SHM* pFDP, int BreakpointId, int ProgramId)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    return FDP_SendProgramRequest(pFDP, FDPCMD_ATTACH_PROGRAM, ProgramId, BreakpointId);
+}
+
+FDP_EXPORTED
+bool FDP_ReadProgramMap(FDP_SHM* pFDP, int ProgramId, uint32_t FirstIndex, uint32_t Count, uint64_t* pValues)
+{
+    if (pFDP == NULL || pValues == NULL || FirstIndex > FDP_PROGRAM_MAP_SIZE || Count > FDP_PROGRAM_MAP_SIZE - FirstIndex)
+    {
+        return false;
+    }
+    if (Count == 0)
+    {
+        return true;
+    }
+    bool bReturnCode = false;
+    uint32_t ReceivedSize = 0;
+    FDP_PROGRAM_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = FDPCMD_READ_PROGRAM_MAP;
+    TempPkt.ProgramId = ProgramId;
+    TempPkt.FirstIndex = FirstIndex;
+    TempPkt.Count = Count;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_PROGRAM_PKT_REQ));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+        if (bReturnCode && ReceivedSize == Count * sizeof(uint64_t))
+        {
+            memcpy(pValues, pFDP->InputBuffer, ReceivedSize);
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnCode && ReceivedSize == Count * sizeof(uint64_t);
+}
+
+static uint32_t FDP_SendBreakpointHandleRequest(FDP_SHM* pFDP, uint8_t Type, uint32_t CpuId, uint32_t Handle, uint64_t PhysicalAddress)
+{
+    uint32_t Result = 0;
+    FDP_BREAKPOINT_HANDLE_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = Type;
+    TempPkt.CpuId = CpuId;
+    TempPkt.Handle = Handle;
+    TempPkt.PhysicalAddress = PhysicalAddress;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_BREAKPOINT_HANDLE_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&Result);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return Result;
+}
+
+//Execute breakpoints aren't limited to FDP_MAX_BREAKPOINT, those of a page share one backend page breakpoint.
+//Hits before it is installed stop the VM, add them while the VM is paused
+FDP_EXPORTED
+bool FDP_AddExecuteBreakpoint(FDP_SHM* pFDP, uint64_t PhysicalAddress, uint32_t* pHandle)
+{
+    if (pFDP == NULL || pHandle == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    *pHandle = FDP_SendBreakpointHandleRequest(pFDP, FDPCMD_ADD_EXECUTE_BREAKPOINT, 0, 0, PhysicalAddress);
+    return *pHandle != FDP_INVALID_BREAKPOINT_HANDLE;
+}
+
+FDP_EXPORTED
+bool FDP_RemoveExecuteBreakpoint(FDP_SHM* pFDP, uint32_t Handle)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    return (uint8_t)FDP_SendBreakpointHandleRequest(pFDP, FDPCMD_REMOVE_EXECUTE_BREAKPOINT, 0, Handle, 0) != 0;
+}
+
+//Execute breakpoint that stopped the CPU, fails if the CPU didn't stop on one
+FDP_EXPORTED
+bool FDP_GetHitBreakpointHandle(FDP_SHM* pFDP, uint32_t CpuId, uint32_t* pHandle)
+{
+    if (pFDP == NULL || pHandle == NULL)
+    {
+        return false;
+    }
+    *pHandle = FDP_SendBreakpointHandleRequest(pFDP, FDPCMD_GET_HIT_BREAKPOINT_HANDLE, CpuId, 0, 0);
+    return *pHandle != FDP_INVALID_BREAKPOINT_HANDLE;
+}
+
+//Arms one-shot execute breakpoints on the physical addresses of the blocks, replacing the previous ones.
+//A hit sets the bit of its block and disarms it without stopping the VM, BlockCount 0 disarms the coverage
+FDP_EXPORTED
+bool FDP_SetCoverageBlocks(FDP_SHM* pFDP, const uint64_t* pPhysicalAddresses, uint32_t BlockCount)
+{
+    if (pFDP == NULL || BlockCount > FDP_COVERAGE_MAX_BLOCKS || (pPhysicalAddresses == NULL && BlockCount > 0))
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        FDP_SET_COVERAGE_BLOCKS_PKT_REQ* TempPkt = (FDP_SET_COVERAGE_BLOCKS_PKT_REQ*)pFDP->OutputBuffer;
+        TempPkt->Type = FDPCMD_SET_COVERAGE_BLOCKS;
+        TempPkt->BlockCount = BlockCount;
+        memcpy(TempPkt->PhysicalAddresses, pPhysicalAddresses, BlockCount * sizeof(uint64_t));
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                     sizeof(FDP_SET_COVERAGE_BLOCKS_PKT_REQ) + BlockCount * sizeof(uint64_t));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//pBitmap (optional) needs a bit per block, (BlockCount + 7) / 8 bytes, bit n is the n-th uploaded block.
+//The server also drops the ranges left without blocks to hit, call it regularly while the guest runs
+FDP_EXPORTED
+bool FDP_GetCoverage(FDP_SHM* pFDP, uint8_t* pBitmap, uint32_t BitmapSize, uint32_t* pHitCount)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    uint32_t ReceivedSize = 0;
+    FDP_GET_COVERAGE_PKT_RSP Rsp = { 0, 0 };
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_GET_COVERAGE;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnValue);
+        if (bReturnValue && ReceivedSize >= sizeof(Rsp))
+        {
+            memcpy(&Rsp, pFDP->InputBuffer, sizeof(Rsp));
+            uint32_t BitmapUsedSize = (Rsp.BlockCount + 7) / 8;
+            if (ReceivedSize < sizeof(Rsp) + BitmapUsedSize || (pBitmap != NULL && BitmapSize < BitmapUsedSize))
+            {
+                bReturnValue = false;
+            }
+            else if (pBitmap != NULL)
+            {
+                memcpy(pBitmap, pFDP->InputBuffer + sizeof(Rsp), BitmapUsedSize);
+            }
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnValue == false || ReceivedSize < sizeof(Rsp))
+    {
+        return false;
+    }
+    if (pHitCount != NULL)
+    {
+        *pHitCount = Rsp.HitCount;
+    }
+    return true;
+}
+
+//Clears the bitmap and arms the blocks again
+FDP_EXPORTED
+bool FDP_ResetCoverage(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_RESET_COVERAGE;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_Save(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    if (FDP_RegisterCacheFlush(pFDP) == false)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_SAVE;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_Restore(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheSetVmStopped(pFDP, false);
+    FDP_ReadaheadSetVmStopped(pFDP, false);
+    bool bReturnValue = false;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_RESTORE;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+static bool FDP_SendSnapshotRequest(FDP_SHM* pFDP, uint8_t Type, const char* pName)
+{
+    if (pName == NULL || strlen(pName) == 0 || strlen(pName) >= FDP_SNAPSHOT_MAX_NAME_SIZE)
+    {
+        return false;
+    }
+    bool bReturnValue = false;
+    FDP_SNAPSHOT_PKT_REQ TempPkt;
+    memset(&TempPkt, 0, sizeof(TempPkt));
+    TempPkt.Type = Type;
+    strcpy(TempPkt.Name, pName);
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SNAPSHOT_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+//Keeps the guest RAM and the CPU state under pName, replacing a snapshot with the same name. Pages left
+//unchanged since the last snapshot saved or restored are shared with it rather than copied
+FDP_EXPORTED
+bool FDP_SaveSnapshot(FDP_SHM* pFDP, const char* pName)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    //Don't keep a snapshot without the registers the client wrote
+    if (FDP_RegisterCacheFlush(pFDP) == false)
+    {
+        return false;
+    }
+    return FDP_SendSnapshotRequest(pFDP, FDPCMD_SAVE_SNAPSHOT, pName);
+}
+
+//Only the pages that may have changed are written back: with a backend that tracks them, the pages written since
+//the last snapshot saved or restored and those it doesn't share with pName, else the pages that compare different.
+//Without FDP_SNAPSHOT_DEVICE_STATE (see pfnSaveDeviceState) the devices can't go back: the restore is refused once
+//the guest ran or was reset since pName was last saved or restored
+FDP_EXPORTED
+bool FDP_RestoreSnapshot(FDP_SHM* pFDP, const char* pName)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheInvalidate(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    return FDP_SendSnapshotRequest(pFDP, FDPCMD_RESTORE_SNAPSHOT, pName);
+}
+
+FDP_EXPORTED
+bool FDP_DeleteSnapshot(FDP_SHM* pFDP, const char* pName)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    return FDP_SendSnapshotRequest(pFDP, FDPCMD_DELETE_SNAPSHOT, pName);
+}
+
+//Fails with more than MaxCount snapshots, FDP_MAX_SNAPSHOTS entries are always enough
+FDP_EXPORTED
+bool FDP_ListSnapshots(FDP_SHM* pFDP, FDP_SNAPSHOT_INFO* pSnapshots, uint32_t MaxCount, uint32_t* pSnapshotCount)
+{
+    if (pFDP == NULL || pSnapshotCount == NULL)
+    {
+        return false;
+    }
+    bool bReturnCode = false;
+    uint32_t ReceivedSize = 0;
+    FDP_LIST_SNAPSHOTS_PKT_RSP Rsp;
+    Rsp.SnapshotCount = 0;
+    FDP_SIMPLE_PKT_REQ TempPkt;
+    TempPkt.Type = FDPCMD_LIST_SNAPSHOTS;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
+        ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+        if (bReturnCode && ReceivedSize >= sizeof(FDP_LIST_SNAPSHOTS_PKT_RSP))
+        {
+            memcpy(&Rsp, pFDP->InputBuffer, sizeof(FDP_LIST_SNAPSHOTS_PKT_RSP));
+            if (pSnapshots != NULL && Rsp.SnapshotCount <= MaxCount)
+            {
+                memcpy(pSnapshots, pFDP->InputBuffer + sizeof(FDP_LIST_SNAPSHOTS_PKT_RSP),
+                       Rsp.SnapshotCount * sizeof(FDP_SNAPSHOT_INFO));
+            }
+        }
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnCode == false
+        || ReceivedSize != sizeof(FDP_LIST_SNAPSHOTS_PKT_RSP) + Rsp.SnapshotCount * sizeof(FDP_SNAPSHOT_INFO))
+    {
+        return false;
+    }
+    *pSnapshotCount = Rsp.SnapshotCount;
+    return pSnapshots == NULL || Rsp.SnapshotCount <= MaxCount;
+}
+
+FDP_EXPORTED
+bool FDP_GetStateChanged(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    bool StateChanged;
+    //LockSHM(pFDP->pSharedFDPSHM);
+    ttas_spinlock_lock(&pFDP->pSharedFDPSHM->stateChangedLock);
+    {
+        StateChanged = pFDP->pSharedFDPSHM->stateChanged;
+        pFDP->pSharedFDPSHM->stateChanged = false;
+    }
+    //UnlockSHM(pFDP->pSharedFDPSHM);
+    ttas_spinlock_unlock(&pFDP->pSharedFDPSHM->stateChangedLock);
+    if (StateChanged)
+    {
+        FDP_ReadaheadInvalidate(pFDP);
+    }
+    return StateChanged;
+}
+
+FDP_EXPORTED
+void FDP_SetStateChanged(FDP_SHM* pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return;
+    }
+    //LockSHM(pFDP->pSharedFDPSHM);
+    ttas_spinlock_lock(&pFDP->pSharedFDPSHM->stateChangedLock);
+    {
+        pFDP->pSharedFDPSHM->stateChanged = true;
+    }
+    //UnlockSHM(pFDP->pSharedFDPSHM);
+    ttas_spinlock_unlock(&pFDP->pSharedFDPSHM->stateChangedLock);
+    return;
+}
+
+FDP_EXPORTED
+bool FDP_InjectInterrupt(FDP_SHM* pFDP, uint32_t CpuId, uint32_t uInterruptionCode, uint32_t uErrorCode,
+                         uint64_t Cr2Value)
+{
+    if (pFDP == NULL)
+    {
+        return false;
+    }
+    if (FDP_RegisterCacheInvalidate(pFDP) == false)
+    {
+        return false;
+    }
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = false;
+    FDP_INJECT_INTERRUPT_PKT_REQ* tmpPkt = (FDP_INJECT_INTERRUPT_PKT_REQ*)pFDP->OutputBuffer;
+    tmpPkt->Type = FDPCMD_INJECT_INTERRUPT;
+    tmpPkt->CpuId = CpuId;
+    tmpPkt->Cr2Value = Cr2Value;
+    tmpPkt->ErrorCode = uErrorCode;
+    tmpPkt->InterruptionCode = uInterruptionCode;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_INJECT_INTERRUPT_PKT_REQ));
+        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnValue;
+}
+
+
+
+//Server Part
+#define FDP_HASH_CHUNK_SIZE                 FDP_1M
+#define FDP_HASH_MAX_PAGES_PER_REQUEST      ((FDP_MAX_DATA_SIZE - 1) / sizeof(uint64_t))
+
+static bool FDP_HashRangeInternal(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, FDP_HashAlgorithm Algorithm,
+                                  uint8_t Flags, uint64_t Address, uint64_t Size, uint8_t* pDstBuffer)
+{
+    bool bReturnCode = false;
+    FDP_HASH_RANGE_PKT_REQ tmpPkt;
+    tmpPkt.Type = FDPCMD_HASH_RANGE;
+    tmpPkt.CpuId = CpuId;
+    tmpPkt.AddressType = AddressType;
+    tmpPkt.Algorithm = Algorithm;
+    tmpPkt.Flags = Flags;
+    tmpPkt.Address = Address;
+    tmpPkt.Size = Size;
+    LockSHM(pFDP->pSharedFDPSHM);
+    {
+        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&tmpPkt, sizeof(FDP_HASH_RANGE_PKT_REQ));
+        ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pDstBuffer, &bReturnCode);
+    }
+    UnlockSHM(pFDP->pSharedFDPSHM);
+    return bReturnCode;
+}
+
+static bool FDP_HashPagesInternal(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, FDP_HashAlgorithm Algorithm,
+                                  uint64_t Address, uint64_t PageCount, uint64_t* pPageHashes)
+{
+    uint64_t CurrentPage = 0;
+    while (CurrentPage < PageCount)
+    {
+        uint64_t CurrentPageCount = MIN(PageCount - CurrentPage, FDP_HASH_MAX_PAGES_PER_REQUEST);
+        if (FDP_HashRangeInternal(pFDP, CpuId, AddressType, Algorithm, FDP_HASH_RANGE_PER_PAGE,
+                                  Address + CurrentPage * FDP_HASH_PAGE_SIZE, CurrentPageCount * FDP_HASH_PAGE_SIZE,
+                                  (uint8_t*)(pPageHashes + CurrentPage)) == false)
+        {
+            return false;
+        }
+        CurrentPage += CurrentPageCount;
+    }
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_HashPhysicalMemory(FDP_SHM* pFDP, FDP_HashAlgorithm Algorithm, uint64_t PhysicalAddress, uint64_t Size,
+                            uint64_t* pHash)
+{
+    if (pFDP == NULL || pHash == NULL)
+    {
+        return false;
+    }
+    return FDP_HashRangeInternal(pFDP, 0, FDP_PHYSICAL_ADDRESS, Algorithm, 0, PhysicalAddress, Size, (uint8_t*)pHash);
+}
+
+FDP_EXPORTED
+bool FDP_HashVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, FDP_HashAlgorithm Algorithm, uint64_t VirtualAddress,
+                           uint64_t Size, uint64_t* pHash)
+{
+    if (pFDP == NULL || pHash == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    return FDP_HashRangeInternal(pFDP, CpuId, FDP_VIRTUAL_ADDRESS, Algorithm, 0, VirtualAddress, Size, (uint8_t*)pHash);
+}
+
+//Unreadable pages are reported as FDP_HASH_UNREADABLE_PAGE
+FDP_EXPORTED
+bool FDP_HashPhysicalPages(FDP_SHM* pFDP, FDP_HashAlgorithm Algorithm, uint64_t PhysicalAddress, uint64_t PageCount,
+                           uint64_t* pPageHashes)
+{
+    if (pFDP == NULL || pPageHashes == NULL)
+    {
+        return false;
+    }
+    return FDP_HashPagesInternal(pFDP, 0, FDP_PHYSICAL_ADDRESS, Algorithm, PhysicalAddress, PageCount, pPageHashes);
+}
+
+FDP_EXPORTED
+bool FDP_HashVirtualPages(FDP_SHM* pFDP, uint32_t CpuId, FDP_HashAlgorithm Algorithm, uint64_t VirtualAddress,
+                          uint64_t PageCount, uint64_t* pPageHashes)
+{
+    if (pFDP == NULL || pPageHashes == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    return FDP_HashPagesInternal(pFDP, CpuId, FDP_VIRTUAL_ADDRESS, Algorithm, VirtualAddress, PageCount, pPageHashes);
+}
+
+static bool FDP_ServerReadMemory(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, uint8_t* pDstBuffer,
+                                 uint64_t Address, uint32_t ReadSize)
+{
+    switch (AddressType)
+    {
+    case FDP_PHYSICAL_ADDRESS:
+        return pFDP->pFdpServer->pfnReadPhysicalMemory(pFDP->pFdpServer->pUserHandle, pDstBuffer, Address, ReadSize);
+    case FDP_VIRTUAL_ADDRESS:
+        return pFDP->pFdpServer->pfnReadVirtualMemory(pFDP->pFdpServer->pUserHandle, CpuId, Address, ReadSize, pDstBuffer);
+    default:
+        break;
+    }
+    return false;
+}
+
+static bool FDP_ServerHashRange(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    //The request is copied out so that InputBuffer can be used as read buffer
+    FDP_HASH_RANGE_PKT_REQ Request = *(FDP_HASH_RANGE_PKT_REQ*)pFDP->InputBuffer;
+    uint8_t* pReadBuffer = pFDP->InputBuffer;
+    FDP_HASH_STATE HashState;
+    if (FDP_HashInit(&HashState, Request.Algorithm) == false)
+    {
+        return false;
+    }
+
+    if (Request.Flags & FDP_HASH_RANGE_PER_PAGE)
+    {
+        uint64_t PageCount = Request.Size / FDP_HASH_PAGE_SIZE;
+        uint64_t* pPageHashes = (uint64_t*)pFDP->OutputBuffer;
+        if ((Request.Size % FDP_HASH_PAGE_SIZE) != 0 || PageCount > FDP_HASH_MAX_PAGES_PER_REQUEST)
+        {
+            return false;
+        }
+        for (uint64_t CurrentPage = 0; CurrentPage < PageCount; CurrentPage += FDP_HASH_CHUNK_SIZE / FDP_HASH_PAGE_SIZE)
+        {
+            uint32_t ChunkPageCount = (uint32_t)MIN(PageCount - CurrentPage, FDP_HASH_CHUNK_SIZE / FDP_HASH_PAGE_SIZE);
+            uint64_t ChunkAddress = Request.Address + CurrentPage * FDP_HASH_PAGE_SIZE;
+            bool bChunkRead = FDP_ServerReadMemory(pFDP, Request.CpuId, Request.AddressType, pReadBuffer, ChunkAddress,
+                                                   ChunkPageCount * FDP_HASH_PAGE_SIZE);
+            for (uint32_t i = 0; i < ChunkPageCount; i++)
+            {
+                uint8_t* pPage = pReadBuffer + i * FDP_HASH_PAGE_SIZE;
+                //Retry page by page when the chunk spans a hole
+                if (bChunkRead == false
+                    && FDP_ServerReadMemory(pFDP, Request.CpuId, Request.AddressType, pPage,
+                                            ChunkAddress + i * FDP_HASH_PAGE_SIZE, FDP_HASH_PAGE_SIZE) == false)
+                {
+                    pPageHashes[CurrentPage + i] = FDP_HASH_UNREADABLE_PAGE;
+                    continue;
+                }
+                FDP_HashInit(&HashState, Request.Algorithm);
+                FDP_HashUpdate(&HashState, pPage, FDP_HASH_PAGE_SIZE);
+                pPageHashes[CurrentPage + i] = FDP_HashDigest(&HashState);
+            }
+        }
+        *pOutputBufferSize = (uint32_t)(PageCount * sizeof(uint64_t));
+        return true;
+    }
+
+    for (uint64_t CurrentOffset = 0; CurrentOffset < Request.Size; CurrentOffset += FDP_HASH_CHUNK_SIZE)
+    {
+        uint32_t ChunkSize = (uint32_t)MIN(Request.Size - CurrentOffset, FDP_HASH_CHUNK_SIZE);
+        if (FDP_ServerReadMemory(pFDP, Request.CpuId, Request.AddressType, pReadBuffer, Request.Address + CurrentOffset,
+                                 ChunkSize) == false)
+        {
+            return false;
+        }
+        FDP_HashUpdate(&HashState, pReadBuffer, ChunkSize);
+    }
+    ((uint64_t*)pFDP->OutputBuffer)[0] = FDP_HashDigest(&HashState);
+    *pOutputBufferSize = sizeof(uint64_t);
+    return true;
+}
+
+#define FDP_SWAP_MAX_ENTRIES_PER_REQUEST \
+    ((FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_SWAP_MEMORY_PKT_REQ)) / sizeof(FDP_SWAP_ENTRY))
+
+FDP_EXPORTED
+bool FDP_SwapMemory(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, FDP_SWAP_ENTRY* pEntries,
+                    uint32_t EntryCount)
+{
+    if (pFDP == NULL || pEntries == NULL)
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    FDP_ReadaheadInvalidate(pFDP);
+    bool bReturnValue = true;
+    uint32_t CurrentEntry = 0;
+    while (CurrentEntry < EntryCount)
+    {
+        uint32_t CurrentEntryCount = MIN(EntryCount - CurrentEntry, FDP_SWAP_MAX_ENTRIES_PER_REQUEST);
+        uint32_t ReceivedSize = 0;
+        bool bReturnCode = false;
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            FDP_SWAP_MEMORY_PKT_REQ* TempPkt = (FDP_SWAP_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
+            TempPkt->Type = FDPCMD_SWAP_MEMORY;
+            TempPkt->CpuId = CpuId;
+            TempPkt->AddressType = AddressType;
+            TempPkt->EntryCount = CurrentEntryCount;
+            memcpy(TempPkt->Entries, pEntries + CurrentEntry, CurrentEntryCount * sizeof(FDP_SWAP_ENTRY));
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
+                         sizeof(FDP_SWAP_MEMORY_PKT_REQ) + CurrentEntryCount * sizeof(FDP_SWAP_ENTRY));
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (ReceivedSize == CurrentEntryCount * sizeof(FDP_SWAP_ENTRY))
+            {
+                memcpy(pEntries + CurrentEntry, pFDP->InputBuffer, ReceivedSize);
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (ReceivedSize != CurrentEntryCount * sizeof(FDP_SWAP_ENTRY))
+        {
+            for (uint32_t i = 0; i < CurrentEntryCount; i++)
+            {
+                pEntries[CurrentEntry + i].Status = FDP_SWAP_FAILED;
+            }
+            bReturnCode = false;
+        }
+        bReturnValue = bReturnValue && bReturnCode;
+        CurrentEntry += CurrentEntryCount;
+    }
+    return bReturnValue;
+}
+
+//pExpected can be NULL for an unconditional swap, pOld can be NULL
+FDP_EXPORTED
+bool FDP_CompareExchangeMemory(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, uint64_t Address,
+                               const uint8_t* pExpected, const uint8_t* pNew, uint8_t* pOld, uint32_t Size)
+{
+    if (pNew == NULL || Size == 0 || Size > FDP_SWAP_MAX_SIZE)
+    {
+        return false;
+    }
+    FDP_SWAP_ENTRY SwapEntry;
+    memset(&SwapEntry, 0, sizeof(SwapEntry));
+    SwapEntry.Address = Address;
+    SwapEntry.Size = Size;
+    if (pExpected != NULL)
+    {
+        SwapEntry.bCompare = true;
+        memcpy(SwapEntry.Expected, pExpected, Size);
+    }
+    memcpy(SwapEntry.New, pNew, Size);
+    FDP_SwapMemory(pFDP, CpuId, AddressType, &SwapEntry, 1);
+    if (pOld != NULL && SwapEntry.Status != FDP_SWAP_FAILED)
+    {
+        memcpy(pOld, SwapEntry.Old, Size);
+    }
+    return SwapEntry.Status == FDP_SWAP_DONE;
+}
+
+static bool FDP_ServerWriteMemory(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, uint8_t* pSrcBuffer,
+                                  uint64_t Address, uint32_t WriteSize)
+{
+    switch (AddressType)
+    {
+    case FDP_PHYSICAL_ADDRESS:
+        return pFDP->pFdpServer->pfnWritePhysicalMemory(pFDP->pFdpServer->pUserHandle, pSrcBuffer, Address, WriteSize);
+    case FDP_VIRTUAL_ADDRESS:
+        return pFDP->pFdpServer->pfnWriteVirtualMemory(pFDP->pFdpServer->pUserHandle, CpuId, pSrcBuffer, Address, WriteSize);
+    default:
+        break;
+    }
+    return false;
+}
+
+static bool FDP_ServerSwapMemory(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_SWAP_MEMORY_PKT_REQ* TempPkt = (FDP_SWAP_MEMORY_PKT_REQ*)pFDP->InputBuffer;
+    if (TempPkt->EntryCount > FDP_SWAP_MAX_ENTRIES_PER_REQUEST)
+    {
+        return false;
+    }
+    FDP_SWAP_ENTRY* pEntries = (FDP_SWAP_ENTRY*)pFDP->OutputBuffer;
+    memcpy(pEntries, TempPkt->Entries, TempPkt->EntryCount * sizeof(FDP_SWAP_ENTRY));
+
+    //The guest must not run between the reads and the writes
+    uint8_t CurrentState = 0;
+    bool bPaused = false;
+    pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &CurrentState);
+    if ((CurrentState & FDP_STATE_PAUSED) == 0)
+    {
+        bPaused = pFDP->pFdpServer->pfnPause(pFDP->pFdpServer->pUserHandle);
+    }
+
+    bool bReturnValue = true;
+    for (uint32_t i = 0; i < TempPkt->EntryCount; i++)
+    {
+        FDP_SWAP_ENTRY* pEntry = &pEntries[i];
+        pEntry->Status = FDP_SWAP_FAILED;
+        if (pEntry->Size == 0 || pEntry->Size > FDP_SWAP_MAX_SIZE
+            || FDP_ServerReadMemory(pFDP, TempPkt->CpuId, TempPkt->AddressType, pEntry->Old, pEntry->Address,
+                                    pEntry->Size) == false)
+        {
+            bReturnValue = false;
+            continue;
+        }
+        if (pEntry->bCompare && memcmp(pEntry->Old, pEntry->Expected, pEntry->Size) != 0)
+        {
+            pEntry->Status = FDP_SWAP_MISMATCH;
+            continue;
+        }
+        if (FDP_ServerWriteMemory(pFDP, TempPkt->CpuId, TempPkt->AddressType, pEntry->New, pEntry->Address,
+                                  pEntry->Size) == false)
+        {
+            bReturnValue = false;
+            continue;
+        }
+        pEntry->Status = FDP_SWAP_DONE;
+    }
+
+    if (bPaused)
+    {
+        pFDP->pFdpServer->pfnResume(pFDP->pFdpServer->pUserHandle);
+    }
+    *pOutputBufferSize = TempPkt->EntryCount * sizeof(FDP_SWAP_ENTRY);
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_WalkList(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, uint64_t HeadAddress, uint32_t NextOffset,
+                  int32_t RecordOffset, uint32_t RecordSize, uint32_t MaxCount, uint32_t Flags, uint64_t* pNodeAddresses,
+                  uint8_t* pRecords, uint32_t* pCount, uint32_t* pEndReason)
+{
+    if (pFDP == NULL || pCount == NULL || (pRecords == NULL && RecordSize > 0))
+    {
+        return false;
+    }
+    FDP_RegisterCacheFlush(pFDP);
+    uint64_t CurrentHeadAddress = HeadAddress;
+    uint32_t CurrentFlags = Flags;
+    uint32_t EndReason = FDP_WALK_LIST_END_MAX_COUNT;
+    *pCount = 0;
+    while (*pCount < MaxCount)
+    {
+        bool bReturnCode = false;
+        uint32_t ReceivedSize = 0;
+        FDP_WALK_LIST_PKT_RSP Rsp = { 0, FDP_WALK_LIST_END_READ_ERROR };
+        uint64_t LastNodeAddress = 0;
+        FDP_WALK_LIST_PKT_REQ TempPkt;
+        TempPkt.Type = FDPCMD_WALK_LIST;
+        TempPkt.CpuId = CpuId;
+        TempPkt.AddressType = AddressType;
+        TempPkt.HeadAddress = CurrentHeadAddress;
+        TempPkt.StopAddress = HeadAddress;
+        TempPkt.NextOffset = NextOffset;
+        TempPkt.RecordOffset = RecordOffset;
+        TempPkt.RecordSize = RecordSize;
+        TempPkt.MaxCount = MaxCount - *pCount;
+        TempPkt.Flags = CurrentFlags;
+        LockSHM(pFDP->pSharedFDPSHM);
+        {
+            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_WALK_LIST_PKT_REQ));
+            ReceivedSize = ReadFDPDataWithStatus(&pFDP->pSharedFDPSHM->ServerToClient, pFDP->InputBuffer, &bReturnCode);
+            if (bReturnCode && ReceivedSize >= sizeof(Rsp))
+            {
+                memcpy(&Rsp, pFDP->InputBuffer, sizeof(Rsp));
+                //Never trust the count beyond what was asked for and what was received
+                uint64_t EntrySize = sizeof(uint64_t) + (uint64_t)RecordSize;
+                if (Rsp.Count > TempPkt.MaxCount || Rsp.Count > (ReceivedSize - sizeof(Rsp)) / EntrySize)
+                {
+                    bReturnCode = false;
+                    Rsp.Count = 0;
+                }
+                uint8_t* pCurrentEntry = pFDP->InputBuffer + sizeof(Rsp);
+                for (uint32_t i = 0; i < Rsp.Count; i++)
+                {
+                    memcpy(&LastNodeAddress, pCurrentEntry, sizeof(uint64_t));
+                    if (pNodeAddresses != NULL)
+                    {
+                        pNodeAddresses[*pCount + i] = LastNodeAddress;
+                    }
+                    memcpy(pRecords + (uint64_t)(*pCount + i) * RecordSize, pCurrentEntry + sizeof(uint64_t), RecordSize);
+                    pCurrentEntry += sizeof(uint64_t) + RecordSize;
+                }
+            }
+        }
+        UnlockSHM(pFDP->pSharedFDPSHM);
+        if (bReturnCode == false || ReceivedSize < sizeof(Rsp))
+        {
+            return false;
+        }
+        *pCount += Rsp.Count;
+        EndReason = Rsp.EndReason;
+        if (EndReason != FDP_WALK_LIST_END_MAX_COUNT || Rsp.Count == 0)
+        {
+            break;
+        }
+        //The reply was full, go on from the last element
+        CurrentHeadAddress = LastNodeAddress;
+        CurrentFlags = (Flags & FDP_WALK_LIST_POINTER32) | FDP_WALK_LIST_SKIP_HEAD;
+    }
+    if (pEndReason != NULL)
+    {
+        *pEndReason = EndReason;
+    }
+    return true;
+}
+
+static bool FDP_ServerReadPointer(FDP_SHM* pFDP, uint32_t CpuId, FDP_AddressType AddressType, uint64_t Address,
+                                  bool bPointer32, uint64_t* pPointer)
+{
+    *pPointer = 0;
+    return FDP_ServerReadMemory(pFDP, CpuId, AddressType, (uint8_t*)pPointer, Address, bPointer32 ? 4 : 8);
+}
+
+static bool FDP_ServerWalkList(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_WALK_LIST_PKT_REQ* TempPkt = (FDP_WALK_LIST_PKT_REQ*)pFDP->InputBuffer;
+    FDP_WALK_LIST_PKT_RSP* pRsp = (FDP_WALK_LIST_PKT_RSP*)pFDP->OutputBuffer;
+    uint8_t* pCurrentEntry = pFDP->OutputBuffer + sizeof(FDP_WALK_LIST_PKT_RSP);
+    uint64_t EntrySize = sizeof(uint64_t) + (uint64_t)TempPkt->RecordSize;
+    uint64_t MaxCount = MIN(TempPkt->MaxCount, (FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_WALK_LIST_PKT_RSP)) / EntrySize);
+    bool bPointer32 = (TempPkt->Flags & FDP_WALK_LIST_POINTER32) != 0;
+    uint64_t FirstNodeAddress = TempPkt->HeadAddress;
+    uint64_t CurrentNodeAddress;
+
+    pRsp->Count = 0;
+    pRsp->EndReason = FDP_WALK_LIST_END_MAX_COUNT;
+    if (TempPkt->Flags & (FDP_WALK_LIST_HEAD_POINTER | FDP_WALK_LIST_SKIP_HEAD))
+    {
+        uint64_t PointerAddress = TempPkt->HeadAddress;
+        if ((TempPkt->Flags & FDP_WALK_LIST_HEAD_POINTER) == 0)
+        {
+            PointerAddress += TempPkt->NextOffset;
+        }
+        if (FDP_ServerReadPointer(pFDP, TempPkt->CpuId, TempPkt->AddressType, PointerAddress, bPointer32,
+                                  &FirstNodeAddress) == false)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_READ_ERROR;
+            goto Done;
+        }
+        if (FirstNodeAddress == 0)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_NULL;
+            goto Done;
+        }
+        if (FirstNodeAddress == TempPkt->StopAddress)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_HEAD;
+            goto Done;
+        }
+    }
+
+    CurrentNodeAddress = FirstNodeAddress;
+    while (pRsp->Count < MaxCount)
+    {
+        memcpy(pCurrentEntry, &CurrentNodeAddress, sizeof(uint64_t));
+        if (TempPkt->RecordSize > 0
+            && FDP_ServerReadMemory(pFDP, TempPkt->CpuId, TempPkt->AddressType, pCurrentEntry + sizeof(uint64_t),
+                                    CurrentNodeAddress + TempPkt->RecordOffset, TempPkt->RecordSize) == false)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_READ_ERROR;
+            break;
+        }
+        pRsp->Count++;
+        pCurrentEntry += EntrySize;
+
+        uint64_t NextNodeAddress;
+        if (FDP_ServerReadPointer(pFDP, TempPkt->CpuId, TempPkt->AddressType, CurrentNodeAddress + TempPkt->NextOffset,
+                                  bPointer32, &NextNodeAddress) == false)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_READ_ERROR;
+            break;
+        }
+        if (NextNodeAddress == 0)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_NULL;
+            break;
+        }
+        if (NextNodeAddress == TempPkt->StopAddress || NextNodeAddress == FirstNodeAddress)
+        {
+            pRsp->EndReason = FDP_WALK_LIST_END_HEAD;
+            break;
+        }
+        CurrentNodeAddress = NextNodeAddress;
+    }
+
+Done:
+    *pOutputBufferSize = (uint32_t)(sizeof(FDP_WALK_LIST_PKT_RSP) + pRsp->Count * EntrySize);
+    return true;
+}
+
+static bool FDP_ServerReadRegisterValues(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, uint64_t* pRegisterValues)
+{
+    if (pFDP->pFdpServer->pfnReadRegisters != NULL)
+    {
+        return pFDP->pFdpServer->pfnReadRegisters(pFDP->pFdpServer->pUserHandle, CpuId, RegisterMask, pRegisterValues);
+    }
+    //Older backends only know about one register at a time
+    uint32_t ValueIndex = 0;
+    for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+    {
+        if ((RegisterMask & FDP_REGISTER_MASK(RegisterId)) == 0)
+        {
+            continue;
+        }
+        if (pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, RegisterId,
+                                              &pRegisterValues[ValueIndex++]) == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool FDP_ServerReadRegisters(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_READ_REGISTERS_PKT_REQ* TempPkt = (FDP_READ_REGISTERS_PKT_REQ*)pFDP->InputBuffer;
+    uint32_t ValueCount = __builtin_popcountll(TempPkt->RegisterMask);
+    FDP_ServerRefreshPausedCpuCtx(pFDP, TempPkt->CpuId);
+    if (FDP_ServerReadRegisterValues(pFDP, TempPkt->CpuId, TempPkt->RegisterMask, (uint64_t*)pFDP->OutputBuffer) == false)
+    {
+        return false;
+    }
+    *pOutputBufferSize = ValueCount * sizeof(uint64_t);
+    return true;
+}
+
+static bool FDP_ServerWriteRegisterValues(FDP_SHM* pFDP, uint32_t CpuId, uint64_t RegisterMask, const uint64_t* pRegisterValues)
+{
+    bool bReturnValue = true;
+    if (pFDP->pFdpServer->pfnWriteRegisters != NULL)
+    {
+        bReturnValue = pFDP->pFdpServer->pfnWriteRegisters(pFDP->pFdpServer->pUserHandle, CpuId, RegisterMask,
+                                                           pRegisterValues);
+    }
+    else
+    {
+        uint32_t ValueIndex = 0;
+        for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT && bReturnValue; RegisterId++)
+        {
+            if (RegisterMask & FDP_REGISTER_MASK(RegisterId))
+            {
+                bReturnValue = pFDP->pFdpServer->pfnWriteRegister(pFDP->pFdpServer->pUserHandle, CpuId, RegisterId,
+                                                                  pRegisterValues[ValueIndex++]);
+            }
+        }
+    }
+    if (bReturnValue == false)
+    {
+        //Some registers may have been written
+        FDP_ServerInvalidateCpuCtx(pFDP);
+        return false;
+    }
+    uint32_t ValueIndex = 0;
+    for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT; RegisterId++)
+    {
+        if (RegisterMask & FDP_REGISTER_MASK(RegisterId))
+        {
+            FDP_ServerUpdateCpuCtx(pFDP, CpuId, RegisterId, pRegisterValues[ValueIndex++]);
+        }
+    }
+    return true;
+}
+
+static bool FDP_ServerWriteRegisters(FDP_SHM* pFDP)
+{
+    FDP_WRITE_REGISTERS_PKT_REQ* TempPkt = (FDP_WRITE_REGISTERS_PKT_REQ*)pFDP->InputBuffer;
+    return FDP_ServerWriteRegisterValues(pFDP, TempPkt->CpuId, TempPkt->RegisterMask, TempPkt->RegisterValues);
+}
+
+static bool FDP_ServerReadXState(FDP_SHM* pFDP, uint32_t CpuId, uint64_t ComponentMask, uint8_t* pXsaveArea,
+                                 uint64_t* pPresentMask)
+{
+    if (pFDP->pFdpServer->pfnGetXState != NULL)
+    {
+        return pFDP->pFdpServer->pfnGetXState(pFDP->pFdpServer->pUserHandle, CpuId, ComponentMask, pXsaveArea,
+                                              pPresentMask);
+    }
+    //Older backends only have the legacy region
+    *pPresentMask = FDP_XSTATE_X87 | FDP_XSTATE_SSE;
+    if ((ComponentMask & *pPresentMask) == 0)
+    {
+        return true;
+    }
+    uint32_t FxStateSize = 0;
+    return pFDP->pFdpServer->pfnGetFxState64(pFDP->pFdpServer->pUserHandle, CpuId, pXsaveArea, &FxStateSize)
+           && FxStateSize == sizeof(FDP_XSAVE_FORMAT64_T);
+}
+
+static bool FDP_ServerGetXState(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_GET_XSTATE_PKT_REQ* TempPkt = (FDP_GET_XSTATE_PKT_REQ*)pFDP->InputBuffer;
+    uint8_t XsaveArea[FDP_XSAVE_AREA_SIZE];
+    uint64_t PresentMask = 0;
+    memset(XsaveArea, 0, sizeof(XsaveArea));
+    if (FDP_ServerReadXState(pFDP, TempPkt->CpuId, TempPkt->ComponentMask, XsaveArea, &PresentMask) == false)
+    {
+        return false;
+    }
+    FDP_GET_XSTATE_PKT_RSP* TempRsp = (FDP_GET_XSTATE_PKT_RSP*)pFDP->OutputBuffer;
+    uint8_t* pComponent = pFDP->OutputBuffer + sizeof(FDP_GET_XSTATE_PKT_RSP);
+    uint32_t KnownIndex = 0;
+    TempRsp->PresentMask = PresentMask;
+    TempRsp->SentMask = 0;
+    for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+    {
+        const FDP_XSTATE_COMPONENT* pComponentInfo = &FDP_XStateComponents[i];
+        bool bKnown = (pComponentInfo->Mask & TempPkt->KnownMask) != 0;
+        uint64_t KnownHash = bKnown ? TempPkt->KnownHashes[KnownIndex++] : 0;
+        if ((pComponentInfo->Mask & TempPkt->ComponentMask & PresentMask) == 0)
+        {
+            continue;
+        }
+        if (bKnown && FDP_HashBuffer(FDP_HASH_XXH64, XsaveArea + pComponentInfo->Offset, pComponentInfo->Size) == KnownHash)
+        {
+            continue;
+        }
+        memcpy(pComponent, XsaveArea + pComponentInfo->Offset, pComponentInfo->Size);
+        pComponent += pComponentInfo->Size;
+        TempRsp->SentMask |= pComponentInfo->Mask;
+    }
+    *pOutputBufferSize = (uint32_t)(pComponent - pFDP->OutputBuffer);
+    return true;
+}
+
+static bool FDP_ServerWriteXState(FDP_SHM* pFDP, uint32_t CpuId, uint64_t ComponentMask, uint8_t* pXsaveArea)
+{
+    if (pFDP->pFdpServer->pfnSetXState != NULL)
+    {
+        return pFDP->pFdpServer->pfnSetXState(pFDP->pFdpServer->pUserHandle, CpuId, ComponentMask, pXsaveArea);
+    }
+    if (ComponentMask & ~(uint64_t)(FDP_XSTATE_X87 | FDP_XSTATE_SSE))
+    {
+        return false;
+    }
+    return pFDP->pFdpServer->pfnSetFxState64(pFDP->pFdpServer->pUserHandle, CpuId, pXsaveArea,
+                                             sizeof(FDP_XSAVE_FORMAT64_T));
+}
+
+static bool FDP_ServerSetXState(FDP_SHM* pFDP)
+{
+    FDP_SET_XSTATE_PKT_REQ* TempPkt = (FDP_SET_XSTATE_PKT_REQ*)pFDP->InputBuffer;
+    uint8_t XsaveArea[FDP_XSAVE_AREA_SIZE];
+    const uint8_t* pComponent = pFDP->InputBuffer + sizeof(FDP_SET_XSTATE_PKT_REQ);
+    memset(XsaveArea, 0, sizeof(XsaveArea));
+    for (uint32_t i = 0; i < FDP_XSTATE_COMPONENT_COUNT; i++)
+    {
+        if (FDP_XStateComponents[i].Mask & TempPkt->ComponentMask)
+        {
+            memcpy(XsaveArea + FDP_XStateComponents[i].Offset, pComponent, FDP_XStateComponents[i].Size);
+            pComponent += FDP_XStateComponents[i].Size;
+        }
+    }
+    return FDP_ServerWriteXState(pFDP, TempPkt->CpuId, TempPkt->ComponentMask, XsaveArea);
+}
+
+static bool FDP_ServerTransferMsrEntries(FDP_SHM* pFDP, bool bWrite, FDP_MSR_ENTRY* pEntries, uint32_t EntryCount)
+{
+    for (uint32_t i = 0; i < EntryCount; i++)
+    {
+        pEntries[i].Status = FDP_MSR_FAILED;
+    }
+    bool(*pfnTransferMsrs)(void*, FDP_MSR_ENTRY*, uint32_t) = bWrite ? pFDP->pFdpServer->pfnWriteMsrs
+                                                                     : pFDP->pFdpServer->pfnReadMsrs;
+    if (pfnTransferMsrs != NULL)
+    {
+        pfnTransferMsrs(pFDP->pFdpServer->pUserHandle, pEntries, EntryCount);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < EntryCount; i++)
+        {
+            bool bDone;
+            if (bWrite)
+            {
+                bDone = pFDP->pFdpServer->pfnWriteMsr(pFDP->pFdpServer->pUserHandle, pEntries[i].CpuId,
+                                                      pEntries[i].MsrId, pEntries[i].Value);
+            }
+            else
+            {
+                bDone = pFDP->pFdpServer->pfnReadMsr(pFDP->pFdpServer->pUserHandle, pEntries[i].CpuId,
+                                                     pEntries[i].MsrId, &pEntries[i].Value);
+            }
+            pEntries[i].Status = bDone ? FDP_MSR_DONE : FDP_MSR_FAILED;
+        }
+    }
+    bool bReturnValue = true;
+    for (uint32_t i = 0; i < EntryCount; i++)
+    {
+        bReturnValue = bReturnValue && pEntries[i].Status == FDP_MSR_DONE;
+    }
+    return bReturnValue;
+}
+
+static bool FDP_ServerTransferMsrs(FDP_SHM* pFDP, bool bWrite, uint32_t* pOutputBufferSize)
+{
+    FDP_MSRS_PKT_REQ* TempPkt = (FDP_MSRS_PKT_REQ*)pFDP->InputBuffer;
+    if (TempPkt->EntryCount > FDP_MSRS_MAX_ENTRIES_PER_REQUEST)
+    {
+        return false;
+    }
+    FDP_MSR_ENTRY* pEntries = (FDP_MSR_ENTRY*)pFDP->OutputBuffer;
+    memcpy(pEntries, TempPkt->Entries, TempPkt->EntryCount * sizeof(FDP_MSR_ENTRY));
+    *pOutputBufferSize = TempPkt->EntryCount * sizeof(FDP_MSR_ENTRY);
+    return FDP_ServerTransferMsrEntries(pFDP, bWrite, pEntries, TempPkt->EntryCount);
+}
+
+static bool FDP_ServerGetAllCpuStates(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_GET_ALL_CPU_STATES_PKT_RSP* pRsp = (FDP_GET_ALL_CPU_STATES_PKT_RSP*)pFDP->OutputBuffer;
+    uint32_t CpuCount = 0;
+    if (pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &pRsp->State) == false
+        || pFDP->pFdpServer->pfnGetCpuCount(pFDP->pFdpServer->pUserHandle, &CpuCount) == false)
+    {
+        return false;
+    }
+    CpuCount = MIN(CpuCount, (FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_GET_ALL_CPU_STATES_PKT_RSP)) / sizeof(FDP_CPU_STATE_ENTRY));
+    pRsp->CpuCount = CpuCount;
+    for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++)
+    {
+        FDP_CPU_STATE_ENTRY* pCpuState = &pRsp->CpuStates[CpuId];
+        memset(pCpuState, 0, sizeof(FDP_CPU_STATE_ENTRY));
+        pCpuState->BreakpointId = -1;
+        pFDP->pFdpServer->pfnGetCpuState(pFDP->pFdpServer->pUserHandle, CpuId, &pCpuState->State);
+        if ((pCpuState->State & FDP_STATE_PAUSED) == 0)
+        {
+            continue;
+        }
+        if ((pCpuState->State & FDP_STATE_BREAKPOINT_HIT) && pFDP->pFdpServer->pfnGetHitBreakpointId != NULL)
+        {
+            pCpuState->BreakpointId = pFDP->pFdpServer->pfnGetHitBreakpointId(pFDP->pFdpServer->pUserHandle, CpuId);
+        }
+        //The shared context is filled on the way, later register reads won't need a round trip
+        FDP_ServerRefreshCpuCtx(pFDP, CpuId);
+        bool bCpuCtxValid = false;
+        if (CpuId < pFDP->CpuShmCount)
+        {
+            FDP_CPU_CTX* pSharedCpuCtx = &pFDP->pCpuShm[CpuId];
+            uint64_t Sequence;
+            do
+            {
+                Sequence = FDP_CpuCtxReadBegin(pSharedCpuCtx);
+                bCpuCtxValid = pSharedCpuCtx->Valid != 0;
+                pCpuState->Rip = pSharedCpuCtx->rip;
+                pCpuState->Rsp = pSharedCpuCtx->rsp;
+                pCpuState->Cr3 = pSharedCpuCtx->cr3;
+            } while (FDP_CpuCtxReadRetry(pSharedCpuCtx, Sequence));
+        }
+        if (bCpuCtxValid == false)
+        {
+            pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, &pCpuState->Rip);
+            pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RSP_REGISTER, &pCpuState->Rsp);
+            pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CR3_REGISTER, &pCpuState->Cr3);
+        }
+    }
+    *pOutputBufferSize = sizeof(FDP_GET_ALL_CPU_STATES_PKT_RSP) + CpuCount * sizeof(FDP_CPU_STATE_ENTRY);
+    return true;
+}
+
+//Execute breakpoints by physical address, behind 32-bit handles. Both hash tables use linear probing
+//and stay at most half full, so a lookup reads a slot or two whatever the number of breakpoints
+#define FDP_BREAKPOINT_HANDLE_INDEX_BITS    20
+#define FDP_BREAKPOINT_HANDLE_INDEX_MASK    ((1U << FDP_BREAKPOINT_HANDLE_INDEX_BITS) - 1)
+#define FDP_BREAKPOINT_TABLE_MIN_SLOTS      256
+#define FDP_BREAKPOINT_PAGE_SIZE            4096ULL
+
+typedef struct FDP_BREAKPOINT_TABLE_ENTRY_
+{
+    uint64_t    Address;
+    uint32_t    Generation;         //Bumped when the entry is freed, stale handles don't match it anymore
+    uint32_t    NextFree;           //Index + 1 of the next free entry, 0 ends the list
+    bool        bUsed;
+} FDP_BREAKPOINT_TABLE_ENTRY;
+
+typedef struct FDP_BREAKPOINT_TABLE_PAGE_
+{
+    uint64_t    Page;
+    uint32_t    BreakpointCount;    //0 for an empty slot
+} FDP_BREAKPOINT_TABLE_PAGE;
+
+struct FDP_BREAKPOINT_TABLE_
+{
+    pthread_rwlock_t            Lock;               //Lookups come from the vCPU threads
+    FDP_BREAKPOINT_TABLE_ENTRY  *pEntries;
+    uint32_t                    EntryCapacity;
+    uint32_t                    EntryCount;         //Entries used once, the free ones are chained from FreeHead
+    uint32_t                    FreeHead;
+    uint32_t                    UsedCount;
+    uint32_t                    *pAddressSlots;     //Entry index + 1, 0 for an empty slot
+    uint32_t                    AddressSlotCount;   //Power of two
+    FDP_BREAKPOINT_TABLE_PAGE   *pPageSlots;
+    uint32_t                    PageSlotCount;      //Power of two
+    uint32_t                    PageCount;
+};
+
+static uint32_t FDP_BreakpointTableHash(uint64_t Key)
+{
+    Key ^= Key >> 33;
+    Key *= 0xFF51AFD7ED558CCDULL;
+    Key ^= Key >> 33;
+    Key *= 0xC4CEB9FE1A85EC53ULL;
+    Key ^= Key >> 33;
+    return (uint32_t)Key;
+}
+
+//Slot holding Address, or the empty slot where it goes
+static uint32_t FDP_BreakpointTableFindAddressSlot(FDP_BREAKPOINT_TABLE* pTable, uint64_t Address)
+{
+    uint32_t Mask = pTable->AddressSlotCount - 1;
+    uint32_t Slot = FDP_BreakpointTableHash(Address) & Mask;
+    while (pTable->pAddressSlots[Slot] != 0 && pTable->pEntries[pTable->pAddressSlots[Slot] - 1].Address != Address)
+    {
+        Slot = (Slot + 1) & Mask;
+    }
+    return Slot;
+}
+
+static uint32_t FDP_BreakpointTableFindPageSlot(FDP_BREAKPOINT_TABLE* pTable, uint64_t Page)
+{
+    uint32_t Mask = pTable->PageSlotCount - 1;
+    uint32_t Slot = FDP_BreakpointTableHash(Page) & Mask;
+    while (pTable->pPageSlots[Slot].BreakpointCount != 0 && pTable->pPageSlots[Slot].Page != Page)
+    {
+        Slot = (Slot + 1) & Mask;
+    }
+    return Slot;
+}
+
+static bool FDP_BreakpointTableGrowAddressSlots(FDP_BREAKPOINT_TABLE* pTable)
+{
+    uint32_t OldSlotCount = pTable->AddressSlotCount;
+    uint32_t* pOldSlots = pTable->pAddressSlots;
+    uint32_t* pNewSlots = (uint32_t*)calloc(OldSlotCount * 2, sizeof(uint32_t));
+    if (pNewSlots == NULL)
+    {
+        return false;
+    }
+    pTable->pAddressSlots = pNewSlots;
+    pTable->AddressSlotCount = OldSlotCount * 2;
+    for (uint32_t Slot = 0; Slot < OldSlotCount; Slot++)
+    {
+        if (pOldSlots[Slot] != 0)
+        {
+            uint64_t Address = pTable->pEntries[pOldSlots[Slot] - 1].Address;
+            pNewSlots[FDP_BreakpointTableFindAddressSlot(pTable, Address)] = pOldSlots[Slot];
+        }
+    }
+    free(pOldSlots);
+    return true;
+}
+
+static bool FDP_BreakpointTableGrowPageSlots(FDP_BREAKPOINT_TABLE* pTable)
+{
+    uint32_t OldSlotCount = pTable->PageSlotCount;
+    FDP_BREAKPOINT_TABLE_PAGE* pOldSlots = pTable->pPageSlots;
+    FDP_BREAKPOINT_TABLE_PAGE* pNewSlots = (FDP_BREAKPOINT_TABLE_PAGE*)calloc(OldSlotCount * 2, sizeof(FDP_BREAKPOINT_TABLE_PAGE));
+    if (pNewSlots == NULL)
+    {
+        return false;
+    }
+    pTable->pPageSlots = pNewSlots;
+    pTable->PageSlotCount = OldSlotCount * 2;
+    for (uint32_t Slot = 0; Slot < OldSlotCount; Slot++)
+    {
+        if (pOldSlots[Slot].BreakpointCount != 0)
+        {
+            pNewSlots[FDP_BreakpointTableFindPageSlot(pTable, pOldSlots[Slot].Page)] = pOldSlots[Slot];
+        }
+    }
+    free(pOldSlots);
+    return true;
+}
+
+//Backward shift deletion, the following slots of the probe sequence move back into the hole
+static void FDP_BreakpointTableEraseAddressSlot(FDP_BREAKPOINT_TABLE* pTable, uint32_t Slot)
+{
+    uint32_t Mask = pTable->AddressSlotCount - 1;
+    for (uint32_t Next = (Slot + 1) & Mask; pTable->pAddressSlots[Next] != 0; Next = (Next + 1) & Mask)
+    {
+        uint32_t Home = FDP_BreakpointTableHash(pTable->pEntries[pTable->pAddressSlots[Next] - 1].Address) & Mask;
+        if (((Next - Home) & Mask) >= ((Next - Slot) & Mask))
+        {
+            pTable->pAddressSlots[Slot] = pTable->pAddressSlots[Next];
+            Slot = Next;
+        }
+    }
+    pTable->pAddressSlots[Slot] = 0;
+}
+
+static void FDP_BreakpointTableErasePageSlot(FDP_BREAKPOINT_TABLE* pTable, uint32_t Slot)
+{
+    uint32_t Mask = pTable->PageSlotCount - 1;
+    for (uint32_t Next = (Slot + 1) & Mask; pTable->pPageSlots[Next].BreakpointCount != 0; Next = (Next + 1) & Mask)
+    {
+        uint32_t Home = FDP_BreakpointTableHash(pTable->pPageSlots[Next].Page) & Mask;
+        if (((Next - Home) & Mask) >= ((Next - Slot) & Mask))
+        {
+            pTable->pPageSlots[Slot] = pTable->pPageSlots[Next];
+            Slot = Next;
+        }
+    }
+    pTable->pPageSlots[Slot].BreakpointCount = 0;
+}
+
+static uint32_t FDP_BreakpointTableMakeHandle(FDP_BREAKPOINT_TABLE* pTable, uint32_t Index)
+{
+    uint32_t Generation = pTable->pEntries[Index].Generation & ((1U << (32 - FDP_BREAKPOINT_HANDLE_INDEX_BITS)) - 1);
+    return (Generation << FDP_BREAKPOINT_HANDLE_INDEX_BITS) | (Index + 1);
+}
+
+//Entry index of a live handle, -1 otherwise
+static int64_t FDP_BreakpointTableHandleIndex(FDP_BREAKPOINT_TABLE* pTable, uint32_t Handle)
+{
+    uint32_t Index = (Handle & FDP_BREAKPOINT_HANDLE_INDEX_MASK) - 1;
+    if ((Handle & FDP_BREAKPOINT_HANDLE_INDEX_MASK) == 0
+        || Index >= pTable->EntryCount
+        || pTable->pEntries[Index].bUsed == false
+        || FDP_BreakpointTableMakeHandle(pTable, Index) != Handle)
+    {
+        return -1;
+    }
+    return Index;
+}
+
+static bool FDP_BreakpointTableInsertLocked(FDP_BREAKPOINT_TABLE* pTable, uint64_t Address, uint32_t* pHandle, bool* pbNewPage)
+{
+    if (pTable->UsedCount >= FDP_MAX_BREAKPOINT_HANDLES
+        || ((pTable->UsedCount + 1) * 2 > pTable->AddressSlotCount && FDP_BreakpointTableGrowAddressSlots(pTable) == false)
+        || ((pTable->PageCount + 1) * 2 > pTable->PageSlotCount && FDP_BreakpointTableGrowPageSlots(pTable) == false))
+    {
+        return false;
+    }
+    uint32_t AddressSlot = FDP_BreakpointTableFindAddressSlot(pTable, Address);
+    if (pTable->pAddressSlots[AddressSlot] != 0)
+    {
+        return false;
+    }
+    uint32_t Index = 0;
+    if (pTable->FreeHead != 0)
+    {
+        Index = pTable->FreeHead - 1;
+        pTable->FreeHead = pTable->pEntries[Index].NextFree;
+    }
+    else
+    {
+        if (pTable->EntryCount == pTable->EntryCapacity)
+        {
+            uint32_t EntryCapacity = pTable->EntryCapacity * 2;
+            if (EntryCapacity > FDP_MAX_BREAKPOINT_HANDLES)
+            {
+                EntryCapacity = FDP_MAX_BREAKPOINT_HANDLES;
+            }
+            FDP_BREAKPOINT_TABLE_ENTRY* pEntries = (FDP_BREAKPOINT_TABLE_ENTRY*)realloc(pTable->pEntries,
+                                                   EntryCapacity * sizeof(FDP_BREAKPOINT_TABLE_ENTRY));
+            if (pEntries == NULL)
+            {
+                return false;
+            }
+            pTable->pEntries = pEntries;
+            pTable->EntryCapacity = EntryCapacity;
+        }
+        Index = pTable->EntryCount++;
+        pTable->pEntries[Index].Generation = 0;
+    }
+    pTable->pEntries[Index].Address = Address;
+    pTable->pEntries[Index].NextFree = 0;
+    pTable->pEntries[Index].bUsed = true;
+    pTable->pAddressSlots[AddressSlot] = Index + 1;
+    pTable->UsedCount++;
+
+    uint64_t Page = Address & ~(FDP_BREAKPOINT_PAGE_SIZE - 1);
+    FDP_BREAKPOINT_TABLE_PAGE* pPage = &pTable->pPageSlots[FDP_BreakpointTableFindPageSlot(pTable, Page)];
+    if (pbNewPage != NULL)
+    {
+        *pbNewPage = pPage->BreakpointCount == 0;
+    }
+    if (pPage->BreakpointCount == 0)
+    {
+        pPage->Page = Page;
+        pTable->PageCount++;
+    }
+    pPage->BreakpointCount++;
+    *pHandle = FDP_BreakpointTableMakeHandle(pTable, Index);
+    return true;
+}
+
+static bool FDP_BreakpointTableRemoveLocked(FDP_BREAKPOINT_TABLE* pTable, uint32_t Handle, uint64_t* pAddress, bool* pbLastInPage)
+{
+    int64_t Index = FDP_BreakpointTableHandleIndex(pTable, Handle);
+    if (Index < 0)
+    {
+        return false;
+    }
+    FDP_BREAKPOINT_TABLE_ENTRY* pEntry = &pTable->pEntries[Index];
+    FDP_BreakpointTableEraseAddressSlot(pTable, FDP_BreakpointTableFindAddressSlot(pTable, pEntry->Address));
+    uint32_t PageSlot = FDP_BreakpointTableFindPageSlot(pTable, pEntry->Address & ~(FDP_BREAKPOINT_PAGE_SIZE - 1));
+    pTable->pPageSlots[PageSlot].BreakpointCount--;
+    if (pbLastInPage != NULL)
+    {
+        *pbLastInPage = pTable->pPageSlots[PageSlot].BreakpointCount == 0;
+    }
+    if (pTable->pPageSlots[PageSlot].BreakpointCount == 0)
+    {
+        FDP_BreakpointTableErasePageSlot(pTable, PageSlot);
+        pTable->PageCount--;
+    }
+    if (pAddress != NULL)
+    {
+        *pAddress = pEntry->Address;
+    }
+    pEntry->bUsed = false;
+    pEntry->Generation++;
+    pEntry->NextFree = pTable->FreeHead;
+    pTable->FreeHead = (uint32_t)Index + 1;
+    pTable->UsedCount--;
+    return true;
+}
+
+//Frees every entry, their handles don't match anymore
+static void FDP_BreakpointTableClear(FDP_BREAKPOINT_TABLE* pTable)
+{
+    pthread_rwlock_wrlock(&pTable->Lock);
+    for (uint32_t Index = 0; Index < pTable->EntryCount; Index++)
+    {
+        if (pTable->pEntries[Index].bUsed)
+        {
+            pTable->pEntries[Index].bUsed = false;
+            pTable->pEntries[Index].Generation++;
+            pTable->pEntries[Index].NextFree = pTable->FreeHead;
+            pTable->FreeHead = Index + 1;
+        }
+    }
+    memset(pTable->pAddressSlots, 0, pTable->AddressSlotCount * sizeof(uint32_t));
+    memset(pTable->pPageSlots, 0, pTable->PageSlotCount * sizeof(FDP_BREAKPOINT_TABLE_PAGE));
+    pTable->UsedCount = 0;
+    pTable->PageCount = 0;
+    pthread_rwlock_unlock(&pTable->Lock);
+}
+
+FDP_EXPORTED
+FDP_BREAKPOINT_TABLE* FDP_CreateBreakpointTable()
+{
+    FDP_BREAKPOINT_TABLE* pTable = (FDP_BREAKPOINT_TABLE*)calloc(1, sizeof(FDP_BREAKPOINT_TABLE));
+    if (pTable == NULL)
+    {
+        return NULL;
+    }
+    pTable->EntryCapacity = FDP_BREAKPOINT_TABLE_MIN_SLOTS;
+    pTable->AddressSlotCount = FDP_BREAKPOINT_TABLE_MIN_SLOTS;
+    pTable->PageSlotCount = FDP_BREAKPOINT_TABLE_MIN_SLOTS;
+    pTable->pEntries = (FDP_BREAKPOINT_TABLE_ENTRY*)malloc(pTable->EntryCapacity * sizeof(FDP_BREAKPOINT_TABLE_ENTRY));
+    pTable->pAddressSlots = (uint32_t*)calloc(pTable->AddressSlotCount, sizeof(uint32_t));
+    pTable->pPageSlots = (FDP_BREAKPOINT_TABLE_PAGE*)calloc(pTable->PageSlotCount, sizeof(FDP_BREAKPOINT_TABLE_PAGE));
+    if (pTable->pEntries == NULL
+        || pTable->pAddressSlots == NULL
+        || pTable->pPageSlots == NULL
+        || pthread_rwlock_init(&pTable->Lock, NULL) != 0)
+    {
+        free(pTable->pEntries);
+        free(pTable->pAddressSlots);
+        free(pTable->pPageSlots);
+        free(pTable);
+        return NULL;
+    }
+    return pTable;
+}
+
+FDP_EXPORTED
+void FDP_DestroyBreakpointTable(FDP_BREAKPOINT_TABLE* pTable)
+{
+    if (pTable == NULL)
+    {
+        return;
+    }
+    pthread_rwlock_destroy(&pTable->Lock);
+    free(pTable->pEntries);
+    free(pTable->pAddressSlots);
+    free(pTable->pPageSlots);
+    free(pTable);
+}
+
+//Fails if Address already has a breakpoint, *pbNewPage tells whether it is the first one of its page
+FDP_EXPORTED
+bool FDP_BreakpointTableInsert(FDP_BREAKPOINT_TABLE* pTable, uint64_t Address, uint32_t* pHandle, bool* pbNewPage)
+{
+    if (pTable == NULL || pHandle == NULL)
+    {
+        return false;
+    }
+    pthread_rwlock_wrlock(&pTable->Lock);
+    bool bReturnValue = FDP_BreakpointTableInsertLocked(pTable, Address, pHandle, pbNewPage);
+    pthread_rwlock_unlock(&pTable->Lock);
+    return bReturnValue;
+}
+
+//*pbLastInPage tells whether the page of the breakpoint has no breakpoint left
+FDP_EXPORTED
+bool FDP_BreakpointTableRemove(FDP_BREAKPOINT_TABLE* pTable, uint32_t Handle, uint64_t* pAddress, bool* pbLastInPage)
+{
+    if (pTable == NULL)
+    {
+        return false;
+    }
+    pthread_rwlock_wrlock(&pTable->Lock);
+    bool bReturnValue = FDP_BreakpointTableRemoveLocked(pTable, Handle, pAddress, pbLastInPage);
+    pthread_rwlock_unlock(&pTable->Lock);
+    return bReturnValue;
+}
+
+//Handle of the breakpoint at Address, FDP_INVALID_BREAKPOINT_HANDLE if none
+FDP_EXPORTED
+uint32_t FDP_BreakpointTableLookup(FDP_BREAKPOINT_TABLE* pTable, uint64_t Address)
+{
+    if (pTable == NULL)
+    {
+        return FDP_INVALID_BREAKPOINT_HANDLE;
+    }
+    uint32_t Handle = FDP_INVALID_BREAKPOINT_HANDLE;
+    pthread_rwlock_rdlock(&pTable->Lock);
+    uint32_t Slot = FDP_BreakpointTableFindAddressSlot(pTable, Address);
+    if (pTable->pAddressSlots[Slot] != 0)
+    {
+        Handle = FDP_BreakpointTableMakeHandle(pTable, pTable->pAddressSlots[Slot] - 1);
+    }
+    pthread_rwlock_unlock(&pTable->Lock);
+    return Handle;
+}
+
+//Number of breakpoints in the page of Address
+FDP_EXPORTED
+uint32_t FDP_BreakpointTablePageCount(FDP_BREAKPOINT_TABLE* pTable, uint64_t Address)
+{
+    if (pTable == NULL)
+    {
+        return 0;
+    }
+    pthread_rwlock_rdlock(&pTable->Lock);
+    uint32_t BreakpointCount = pTable->pPageSlots[FDP_BreakpointTableFindPageSlot(pTable, Address & ~(FDP_BREAKPOINT_PAGE_SIZE - 1))].BreakpointCount;
+    pthread_rwlock_unlock(&pTable->Lock);
+    return BreakpointCount;
+}
+
+#define FDP_BREAKPOINT_HANDLE_MAX_CPU   256
+
+typedef struct FDP_BREAKPOINT_ACTION_
+{
+    volatile uint32_t           Flags;              //FDP_TracepointFlags, 0 for a regular breakpoint
+    volatile uint64_t           RegisterMask;
+    volatile uint32_t           ConditionCount;     //0 for an unconditional breakpoint
+    FDP_BREAKPOINT_CONDITION    aConditions[FDP_MAX_BREAKPOINT_CONDITIONS];
+    volatile int32_t            ProgramId;          //-1 when no program is attached
+    volatile int32_t            AggregationId;      //-1 when the hits aren't counted
+    volatile uint64_t           WatchStart;
+    volatile uint64_t           WatchEnd;           //0 when the breakpoint isn't a watchpoint
+    volatile FDP_Access         WatchAccess;
+    volatile FDP_AddressType    WatchAddressType;
+} FDP_BREAKPOINT_ACTION;
+
+typedef struct FDP_PROGRAM_
+{
+    volatile bool               bLoaded;
+    volatile uint32_t           ActiveRunCount;     //vCPUs running it, it is only reused at 0
+    uint32_t                    InstructionCount;
+    FDP_PROGRAM_INSTRUCTION     aInstructions[FDP_PROGRAM_MAX_INSTRUCTIONS];
+    volatile uint64_t           aMap[FDP_PROGRAM_MAP_SIZE];
+} FDP_PROGRAM;
+
+#define FDP_COVERAGE_PAGE_GROUP     2   //aPageGroups of the coverage ranges, execute breakpoints use Page | 1
+
+typedef struct FDP_COVERAGE_RANGE_
+{
+    int                     BreakpointId;       //-1 once unset
+    uint64_t                Start;
+    uint64_t                End;
+} FDP_COVERAGE_RANGE;
+
+typedef struct FDP_COVERAGE_
+{
+    volatile bool           bArmed;
+    volatile uint32_t       ActiveHitCount;     //vCPUs in FDP_ServerCoverageHit, the blocks are only rebuilt at 0
+    uint64_t                *pAddresses;        //Uploaded blocks, kept to arm them again
+    uint32_t                BlockCount;
+    FDP_BREAKPOINT_TABLE    *pBlocks;           //Blocks not hit yet
+    uint32_t                *pBlockIndexes;     //Block of each table entry
+    volatile uint64_t       *pBitmap;
+    volatile uint32_t       HitCount;
+    volatile bool           bTrimPending;       //A page has no block left to hit, see FDP_ServerTrimCoverage
+    bool                    bTrimRefused;       //The backend refused the last trim, only retried once paused
+    FDP_COVERAGE_RANGE      aRanges[FDP_COVERAGE_MAX_RANGES];
+    uint32_t                RangeCount;         //Sorted by Start, only used by the server thread
+} FDP_COVERAGE;
+
+typedef struct FDP_AGGREGATION_SLOT_
+{
+    volatile uint32_t       State;              //FDP_AGGREGATION_SLOT_FREE, _WRITING or _USED
+    volatile uint64_t       Key;
+    volatile uint64_t       Count;
+} FDP_AGGREGATION_SLOT;
+
+#define FDP_AGGREGATION_SLOT_FREE       0
+#define FDP_AGGREGATION_SLOT_WRITING    1
+#define FDP_AGGREGATION_SLOT_USED       2
+
+typedef struct FDP_AGGREGATION_TABLE_
+{
+    FDP_AGGREGATION_SLOT    *pSlots;
+    volatile uint32_t       KeyCount;
+    volatile uint64_t       DroppedCount;       //Hits on new keys past MaxKeyCount, or with an unreadable key
+    volatile uint32_t       ActiveHitCount;     //vCPUs counting in it, it is only cleared at 0
+} FDP_AGGREGATION_TABLE;
+
+//Hits are counted in aTables[ActiveTable], a reset switches to the other table and drains the previous one
+typedef struct FDP_AGGREGATION_
+{
+    volatile bool           bCreated;
+    uint32_t                KeyType;            //FDP_AggregationKey
+    int32_t                 StackOffset;
+    uint32_t                MaxKeyCount;
+    uint32_t                SlotCount;          //Power of 2, twice MaxKeyCount at least
+    FDP_AGGREGATION_TABLE   aTables[2];
+    volatile uint32_t       ActiveTable;
+} FDP_AGGREGATION;
+
+struct FDP_BREAKPOINT_ACTIONS_
+{
+    FDP_BREAKPOINT_ACTION   aActions[FDP_MAX_BREAKPOINT + 1];
+    FDP_PROGRAM             aPrograms[FDP_MAX_PROGRAMS];
+    FDP_BREAKPOINT_TABLE    *pExecuteBreakpoints;                           //See FDP_AddExecuteBreakpoint
+    volatile uint64_t       aPageGroups[FDP_MAX_BREAKPOINT + 1];            //Page | 1 of the execute breakpoints behind this backend breakpoint
+    volatile uint32_t       aHitHandles[FDP_BREAKPOINT_HANDLE_MAX_CPU];     //Execute breakpoint of the last hit of each CPU
+    FDP_COVERAGE            Coverage;                                       //See FDP_SetCoverageBlocks
+    FDP_AGGREGATION         aAggregations[FDP_MAX_AGGREGATIONS];            //See FDP_CreateAggregation
+};
+
+static uint64_t FDP_GetTimestamp()
+{
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+static bool FDP_ServerSetTracepoint(FDP_SHM* pFDP)
+{
+    FDP_SET_TRACEPOINT_PKT_REQ* TempPkt = (FDP_SET_TRACEPOINT_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL
+        || TempPkt->BreakpointId < 0
+        || TempPkt->BreakpointId > FDP_MAX_BREAKPOINT
+        || __builtin_popcountll(TempPkt->RegisterMask) > FDP_HIT_LOG_MAX_REGISTERS
+        || ((TempPkt->Flags & FDP_TRACEPOINT_LOG) && pFDP->pHitLog == NULL))
+    {
+        return false;
+    }
+    FDP_BREAKPOINT_ACTION* pAction = &pFDP->pBreakpointActions->aActions[TempPkt->BreakpointId];
+    //Hits on other vCPUs may see the old flags with the new mask, never a mask wider than allowed
+    pAction->Flags = 0;
+    __sync_synchronize();
+    pAction->RegisterMask = TempPkt->RegisterMask;
+    __sync_synchronize();
+    pAction->Flags = TempPkt->Flags;
+    return true;
+}
+
+static bool FDP_ServerCheckConditions(const FDP_BREAKPOINT_CONDITION* pConditions, uint32_t ConditionCount)
+{
+    if (ConditionCount > FDP_MAX_BREAKPOINT_CONDITIONS)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < ConditionCount; i++)
+    {
+        const FDP_BREAKPOINT_CONDITION* pCondition = &pConditions[i];
+        if (pCondition->Operand > FDP_CONDITION_MEMORY
+            || pCondition->Operator > FDP_CONDITION_GE
+            || pCondition->RegisterId >= FDP_MAX_REGISTER_MASK_COUNT
+            || (pCondition->Operand == FDP_CONDITION_MEMORY
+                && pCondition->Size != 1 && pCondition->Size != 2 && pCondition->Size != 4 && pCondition->Size != 8))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool FDP_ServerSetBreakpointCondition(FDP_SHM* pFDP)
+{
+    FDP_SET_BREAKPOINT_CONDITION_PKT_REQ* TempPkt = (FDP_SET_BREAKPOINT_CONDITION_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL
+        || TempPkt->BreakpointId < 0
+        || TempPkt->BreakpointId > FDP_MAX_BREAKPOINT
+        || FDP_ServerCheckConditions(TempPkt->Conditions, TempPkt->ConditionCount) == false)
+    {
+        return false;
+    }
+    FDP_BREAKPOINT_ACTION* pAction = &pFDP->pBreakpointActions->aActions[TempPkt->BreakpointId];
+    //Hits on other vCPUs see no condition while the new ones are copied
+    pAction->ConditionCount = 0;
+    __sync_synchronize();
+    memcpy(pAction->aConditions, TempPkt->Conditions, TempPkt->ConditionCount * sizeof(FDP_BREAKPOINT_CONDITION));
+    __sync_synchronize();
+    pAction->ConditionCount = TempPkt->ConditionCount;
+    return true;
+}
+
+//An operand that can't be read makes the condition true, the VM stops rather than missing a hit
+static bool FDP_ServerEvaluateConditions(FDP_SHM* pFDP, uint32_t CpuId, const FDP_BREAKPOINT_CONDITION* pConditions,
+                                         uint32_t ConditionCount)
+{
+    for (uint32_t i = 0; i < ConditionCount; i++)
+    {
+        const FDP_BREAKPOINT_CONDITION* pCondition = &pConditions[i];
+        uint64_t Operand = 0;
+        if (pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, pCondition->RegisterId, &Operand) == false)
+        {
+            continue;
+        }
+        if (pCondition->Operand == FDP_CONDITION_MEMORY)
+        {
+            uint64_t Address = Operand + (uint64_t)pCondition->Offset;
+            Operand = 0;
+            if (pFDP->pFdpServer->pfnReadVirtualMemory(pFDP->pFdpServer->pUserHandle, CpuId, Address,
+                                                       pCondition->Size, (uint8_t*)&Operand) == false)
+            {
+                continue;
+            }
+        }
+        Operand &= pCondition->Mask;
+        bool bResult = false;
+        switch (pCondition->Operator)
+        {
+        case FDP_CONDITION_EQ: bResult = Operand == pCondition->Value; break;
+        case FDP_CONDITION_NE: bResult = Operand != pCondition->Value; break;
+        case FDP_CONDITION_LT: bResult = Operand < pCondition->Value; break;
+        case FDP_CONDITION_LE: bResult = Operand <= pCondition->Value; break;
+        case FDP_CONDITION_GT: bResult = Operand > pCondition->Value; break;
+        case FDP_CONDITION_GE: bResult = Operand >= pCondition->Value; break;
+        }
+        if (bResult == false)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool FDP_ServerSingleStepN(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_SINGLE_STEP_N_PKT_REQ* TempPkt = (FDP_SINGLE_STEP_N_PKT_REQ*)pFDP->InputBuffer;
+    FDP_SINGLE_STEP_N_PKT_RSP* pRsp = (FDP_SINGLE_STEP_N_PKT_RSP*)pFDP->OutputBuffer;
+    if (FDP_ServerCheckConditions(TempPkt->Conditions, TempPkt->ConditionCount) == false)
+    {
+        return false;
+    }
+    //RIP then the RegisterMask registers, for each step
+    uint32_t ValueCount = TempPkt->bTrace ? 1 + __builtin_popcountll(TempPkt->RegisterMask) : 0;
+    uint32_t StepCount = TempPkt->StepCount;
+    if (ValueCount > 0)
+    {
+        //Steps that don't fit are made by the next request
+        StepCount = MIN(StepCount, (FDP_MAX_DATA_SIZE - 1 - sizeof(FDP_SINGLE_STEP_N_PKT_RSP)) / (ValueCount * sizeof(uint64_t)));
+    }
+    uint64_t* pTrace = (uint64_t*)(pFDP->OutputBuffer + sizeof(FDP_SINGLE_STEP_N_PKT_RSP));
+    pRsp->StepCount = 0;
+    pRsp->EndReason = FDP_STEP_END_COUNT;
+    while (pRsp->StepCount < StepCount)
+    {
+        if (pFDP->pFdpServer->pfnSingleStep(pFDP->pFdpServer->pUserHandle, TempPkt->CpuId) == false)
+        {
+            pRsp->EndReason = FDP_STEP_END_ERROR;
+            break;
+        }
+        pRsp->StepCount++;
+        if (ValueCount > 0)
+        {
+            memset(pTrace, 0, ValueCount * sizeof(uint64_t));
+            if (pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, TempPkt->CpuId, FDP_RIP_REGISTER,
+                                                  &pTrace[0]) == false
+                || FDP_ServerReadRegisterValues(pFDP, TempPkt->CpuId, TempPkt->RegisterMask, &pTrace[1]) == false)
+            {
+                pRsp->EndReason = FDP_STEP_END_ERROR;
+                break;
+            }
+            pTrace += ValueCount;
+        }
+        if (TempPkt->ConditionCount > 0
+            && FDP_ServerEvaluateConditions(pFDP, TempPkt->CpuId, TempPkt->Conditions, TempPkt->ConditionCount))
+        {
+            pRsp->EndReason = FDP_STEP_END_CONDITION;
+            break;
+        }
+    }
+    FDP_ServerRefreshCpuCtx(pFDP, TempPkt->CpuId);
+    *pOutputBufferSize = (uint32_t)(sizeof(FDP_SINGLE_STEP_N_PKT_RSP) + pRsp->StepCount * ValueCount * sizeof(uint64_t));
+    return true;
+}
+
+static bool FDP_ServerReadStepRegisters(FDP_SHM* pFDP, uint32_t CpuId, uint64_t* pRip, uint64_t* pRsp, uint64_t* pCr3)
+{
+    return pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, pRip)
+        && pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RSP_REGISTER, pRsp)
+        && pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CR3_REGISTER, pCr3);
+}
+
+//Whether the instruction at Rip is a near or far RET, its prefixes are skipped
+static bool FDP_ServerIsReturnInstruction(FDP_SHM* pFDP, uint32_t CpuId, uint64_t Rip)
+{
+    uint8_t Instruction[FDP_MAX_INSTRUCTION_SIZE];
+    //Stay on the page of Rip, only a RET with a dozen prefixes has its opcode on the next one
+    uint32_t ReadSize = (uint32_t)MIN(FDP_MAX_INSTRUCTION_SIZE, FDP_BREAKPOINT_PAGE_SIZE - (Rip & (FDP_BREAKPOINT_PAGE_SIZE - 1)));
+    if (FDP_ServerReadMemory(pFDP, CpuId, FDP_VIRTUAL_ADDRESS, Instruction, Rip, ReadSize) == false)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < ReadSize; i++)
+    {
+        uint8_t Byte = Instruction[i];
+        bool bPrefix = Byte == 0x26 || Byte == 0x2E || Byte == 0x36 || Byte == 0x3E || Byte == 0x64 || Byte == 0x65
+            || Byte == 0x66 || Byte == 0x67 || Byte == 0xF0 || Byte == 0xF2 || Byte == 0xF3
+            || (Byte & 0xF0) == 0x40;   //REX
+        if (bPrefix == false)
+        {
+            return Byte == 0xC3 || Byte == 0xC2 || Byte == 0xCB || Byte == 0xCA;
+        }
+    }
+    return false;
+}
+
+static bool FDP_ServerStepUntil(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_STEP_UNTIL_PKT_REQ* TempPkt = (FDP_STEP_UNTIL_PKT_REQ*)pFDP->InputBuffer;
+    FDP_STEP_UNTIL_RESULT* pResult = (FDP_STEP_UNTIL_RESULT*)pFDP->OutputBuffer;
+    if ((TempPkt->Flags & ~FDP_STEP_UNTIL_ALL) != 0)
+    {
+        return false;
+    }
+    memset(pResult, 0, sizeof(FDP_STEP_UNTIL_RESULT));
+    pResult->EndReason = FDP_STEP_END_COUNT;
+    pResult->CpuState.BreakpointId = -1;
+    *pOutputBufferSize = sizeof(FDP_STEP_UNTIL_RESULT);
+
+    uint64_t Rip = 0;
+    uint64_t StartRsp = 0;
+    uint64_t StartCr3 = 0;
+    if (FDP_ServerReadStepRegisters(pFDP, TempPkt->CpuId, &Rip, &StartRsp, &StartCr3) == false)
+    {
+        pResult->EndReason = FDP_STEP_END_ERROR;
+        return true;
+    }
+    uint64_t Rsp = StartRsp;
+    uint64_t Cr3 = StartCr3;
+    //Return address of the frame the steps start from, when they start on a function entry
+    uint64_t ReturnAddress = 0;
+    bool bReturnAddress = (TempPkt->Flags & FDP_STEP_UNTIL_RETURN)
+        && FDP_ServerReadMemory(pFDP, TempPkt->CpuId, FDP_VIRTUAL_ADDRESS, (uint8_t*)&ReturnAddress, StartRsp,
+                                sizeof(ReturnAddress));
+    while (pResult->StepCount < TempPkt->MaxStepCount)
+    {
+        uint64_t PreviousRip = Rip;
+        if (pFDP->pFdpServer->pfnSingleStep(pFDP->pFdpServer->pUserHandle, TempPkt->CpuId) == false)
+        {
+            pResult->EndReason = FDP_STEP_END_ERROR;
+            break;
+        }
+        pResult->StepCount++;
+        if (FDP_ServerReadStepRegisters(pFDP, TempPkt->CpuId, &Rip, &Rsp, &Cr3) == false)
+        {
+            pResult->EndReason = FDP_STEP_END_ERROR;
+            break;
+        }
+        bool bInside = Rip >= TempPkt->RangeStart && Rip < TempPkt->RangeEnd;
+        uint32_t StopFlags = 0;
+        StopFlags |= bInside ? FDP_STEP_UNTIL_RIP_INSIDE : FDP_STEP_UNTIL_RIP_OUTSIDE;
+        StopFlags |= (Cr3 != StartCr3) ? FDP_STEP_UNTIL_CR3_CHANGE : 0;
+        //Without decoding, a short forward jump looks like a straight instruction while a rep-prefixed instruction
+        //that isn't done (RIP doesn't move) and an interrupt or exception entry look like branches
+        StopFlags |= (Rip <= PreviousRip || Rip > PreviousRip + FDP_MAX_INSTRUCTION_SIZE) ? FDP_STEP_UNTIL_BRANCH : 0;
+        //Popping or adjusting RSP isn't a return, the step must have been a RET or landed on the saved return address
+        if ((TempPkt->Flags & FDP_STEP_UNTIL_RETURN) && Rsp > StartRsp
+            && ((bReturnAddress && Rip == ReturnAddress)
+                || FDP_ServerIsReturnInstruction(pFDP, TempPkt->CpuId, PreviousRip)))
+        {
+            StopFlags |= FDP_STEP_UNTIL_RETURN;
+        }
+        pResult->StopFlags = StopFlags & TempPkt->Flags;
+        if (pResult->StopFlags != 0)
+        {
+            pResult->EndReason = FDP_STEP_END_CONDITION;
+            break;
+        }
+    }
+    FDP_ServerRefreshCpuCtx(pFDP, TempPkt->CpuId);
+    pFDP->pFdpServer->pfnGetCpuState(pFDP->pFdpServer->pUserHandle, TempPkt->CpuId, &pResult->CpuState.State);
+    pResult->CpuState.Rip = Rip;
+    pResult->CpuState.Rsp = Rsp;
+    pResult->CpuState.Cr3 = Cr3;
+    return true;
+}
+
+static FDP_PROGRAM* FDP_ServerGetProgram(FDP_SHM* pFDP, int ProgramId)
+{
+    if (pFDP->pBreakpointActions == NULL || ProgramId < 0 || ProgramId >= FDP_MAX_PROGRAMS
+        || pFDP->pBreakpointActions->aPrograms[ProgramId].bLoaded == false)
+    {
+        return NULL;
+    }
+    return &pFDP->pBreakpointActions->aPrograms[ProgramId];
+}
+
+static bool FDP_ServerLoadProgram(FDP_SHM* pFDP, int* pProgramId)
+{
+    FDP_LOAD_PROGRAM_PKT_REQ* TempPkt = (FDP_LOAD_PROGRAM_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL || FDP_VerifyProgram(TempPkt->Instructions, TempPkt->InstructionCount) == false)
+    {
+        return false;
+    }
+    for (int ProgramId = 0; ProgramId < FDP_MAX_PROGRAMS; ProgramId++)
+    {
+        FDP_PROGRAM* pProgram = &pFDP->pBreakpointActions->aPrograms[ProgramId];
+        if (pProgram->bLoaded == false && pProgram->ActiveRunCount == 0)
+        {
+            pProgram->InstructionCount = TempPkt->InstructionCount;
+            memcpy(pProgram->aInstructions, TempPkt->Instructions, TempPkt->InstructionCount * sizeof(FDP_PROGRAM_INSTRUCTION));
+            memset((void*)pProgram->aMap, 0, sizeof(pProgram->aMap));
+            __sync_synchronize();
+            pProgram->bLoaded = true;
+            *pProgramId = ProgramId;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool FDP_ServerUnloadProgram(FDP_SHM* pFDP)
+{
+    FDP_PROGRAM_PKT_REQ* TempPkt = (FDP_PROGRAM_PKT_REQ*)pFDP->InputBuffer;
+    FDP_PROGRAM* pProgram = FDP_ServerGetProgram(pFDP, TempPkt->ProgramId);
+    if (pProgram == NULL)
+    {
+        return false;
+    }
+    for (int BreakpointId = 0; BreakpointId <= FDP_MAX_BREAKPOINT; BreakpointId++)
+    {
+        __sync_bool_compare_and_swap(&pFDP->pBreakpointActions->aActions[BreakpointId].ProgramId, TempPkt->ProgramId, -1);
+    }
+    pProgram->bLoaded = false;
+    __sync_synchronize();
+    //Let the vCPUs still running it finish
+    while (pProgram->ActiveRunCount != 0)
+    {
+        __sync_synchronize();
+    }
+    return true;
+}
+
+static bool FDP_ServerAttachProgram(FDP_SHM* pFDP)
+{
+    FDP_PROGRAM_PKT_REQ* TempPkt = (FDP_PROGRAM_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL
+        || TempPkt->BreakpointId < 0
+        || TempPkt->BreakpointId > FDP_MAX_BREAKPOINT
+        || (TempPkt->ProgramId != -1 && FDP_ServerGetProgram(pFDP, TempPkt->ProgramId) == NULL))
+    {
+        return false;
+    }
+    pFDP->pBreakpointActions->aActions[TempPkt->BreakpointId].ProgramId = TempPkt->ProgramId;
+    return true;
+}
+
+static bool FDP_ServerReadProgramMap(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_PROGRAM_PKT_REQ* TempPkt = (FDP_PROGRAM_PKT_REQ*)pFDP->InputBuffer;
+    FDP_PROGRAM* pProgram = FDP_ServerGetProgram(pFDP, TempPkt->ProgramId);
+    if (pProgram == NULL || TempPkt->FirstIndex > FDP_PROGRAM_MAP_SIZE || TempPkt->Count > FDP_PROGRAM_MAP_SIZE - TempPkt->FirstIndex)
+    {
+        return false;
+    }
+    uint64_t* pValues = (uint64_t*)pFDP->OutputBuffer;
+    for (uint32_t i = 0; i < TempPkt->Count; i++)
+    {
+        pValues[i] = pProgram->aMap[TempPkt->FirstIndex + i];
+    }
+    *pOutputBufferSize = TempPkt->Count * sizeof(uint64_t);
+    return true;
+}
+
+#define FDP_PROGRAM_PAGE_SIZE   4096
+
+//Reads Size bytes of guest memory that may cross pages, stops at the first unreadable page
+static uint32_t FDP_ServerReadVirtualBytes(FDP_SHM* pFDP, uint32_t CpuId, uint64_t VirtualAddress, uint8_t* pBuffer, uint32_t Size)
+{
+    uint32_t ReadSize = 0;
+    while (ReadSize < Size)
+    {
+        uint32_t ChunkSize = MIN(Size - ReadSize, FDP_PROGRAM_PAGE_SIZE - (uint32_t)((VirtualAddress + ReadSize) & (FDP_PROGRAM_PAGE_SIZE - 1)));
+        if (pFDP->pFdpServer->pfnReadVirtualMemory(pFDP->pFdpServer->pUserHandle, CpuId, VirtualAddress + ReadSize,
+                                                   ChunkSize, pBuffer + ReadSize) == false)
+        {
+            break;
+        }
+        ReadSize += ChunkSize;
+    }
+    return ReadSize;
+}
+
+static void FDP_ServerCallProgramHelper(FDP_SHM* pFDP, FDP_PROGRAM* pProgram, uint32_t CpuId, int BreakpointId, int64_t HelperId, uint64_t* pRegisters)
+{
+    uint64_t Result = 0;
+    uint64_t Status = 0;
+    switch (HelperId)
+    {
+    case FDP_HELPER_READ_REGISTER:
+        Status = pRegisters[1] < FDP_MAX_REGISTER_MASK_COUNT
+            && pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, (FDP_Register)pRegisters[1], &Result);
+        break;
+    case FDP_HELPER_READ_MEMORY:
+        if (pRegisters[2] == 1 || pRegisters[2] == 2 || pRegisters[2] == 4 || pRegisters[2] == 8)
+        {
+            Status = FDP_ServerReadVirtualBytes(pFDP, CpuId, pRegisters[1], (uint8_t*)&Result, (uint32_t)pRegisters[2]) == pRegisters[2];
+            if (Status == 0)
+            {
+                Result = 0;
+            }
+        }
+        break;
+    case FDP_HELPER_HASH_STRING:
+    {
+        uint8_t aString[FDP_PROGRAM_MAX_STRING_SIZE];
+        uint32_t MaxSize = (uint32_t)MIN(pRegisters[2], FDP_PROGRAM_MAX_STRING_SIZE);
+        uint32_t ReadSize = FDP_ServerReadVirtualBytes(pFDP, CpuId, pRegisters[1], aString, MaxSize);
+        //FNV-1a, up to the terminating zero or MaxSize bytes
+        Result = 0xCBF29CE484222325ULL;
+        uint32_t i;
+        for (i = 0; i < ReadSize && aString[i] != 0; i++)
+        {
+            Result = (Result ^ aString[i]) * 0x100000001B3ULL;
+        }
+        Status = i < ReadSize || ReadSize == MaxSize;
+        break;
+    }
+    case FDP_HELPER_MAP_LOOKUP:
+        Result = pRegisters[1] < FDP_PROGRAM_MAP_SIZE ? pProgram->aMap[pRegisters[1]] : 0;
+        break;
+    case FDP_HELPER_MAP_UPDATE:
+        if (pRegisters[1] < FDP_PROGRAM_MAP_SIZE)
+        {
+            pProgram->aMap[pRegisters[1]] = pRegisters[2];
+            Result = 1;
+        }
+        break;
+    case FDP_HELPER_MAP_ADD:
+        if (pRegisters[1] < FDP_PROGRAM_MAP_SIZE)
+        {
+            Result = __sync_add_and_fetch(&pProgram->aMap[pRegisters[1]], pRegisters[2]);
+        }
+        break;
+    case FDP_HELPER_OUTPUT:
+        if (pFDP->pHitLog != NULL)
+        {
+            FDP_HIT_RECORD Record;
+            memset(&Record, 0, sizeof(Record));
+            Record.Timestamp = FDP_GetTimestamp();
+            Record.CpuId = CpuId;
+            Record.BreakpointId = BreakpointId;
+            pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, &Record.Rip);
+            pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CR3_REGISTER, &Record.Cr3);
+            Record.RegisterMask = FDP_HIT_RECORD_PROGRAM_OUTPUT;
+            memcpy(Record.RegisterValues, &pRegisters[1], 5 * sizeof(uint64_t));
+            Result = FDP_HitLogAppend(pFDP->pHitLog, &Record);
+        }
+        break;
+    case FDP_HELPER_GET_TIMESTAMP:
+        Result = FDP_GetTimestamp();
+        break;
+    }
+    pRegisters[0] = Result;
+    //r1-r5 are clobbered by calls
+    pRegisters[1] = Status;
+    pRegisters[2] = pRegisters[3] = pRegisters[4] = pRegisters[5] = 0;
+}
+
+//Returns false if the run was aborted after FDP_PROGRAM_MAX_STEPS instructions
+static bool FDP_ServerRunProgram(FDP_SHM* pFDP, FDP_PROGRAM* pProgram, uint32_t CpuId, int BreakpointId, uint64_t* pResult)
+{
+    uint64_t aRegisters[FDP_PROGRAM_REGISTER_COUNT];
+    memset(aRegisters, 0, sizeof(aRegisters));
+    aRegisters[1] = CpuId;
+    aRegisters[2] = (uint64_t)(int64_t)BreakpointId;
+    uint32_t Pc = 0;
+    for (uint32_t Step = 0; Step < FDP_PROGRAM_MAX_STEPS; Step++)
+    {
+        //FDP_VerifyProgram guarantees indexes and jump targets are in range
+        const FDP_PROGRAM_INSTRUCTION* pInstruction = &pProgram->aInstructions[Pc++];
+        uint8_t Operation = pInstruction->Opcode & ~FDP_OP_IMM;
+        if (Operation == FDP_OP_EXIT)
+        {
+            *pResult = aRegisters[0];
+            return true;
+        }
+        if (Operation == FDP_OP_CALL)
+        {
+            FDP_ServerCallProgramHelper(pFDP, pProgram, CpuId, BreakpointId, pInstruction->Imm, aRegisters);
+            continue;
+        }
+        uint64_t* pDst = &aRegisters[pInstruction->Dst];
+        uint64_t Src = (pInstruction->Opcode & FDP_OP_IMM) ? (uint64_t)pInstruction->Imm : aRegisters[pInstruction->Src];
+        bool bJump = false;
+        switch (Operation)
+        {
+        case FDP_OP_MOV: *pDst = Src; break;
+        case FDP_OP_ADD: *pDst += Src; break;
+        case FDP_OP_SUB: *pDst -= Src; break;
+        case FDP_OP_MUL: *pDst *= Src; break;
+        case FDP_OP_DIV: *pDst = Src ? *pDst / Src : 0; break;
+        case FDP_OP_MOD: *pDst = Src ? *pDst % Src : *pDst; break;
+        case FDP_OP_AND: *pDst &= Src; break;
+        case FDP_OP_OR: *pDst |= Src; break;
+        case FDP_OP_XOR: *pDst ^= Src; break;
+        case FDP_OP_LSH: *pDst <<= (Src & 63); break;
+        case FDP_OP_RSH: *pDst >>= (Src & 63); break;
+        case FDP_OP_NEG: *pDst = (uint64_t)0 - *pDst; break;
+        case FDP_OP_JA: bJump = true; break;
+        case FDP_OP_JEQ: bJump = *pDst == Src; break;
+        case FDP_OP_JNE: bJump = *pDst != Src; break;
+        case FDP_OP_JLT: bJump = *pDst < Src; break;
+        case FDP_OP_JLE: bJump = *pDst <= Src; break;
+        case FDP_OP_JGT: bJump = *pDst > Src; break;
+        case FDP_OP_JGE: bJump = *pDst >= Src; break;
+        case FDP_OP_JSET: bJump = (*pDst & Src) != 0; break;
+        }
+        if (bJump)
+        {
+            Pc += pInstruction->Offset;
+        }
+    }
+    return false;
+}
+
+static FDP_AGGREGATION* FDP_ServerGetAggregation(FDP_SHM* pFDP, int AggregationId)
+{
+    if (pFDP->pBreakpointActions == NULL || AggregationId < 0 || AggregationId >= FDP_MAX_AGGREGATIONS
+        || pFDP->pBreakpointActions->aAggregations[AggregationId].bCreated == false)
+    {
+        return NULL;
+    }
+    return &pFDP->pBreakpointActions->aAggregations[AggregationId];
+}
+
+static void FDP_ServerClearAggregationTable(FDP_AGGREGATION* pAggregation, FDP_AGGREGATION_TABLE* pTable)
+{
+    memset((void*)pTable->pSlots, 0, pAggregation->SlotCount * sizeof(FDP_AGGREGATION_SLOT));
+    pTable->KeyCount = 0;
+    pTable->DroppedCount = 0;
+}
+
+static bool FDP_ServerCreateAggregation(FDP_SHM* pFDP, int* pAggregationId)
+{
+    FDP_AGGREGATION_PKT_REQ* TempPkt = (FDP_AGGREGATION_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL
+        || TempPkt->KeyType > FDP_AGGREGATE_RETURN_ADDRESS
+        || TempPkt->MaxKeyCount == 0
+        || TempPkt->MaxKeyCount > FDP_AGGREGATION_MAX_KEYS)
+    {
+        return false;
+    }
+    for (int AggregationId = 0; AggregationId < FDP_MAX_AGGREGATIONS; AggregationId++)
+    {
+        FDP_AGGREGATION* pAggregation = &pFDP->pBreakpointActions->aAggregations[AggregationId];
+        if (pAggregation->bCreated
+            || pAggregation->aTables[0].ActiveHitCount != 0
+            || pAggregation->aTables[1].ActiveHitCount != 0)
+        {
+            continue;
+        }
+        //Half full at most, probe sequences stay short
+        uint32_t SlotCount = 2;
+        while (SlotCount < TempPkt->MaxKeyCount * 2)
+        {
+            SlotCount *= 2;
+        }
+        FDP_AGGREGATION_SLOT* pSlots0 = (FDP_AGGREGATION_SLOT*)calloc(SlotCount, sizeof(FDP_AGGREGATION_SLOT));
+        FDP_AGGREGATION_SLOT* pSlots1 = (FDP_AGGREGATION_SLOT*)calloc(SlotCount, sizeof(FDP_AGGREGATION_SLOT));
+        if (pSlots0 == NULL || pSlots1 == NULL)
+        {
+            free(pSlots0);
+            free(pSlots1);
+            return false;
+        }
+        pAggregation->KeyType = TempPkt->KeyType;
+        pAggregation->StackOffset = TempPkt->StackOffset;
+        pAggregation->MaxKeyCount = TempPkt->MaxKeyCount;
+        pAggregation->SlotCount = SlotCount;
+        pAggregation->aTables[0].pSlots = pSlots0;
+        pAggregation->aTables[1].pSlots = pSlots1;
+        FDP_ServerClearAggregationTable(pAggregation, &pAggregation->aTables[0]);
+        FDP_ServerClearAggregationTable(pAggregation, &pAggregation->aTables[1]);
+        pAggregation->ActiveTable = 0;
+        __sync_synchronize();
+        pAggregation->bCreated = true;
+        *pAggregationId = AggregationId;
+        return true;
+    }
+    return false;
+}
+
+static bool FDP_ServerDeleteAggregation(FDP_SHM* pFDP)
+{
+    FDP_AGGREGATION_PKT_REQ* TempPkt = (FDP_AGGREGATION_PKT_REQ*)pFDP->InputBuffer;
+    FDP_AGGREGATION* pAggregation = FDP_ServerGetAggregation(pFDP, TempPkt->AggregationId);
+    if (pAggregation == NULL)
+    {
+        return false;
+    }
+    for (int BreakpointId = 0; BreakpointId <= FDP_MAX_BREAKPOINT; BreakpointId++)
+    {
+        __sync_bool_compare_and_swap(&pFDP->pBreakpointActions->aActions[BreakpointId].AggregationId, TempPkt->AggregationId, -1);
+    }
+    pAggregation->bCreated = false;
+    __sync_synchronize();
+    //Let the vCPUs still counting finish
+    while (pAggregation->aTables[0].ActiveHitCount != 0 || pAggregation->aTables[1].ActiveHitCount != 0)
+    {
+        __sync_synchronize();
+    }
+    free(pAggregation->aTables[0].pSlots);
+    free(pAggregation->aTables[1].pSlots);
+    pAggregation->aTables[0].pSlots = NULL;
+    pAggregation->aTables[1].pSlots = NULL;
+    return true;
+}
+
+static bool FDP_ServerAttachAggregation(FDP_SHM* pFDP)
+{
+    FDP_AGGREGATION_PKT_REQ* TempPkt = (FDP_AGGREGATION_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL
+        || TempPkt->BreakpointId < 0
+        || TempPkt->BreakpointId > FDP_MAX_BREAKPOINT
+        || (TempPkt->AggregationId != -1 && FDP_ServerGetAggregation(pFDP, TempPkt->AggregationId) == NULL))
+    {
+        return false;
+    }
+    pFDP->pBreakpointActions->aActions[TempPkt->BreakpointId].AggregationId = TempPkt->AggregationId;
+    return true;
+}
+
+//A reset swaps the tables first, the drained table then holds every hit counted before the request
+static bool FDP_ServerGetAggregationEntries(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_AGGREGATION_PKT_REQ* TempPkt = (FDP_AGGREGATION_PKT_REQ*)pFDP->InputBuffer;
+    FDP_AGGREGATION* pAggregation = FDP_ServerGetAggregation(pFDP, TempPkt->AggregationId);
+    if (pAggregation == NULL)
+    {
+        return false;
+    }
+    FDP_AGGREGATION_TABLE* pTable = &pAggregation->aTables[pAggregation->ActiveTable];
+    if (TempPkt->bReset)
+    {
+        pAggregation->ActiveTable ^= 1;
+        __sync_synchronize();
+        while (pTable->ActiveHitCount != 0)
+        {
+            __sync_synchronize();
+        }
+    }
+    FDP_GET_AGGREGATION_PKT_RSP* pRsp = (FDP_GET_AGGREGATION_PKT_RSP*)pFDP->OutputBuffer;
+    FDP_AGGREGATION_ENTRY* pEntries = (FDP_AGGREGATION_ENTRY*)(pFDP->OutputBuffer + sizeof(FDP_GET_AGGREGATION_PKT_RSP));
+    uint32_t EntryCount = 0;
+    for (uint32_t Slot = 0; Slot < pAggregation->SlotCount; Slot++)
+    {
+        if (pTable->pSlots[Slot].State == FDP_AGGREGATION_SLOT_USED)
+        {
+            pEntries[EntryCount].Key = pTable->pSlots[Slot].Key;
+            pEntries[EntryCount].Count = pTable->pSlots[Slot].Count;
+            EntryCount++;
+        }
+    }
+    pRsp->EntryCount = EntryCount;
+    pRsp->DroppedCount = pTable->DroppedCount;
+    if (TempPkt->bReset)
+    {
+        FDP_ServerClearAggregationTable(pAggregation, pTable);
+    }
+    *pOutputBufferSize = sizeof(FDP_GET_AGGREGATION_PKT_RSP) + EntryCount * sizeof(FDP_AGGREGATION_ENTRY);
+    return true;
+}
+
+static bool FDP_ServerGetAggregationKey(FDP_SHM* pFDP, FDP_AGGREGATION* pAggregation, uint32_t CpuId, int BreakpointId, uint64_t* pKey)
+{
+    switch (pAggregation->KeyType)
+    {
+    case FDP_AGGREGATE_BREAKPOINT_ID:
+        *pKey = (uint64_t)BreakpointId;
+        return true;
+    case FDP_AGGREGATE_RIP:
+        return pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, pKey);
+    case FDP_AGGREGATE_CR3:
+        return pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CR3_REGISTER, pKey);
+    case FDP_AGGREGATE_RETURN_ADDRESS:
+    {
+        uint64_t Rsp = 0;
+        return pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RSP_REGISTER, &Rsp)
+            && FDP_ServerReadVirtualBytes(pFDP, CpuId, Rsp + pAggregation->StackOffset, (uint8_t*)pKey, sizeof(uint64_t)) == sizeof(uint64_t);
+    }
+    }
+    return false;
+}
+
+static void FDP_ServerCountAggregationKey(FDP_AGGREGATION* pAggregation, FDP_AGGREGATION_TABLE* pTable, uint64_t Key)
+{
+    uint32_t Mask = pAggregation->SlotCount - 1;
+    uint32_t Slot = FDP_BreakpointTableHash(Key) & Mask;
+    for (uint32_t ProbeCount = 0; ProbeCount < pAggregation->SlotCount; ProbeCount++, Slot = (Slot + 1) & Mask)
+    {
+        FDP_AGGREGATION_SLOT* pSlot = &pTable->pSlots[Slot];
+        if (pSlot->State == FDP_AGGREGATION_SLOT_FREE)
+        {
+            //The key is reserved before the slot, the table never has more than MaxKeyCount keys
+            if (__sync_fetch_and_add(&pTable->KeyCount, 1) >= pAggregation->MaxKeyCount)
+            {
+                __sync_fetch_and_sub(&pTable->KeyCount, 1);
+                break;
+            }
+            if (__sync_bool_compare_and_swap(&pSlot->State, FDP_AGGREGATION_SLOT_FREE, FDP_AGGREGATION_SLOT_WRITING))
+            {
+                pSlot->Key = Key;
+                pSlot->Count = 1;
+                __sync_synchronize();
+                pSlot->State = FDP_AGGREGATION_SLOT_USED;
+                return;
+            }
+            __sync_fetch_and_sub(&pTable->KeyCount, 1);
+        }
+        //Another vCPU is writing this key
+        while (pSlot->State == FDP_AGGREGATION_SLOT_WRITING)
+        {
+            __sync_synchronize();
+        }
+        if (pSlot->Key == Key)
+        {
+            __sync_fetch_and_add(&pSlot->Count, 1);
+            return;
+        }
+    }
+    __sync_fetch_and_add(&pTable->DroppedCount, 1);
+}
+
+//Returns true if the hit was counted by the aggregation attached to the breakpoint
+static bool FDP_ServerAggregateHit(FDP_SHM* pFDP, FDP_BREAKPOINT_ACTION* pAction, uint32_t CpuId, int BreakpointId)
+{
+    int AggregationId = pAction->AggregationId;
+    if (AggregationId < 0)
+    {
+        return false;
+    }
+    FDP_AGGREGATION* pAggregation = &pFDP->pBreakpointActions->aAggregations[AggregationId];
+    for (;;)
+    {
+        uint32_t TableIndex = pAggregation->ActiveTable;
+        FDP_AGGREGATION_TABLE* pTable = &pAggregation->aTables[TableIndex];
+        __sync_fetch_and_add(&pTable->ActiveHitCount, 1);
+        //Skip it if it was detached or deleted meanwhile
+        if (pAggregation->bCreated == false || pAction->AggregationId != AggregationId)
+        {
+            __sync_fetch_and_sub(&pTable->ActiveHitCount, 1);
+            return false;
+        }
+        //A reset switched the tables meanwhile, count in the new one
+        if (pAggregation->ActiveTable != TableIndex)
+        {
+            __sync_fetch_and_sub(&pTable->ActiveHitCount, 1);
+            continue;
+        }
+        uint64_t Key = 0;
+        if (FDP_ServerGetAggregationKey(pFDP, pAggregation, CpuId, BreakpointId, &Key))
+        {
+            FDP_ServerCountAggregationKey(pAggregation, pTable, Key);
+        }
+        else
+        {
+            __sync_fetch_and_add(&pTable->DroppedCount, 1);
+        }
+        __sync_fetch_and_sub(&pTable->ActiveHitCount, 1);
+        return true;
+    }
+}
+
+static bool FDP_ServerReleaseBreakpoint(FDP_SHM* pFDP, uint8_t BreakpointId)
+{
+    if (pFDP->pBreakpointActions != NULL)
+    {
+        //The id can be reused by the next breakpoint
+        pFDP->pBreakpointActions->aActions[BreakpointId].Flags = 0;
+        pFDP->pBreakpointActions->aActions[BreakpointId].ConditionCount = 0;
+        pFDP->pBreakpointActions->aActions[BreakpointId].ProgramId = -1;
+        pFDP->pBreakpointActions->aActions[BreakpointId].AggregationId = -1;
+        pFDP->pBreakpointActions->aActions[BreakpointId].WatchEnd = 0;
+        pFDP->pBreakpointActions->aPageGroups[BreakpointId] = 0;
+    }
+    return pFDP->pFdpServer->pfnUnsetBreakpoint(pFDP->pFdpServer->pUserHandle, BreakpointId);
+}
+
+//The backend breakpoints behind execute breakpoints and the coverage belong to them, not to the client
+static bool FDP_ServerUnsetBreakpoint(FDP_SHM* pFDP, uint8_t BreakpointId)
+{
+    if (pFDP->pBreakpointActions != NULL && pFDP->pBreakpointActions->aPageGroups[BreakpointId] != 0)
+    {
+        return false;
+    }
+    return FDP_ServerReleaseBreakpoint(pFDP, BreakpointId);
+}
+
+static bool FDP_ServerSetBreakpoints(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_SET_BREAKPOINTS_PKT_REQ* TempPkt = (FDP_SET_BREAKPOINTS_PKT_REQ*)pFDP->InputBuffer;
+    if (TempPkt->EntryCount > FDP_SET_BREAKPOINTS_MAX_ENTRIES_PER_REQUEST)
+    {
+        return false;
+    }
+    FDP_BREAKPOINT_ENTRY* pEntries = (FDP_BREAKPOINT_ENTRY*)pFDP->OutputBuffer;
+    memcpy(pEntries, TempPkt->Entries, TempPkt->EntryCount * sizeof(FDP_BREAKPOINT_ENTRY));
+    bool bReturnValue = true;
+    for (uint32_t i = 0; i < TempPkt->EntryCount; i++)
+    {
+        //Forwarded like the BreakpointId of FDPCMD_SET_BP, a negative id or 0xFF lets the backend choose
+        uint8_t RequestedBreakpointId = pEntries[i].BreakpointId < 0 ? 0xFF : (uint8_t)MIN(pEntries[i].BreakpointId, 0xFF);
+        pEntries[i].BreakpointId = pFDP->pFdpServer->pfnSetBreakpoint(pFDP->pFdpServer->pUserHandle, pEntries[i].CpuId,
+                                                                      pEntries[i].BreakpointType, RequestedBreakpointId,
+                                                                      pEntries[i].BreakpointAccessType,
+                                                                      pEntries[i].BreakpointAddressType,
+                                                                      pEntries[i].BreakpointAddress,
+                                                                      pEntries[i].BreakpointLength,
+                                                                      pEntries[i].BreakpointCr3);
+        if (pEntries[i].BreakpointId < 0)
+        {
+            pEntries[i].BreakpointId = -1;
+            bReturnValue = false;
+        }
+    }
+    *pOutputBufferSize = TempPkt->EntryCount * sizeof(FDP_BREAKPOINT_ENTRY);
+    return bReturnValue;
+}
+
+static bool FDP_ServerUnsetBreakpoints(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
+{
+    FDP_UNSET_BREAKPOINTS_PKT_REQ* TempPkt = (FDP_UNSET_BREAKPOINTS_PKT_REQ*)pFDP->InputBuffer;
+    if (TempPkt->BreakpointCount > FDP_UNSET_BREAKPOINTS_MAX_IDS_PER_REQUEST)
+    {
+        return false;
+    }
+    bool* pbUnset = (bool*)pFDP->OutputBuffer;
+    bool bReturnValue = true;
+    for (uint32_t i = 0; i < TempPkt->BreakpointCount; i++)
+    {
+        pbUnset[i] = FDP_ServerUnsetBreakpoint(pFDP, TempPkt->BreakpointIds[i]);
+        bReturnValue = bReturnValue && pbUnset[i];
+    }
+    *pOutputBufferSize = TempPkt->BreakpointCount * sizeof(bool);
+    return bReturnValue;
+}
+
+//Unused ids are unset too, the backend doesn't list its breakpoints
+static int FDP_CompareAddresses(const void* pLeft, const void* pRight)
+{
+    uint64_t Left = *(const uint64_t*)pLeft;
+    uint64_t Right = *(const uint64_t*)pRight;
+    return (Left > Right) - (Left < Right);
+}
+
+static void FDP_ServerUnsetCoverageRange(FDP_SHM* pFDP, FDP_COVERAGE_RANGE* pRange)
 {
-    if (pFDP == NULL)
+    if (pRange->BreakpointId >= 0)
+    {
+        pFDP->pFdpServer->pfnUnsetBreakpoint(pFDP->pFdpServer->pUserHandle, pRange->BreakpointId);
+        pFDP->pBreakpointActions->aPageGroups[pRange->BreakpointId] = 0;
+        pRange->BreakpointId = -1;
+    }
+}
+
+//Stops the hits and unsets the ranges, the uploaded blocks and the bitmap are kept
+static void FDP_ServerDisarmCoverage(FDP_SHM* pFDP)
+{
+    FDP_COVERAGE* pCoverage = &pFDP->pBreakpointActions->Coverage;
+    pCoverage->bArmed = false;
+    __sync_synchronize();
+    //Let the vCPUs still in FDP_ServerCoverageHit finish
+    while (pCoverage->ActiveHitCount != 0)
+    {
+        __sync_synchronize();
+    }
+    for (uint32_t i = 0; i < pCoverage->RangeCount; i++)
+    {
+        FDP_ServerUnsetCoverageRange(pFDP, &pCoverage->aRanges[i]);
+    }
+    pCoverage->RangeCount = 0;
+}
+
+//Sorted pages holding blocks not hit yet, pPages has room for BlockCount entries
+static uint32_t FDP_ServerGetCoveragePages(FDP_COVERAGE* pCoverage, uint64_t* pPages)
+{
+    uint32_t PageCount = 0;
+    for (uint32_t i = 0; i < pCoverage->BlockCount; i++)
+    {
+        if (FDP_BreakpointTableLookup(pCoverage->pBlocks, pCoverage->pAddresses[i]) != FDP_INVALID_BREAKPOINT_HANDLE)
+        {
+            pPages[PageCount++] = pCoverage->pAddresses[i] & ~(FDP_BREAKPOINT_PAGE_SIZE - 1);
+        }
+    }
+    qsort(pPages, PageCount, sizeof(uint64_t), FDP_CompareAddresses);
+    uint32_t UniqueCount = 0;
+    for (uint32_t i = 0; i < PageCount; i++)
+    {
+        if (UniqueCount == 0 || pPages[i] != pPages[UniqueCount - 1])
+        {
+            pPages[UniqueCount++] = pPages[i];
+        }
+    }
+    return UniqueCount;
+}
+
+//Contiguous pages share a range and the smallest gaps are filled until the ranges fit, pGaps has room for
+//PageCount entries. The ranges are left unset
+static uint32_t FDP_ServerBuildCoverageRanges(const uint64_t* pPages, uint32_t PageCount, uint64_t* pGaps,
+                                              FDP_COVERAGE_RANGE* pRanges)
+{
+    uint32_t GapCount = 0;
+    for (uint32_t i = 1; i < PageCount; i++)
+    {
+        if (pPages[i] - pPages[i - 1] > FDP_BREAKPOINT_PAGE_SIZE)
+        {
+            pGaps[GapCount++] = pPages[i] - pPages[i - 1];
+        }
+    }
+    //Gaps below MaxFilledGap are filled, then as many gaps of MaxFilledGap as needed
+    uint64_t MaxFilledGap = FDP_BREAKPOINT_PAGE_SIZE;
+    uint32_t MaxGapFillCount = 0;
+    if (GapCount + 1 > FDP_COVERAGE_MAX_RANGES)
+    {
+        qsort(pGaps, GapCount, sizeof(uint64_t), FDP_CompareAddresses);
+        uint32_t FillCount = GapCount + 1 - FDP_COVERAGE_MAX_RANGES;
+        MaxFilledGap = pGaps[FillCount - 1];
+        while (MaxGapFillCount < FillCount && pGaps[FillCount - 1 - MaxGapFillCount] == MaxFilledGap)
+        {
+            MaxGapFillCount++;
+        }
+    }
+    uint32_t RangeCount = 0;
+    for (uint32_t i = 0; i < PageCount; i++)
+    {
+        uint64_t Gap = i > 0 ? pPages[i] - pPages[i - 1] : 0;
+        bool bFill = i > 0 && (Gap == FDP_BREAKPOINT_PAGE_SIZE || Gap < MaxFilledGap);
+        if (i > 0 && Gap == MaxFilledGap && MaxGapFillCount > 0)
+        {
+            MaxGapFillCount--;
+            bFill = true;
+        }
+        if (bFill)
+        {
+            pRanges[RangeCount - 1].End = pPages[i] + FDP_BREAKPOINT_PAGE_SIZE;
+            continue;
+        }
+        FDP_COVERAGE_RANGE* pRange = &pRanges[RangeCount++];
+        pRange->BreakpointId = -1;
+        pRange->Start = pPages[i];
+        pRange->End = pPages[i] + FDP_BREAKPOINT_PAGE_SIZE;
+    }
+    return RangeCount;
+}
+
+static bool FDP_ServerSetCoverageRange(FDP_SHM* pFDP, FDP_COVERAGE_RANGE* pRange)
+{
+    int BreakpointId = pFDP->pFdpServer->pfnSetBreakpoint(pFDP->pFdpServer->pUserHandle, 0, FDP_PAGEHBP, 0xFF,
+                                                          FDP_EXECUTE_BP, FDP_PHYSICAL_ADDRESS, pRange->Start,
+                                                          pRange->End - pRange->Start, FDP_NO_CR3);
+    if (BreakpointId < 0 || BreakpointId > FDP_MAX_BREAKPOINT)
     {
         return false;
     }
+    pRange->BreakpointId = BreakpointId;
+    pFDP->pBreakpointActions->aPageGroups[BreakpointId] = FDP_COVERAGE_PAGE_GROUP;
+    return true;
+}
+
+static int FDP_ServerFindCoverageRange(FDP_COVERAGE_RANGE* pRanges, uint32_t RangeCount, uint64_t Start, uint64_t End)
+{
+    for (uint32_t i = 0; i < RangeCount; i++)
+    {
+        if (pRanges[i].Start == Start && pRanges[i].End == End)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+//Called by FDP_ServerGetCoverage once a hit left a page without blocks to hit: the ranges are built again from the
+//pages still holding some, so the guest stops exiting on the pages it already covered. Other requests don't pay it.
+//The new ranges are set before the old ones are unset, no block is missed in between. Backends that can't change
+//their breakpoints while the guest runs refuse it, it is then retried once the guest is paused
+static void FDP_ServerTrimCoverage(FDP_SHM* pFDP)
+{
+    FDP_COVERAGE* pCoverage = &pFDP->pBreakpointActions->Coverage;
+    if (pCoverage->bArmed == false || pCoverage->bTrimPending == false)
+    {
+        return;
+    }
+    if (pCoverage->bTrimRefused)
+    {
+        uint8_t State = 0;
+        if (pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &State) == false
+            || (State & FDP_STATE_PAUSED) == 0)
+        {
+            return;
+        }
+    }
+    pCoverage->bTrimPending = false;
+    __sync_synchronize();
+    FDP_COVERAGE_RANGE aRanges[FDP_COVERAGE_MAX_RANGES];
+    uint64_t* pPages = (uint64_t*)malloc((pCoverage->BlockCount + 1) * sizeof(uint64_t));
+    uint64_t* pGaps = (uint64_t*)malloc((pCoverage->BlockCount + 1) * sizeof(uint64_t));
+    uint32_t RangeCount = 0;
+    uint32_t SetCount = 0;
+    bool bTrimmed = false;
+    if (pPages == NULL || pGaps == NULL)
+    {
+        goto Fail;
+    }
+    RangeCount = FDP_ServerBuildCoverageRanges(pPages, FDP_ServerGetCoveragePages(pCoverage, pPages), pGaps, aRanges);
+    for (SetCount = 0; SetCount < RangeCount; SetCount++)
+    {
+        if (FDP_ServerFindCoverageRange(pCoverage->aRanges, pCoverage->RangeCount, aRanges[SetCount].Start,
+                                        aRanges[SetCount].End) < 0
+            && FDP_ServerSetCoverageRange(pFDP, &aRanges[SetCount]) == false)
+        {
+            goto Fail;
+        }
+    }
+    for (uint32_t i = 0; i < pCoverage->RangeCount; i++)
+    {
+        int Index = FDP_ServerFindCoverageRange(aRanges, RangeCount, pCoverage->aRanges[i].Start, pCoverage->aRanges[i].End);
+        if (Index >= 0)
+        {
+            aRanges[Index].BreakpointId = pCoverage->aRanges[i].BreakpointId;
+        }
+        else
+        {
+            FDP_ServerUnsetCoverageRange(pFDP, &pCoverage->aRanges[i]);
+        }
+    }
+    memcpy(pCoverage->aRanges, aRanges, RangeCount * sizeof(FDP_COVERAGE_RANGE));
+    pCoverage->RangeCount = RangeCount;
+    bTrimmed = true;
+Fail:
+    if (bTrimmed == false)
+    {
+        for (uint32_t i = 0; i < SetCount; i++)
+        {
+            FDP_ServerUnsetCoverageRange(pFDP, &aRanges[i]);
+        }
+        pCoverage->bTrimPending = true;
+    }
+    pCoverage->bTrimRefused = !bTrimmed;
+    free(pPages);
+    free(pGaps);
+}
+
+//Builds the blocks table, clears the bitmap and sets a backend page breakpoint per range of pages
+static bool FDP_ServerArmCoverage(FDP_SHM* pFDP)
+{
+    FDP_COVERAGE* pCoverage = &pFDP->pBreakpointActions->Coverage;
+    FDP_ServerDisarmCoverage(pFDP);
+    FDP_DestroyBreakpointTable(pCoverage->pBlocks);
+    free((void*)pCoverage->pBitmap);
+    free(pCoverage->pBlockIndexes);
+    pCoverage->pBlocks = FDP_CreateBreakpointTable();
+    pCoverage->pBitmap = (volatile uint64_t*)calloc(pCoverage->BlockCount / 64 + 1, sizeof(uint64_t));
+    pCoverage->pBlockIndexes = (uint32_t*)malloc((pCoverage->BlockCount + 1) * sizeof(uint32_t));
+    pCoverage->HitCount = 0;
+    pCoverage->bTrimPending = false;
+    pCoverage->bTrimRefused = false;
+    uint64_t* pPages = (uint64_t*)malloc((pCoverage->BlockCount + 1) * sizeof(uint64_t));
+    uint64_t* pGaps = (uint64_t*)malloc((pCoverage->BlockCount + 1) * sizeof(uint64_t));
     bool bReturnValue = false;
-    uint32_t InputBufferSize = 0;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if (pCoverage->pBlocks == NULL || pCoverage->pBitmap == NULL || pCoverage->pBlockIndexes == NULL
+        || pPages == NULL || pGaps == NULL)
     {
-        FDP_WRITE_VIRTUAL_MEMORY_PKT_REQ* TempPkt = (FDP_WRITE_VIRTUAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
-        TempPkt->Type = FDPCMD_WRITE_VIRTUAL;
-        TempPkt->CpuId = CpuId;
-        TempPkt->VirtualAddress = VirtualAddress;
-        TempPkt->WriteSize = WriteSize;
-        if (WriteSize < FDP_MAX_DATA_SIZE - sizeof(*TempPkt))
+        goto Fail;
+    }
+    //Duplicated blocks are only armed once, the bits of the others stay clear
+    for (uint32_t i = 0; i < pCoverage->BlockCount; i++)
+    {
+        uint32_t Handle = FDP_INVALID_BREAKPOINT_HANDLE;
+        if (FDP_BreakpointTableInsert(pCoverage->pBlocks, pCoverage->pAddresses[i], &Handle, NULL))
         {
-            memcpy(TempPkt->Data, pSrcBuffer, WriteSize);
-            WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
-                         sizeof(FDP_WRITE_VIRTUAL_MEMORY_PKT_REQ) + WriteSize);
-            InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+            pCoverage->pBlockIndexes[(Handle & FDP_BREAKPOINT_HANDLE_INDEX_MASK) - 1] = i;
         }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
+    pCoverage->RangeCount = FDP_ServerBuildCoverageRanges(pPages, FDP_ServerGetCoveragePages(pCoverage, pPages), pGaps,
+                                                          pCoverage->aRanges);
+    for (uint32_t i = 0; i < pCoverage->RangeCount; i++)
+    {
+        if (FDP_ServerSetCoverageRange(pFDP, &pCoverage->aRanges[i]) == false)
+        {
+            goto Fail;
+        }
+    }
+    __sync_synchronize();
+    pCoverage->bArmed = true;
+    bReturnValue = true;
+Fail:
+    if (bReturnValue == false)
+    {
+        FDP_ServerDisarmCoverage(pFDP);
+    }
+    free(pPages);
+    free(pGaps);
     return bReturnValue;
 }
 
-FDP_EXPORTED
-uint64_t FDP_SearchPhysicalMemory(FDP_SHM* pFDP, const void* pPatternData, uint32_t PatternSize, uint64_t StartOffset)
+static bool FDP_ServerSetCoverageBlocks(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    FDP_SET_COVERAGE_BLOCKS_PKT_REQ* TempPkt = (FDP_SET_COVERAGE_BLOCKS_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL || TempPkt->BlockCount > FDP_COVERAGE_MAX_BLOCKS)
     {
         return false;
     }
-    uint64_t FoundAddress = 0x0;
-    LockSHM(pFDP->pSharedFDPSHM);
+    FDP_COVERAGE* pCoverage = &pFDP->pBreakpointActions->Coverage;
+    FDP_ServerDisarmCoverage(pFDP);
+    pCoverage->BlockCount = 0;
+    uint64_t* pAddresses = (uint64_t*)realloc(pCoverage->pAddresses, (TempPkt->BlockCount + 1) * sizeof(uint64_t));
+    if (pAddresses == NULL)
     {
-        FDP_SEARCH_PHYSICAL_MEMORY_PKT_REQ* TempPkt = (FDP_SEARCH_PHYSICAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
-        TempPkt->Type = FDPCMD_SEARCH_PHYSICAL_MEMORY;
-        TempPkt->PatternSize = PatternSize;
-        TempPkt->StartOffset = StartOffset;
-        memcpy(TempPkt->PatternData, pPatternData, PatternSize);
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
-                     sizeof(FDP_SEARCH_PHYSICAL_MEMORY_PKT_REQ) + PatternSize);
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&FoundAddress); //TODO: return success/fail !
+        return false;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return FoundAddress;
+    pCoverage->pAddresses = pAddresses;
+    memcpy(pCoverage->pAddresses, TempPkt->PhysicalAddresses, TempPkt->BlockCount * sizeof(uint64_t));
+    pCoverage->BlockCount = TempPkt->BlockCount;
+    if (pCoverage->BlockCount == 0)
+    {
+        return true;
+    }
+    return FDP_ServerArmCoverage(pFDP);
 }
 
-//TODO !
-FDP_EXPORTED
-bool FDP_SearchVirtualMemory(FDP_SHM* pFDP, uint32_t CpuId, const void* pPatternData, uint32_t PatternSize,
-                             uint64_t StartOffset)
+static bool FDP_ServerGetCoverage(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
 {
-    if (pFDP == NULL)
+    if (pFDP->pBreakpointActions == NULL)
     {
         return false;
     }
-    uint64_t FoundAddress = 0x0;
-    bool bReturnCode = false;
-    LockSHM(pFDP->pSharedFDPSHM);
+    FDP_ServerTrimCoverage(pFDP);
+    FDP_COVERAGE* pCoverage = &pFDP->pBreakpointActions->Coverage;
+    FDP_GET_COVERAGE_PKT_RSP* pRsp = (FDP_GET_COVERAGE_PKT_RSP*)pFDP->OutputBuffer;
+    pRsp->BlockCount = pCoverage->pBitmap != NULL ? pCoverage->BlockCount : 0;
+    pRsp->HitCount = pCoverage->HitCount;
+    uint32_t BitmapSize = (pRsp->BlockCount + 63) / 64 * sizeof(uint64_t);
+    if (BitmapSize > 0)
     {
-        FDP_SEARCH_VIRTUAL_MEMORY_PKT_REQ* TempPkt = (FDP_SEARCH_VIRTUAL_MEMORY_PKT_REQ*)pFDP->OutputBuffer;
-        TempPkt->Type = FDPCMD_SEARCH_VIRTUAL_MEMORY;
-        TempPkt->CpuId = CpuId;
-        TempPkt->PatternSize = PatternSize;
-        TempPkt->StartOffset = StartOffset;
-        memcpy(TempPkt->PatternData, pPatternData, PatternSize);
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer,
-                     sizeof(FDP_SEARCH_VIRTUAL_MEMORY_PKT_REQ) + PatternSize);
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&FoundAddress); //TODO: return success/fail !
-        bReturnCode = true;
+        memcpy(pFDP->OutputBuffer + sizeof(FDP_GET_COVERAGE_PKT_RSP), (const void*)pCoverage->pBitmap, BitmapSize);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnCode;
+    *pOutputBufferSize = sizeof(FDP_GET_COVERAGE_PKT_RSP) + BitmapSize;
+    return true;
 }
 
-FDP_EXPORTED
-bool FDP_ReadRegister(FDP_SHM* pFDP, uint32_t CpuId, FDP_Register RegisterId, uint64_t* pRegisterValue)
+static bool FDP_ServerResetCoverage(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    if (pFDP->pBreakpointActions == NULL)
     {
         return false;
     }
-    //Fast way...
-    switch (RegisterId)
+    if (pFDP->pBreakpointActions->Coverage.BlockCount == 0)
     {
-    case FDP_RIP_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rip;
-        return true;
-    case FDP_RAX_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rax;
-        return true;
-    case FDP_RCX_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rcx;
-        return true;
-    case FDP_RDX_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rdx;
-        return true;
-    case FDP_RBX_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rbx;
-        return true;
-    case FDP_RSP_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rsp;
-        return true;
-    case FDP_RBP_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rbp;
-        return true;
-    case FDP_RSI_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rsi;
-        return true;
-    case FDP_RDI_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->rdi;
-        return true;
-    case FDP_R8_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r8;
-        return true;
-    case FDP_R9_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r9;
-        return true;
-    case FDP_R10_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r10;
-        return true;
-    case FDP_R11_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r11;
-        return true;
-    case FDP_R12_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r12;
         return true;
-    case FDP_R13_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r13;
-        return true;
-    case FDP_R14_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r14;
-        return true;
-    case FDP_R15_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->r15;
-        return true;
-    case FDP_CR0_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->cr0;
-        return true;
-    case FDP_CR2_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->cr2;
-        return true;
-    case FDP_CR3_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->cr3;
-        return true;
-    case FDP_CR4_REGISTER:
-        *pRegisterValue = pFDP->pCpuShm->cr4;
-        return true;
-    default:
-        break;
     }
-    //Old version => low performance
-    FDP_READ_REGISTER_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_READ_REGISTER;
-    TempPkt.CpuId = CpuId;
-    TempPkt.RegisterId = RegisterId;
-    LockSHM(pFDP->pSharedFDPSHM);
+    return FDP_ServerArmCoverage(pFDP);
+}
+
+//A coverage hit never stops the VM, the block is disarmed and its bit set
+static bool FDP_ServerCoverageHit(FDP_SHM* pFDP, uint32_t CpuId)
+{
+    FDP_COVERAGE* pCoverage = &pFDP->pBreakpointActions->Coverage;
+    __sync_fetch_and_add(&pCoverage->ActiveHitCount, 1);
+    uint64_t Rip = 0;
+    uint64_t PhysicalAddress = 0;
+    if (pCoverage->bArmed
+        && pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, &Rip)
+        && pFDP->pFdpServer->pfnVirtualToPhysical(pFDP->pFdpServer->pUserHandle, CpuId, Rip, &PhysicalAddress))
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_READ_REGISTER_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pRegisterValue); //TODO: return success/fail !
+        uint32_t Handle = FDP_BreakpointTableLookup(pCoverage->pBlocks, PhysicalAddress);
+        bool bLastInPage = false;
+        //Only one of the vCPUs hitting the block at once removes it
+        if (Handle != FDP_INVALID_BREAKPOINT_HANDLE
+            && FDP_BreakpointTableRemove(pCoverage->pBlocks, Handle, NULL, &bLastInPage))
+        {
+            uint32_t BlockIndex = pCoverage->pBlockIndexes[(Handle & FDP_BREAKPOINT_HANDLE_INDEX_MASK) - 1];
+            __sync_fetch_and_or(&pCoverage->pBitmap[BlockIndex / 64], 1ULL << (BlockIndex % 64));
+            __sync_fetch_and_add(&pCoverage->HitCount, 1);
+            if (bLastInPage)
+            {
+                pCoverage->bTrimPending = true;
+            }
+        }
+    }
+    __sync_fetch_and_sub(&pCoverage->ActiveHitCount, 1);
+    return false;
+}
+
+static bool FDP_ServerUnsetAllBreakpoints(FDP_SHM* pFDP)
+{
+    if (pFDP->pBreakpointActions != NULL)
+    {
+        FDP_ServerDisarmCoverage(pFDP);
+    }
+    for (int BreakpointId = 0; BreakpointId <= FDP_MAX_BREAKPOINT; BreakpointId++)
+    {
+        FDP_ServerReleaseBreakpoint(pFDP, (uint8_t)BreakpointId);
+    }
+    if (pFDP->pBreakpointActions != NULL && pFDP->pBreakpointActions->pExecuteBreakpoints != NULL)
+    {
+        FDP_BreakpointTableClear(pFDP->pBreakpointActions->pExecuteBreakpoints);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
     return true;
 }
 
-FDP_EXPORTED
-bool FDP_ReadMsr(FDP_SHM* pFDP, uint32_t CpuId, uint64_t MsrId, uint64_t* pMsrValue)
+//Every execute breakpoint of a page shares one backend page breakpoint, so the page protection only
+//changes for its first and last breakpoint. Hits are sorted out by FDP_ServerExecuteBreakpointHit
+static bool FDP_ServerAddExecuteBreakpoint(FDP_SHM* pFDP, uint32_t* pHandle)
 {
-    if (pFDP == NULL)
+    FDP_BREAKPOINT_HANDLE_PKT_REQ* TempPkt = (FDP_BREAKPOINT_HANDLE_PKT_REQ*)pFDP->InputBuffer;
+    bool bNewPage = false;
+    if (pFDP->pBreakpointActions == NULL
+        || FDP_BreakpointTableInsert(pFDP->pBreakpointActions->pExecuteBreakpoints, TempPkt->PhysicalAddress, pHandle, &bNewPage) == false)
     {
         return false;
     }
-    FDP_READ_MSR_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_READ_MSR;
-    TempPkt.CpuId = CpuId;
-    TempPkt.MsrId = MsrId;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if (bNewPage)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_READ_MSR_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pMsrValue); //TODO: return success/fail !
+        uint64_t Page = TempPkt->PhysicalAddress & ~(FDP_BREAKPOINT_PAGE_SIZE - 1);
+        int BreakpointId = pFDP->pFdpServer->pfnSetBreakpoint(pFDP->pFdpServer->pUserHandle, 0, FDP_PAGEHBP, 0xFF,
+                                                              FDP_EXECUTE_BP, FDP_PHYSICAL_ADDRESS, Page,
+                                                              FDP_BREAKPOINT_PAGE_SIZE, FDP_NO_CR3);
+        if (BreakpointId < 0 || BreakpointId > FDP_MAX_BREAKPOINT)
+        {
+            FDP_BreakpointTableRemove(pFDP->pBreakpointActions->pExecuteBreakpoints, *pHandle, NULL, NULL);
+            *pHandle = FDP_INVALID_BREAKPOINT_HANDLE;
+            return false;
+        }
+        pFDP->pBreakpointActions->aPageGroups[BreakpointId] = Page | 1;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
     return true;
 }
 
-FDP_EXPORTED
-bool FDP_WriteMsr(FDP_SHM* pFDP, uint32_t CpuId, uint64_t MsrId, uint64_t MsrValue)
+static bool FDP_ServerRemoveExecuteBreakpoint(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    FDP_BREAKPOINT_HANDLE_PKT_REQ* TempPkt = (FDP_BREAKPOINT_HANDLE_PKT_REQ*)pFDP->InputBuffer;
+    uint64_t Address = 0;
+    bool bLastInPage = false;
+    if (pFDP->pBreakpointActions == NULL
+        || FDP_BreakpointTableRemove(pFDP->pBreakpointActions->pExecuteBreakpoints, TempPkt->Handle, &Address, &bLastInPage) == false)
     {
         return false;
     }
-    bool bReturnValue = false;
-    uint32_t InputBufferSize = 0;
-    FDP_WRITE_MSR_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_WRITE_MSR;
-    TempPkt.CpuId = CpuId;
-    TempPkt.MsrId = MsrId;
-    TempPkt.MsrValue = MsrValue;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if (bLastInPage)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_WRITE_MSR_PKT_REQ));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        uint64_t PageGroup = (Address & ~(FDP_BREAKPOINT_PAGE_SIZE - 1)) | 1;
+        for (int BreakpointId = 0; BreakpointId <= FDP_MAX_BREAKPOINT; BreakpointId++)
+        {
+            if (pFDP->pBreakpointActions->aPageGroups[BreakpointId] == PageGroup)
+            {
+                pFDP->pFdpServer->pfnUnsetBreakpoint(pFDP->pFdpServer->pUserHandle, BreakpointId);
+                pFDP->pBreakpointActions->aPageGroups[BreakpointId] = 0;
+                break;
+            }
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    return true;
 }
 
-FDP_EXPORTED
-bool FDP_WriteRegister(FDP_SHM* pFDP, uint32_t CpuId, FDP_Register RegisterId, uint64_t RegisterValue)
+static uint32_t FDP_ServerGetHitBreakpointHandle(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    FDP_BREAKPOINT_HANDLE_PKT_REQ* TempPkt = (FDP_BREAKPOINT_HANDLE_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL || TempPkt->CpuId >= FDP_BREAKPOINT_HANDLE_MAX_CPU)
+    {
+        return FDP_INVALID_BREAKPOINT_HANDLE;
+    }
+    return pFDP->pBreakpointActions->aHitHandles[TempPkt->CpuId];
+}
+
+//A page group hit only stops the VM on the address of an execute breakpoint
+static bool FDP_ServerExecuteBreakpointHit(FDP_SHM* pFDP, uint32_t CpuId)
+{
+    uint64_t Rip = 0;
+    uint64_t PhysicalAddress = 0;
+    if (pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, &Rip) == false
+        || pFDP->pFdpServer->pfnVirtualToPhysical(pFDP->pFdpServer->pUserHandle, CpuId, Rip, &PhysicalAddress) == false)
+    {
+        return true;
+    }
+    uint32_t Handle = FDP_BreakpointTableLookup(pFDP->pBreakpointActions->pExecuteBreakpoints, PhysicalAddress);
+    if (Handle == FDP_INVALID_BREAKPOINT_HANDLE)
     {
         return false;
     }
-    uint32_t InputBufferSize = 0;
-    bool bReturnValue = false;
-    FDP_WRITE_REGISTER_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_WRITE_REGISTER;
-    TempPkt.CpuId = CpuId;
-    TempPkt.RegisterId = RegisterId;
-    TempPkt.RegisterValue = RegisterValue;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if (CpuId < FDP_BREAKPOINT_HANDLE_MAX_CPU)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_WRITE_REGISTER_PKT_REQ));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        pFDP->pBreakpointActions->aHitHandles[CpuId] = Handle;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    return true;
 }
 
-
-FDP_EXPORTED
-bool FDP_UnsetBreakpoint(FDP_SHM* pFDP, uint8_t BreakpointId)
+//Page breakpoint over the pages of the watched range, tagged once the backend gave its id
+static int FDP_ServerSetWatchpoint(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    FDP_SET_WATCHPOINT_PKT_REQ* TempPkt = (FDP_SET_WATCHPOINT_PKT_REQ*)pFDP->InputBuffer;
+    if (pFDP->pBreakpointActions == NULL
+        || TempPkt->Length == 0
+        || TempPkt->Address + TempPkt->Length <= TempPkt->Address
+        || (TempPkt->Access & (FDP_EXECUTE_BP | FDP_WRITE_BP | FDP_READ_BP)) == 0
+        || (TempPkt->Flags & ~(FDP_TRACEPOINT_LOG | FDP_TRACEPOINT_STOP)) != 0
+        || ((TempPkt->Flags & FDP_TRACEPOINT_LOG) && pFDP->pHitLog == NULL))
     {
-        return false;
+        return -1;
     }
-    uint32_t InputBufferSize = 0;
-    bool bReturnValue = false;
-    FDP_CLEAR_BREAKPOINT_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_UNSET_BP;
-    TempPkt.BreakpointId = BreakpointId;
-    LockSHM(pFDP->pSharedFDPSHM);
+    uint64_t FirstPage = TempPkt->Address & ~(FDP_BREAKPOINT_PAGE_SIZE - 1);
+    uint64_t LastPage = (TempPkt->Address + TempPkt->Length - 1) & ~(FDP_BREAKPOINT_PAGE_SIZE - 1);
+    int BreakpointId = pFDP->pFdpServer->pfnSetBreakpoint(pFDP->pFdpServer->pUserHandle, TempPkt->CpuId, FDP_PAGEHBP, 0xFF,
+                                                          TempPkt->Access, TempPkt->AddressType, FirstPage,
+                                                          LastPage - FirstPage + FDP_BREAKPOINT_PAGE_SIZE, TempPkt->Cr3);
+    if (BreakpointId < 0 || BreakpointId > FDP_MAX_BREAKPOINT)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_CLEAR_BREAKPOINT_PKT_REQ));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        return -1;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    FDP_BREAKPOINT_ACTION* pAction = &pFDP->pBreakpointActions->aActions[BreakpointId];
+    pAction->RegisterMask = 0;
+    pAction->Flags = TempPkt->Flags;
+    pAction->WatchStart = TempPkt->Address;
+    pAction->WatchAccess = TempPkt->Access;
+    pAction->WatchAddressType = TempPkt->AddressType;
+    __sync_synchronize();
+    pAction->WatchEnd = TempPkt->Address + TempPkt->Length;
+    return BreakpointId;
 }
 
+//Hits on the watched pages outside of the range let the guest go on. Without the access from the backend
+//every hit counts and the record only has the RIP
+#define FDP_WATCHPOINT_UNKNOWN_SIZE     64      //Bytes assumed from the address of an access of unknown size
 
-FDP_EXPORTED
-int FDP_SetBreakpoint(
-    FDP_SHM*             pFDP,
-    uint32_t            CpuId,
-    FDP_BreakpointType  BreakpointType,
-    uint8_t             BreakpointId,
-    FDP_Access          BreakpointAccessType,
-    FDP_AddressType     BreakpointAddressType,
-    uint64_t            BreakpointAddress,
-    uint64_t            BreakpointLength,
-    uint64_t            BreakpointCr3)
+static bool FDP_ServerWatchpointHit(FDP_SHM* pFDP, uint32_t CpuId, int BreakpointId, FDP_BREAKPOINT_ACTION* pAction)
 {
-    if (pFDP == NULL)
+    uint64_t LinearAddress = 0;
+    uint32_t Size = 0;
+    FDP_Access Access = FDP_WRONG_BP;
+    if (pFDP->pFdpServer->pfnGetHitAccess != NULL
+        && pFDP->pFdpServer->pfnGetHitAccess(pFDP->pFdpServer->pUserHandle, CpuId, &LinearAddress, &Size, &Access))
+    {
+        if ((Access & pAction->WatchAccess) == 0)
+        {
+            return false;
+        }
+        uint64_t Address = LinearAddress;
+        //An untranslatable address can't be filtered, the hit counts
+        if (pAction->WatchAddressType != FDP_PHYSICAL_ADDRESS
+            || pFDP->pFdpServer->pfnVirtualToPhysical(pFDP->pFdpServer->pUserHandle, CpuId, LinearAddress, &Address))
+        {
+            //An access of unknown size (string, XSAVE or vector instruction...) may reach the range from below,
+            //it is kept rather than missed
+            uint64_t AccessEnd = Address + (Size != 0 ? Size : FDP_WATCHPOINT_UNKNOWN_SIZE);
+            if (AccessEnd <= pAction->WatchStart || Address >= pAction->WatchEnd)
+            {
+                return false;
+            }
+        }
+    }
+    if (FDP_ServerEvaluateConditions(pFDP, CpuId, pAction->aConditions, pAction->ConditionCount) == false)
     {
         return false;
     }
-    uint32_t InputBufferSize = 0;
-    int iReturnedBreakpointId;
-    FDP_SET_BREAKPOINT_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_SET_BP;
-    TempPkt.CpuId = CpuId;
-    TempPkt.BreakpointType = BreakpointType;
-    TempPkt.BreakpointId = BreakpointId;
-    TempPkt.BreakpointAccessType = BreakpointAccessType;
-    TempPkt.BreakpointAddressType = BreakpointAddressType;
-    TempPkt.BreakpointAddress = BreakpointAddress;
-    TempPkt.BreakpointLength = BreakpointLength;
-    TempPkt.BreakpointCr3 = BreakpointCr3;
-    LockSHM(pFDP->pSharedFDPSHM);
+    bool bAggregated = FDP_ServerAggregateHit(pFDP, pAction, CpuId, BreakpointId);
+    uint32_t Flags = pAction->Flags;
+    if ((Flags & FDP_TRACEPOINT_LOG) == 0 || pFDP->pHitLog == NULL)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SET_BREAKPOINT_PKT_REQ));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&iReturnedBreakpointId);
+        return bAggregated == false || (Flags & FDP_TRACEPOINT_STOP) != 0;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return iReturnedBreakpointId;
+    __sync_fetch_and_add(&pFDP->pHitLog->HitCount, 1);
+
+    FDP_HIT_RECORD Record;
+    memset(&Record, 0, sizeof(Record));
+    Record.Timestamp = FDP_GetTimestamp();
+    Record.CpuId = CpuId;
+    Record.BreakpointId = BreakpointId;
+    pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, &Record.Rip);
+    pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CR3_REGISTER, &Record.Cr3);
+    Record.RegisterMask = FDP_HIT_RECORD_WATCHPOINT;
+    Record.RegisterValues[FDP_WATCHPOINT_RECORD_ADDRESS] = LinearAddress;
+    Record.RegisterValues[FDP_WATCHPOINT_RECORD_SIZE] = Size;
+    Record.RegisterValues[FDP_WATCHPOINT_RECORD_ACCESS] = Access;
+    FDP_HitLogAppend(pFDP->pHitLog, &Record);
+    return (Flags & FDP_TRACEPOINT_STOP) != 0;
 }
 
+//Called by the backend on the vCPU thread at each breakpoint hit, returns true if the VM has to stop
 FDP_EXPORTED
-bool FDP_VirtualToPhysical(FDP_SHM* pFDP, uint32_t CpuId, uint64_t VirtualAddress, uint64_t* PhysicalAddress)
+bool FDP_ServerBreakpointHit(FDP_SHM* pFDP, uint32_t CpuId, int BreakpointId)
 {
-    if (pFDP == NULL)
+    if (pFDP == NULL || pFDP->pBreakpointActions == NULL || BreakpointId < 0 || BreakpointId > FDP_MAX_BREAKPOINT)
+    {
+        return true;
+    }
+    if (CpuId < FDP_BREAKPOINT_HANDLE_MAX_CPU)
+    {
+        pFDP->pBreakpointActions->aHitHandles[CpuId] = FDP_INVALID_BREAKPOINT_HANDLE;
+    }
+    uint64_t PageGroup = pFDP->pBreakpointActions->aPageGroups[BreakpointId];
+    if (PageGroup == FDP_COVERAGE_PAGE_GROUP)
+    {
+        return FDP_ServerCoverageHit(pFDP, CpuId);
+    }
+    if (PageGroup != 0)
+    {
+        return FDP_ServerExecuteBreakpointHit(pFDP, CpuId);
+    }
+    FDP_BREAKPOINT_ACTION* pAction = &pFDP->pBreakpointActions->aActions[BreakpointId];
+    if (pAction->WatchEnd != 0)
+    {
+        return FDP_ServerWatchpointHit(pFDP, CpuId, BreakpointId, pAction);
+    }
+    //A false condition lets the guest go on, as if the breakpoint wasn't there
+    if (FDP_ServerEvaluateConditions(pFDP, CpuId, pAction->aConditions, pAction->ConditionCount) == false)
     {
         return false;
     }
-    FDP_VIRTUAL_PHYSICAL_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_VIRTUAL_PHYSICAL;
-    TempPkt.CpuId = CpuId;
-    TempPkt.VirtualAddress = VirtualAddress;
-    LockSHM(pFDP->pSharedFDPSHM);
+    int ProgramId = pAction->ProgramId;
+    if (ProgramId >= 0)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_VIRTUAL_PHYSICAL_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)PhysicalAddress); //TODO: return success/fail !
+        FDP_PROGRAM* pProgram = &pFDP->pBreakpointActions->aPrograms[ProgramId];
+        __sync_fetch_and_add(&pProgram->ActiveRunCount, 1);
+        //Skip it if it was detached or unloaded meanwhile
+        if (pProgram->bLoaded && pAction->ProgramId == ProgramId)
+        {
+            uint64_t Result = 1;
+            //An aborted run stops the VM, like an unreadable condition
+            FDP_ServerRunProgram(pFDP, pProgram, CpuId, BreakpointId, &Result);
+            __sync_fetch_and_sub(&pProgram->ActiveRunCount, 1);
+            if (Result == 0)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            __sync_fetch_and_sub(&pProgram->ActiveRunCount, 1);
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return true;
+    //A counted hit only stops the VM with FDP_TRACEPOINT_STOP, like a tracepoint
+    bool bAggregated = FDP_ServerAggregateHit(pFDP, pAction, CpuId, BreakpointId);
+    uint32_t Flags = pAction->Flags;
+    if ((Flags & FDP_TRACEPOINT_LOG) == 0 || pFDP->pHitLog == NULL)
+    {
+        return bAggregated == false || (Flags & FDP_TRACEPOINT_STOP) != 0;
+    }
+    __sync_fetch_and_add(&pFDP->pHitLog->HitCount, 1);
+
+    FDP_HIT_RECORD Record;
+    memset(&Record, 0, sizeof(Record));
+    Record.Timestamp = FDP_GetTimestamp();
+    Record.CpuId = CpuId;
+    Record.BreakpointId = BreakpointId;
+    pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_RIP_REGISTER, &Record.Rip);
+    pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, FDP_CR3_REGISTER, &Record.Cr3);
+    uint64_t RegisterMask = pAction->RegisterMask;
+    uint32_t ValueIndex = 0;
+    for (uint32_t RegisterId = 0; RegisterId < FDP_MAX_REGISTER_MASK_COUNT && ValueIndex < FDP_HIT_LOG_MAX_REGISTERS; RegisterId++)
+    {
+        if ((RegisterMask & FDP_REGISTER_MASK(RegisterId))
+            && pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle, CpuId, RegisterId,
+                                                 &Record.RegisterValues[ValueIndex]))
+        {
+            Record.RegisterMask |= FDP_REGISTER_MASK(RegisterId);
+            ValueIndex++;
+        }
+    }
+    FDP_HitLogAppend(pFDP->pHitLog, &Record);
+    return (Flags & FDP_TRACEPOINT_STOP) != 0;
 }
 
-FDP_EXPORTED
-bool FDP_GetState(FDP_SHM* pFDP, FDP_State* DebuggeeState)
+#define FDP_SNAPSHOT_PAGE_SIZE          4096ULL
+#define FDP_SNAPSHOT_CHUNK_PAGES        (FDP_1M / FDP_SNAPSHOT_PAGE_SIZE)
+#define FDP_SNAPSHOT_UNREADABLE_PAGE    ((FDP_SNAPSHOT_PAGE*)1)     //Left untouched by a restore, MMIO holes for instance
+//Every writable register: the mode and descriptor tables go first, a selector is loaded from its descriptor.
+//MXCSR is part of the XSAVE area, LDTRB and LDTRL come with LDTR
+#define FDP_SNAPSHOT_SYSTEM_REGISTER_MASK   (FDP_REGISTER_MASK(FDP_RFLAGS_REGISTER) \
+                                             | FDP_REGISTER_MASK(FDP_GDTRB_REGISTER) | FDP_REGISTER_MASK(FDP_GDTRL_REGISTER) \
+                                             | FDP_REGISTER_MASK(FDP_IDTRB_REGISTER) | FDP_REGISTER_MASK(FDP_IDTRL_REGISTER) \
+                                             | FDP_REGISTER_MASK(FDP_CR0_REGISTER) | FDP_REGISTER_MASK(FDP_CR2_REGISTER) \
+                                             | FDP_REGISTER_MASK(FDP_CR3_REGISTER) | FDP_REGISTER_MASK(FDP_CR4_REGISTER) \
+                                             | FDP_REGISTER_MASK(FDP_CR8_REGISTER))
+#define FDP_SNAPSHOT_REGISTER_MASK      ((FDP_REGISTER_MASK(FDP_SS_REGISTER + 1) - 1) \
+                                         | FDP_REGISTER_MASK(FDP_LDTR_REGISTER) | FDP_REGISTER_MASK(FDP_TR_REGISTER))
+
+//SYSENTER_CS/ESP/EIP, EFER, STAR, LSTAR, CSTAR, SFMASK, FS_BASE, GS_BASE and KERNEL_GS_BASE
+static const uint64_t FDP_SnapshotMsrIds[] =
 {
-    if (pFDP == NULL)
+    0x174, 0x175, 0x176, 0xC0000080, 0xC0000081, 0xC0000082, 0xC0000083, 0xC0000084, 0xC0000100, 0xC0000101, 0xC0000102
+};
+
+#define FDP_SNAPSHOT_MSR_COUNT  (sizeof(FDP_SnapshotMsrIds) / sizeof(FDP_SnapshotMsrIds[0]))
+
+//Pages are immutable once saved, snapshots share the pages they have in common
+typedef struct FDP_SNAPSHOT_PAGE_
+{
+    uint32_t        RefCount;
+    uint8_t         aData[FDP_SNAPSHOT_PAGE_SIZE];
+} FDP_SNAPSHOT_PAGE;
+
+typedef struct FDP_SNAPSHOT_CPU_
+{
+    uint64_t        aSystemRegisterValues[FDP_MAX_REGISTER_MASK_COUNT]; //FDP_SNAPSHOT_SYSTEM_REGISTER_MASK, lowest register first
+    uint64_t        aRegisterValues[FDP_MAX_REGISTER_MASK_COUNT];   //FDP_SNAPSHOT_REGISTER_MASK, lowest register first
+    FDP_MSR_ENTRY   aMsrs[FDP_SNAPSHOT_MSR_COUNT];                  //MSRs the backend couldn't read are FDP_MSR_FAILED
+    uint64_t        XStateMask;                                     //Components saved in aXsaveArea
+    uint8_t         aXsaveArea[FDP_XSAVE_AREA_SIZE];
+} FDP_SNAPSHOT_CPU;
+
+typedef struct FDP_SNAPSHOT_
+{
+    bool                bUsed;
+    char                Name[FDP_SNAPSHOT_MAX_NAME_SIZE];
+    uint64_t            Timestamp;
+    uint64_t            PageCount;
+    uint64_t            LastRestorePageCount;
+    FDP_SNAPSHOT_PAGE   **ppPages;          //NULL for zero pages
+    uint32_t            CpuCount;
+    FDP_SNAPSHOT_CPU    *pCpus;
+    bool                bDeviceState;       //The backend keeps the device state of the snapshot, see pfnSaveDeviceState
+} FDP_SNAPSHOT;
+
+struct FDP_SNAPSHOT_STORE_
+{
+    FDP_SNAPSHOT    aSnapshots[FDP_MAX_SNAPSHOTS];
+    int             BaseSnapshot;       //Last snapshot saved or restored, -1 if none
+    uint64_t        *pDirtyBitmap;      //Pages written since the RAM matched BaseSnapshot, see pfnGetDirtyPages
+    uint64_t        DirtyPageCount;     //Bits in pDirtyBitmap
+    bool            bDirtyTracked;      //pDirtyBitmap holds every write since the RAM matched BaseSnapshot
+    int             DeviceSnapshot;     //Snapshot the devices still match (the guest didn't run since), -1 if none
+};
+
+static bool FDP_SnapshotIsZeroPage(const uint8_t* pData)
+{
+    return pData[0] == 0 && memcmp(pData, pData + 1, FDP_SNAPSHOT_PAGE_SIZE - 1) == 0;
+}
+
+static bool FDP_SnapshotPageIsDirty(const uint64_t* pDirtyBitmap, uint64_t PageIndex)
+{
+    return (pDirtyBitmap[PageIndex / 64] & (1ULL << (PageIndex % 64))) != 0;
+}
+
+static bool FDP_SnapshotNameIsValid(const char* pName)
+{
+    return pName[0] != 0 && memchr(pName, 0, FDP_SNAPSHOT_MAX_NAME_SIZE) != NULL;
+}
+
+static int FDP_ServerFindSnapshot(FDP_SNAPSHOT_STORE* pStore, const char* pName)
+{
+    for (int SnapshotId = 0; SnapshotId < FDP_MAX_SNAPSHOTS; SnapshotId++)
     {
-        return false;
+        if (pStore->aSnapshots[SnapshotId].bUsed && strcmp(pStore->aSnapshots[SnapshotId].Name, pName) == 0)
+        {
+            return SnapshotId;
+        }
     }
-    FDP_GET_STATE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_GET_STATE;
-    LockSHM(pFDP->pSharedFDPSHM);
+    return -1;
+}
+
+static void FDP_ServerReleaseSnapshot(FDP_SNAPSHOT* pSnapshot)
+{
+    for (uint64_t PageIndex = 0; pSnapshot->ppPages != NULL && PageIndex < pSnapshot->PageCount; PageIndex++)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_GET_STATE_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)DebuggeeState); //TODO: return success/fail !
+        FDP_SNAPSHOT_PAGE* pPage = pSnapshot->ppPages[PageIndex];
+        if (pPage != NULL && pPage != FDP_SNAPSHOT_UNREADABLE_PAGE && --pPage->RefCount == 0)
+        {
+            free(pPage);
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return true;
+    free(pSnapshot->ppPages);
+    free(pSnapshot->pCpus);
+    memset(pSnapshot, 0, sizeof(FDP_SNAPSHOT));
 }
 
-FDP_EXPORTED
-bool FDP_WaitForStateChanged(FDP_SHM *pFDP, FDP_State *DebuggeeState)
+static bool FDP_ServerSaveSnapshotCpu(FDP_SHM* pFDP, uint32_t CpuId, FDP_SNAPSHOT_CPU* pCpu)
 {
-    if (pFDP == NULL)
+    if (FDP_ServerReadRegisterValues(pFDP, CpuId, FDP_SNAPSHOT_SYSTEM_REGISTER_MASK, pCpu->aSystemRegisterValues) == false
+        || FDP_ServerReadRegisterValues(pFDP, CpuId, FDP_SNAPSHOT_REGISTER_MASK, pCpu->aRegisterValues) == false)
     {
         return false;
     }
-    while (true)
+    for (uint32_t i = 0; i < FDP_SNAPSHOT_MSR_COUNT; i++)
     {
-        usleep(0);
-        if (FDP_GetStateChanged(pFDP) == true)
-        {
-            return FDP_GetState(pFDP, DebuggeeState);
-        }
+        pCpu->aMsrs[i].CpuId = CpuId;
+        pCpu->aMsrs[i].MsrId = FDP_SnapshotMsrIds[i];
+        pCpu->aMsrs[i].Value = 0;
+    }
+    //Not every backend knows every MSR, the missing ones are skipped by the restore
+    FDP_ServerTransferMsrEntries(pFDP, false, pCpu->aMsrs, FDP_SNAPSHOT_MSR_COUNT);
+    uint64_t PresentMask = 0;
+    if (FDP_ServerReadXState(pFDP, CpuId, FDP_XSTATE_ALL, pCpu->aXsaveArea, &PresentMask) == false)
+    {
+        return false;
     }
+    pCpu->XStateMask = PresentMask & FDP_XSTATE_ALL;
     return true;
 }
 
-FDP_EXPORTED
-bool FDP_Init(FDP_SHM* pFDP)
+static bool FDP_ServerRestoreSnapshotCpu(FDP_SHM* pFDP, uint32_t CpuId, FDP_SNAPSHOT_CPU* pCpu)
 {
-    if (pFDP == NULL)
+    FDP_MSR_ENTRY aMsrs[FDP_SNAPSHOT_MSR_COUNT];
+    uint32_t MsrCount = 0;
+    for (uint32_t i = 0; i < FDP_SNAPSHOT_MSR_COUNT; i++)
     {
-        return false;
+        if (pCpu->aMsrs[i].Status == FDP_MSR_DONE)
+        {
+            aMsrs[MsrCount++] = pCpu->aMsrs[i];
+        }
     }
-    bool bReturnValue = true;
-    memset(pFDP->pSharedFDPSHM, 0, FDP_SHM_SHARED_SIZE);
-    return bReturnValue;
+    //EFER is set before the segments are loaded, FS_BASE and GS_BASE are set again after
+    return FDP_ServerWriteRegisterValues(pFDP, CpuId, FDP_SNAPSHOT_SYSTEM_REGISTER_MASK, pCpu->aSystemRegisterValues)
+           && FDP_ServerTransferMsrEntries(pFDP, true, aMsrs, MsrCount)
+           && FDP_ServerWriteRegisterValues(pFDP, CpuId, FDP_SNAPSHOT_REGISTER_MASK, pCpu->aRegisterValues)
+           && FDP_ServerTransferMsrEntries(pFDP, true, aMsrs, MsrCount)
+           && FDP_ServerWriteXState(pFDP, CpuId, pCpu->XStateMask, pCpu->aXsaveArea);
 }
 
-FDP_EXPORTED
-bool FDP_SingleStep(FDP_SHM* pFDP, uint32_t CpuId)
+//Adds the pages written since the previous call to pDirtyBitmap, fails when the backend can't tell them
+static bool FDP_ServerGetDirtyPages(FDP_SHM* pFDP, uint64_t PageCount)
 {
-    if (pFDP == NULL)
+    FDP_SNAPSHOT_STORE* pStore = pFDP->pSnapshotStore;
+    if (pStore->DirtyPageCount != PageCount)
     {
-        return false;
+        free(pStore->pDirtyBitmap);
+        pStore->pDirtyBitmap = (uint64_t*)calloc((PageCount + 63) / 64, sizeof(uint64_t));
+        pStore->DirtyPageCount = pStore->pDirtyBitmap != NULL ? PageCount : 0;
+        pStore->bDirtyTracked = false;
     }
-    bool bReturnValue = false;
-    uint32_t InputBufferSize = 0;
-    FDP_SINGLE_STEP_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_SINGLE_STEP;
-    TempPkt.CpuId = CpuId;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if (pStore->pDirtyBitmap == NULL || pFDP->pFdpServer->pfnGetDirtyPages == NULL
+        || pFDP->pFdpServer->pfnGetDirtyPages(pFDP->pFdpServer->pUserHandle, pStore->pDirtyBitmap, PageCount) == false)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_SINGLE_STEP_PKT_REQ));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue);
+        pStore->bDirtyTracked = false;
+        return false;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    return true;
 }
 
-uint8_t FDP_Test(FDP_SHM* pFDP)
+//Called once the RAM matches BaseSnapshot, the writes of the save or restore itself are dropped
+static void FDP_ServerRestartDirtyTracking(FDP_SHM* pFDP, uint64_t PageCount)
 {
-    if (pFDP == NULL)
+    FDP_SNAPSHOT_STORE* pStore = pFDP->pSnapshotStore;
+    pStore->bDirtyTracked = FDP_ServerGetDirtyPages(pFDP, PageCount);
+    if (pStore->pDirtyBitmap != NULL)
     {
-        return false;
+        memset(pStore->pDirtyBitmap, 0, ((pStore->DirtyPageCount + 63) / 64) * sizeof(uint64_t));
     }
-    uint8_t DebuggeState;
-    FDP_GET_STATE_PKT_REQ* tmpPkt = (FDP_GET_STATE_PKT_REQ*)pFDP->OutputBuffer;
-    tmpPkt->Type = FDPCMD_TEST;
-    LockSHM(pFDP->pSharedFDPSHM);
+}
+
+//The backend changed the RAM behind the store's back, FDPCMD_RESTORE for instance
+static void FDP_ServerInvalidateDirtyTracking(FDP_SHM* pFDP)
+{
+    if (pFDP->pSnapshotStore != NULL)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_GET_STATE_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&DebuggeState); //TODO: return success/fail !
+        pFDP->pSnapshotStore->bDirtyTracked = false;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return DebuggeState;
 }
 
-
-FDP_EXPORTED
-bool FDP_GetFxState64(FDP_SHM* pFDP, uint32_t CpuId, FDP_XSAVE_FORMAT64_T* pFxState)
+//The guest ran or was reset, its devices moved away from every snapshot
+static void FDP_ServerInvalidateDeviceSnapshot(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    if (pFDP->pSnapshotStore != NULL)
     {
-        return false;
+        pFDP->pSnapshotStore->DeviceSnapshot = -1;
     }
-    FDP_GET_STATE_PKT_REQ* TempPkt = (FDP_GET_STATE_PKT_REQ*)pFDP->OutputBuffer;
-    TempPkt->Type = FDPCMD_GET_FXSTATE;
-    TempPkt->CpuId = CpuId;
-    LockSHM(pFDP->pSharedFDPSHM);
+}
+
+//Pages equal to the same page of the base snapshot are shared with it, zero pages take no memory. With
+//pDirtyBitmap only the dirty pages are read, the others are still those of the base snapshot
+static bool FDP_ServerSaveSnapshotPages(FDP_SHM* pFDP, FDP_SNAPSHOT* pSnapshot, FDP_SNAPSHOT* pBase,
+                                        const uint64_t* pDirtyBitmap)
+{
+    uint8_t* pReadBuffer = pFDP->InputBuffer;
+    for (uint64_t CurrentPage = 0; CurrentPage < pSnapshot->PageCount; CurrentPage += FDP_SNAPSHOT_CHUNK_PAGES)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_GET_STATE_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pFxState); //TODO: return success/fail !
+        uint32_t ChunkPageCount = (uint32_t)MIN(pSnapshot->PageCount - CurrentPage, FDP_SNAPSHOT_CHUNK_PAGES);
+        bool bChunkRead = pDirtyBitmap == NULL
+                          && pFDP->pFdpServer->pfnReadPhysicalMemory(pFDP->pFdpServer->pUserHandle, pReadBuffer,
+                                                                     CurrentPage * FDP_SNAPSHOT_PAGE_SIZE,
+                                                                     (uint32_t)(ChunkPageCount * FDP_SNAPSHOT_PAGE_SIZE));
+        for (uint32_t i = 0; i < ChunkPageCount; i++)
+        {
+            uint64_t PageIndex = CurrentPage + i;
+            uint8_t* pData = pReadBuffer + i * FDP_SNAPSHOT_PAGE_SIZE;
+            if (pDirtyBitmap != NULL && FDP_SnapshotPageIsDirty(pDirtyBitmap, PageIndex) == false)
+            {
+                FDP_SNAPSHOT_PAGE* pBasePage = pBase->ppPages[PageIndex];
+                if (pBasePage != NULL && pBasePage != FDP_SNAPSHOT_UNREADABLE_PAGE)
+                {
+                    pBasePage->RefCount++;
+                }
+                pSnapshot->ppPages[PageIndex] = pBasePage;
+                continue;
+            }
+            //Retry page by page when the chunk spans a hole
+            if (bChunkRead == false
+                && pFDP->pFdpServer->pfnReadPhysicalMemory(pFDP->pFdpServer->pUserHandle, pData,
+                                                           PageIndex * FDP_SNAPSHOT_PAGE_SIZE,
+                                                           (uint32_t)FDP_SNAPSHOT_PAGE_SIZE) == false)
+            {
+                pSnapshot->ppPages[PageIndex] = FDP_SNAPSHOT_UNREADABLE_PAGE;
+                continue;
+            }
+            if (FDP_SnapshotIsZeroPage(pData))
+            {
+                continue;
+            }
+            FDP_SNAPSHOT_PAGE* pBasePage = (pBase != NULL && PageIndex < pBase->PageCount) ? pBase->ppPages[PageIndex] : NULL;
+            if (pBasePage != NULL && pBasePage != FDP_SNAPSHOT_UNREADABLE_PAGE
+                && memcmp(pBasePage->aData, pData, FDP_SNAPSHOT_PAGE_SIZE) == 0)
+            {
+                pBasePage->RefCount++;
+                pSnapshot->ppPages[PageIndex] = pBasePage;
+                continue;
+            }
+            FDP_SNAPSHOT_PAGE* pPage = (FDP_SNAPSHOT_PAGE*)malloc(sizeof(FDP_SNAPSHOT_PAGE));
+            if (pPage == NULL)
+            {
+                return false;
+            }
+            pPage->RefCount = 1;
+            memcpy(pPage->aData, pData, FDP_SNAPSHOT_PAGE_SIZE);
+            pSnapshot->ppPages[PageIndex] = pPage;
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
     return true;
 }
 
-FDP_EXPORTED
-bool FDP_SetFxState64(FDP_SHM* pFDP, uint32_t CpuId, FDP_XSAVE_FORMAT64_T* pFxState64)
+//Only the pages that may differ from the snapshot are written: the dirty pages and those the base snapshot doesn't
+//share with it when pDirtyBitmap is given, else the pages that read differently. Unreadable pages are left as they are
+static bool FDP_ServerRestoreSnapshotPages(FDP_SHM* pFDP, FDP_SNAPSHOT* pSnapshot, FDP_SNAPSHOT* pBase,
+                                           const uint64_t* pDirtyBitmap, uint64_t* pWrittenPageCount)
 {
-    if (pFDP == NULL)
-    {
-        return false;
-    }
-    bool bReturnValue = false;
-    FDP_SET_FX_STATE_REQ* TempPkt = (FDP_SET_FX_STATE_REQ*)pFDP->OutputBuffer;
-    TempPkt->Type = FDPCMD_SET_FXSTATE;
-    TempPkt->CpuId = CpuId;
-    memcpy(&TempPkt->FxState64, pFxState64, sizeof(FDP_XSAVE_FORMAT64_T));
-    LockSHM(pFDP->pSharedFDPSHM);
+    uint8_t* pWriteBuffer = pFDP->InputBuffer;
+    uint8_t* pReadBuffer = pFDP->OutputBuffer;
+    *pWrittenPageCount = 0;
+    for (uint64_t CurrentPage = 0; CurrentPage < pSnapshot->PageCount; CurrentPage += FDP_SNAPSHOT_CHUNK_PAGES)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_SET_FX_STATE_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+        uint32_t ChunkPageCount = (uint32_t)MIN(pSnapshot->PageCount - CurrentPage, FDP_SNAPSHOT_CHUNK_PAGES);
+        bool bChunkRead = pDirtyBitmap == NULL
+                          && pFDP->pFdpServer->pfnReadPhysicalMemory(pFDP->pFdpServer->pUserHandle, pReadBuffer,
+                                                                     CurrentPage * FDP_SNAPSHOT_PAGE_SIZE,
+                                                                     (uint32_t)(ChunkPageCount * FDP_SNAPSHOT_PAGE_SIZE));
+        uint32_t RunStart = 0;
+        uint32_t RunPageCount = 0;
+        for (uint32_t i = 0; i <= ChunkPageCount; i++)
+        {
+            uint64_t PageIndex = CurrentPage + i;
+            //Restoring the base snapshot, the clean pages are skipped 64 at a time
+            if (pDirtyBitmap != NULL && pBase == pSnapshot && RunPageCount == 0 && PageIndex % 64 == 0
+                && i + 64 <= ChunkPageCount && pDirtyBitmap[PageIndex / 64] == 0)
+            {
+                i += 63;
+                continue;
+            }
+            FDP_SNAPSHOT_PAGE* pPage = i < ChunkPageCount ? pSnapshot->ppPages[PageIndex] : FDP_SNAPSHOT_UNREADABLE_PAGE;
+            bool bWrite = false;
+            if (pPage != FDP_SNAPSHOT_UNREADABLE_PAGE && pDirtyBitmap != NULL)
+            {
+                bWrite = FDP_SnapshotPageIsDirty(pDirtyBitmap, PageIndex) || pBase->ppPages[PageIndex] != pPage;
+            }
+            else if (pPage != FDP_SNAPSHOT_UNREADABLE_PAGE)
+            {
+                //A page that can't be read now is written anyway
+                uint8_t* pCurrentData = pReadBuffer + i * FDP_SNAPSHOT_PAGE_SIZE;
+                bWrite = (bChunkRead == false
+                          && pFDP->pFdpServer->pfnReadPhysicalMemory(pFDP->pFdpServer->pUserHandle, pCurrentData,
+                                                                     PageIndex * FDP_SNAPSHOT_PAGE_SIZE,
+                                                                     (uint32_t)FDP_SNAPSHOT_PAGE_SIZE) == false)
+                         || (pPage == NULL ? FDP_SnapshotIsZeroPage(pCurrentData) == false
+                                           : memcmp(pCurrentData, pPage->aData, FDP_SNAPSHOT_PAGE_SIZE) != 0);
+            }
+            if (bWrite)
+            {
+                uint8_t* pData = pWriteBuffer + i * FDP_SNAPSHOT_PAGE_SIZE;
+                if (pPage == NULL)
+                {
+                    memset(pData, 0, FDP_SNAPSHOT_PAGE_SIZE);
+                }
+                else
+                {
+                    memcpy(pData, pPage->aData, FDP_SNAPSHOT_PAGE_SIZE);
+                }
+                RunStart = RunPageCount == 0 ? i : RunStart;
+                RunPageCount++;
+                continue;
+            }
+            //Contiguous pages are written together
+            if (RunPageCount > 0
+                && pFDP->pFdpServer->pfnWritePhysicalMemory(pFDP->pFdpServer->pUserHandle,
+                                                            pWriteBuffer + RunStart * FDP_SNAPSHOT_PAGE_SIZE,
+                                                            (CurrentPage + RunStart) * FDP_SNAPSHOT_PAGE_SIZE,
+                                                            (uint32_t)(RunPageCount * FDP_SNAPSHOT_PAGE_SIZE)) == false)
+            {
+                return false;
+            }
+            *pWrittenPageCount += RunPageCount;
+            RunPageCount = 0;
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    return true;
 }
 
-
-FDP_EXPORTED
-bool FDP_GetPhysicalMemorySize(FDP_SHM* pFDP, uint64_t* PhysicalMemorySize)
+static bool FDP_ServerSaveSnapshot(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    //The request is copied out so that InputBuffer can be used as read buffer
+    FDP_SNAPSHOT_PKT_REQ Request = *(FDP_SNAPSHOT_PKT_REQ*)pFDP->InputBuffer;
+    FDP_SNAPSHOT_STORE* pStore = pFDP->pSnapshotStore;
+    if (pStore == NULL || FDP_SnapshotNameIsValid(Request.Name) == false)
     {
         return false;
     }
-    bool bReturnValue = true;
-    uint32_t InputBufferSize = 0;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_GET_MEMORYSIZE;
-    LockSHM(pFDP->pSharedFDPSHM);
+    //A snapshot with the same name is replaced once the new one is complete
+    int SnapshotId = FDP_ServerFindSnapshot(pStore, Request.Name);
+    for (int i = 0; i < FDP_MAX_SNAPSHOTS && SnapshotId < 0; i++)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)PhysicalMemorySize);
+        if (pStore->aSnapshots[i].bUsed == false)
+        {
+            SnapshotId = i;
+        }
+    }
+    uint64_t MemorySize = 0;
+    uint32_t CpuCount = 0;
+    if (SnapshotId < 0
+        || pFDP->pFdpServer->pfnGetMemorySize(pFDP->pFdpServer->pUserHandle, &MemorySize) == false
+        || pFDP->pFdpServer->pfnGetCpuCount(pFDP->pFdpServer->pUserHandle, &CpuCount) == false)
+    {
+        return false;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    //TODO return bool !
-    return bReturnValue;
-}
 
+    FDP_SNAPSHOT Snapshot;
+    memset(&Snapshot, 0, sizeof(Snapshot));
+    strcpy(Snapshot.Name, Request.Name);
+    Snapshot.PageCount = MemorySize / FDP_SNAPSHOT_PAGE_SIZE;
+    Snapshot.CpuCount = CpuCount;
+    Snapshot.ppPages = (FDP_SNAPSHOT_PAGE**)calloc(Snapshot.PageCount, sizeof(FDP_SNAPSHOT_PAGE*));
+    Snapshot.pCpus = (FDP_SNAPSHOT_CPU*)calloc(CpuCount, sizeof(FDP_SNAPSHOT_CPU));
+    bool bReturnValue = Snapshot.ppPages != NULL && Snapshot.pCpus != NULL;
 
-FDP_EXPORTED
-bool FDP_GetCpuCount(FDP_SHM* pFDP, uint32_t* CPUCount)
-{
-    if (pFDP == NULL)
+    //The guest must not run while its state is copied
+    uint8_t CurrentState = 0;
+    bool bPaused = false;
+    pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &CurrentState);
+    if ((CurrentState & FDP_STATE_PAUSED) == 0)
     {
-        return false;
+        bPaused = pFDP->pFdpServer->pfnPause(pFDP->pFdpServer->pUserHandle);
     }
-    bool bReturnValue = true;
-    uint32_t InputBufferSize = 0;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_GET_CPU_COUNT;
-    LockSHM(pFDP->pSharedFDPSHM);
+    for (uint32_t CpuId = 0; CpuId < CpuCount && bReturnValue; CpuId++)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        InputBufferSize = ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)CPUCount);
+        bReturnValue = FDP_ServerSaveSnapshotCpu(pFDP, CpuId, &Snapshot.pCpus[CpuId]);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
-}
-
-FDP_EXPORTED
-bool FDP_GetCpuState(FDP_SHM* pFDP, uint32_t CpuId, FDP_State* pDebuggeeState)
-{
-    if (pFDP == NULL)
+    FDP_SNAPSHOT* pBase = pStore->BaseSnapshot >= 0 ? &pStore->aSnapshots[pStore->BaseSnapshot] : NULL;
+    bool bDirtyTracked = pBase != NULL && pBase->PageCount == Snapshot.PageCount
+                         && FDP_ServerGetDirtyPages(pFDP, Snapshot.PageCount) && pStore->bDirtyTracked;
+    bReturnValue = bReturnValue
+                   && FDP_ServerSaveSnapshotPages(pFDP, &Snapshot, pBase, bDirtyTracked ? pStore->pDirtyBitmap : NULL);
+    //Last, the backend overwrites the device state of the snapshot it replaces
+    bool bDeviceStateLost = false;
+    if (bReturnValue && pFDP->pFdpServer->pfnSaveDeviceState != NULL)
     {
-        return false;
+        Snapshot.bDeviceState = pFDP->pFdpServer->pfnSaveDeviceState(pFDP->pFdpServer->pUserHandle, (uint32_t)SnapshotId);
+        bDeviceStateLost = Snapshot.bDeviceState == false;
+        bReturnValue = Snapshot.bDeviceState;
     }
-    FDP_GET_CPU_STATE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_GET_CPU_STATE;
-    TempPkt.CpuId = CpuId;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if (bReturnValue)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(FDP_GET_CPU_STATE_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)pDebuggeeState); //TODO: return success/fail !
+        FDP_ServerRestartDirtyTracking(pFDP, Snapshot.PageCount);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
+    if (bPaused)
+    {
+        pFDP->pFdpServer->pfnResume(pFDP->pFdpServer->pUserHandle);
+    }
+
+    if (bReturnValue == false)
+    {
+        FDP_ServerReleaseSnapshot(&Snapshot);
+        if (bDeviceStateLost && pStore->aSnapshots[SnapshotId].bUsed)
+        {
+            FDP_ServerReleaseSnapshot(&pStore->aSnapshots[SnapshotId]);
+            pStore->BaseSnapshot = pStore->BaseSnapshot == SnapshotId ? -1 : pStore->BaseSnapshot;
+        }
+        return false;
+    }
+    Snapshot.bUsed = true;
+    Snapshot.Timestamp = FDP_GetTimestamp();
+    FDP_ServerReleaseSnapshot(&pStore->aSnapshots[SnapshotId]);
+    pStore->aSnapshots[SnapshotId] = Snapshot;
+    pStore->BaseSnapshot = SnapshotId;
+    pStore->DeviceSnapshot = bPaused ? -1 : SnapshotId;
     return true;
 }
 
-FDP_EXPORTED
-bool FDP_Save(FDP_SHM* pFDP)
+static bool FDP_ServerRestoreSnapshot(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    //The request is copied out so that InputBuffer can be used as write buffer
+    FDP_SNAPSHOT_PKT_REQ Request = *(FDP_SNAPSHOT_PKT_REQ*)pFDP->InputBuffer;
+    FDP_SNAPSHOT_STORE* pStore = pFDP->pSnapshotStore;
+    uint32_t CpuCount = 0;
+    if (pStore == NULL || FDP_SnapshotNameIsValid(Request.Name) == false
+        || pFDP->pFdpServer->pfnGetCpuCount(pFDP->pFdpServer->pUserHandle, &CpuCount) == false)
     {
         return false;
     }
-    bool bReturnValue = false;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_SAVE;
-    LockSHM(pFDP->pSharedFDPSHM);
+    int SnapshotId = FDP_ServerFindSnapshot(pStore, Request.Name);
+    if (SnapshotId < 0 || pStore->aSnapshots[SnapshotId].CpuCount != CpuCount)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+        return false;
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
-}
+    FDP_SNAPSHOT* pSnapshot = &pStore->aSnapshots[SnapshotId];
 
-FDP_EXPORTED
-bool FDP_Restore(FDP_SHM* pFDP)
-{
-    if (pFDP == NULL)
+    uint8_t CurrentState = 0;
+    bool bPaused = false;
+    pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &CurrentState);
+    //Without the device state, the RAM and CPUs only go back while the devices haven't moved
+    if (pSnapshot->bDeviceState == false
+        && (pStore->DeviceSnapshot != SnapshotId || (CurrentState & FDP_STATE_PAUSED) == 0))
     {
         return false;
     }
-    bool bReturnValue = false;
-    FDP_SIMPLE_PKT_REQ TempPkt;
-    TempPkt.Type = FDPCMD_RESTORE;
-    LockSHM(pFDP->pSharedFDPSHM);
+    if ((CurrentState & FDP_STATE_PAUSED) == 0)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, (uint8_t*)&TempPkt, sizeof(TempPkt));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+        bPaused = pFDP->pFdpServer->pfnPause(pFDP->pFdpServer->pUserHandle);
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
+    FDP_SNAPSHOT* pBase = pStore->BaseSnapshot >= 0 ? &pStore->aSnapshots[pStore->BaseSnapshot] : NULL;
+    bool bDirtyTracked = pBase != NULL && pBase->PageCount == pSnapshot->PageCount
+                         && FDP_ServerGetDirtyPages(pFDP, pSnapshot->PageCount) && pStore->bDirtyTracked;
+    //The devices go back first, a backend loading them may also load its RAM and CPUs, ours are written over
+    bool bReturnValue = pSnapshot->bDeviceState == false
+                        || pFDP->pFdpServer->pfnRestoreDeviceState(pFDP->pFdpServer->pUserHandle, (uint32_t)SnapshotId);
+    bReturnValue = bReturnValue
+                   && FDP_ServerRestoreSnapshotPages(pFDP, pSnapshot, pBase, bDirtyTracked ? pStore->pDirtyBitmap : NULL,
+                                                     &pSnapshot->LastRestorePageCount);
+    for (uint32_t CpuId = 0; CpuId < CpuCount && bReturnValue; CpuId++)
+    {
+        bReturnValue = FDP_ServerRestoreSnapshotCpu(pFDP, CpuId, &pSnapshot->pCpus[CpuId]);
+    }
+    if (bReturnValue)
+    {
+        FDP_ServerRestartDirtyTracking(pFDP, pSnapshot->PageCount);
+    }
+    if (bPaused)
+    {
+        pFDP->pFdpServer->pfnResume(pFDP->pFdpServer->pUserHandle);
+    }
+    if (bReturnValue)
+    {
+        pStore->BaseSnapshot = SnapshotId;
+    }
+    pStore->DeviceSnapshot = bReturnValue && bPaused == false ? SnapshotId : -1;
     return bReturnValue;
 }
 
-FDP_EXPORTED
-bool FDP_GetStateChanged(FDP_SHM* pFDP)
+static bool FDP_ServerDeleteSnapshot(FDP_SHM* pFDP)
 {
-    if (pFDP == NULL)
+    FDP_SNAPSHOT_PKT_REQ* TempPkt = (FDP_SNAPSHOT_PKT_REQ*)pFDP->InputBuffer;
+    FDP_SNAPSHOT_STORE* pStore = pFDP->pSnapshotStore;
+    if (pStore == NULL || FDP_SnapshotNameIsValid(TempPkt->Name) == false)
     {
         return false;
     }
-    bool StateChanged;
-    //LockSHM(pFDP->pSharedFDPSHM);
-    ttas_spinlock_lock(&pFDP->pSharedFDPSHM->stateChangedLock);
+    int SnapshotId = FDP_ServerFindSnapshot(pStore, TempPkt->Name);
+    if (SnapshotId < 0)
     {
-        StateChanged = pFDP->pSharedFDPSHM->stateChanged;
-        pFDP->pSharedFDPSHM->stateChanged = false;
+        return false;
     }
-    //UnlockSHM(pFDP->pSharedFDPSHM);
-    ttas_spinlock_unlock(&pFDP->pSharedFDPSHM->stateChangedLock);
-    return StateChanged;
-}
-
-FDP_EXPORTED
-void FDP_SetStateChanged(FDP_SHM* pFDP)
-{
-    if (pFDP == NULL)
+    FDP_ServerReleaseSnapshot(&pStore->aSnapshots[SnapshotId]);
+    if (pStore->BaseSnapshot == SnapshotId)
     {
-        return;
+        pStore->BaseSnapshot = -1;
     }
-    //LockSHM(pFDP->pSharedFDPSHM);
-    ttas_spinlock_lock(&pFDP->pSharedFDPSHM->stateChangedLock);
+    if (pStore->DeviceSnapshot == SnapshotId)
     {
-        pFDP->pSharedFDPSHM->stateChanged = true;
+        pStore->DeviceSnapshot = -1;
     }
-    //UnlockSHM(pFDP->pSharedFDPSHM);
-    ttas_spinlock_unlock(&pFDP->pSharedFDPSHM->stateChangedLock);
-    return;
+    return true;
 }
 
-FDP_EXPORTED
-bool FDP_InjectInterrupt(FDP_SHM* pFDP, uint32_t CpuId, uint32_t uInterruptionCode, uint32_t uErrorCode,
-                         uint64_t Cr2Value)
+static bool FDP_ServerListSnapshots(FDP_SHM* pFDP, uint32_t* pOutputBufferSize)
 {
-    if (pFDP == NULL)
+    FDP_SNAPSHOT_STORE* pStore = pFDP->pSnapshotStore;
+    if (pStore == NULL)
     {
         return false;
     }
-    bool bReturnValue = false;
-    FDP_INJECT_INTERRUPT_PKT_REQ* tmpPkt = (FDP_INJECT_INTERRUPT_PKT_REQ*)pFDP->OutputBuffer;
-    tmpPkt->Type = FDPCMD_INJECT_INTERRUPT;
-    tmpPkt->CpuId = CpuId;
-    tmpPkt->Cr2Value = Cr2Value;
-    tmpPkt->ErrorCode = uErrorCode;
-    tmpPkt->InterruptionCode = uInterruptionCode;
-    LockSHM(pFDP->pSharedFDPSHM);
+    FDP_LIST_SNAPSHOTS_PKT_RSP* pRsp = (FDP_LIST_SNAPSHOTS_PKT_RSP*)pFDP->OutputBuffer;
+    FDP_SNAPSHOT_INFO* pInfos = (FDP_SNAPSHOT_INFO*)(pFDP->OutputBuffer + sizeof(FDP_LIST_SNAPSHOTS_PKT_RSP));
+    pRsp->SnapshotCount = 0;
+    for (int SnapshotId = 0; SnapshotId < FDP_MAX_SNAPSHOTS; SnapshotId++)
     {
-        WriteFDPData(&pFDP->pSharedFDPSHM->ClientToServer, pFDP->OutputBuffer, sizeof(FDP_INJECT_INTERRUPT_PKT_REQ));
-        ReadFDPData(&pFDP->pSharedFDPSHM->ServerToClient, (uint8_t*)&bReturnValue); //TODO: return success/fail !
+        FDP_SNAPSHOT* pSnapshot = &pStore->aSnapshots[SnapshotId];
+        if (pSnapshot->bUsed == false)
+        {
+            continue;
+        }
+        FDP_SNAPSHOT_INFO* pInfo = &pInfos[pRsp->SnapshotCount++];
+        memcpy(pInfo->Name, pSnapshot->Name, FDP_SNAPSHOT_MAX_NAME_SIZE);
+        pInfo->Timestamp = pSnapshot->Timestamp;
+        pInfo->PageCount = pSnapshot->PageCount;
+        pInfo->LastRestorePageCount = pSnapshot->LastRestorePageCount;
+        pInfo->Flags = pSnapshot->bDeviceState ? FDP_SNAPSHOT_DEVICE_STATE : 0;
+        pInfo->PrivatePageCount = 0;
+        for (uint64_t PageIndex = 0; PageIndex < pSnapshot->PageCount; PageIndex++)
+        {
+            FDP_SNAPSHOT_PAGE* pPage = pSnapshot->ppPages[PageIndex];
+            if (pPage != NULL && pPage != FDP_SNAPSHOT_UNREADABLE_PAGE && pPage->RefCount == 1)
+            {
+                pInfo->PrivatePageCount++;
+            }
+        }
     }
-    UnlockSHM(pFDP->pSharedFDPSHM);
-    return bReturnValue;
+    *pOutputBufferSize = (uint32_t)(sizeof(FDP_LIST_SNAPSHOTS_PKT_RSP) + pRsp->SnapshotCount * sizeof(FDP_SNAPSHOT_INFO));
+    return true;
 }
 
-
-
-//Server Part
 FDP_EXPORTED
 bool FDP_ServerLoop(FDP_SHM* pFDP)
 {
@@ -1073,12 +7024,18 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
         }
         case FDPCMD_RESTORE:
         {
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerInvalidateDirtyTracking(pFDP);
+            FDP_ServerInvalidateDeviceSnapshot(pFDP);
             pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnRestore(pFDP->pFdpServer->pUserHandle);
             u32OutputBuffersize = 1;
             break;
         }
         case FDPCMD_REBOOT:
         {
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerInvalidateDirtyTracking(pFDP);
+            FDP_ServerInvalidateDeviceSnapshot(pFDP);
             pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnReboot(pFDP->pFdpServer->pUserHandle);
             u32OutputBuffersize = 1;
             break;
@@ -1095,6 +7052,10 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
         {
             uint8_t CurrentState;
             pFDP->pFdpServer->pfnGetState(pFDP->pFdpServer->pUserHandle, &CurrentState);
+            if (CurrentState & FDP_STATE_PAUSED)
+            {
+                FDP_ServerRefreshAllCpuCtx(pFDP);
+            }
             pFDP->OutputBuffer[0] = CurrentState;
             u32OutputBuffersize = sizeof(CurrentState);
             break;
@@ -1119,13 +7080,15 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
         case FDPCMD_UNSET_BP:
         {
             FDP_CLEAR_BREAKPOINT_PKT_REQ* TempPkt = (FDP_CLEAR_BREAKPOINT_PKT_REQ*)pFDP->InputBuffer;
-            pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnUnsetBreakpoint(pFDP->pFdpServer->pUserHandle, TempPkt->BreakpointId);
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            pFDP->OutputBuffer[0] = FDP_ServerUnsetBreakpoint(pFDP, TempPkt->BreakpointId);
             u32OutputBuffersize = 1;
             break;
         }
         case FDPCMD_SET_BP:
         {
             FDP_SET_BREAKPOINT_PKT_REQ* TempPkt = (FDP_SET_BREAKPOINT_PKT_REQ*)pFDP->InputBuffer;
+            FDP_ServerInvalidateCpuCtx(pFDP);
             ((int*)pFDP->OutputBuffer)[0] = pFDP->pFdpServer->pfnSetBreakpoint(pFDP->pFdpServer->pUserHandle,
                                             TempPkt->CpuId,
                                             TempPkt->BreakpointType,
@@ -1151,17 +7114,29 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
             break;
         }
         case FDPCMD_RESUME_VM:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerInvalidateDeviceSnapshot(pFDP);
             pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnResume(pFDP->pFdpServer->pUserHandle);
             u32OutputBuffersize = sizeof(bool);
             break;
         case FDPCMD_PAUSE_VM:
             pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnPause(pFDP->pFdpServer->pUserHandle);
+            if (pFDP->OutputBuffer[0])
+            {
+                FDP_ServerRefreshAllCpuCtx(pFDP);
+            }
             u32OutputBuffersize = sizeof(bool);
             break;
         case FDPCMD_SINGLE_STEP:
         {
             FDP_GET_STATE_PKT_REQ* TempPkt = (FDP_GET_STATE_PKT_REQ*)pFDP->InputBuffer;
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerInvalidateDeviceSnapshot(pFDP);
             pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnSingleStep(pFDP->pFdpServer->pUserHandle, TempPkt->CpuId);
+            if (pFDP->OutputBuffer[0])
+            {
+                FDP_ServerRefreshCpuCtx(pFDP, TempPkt->CpuId);
+            }
             u32OutputBuffersize = sizeof(bool);
             break;
         }
@@ -1169,6 +7144,7 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
         {
             uint64_t RegisterValue = 0;
             FDP_READ_REGISTER_PKT_REQ* TempPkt = (FDP_READ_REGISTER_PKT_REQ*)pFDP->InputBuffer;
+            FDP_ServerRefreshPausedCpuCtx(pFDP, TempPkt->CpuId);
             pFDP->pFdpServer->pfnReadRegister(pFDP->pFdpServer->pUserHandle,
                                               TempPkt->CpuId,
                                               TempPkt->RegisterId,
@@ -1225,6 +7201,10 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
                                     TempPkt->CpuId,
                                     TempPkt->RegisterId,
                                     TempPkt->RegisterValue);
+            if (pFDP->OutputBuffer[0])
+            {
+                FDP_ServerUpdateCpuCtx(pFDP, TempPkt->CpuId, TempPkt->RegisterId, TempPkt->RegisterValue);
+            }
             u32OutputBuffersize = sizeof(bool);
             break;
         }
@@ -1302,6 +7282,7 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
         case FDPCMD_INJECT_INTERRUPT:
         {
             FDP_INJECT_INTERRUPT_PKT_REQ* TempPkt = (FDP_INJECT_INTERRUPT_PKT_REQ*)pFDP->InputBuffer;
+            FDP_ServerInvalidateCpuCtx(pFDP);
             pFDP->OutputBuffer[0] = pFDP->OutputBuffer[0] = pFDP->pFdpServer->pfnInjectInterrupt(
                                         pFDP->pFdpServer->pUserHandle,
                                         TempPkt->CpuId,
@@ -1312,6 +7293,227 @@ bool FDP_ServerLoop(FDP_SHM* pFDP)
             u32OutputBuffersize = sizeof(bool);
             break;
         }
+        case FDPCMD_HASH_RANGE:
+        {
+            bStatus = FDP_ServerHashRange(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        }
+        case FDPCMD_SWAP_MEMORY:
+        {
+            bStatus = FDP_ServerSwapMemory(pFDP, &u32OutputBuffersize);
+            if (u32OutputBuffersize == 0)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        }
+        case FDPCMD_WALK_LIST:
+        {
+            bStatus = FDP_ServerWalkList(pFDP, &u32OutputBuffersize);
+            break;
+        }
+        case FDPCMD_READ_REGISTERS:
+        {
+            bStatus = FDP_ServerReadRegisters(pFDP, &u32OutputBuffersize);
+            if (bStatus == false || u32OutputBuffersize == 0)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        }
+        case FDPCMD_WRITE_REGISTERS:
+            pFDP->OutputBuffer[0] = FDP_ServerWriteRegisters(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_GET_XSTATE:
+        {
+            bStatus = FDP_ServerGetXState(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        }
+        case FDPCMD_SET_XSTATE:
+            pFDP->OutputBuffer[0] = FDP_ServerSetXState(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_LOAD_PROGRAM:
+        {
+            int ProgramId = -1;
+            FDP_ServerLoadProgram(pFDP, &ProgramId);
+            ((int*)pFDP->OutputBuffer)[0] = ProgramId;
+            u32OutputBuffersize = sizeof(int);
+            break;
+        }
+        case FDPCMD_UNLOAD_PROGRAM:
+            pFDP->OutputBuffer[0] = FDP_ServerUnloadProgram(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_ATTACH_PROGRAM:
+            pFDP->OutputBuffer[0] = FDP_ServerAttachProgram(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_READ_PROGRAM_MAP:
+            bStatus = FDP_ServerReadProgramMap(pFDP, &u32OutputBuffersize);
+            if (u32OutputBuffersize == 0)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_ADD_EXECUTE_BREAKPOINT:
+        {
+            uint32_t Handle = FDP_INVALID_BREAKPOINT_HANDLE;
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerAddExecuteBreakpoint(pFDP, &Handle);
+            ((uint32_t*)pFDP->OutputBuffer)[0] = Handle;
+            u32OutputBuffersize = sizeof(uint32_t);
+            break;
+        }
+        case FDPCMD_REMOVE_EXECUTE_BREAKPOINT:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            pFDP->OutputBuffer[0] = FDP_ServerRemoveExecuteBreakpoint(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_GET_HIT_BREAKPOINT_HANDLE:
+            ((uint32_t*)pFDP->OutputBuffer)[0] = FDP_ServerGetHitBreakpointHandle(pFDP);
+            u32OutputBuffersize = sizeof(uint32_t);
+            break;
+        case FDPCMD_SET_BREAKPOINTS:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            bStatus = FDP_ServerSetBreakpoints(pFDP, &u32OutputBuffersize);
+            if (u32OutputBuffersize == 0)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_UNSET_BREAKPOINTS:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            bStatus = FDP_ServerUnsetBreakpoints(pFDP, &u32OutputBuffersize);
+            if (u32OutputBuffersize == 0)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_UNSET_ALL_BREAKPOINTS:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            pFDP->OutputBuffer[0] = FDP_ServerUnsetAllBreakpoints(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_SINGLE_STEP_N:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerInvalidateDeviceSnapshot(pFDP);
+            bStatus = FDP_ServerSingleStepN(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_SET_COVERAGE_BLOCKS:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            pFDP->OutputBuffer[0] = FDP_ServerSetCoverageBlocks(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_GET_COVERAGE:
+            bStatus = FDP_ServerGetCoverage(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_RESET_COVERAGE:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            pFDP->OutputBuffer[0] = FDP_ServerResetCoverage(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_STEP_UNTIL:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            FDP_ServerInvalidateDeviceSnapshot(pFDP);
+            bStatus = FDP_ServerStepUntil(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_CREATE_AGGREGATION:
+        {
+            int AggregationId = -1;
+            FDP_ServerCreateAggregation(pFDP, &AggregationId);
+            ((int*)pFDP->OutputBuffer)[0] = AggregationId;
+            u32OutputBuffersize = sizeof(int);
+            break;
+        }
+        case FDPCMD_DELETE_AGGREGATION:
+            pFDP->OutputBuffer[0] = FDP_ServerDeleteAggregation(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_ATTACH_AGGREGATION:
+            pFDP->OutputBuffer[0] = FDP_ServerAttachAggregation(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_GET_AGGREGATION:
+            bStatus = FDP_ServerGetAggregationEntries(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_SAVE_SNAPSHOT:
+            pFDP->OutputBuffer[0] = FDP_ServerSaveSnapshot(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_RESTORE_SNAPSHOT:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            pFDP->OutputBuffer[0] = FDP_ServerRestoreSnapshot(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_DELETE_SNAPSHOT:
+            pFDP->OutputBuffer[0] = FDP_ServerDeleteSnapshot(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_LIST_SNAPSHOTS:
+            bStatus = FDP_ServerListSnapshots(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        case FDPCMD_SET_WATCHPOINT:
+            FDP_ServerInvalidateCpuCtx(pFDP);
+            ((int*)pFDP->OutputBuffer)[0] = FDP_ServerSetWatchpoint(pFDP);
+            u32OutputBuffersize = sizeof(int);
+            break;
+        case FDPCMD_SET_BREAKPOINT_CONDITION:
+            pFDP->OutputBuffer[0] = FDP_ServerSetBreakpointCondition(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_SET_TRACEPOINT:
+            pFDP->OutputBuffer[0] = FDP_ServerSetTracepoint(pFDP);
+            u32OutputBuffersize = sizeof(bool);
+            break;
+        case FDPCMD_GET_ALL_CPU_STATES:
+        {
+            bStatus = FDP_ServerGetAllCpuStates(pFDP, &u32OutputBuffersize);
+            if (bStatus == false)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        }
+        case FDPCMD_READ_MSRS:
+        case FDPCMD_WRITE_MSRS:
+        {
+            bStatus = FDP_ServerTransferMsrs(pFDP, Type == FDPCMD_WRITE_MSRS, &u32OutputBuffersize);
+            if (u32OutputBuffersize == 0)
+            {
+                u32OutputBuffersize = 1;
+            }
+            break;
+        }
         //TODO !
         case FDPCMD_SEARCH_PHYSICAL_MEMORY:
         {
@@ -1354,5 +7556,27 @@ bool FDP_SetFDPServer(FDP_SHM* pFDP, FDP_SERVER_INTERFACE_T* pFDPServer)
         return false;
     }
     pFDP->pFdpServer = pFDPServer;
+    if (pFDP->pBreakpointActions == NULL)
+    {
+        pFDP->pBreakpointActions = (FDP_BREAKPOINT_ACTIONS*)calloc(1, sizeof(FDP_BREAKPOINT_ACTIONS));
+        if (pFDP->pBreakpointActions != NULL)
+        {
+            for (int BreakpointId = 0; BreakpointId <= FDP_MAX_BREAKPOINT; BreakpointId++)
+            {
+                pFDP->pBreakpointActions->aActions[BreakpointId].ProgramId = -1;
+                pFDP->pBreakpointActions->aActions[BreakpointId].AggregationId = -1;
+            }
+            pFDP->pBreakpointActions->pExecuteBreakpoints = FDP_CreateBreakpointTable();
+        }
+    }
+    if (pFDP->pSnapshotStore == NULL)
+    {
+        pFDP->pSnapshotStore = (FDP_SNAPSHOT_STORE*)calloc(1, sizeof(FDP_SNAPSHOT_STORE));
+        if (pFDP->pSnapshotStore != NULL)
+        {
+            pFDP->pSnapshotStore->BaseSnapshot = -1;
+            pFDP->pSnapshotStore->DeviceSnapshot = -1;
+        }
+    }
     return true;
 }
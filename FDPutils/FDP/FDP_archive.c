@@ -0,0 +1,1154 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FDP.h"
+#include "FDP_archive.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+//File layout, little-endian, every structure 8 bytes aligned:
+//  FDP_ARCHIVE_HEADER
+//  Compressed blocks, snapshot page maps and CPU records, in the order they were written
+//  Index: FDP_ARCHIVE_BLOCK_ENTRY[BlockCount], uint64_t PageHashes[StoredPageCount],
+//         FDP_ARCHIVE_SNAPSHOT_ENTRY[SnapshotCount], FDP_ARCHIVE_TRAILER
+//A page map holds one page id per guest page, page ids number the stored pages
+//in the order they were written. Every close appends a new index and only then
+//points the header at its trailer, an interrupted writer leaves the previous
+//index in place.
+#define FDP_ARCHIVE_MAGIC               "FDPARCHV"
+#define FDP_ARCHIVE_VERSION             2
+#define FDP_ARCHIVE_ZERO_PAGE           0xFFFFFFFFFFFFFFFEULL
+#define FDP_ARCHIVE_UNREADABLE_PAGE     0xFFFFFFFFFFFFFFFFULL
+#define FDP_ARCHIVE_BATCH_PAGES         256     //Pages read per request (1MB)
+#define FDP_ARCHIVE_BLOCK_SIZE          (FDP_ARCHIVE_BLOCK_PAGES * FDP_ARCHIVE_PAGE_SIZE)
+#define FDP_ARCHIVE_COMPRESS_BOUND      (FDP_ARCHIVE_BLOCK_SIZE + FDP_ARCHIVE_BLOCK_SIZE / 255 + 16)
+#define FDP_ARCHIVE_LZ_HASH_BITS        12
+#define FDP_ARCHIVE_LZ_MIN_MATCH        4
+#define FDP_ARCHIVE_LZ_MAX_OFFSET       0xFFFF
+#define FDP_ARCHIVE_ALIGN(x)            (((x) + 7) & ~7ULL)
+
+typedef struct FDP_ARCHIVE_HEADER_
+{
+    char        Magic[8];
+    uint32_t    Version;
+    uint32_t    PageSize;
+    uint32_t    BlockPageCount;
+    uint32_t    Reserved;
+    uint64_t    TrailerOffset;      //0 => no index written yet
+} FDP_ARCHIVE_HEADER;
+
+typedef struct FDP_ARCHIVE_BLOCK_ENTRY_
+{
+    uint64_t    Offset;
+    uint64_t    FirstPageId;
+    uint32_t    CompressedSize;     //PageCount * FDP_ARCHIVE_PAGE_SIZE => stored as is
+    uint32_t    PageCount;
+} FDP_ARCHIVE_BLOCK_ENTRY;
+
+typedef struct FDP_ARCHIVE_CPU_ENTRY_
+{
+    uint64_t    ValidMask;          //FDP_REGISTER_MASK of the registers that could be read
+    uint64_t    RegisterValues[FDP_ARCHIVE_REGISTER_COUNT];
+} FDP_ARCHIVE_CPU_ENTRY;
+
+typedef struct FDP_ARCHIVE_SNAPSHOT_ENTRY_
+{
+    char        Name[FDP_ARCHIVE_MAX_NAME_SIZE];
+    uint64_t    Timestamp;
+    uint64_t    PageCount;
+    uint64_t    NewPageCount;
+    uint64_t    ZeroPageCount;
+    uint64_t    UnreadablePageCount;
+    uint64_t    MapOffset;          //uint64_t[PageCount]
+    uint64_t    CpuOffset;          //FDP_ARCHIVE_CPU_ENTRY[CpuCount]
+    uint32_t    CpuCount;
+    uint32_t    Reserved;
+} FDP_ARCHIVE_SNAPSHOT_ENTRY;
+
+typedef struct FDP_ARCHIVE_TRAILER_
+{
+    uint64_t    IndexOffset;
+    uint64_t    BlockCount;
+    uint64_t    StoredPageCount;
+    uint32_t    SnapshotCount;
+    uint32_t    Reserved;
+    char        Magic[8];
+} FDP_ARCHIVE_TRAILER;
+
+struct FDP_ARCHIVE_WRITER_
+{
+    int                         Fd;
+    uint64_t                    FileOffset;
+    bool                        bFailed;            //A write failed, the index is not written
+    FDP_ARCHIVE_BLOCK_ENTRY     *pBlocks;
+    uint64_t                    BlockCount;
+    uint64_t                    BlockCapacity;
+    uint64_t                    *pPageHashes;
+    uint64_t                    StoredPageCount;
+    uint64_t                    PageHashCapacity;
+    FDP_ARCHIVE_SNAPSHOT_ENTRY  *pSnapshots;
+    uint32_t                    SnapshotCount;
+    uint32_t                    SnapshotCapacity;
+    uint64_t                    *pHashTable;        //Page id + 1, 0 => free slot
+    uint64_t                    HashTableSize;      //Power of 2
+    uint8_t                     *pBlockBuffer;      //Stored pages not yet written
+    uint32_t                    BlockBufferPageCount;
+    uint8_t                     *pCompressBuffer;
+    uint8_t                     *pVerifyBlock;      //Written block read back to confirm hash hits
+    uint64_t                    VerifyBlock;        //Block in pVerifyBlock, UINT64_MAX => none
+    FDP_ARCHIVE_HEADER          Header;
+};
+
+struct FDP_ARCHIVE_
+{
+    const uint8_t                       *pData;
+    uint64_t                            Size;
+    const FDP_ARCHIVE_BLOCK_ENTRY       *pBlocks;
+    uint64_t                            BlockCount;
+    uint64_t                            StoredPageCount;
+    const FDP_ARCHIVE_SNAPSHOT_ENTRY    *pSnapshots;
+    uint32_t                            SnapshotCount;
+    uint64_t                            CachedBlock;        //Block decompressed in pBlockCache, BlockCount => none
+    uint8_t                             *pBlockCache;
+};
+
+
+//
+// Block compression, a byte oriented LZ77 with LZ4-like sequences:
+// token (literal length << 4 | match length - 4), literal length extension,
+// literals, 16-bit offset, match length extension. The last sequence has no match.
+//
+__inline static uint32_t FDP_ArchiveRead32(const uint8_t *pBuffer)
+{
+    uint32_t Value;
+    memcpy(&Value, pBuffer, sizeof(Value));
+    return Value;
+}
+
+__inline static uint32_t FDP_ArchiveLzHash(uint32_t Value)
+{
+    return (Value * 2654435761U) >> (32 - FDP_ARCHIVE_LZ_HASH_BITS);
+}
+
+static uint8_t* FDP_ArchiveLzWriteLength(uint8_t *pOut, uint32_t Length)
+{
+    while (Length >= 255)
+    {
+        *pOut++ = 255;
+        Length -= 255;
+    }
+    *pOut++ = (uint8_t)Length;
+    return pOut;
+}
+
+static uint8_t* FDP_ArchiveLzWriteSequence(uint8_t *pOut, const uint8_t *pLiterals, uint32_t LiteralLength,
+                                           uint32_t Offset, uint32_t MatchLength)
+{
+    uint8_t *pToken = pOut++;
+    *pToken = (uint8_t)(MIN(LiteralLength, 15) << 4);
+    if (LiteralLength >= 15)
+    {
+        pOut = FDP_ArchiveLzWriteLength(pOut, LiteralLength - 15);
+    }
+    memcpy(pOut, pLiterals, LiteralLength);
+    pOut += LiteralLength;
+    if (MatchLength == 0)
+    {
+        return pOut;
+    }
+    MatchLength -= FDP_ARCHIVE_LZ_MIN_MATCH;
+    *pToken |= (uint8_t)MIN(MatchLength, 15);
+    *pOut++ = (uint8_t)(Offset & 0xFF);
+    *pOut++ = (uint8_t)(Offset >> 8);
+    if (MatchLength >= 15)
+    {
+        pOut = FDP_ArchiveLzWriteLength(pOut, MatchLength - 15);
+    }
+    return pOut;
+}
+
+//pDst must hold FDP_ARCHIVE_COMPRESS_BOUND bytes
+static uint32_t FDP_ArchiveCompress(const uint8_t *pSrc, uint32_t SrcSize, uint8_t *pDst)
+{
+    uint32_t aTable[1 << FDP_ARCHIVE_LZ_HASH_BITS];
+    memset(aTable, 0, sizeof(aTable));
+    uint8_t *pOut = pDst;
+    uint32_t Anchor = 0;
+    uint32_t Position = 0;
+    while (Position + FDP_ARCHIVE_LZ_MIN_MATCH <= SrcSize)
+    {
+        uint32_t Sequence = FDP_ArchiveRead32(pSrc + Position);
+        uint32_t Hash = FDP_ArchiveLzHash(Sequence);
+        uint32_t Reference = aTable[Hash];
+        aTable[Hash] = Position;
+        if (Reference >= Position || Position - Reference > FDP_ARCHIVE_LZ_MAX_OFFSET
+            || FDP_ArchiveRead32(pSrc + Reference) != Sequence)
+        {
+            Position++;
+            continue;
+        }
+        uint32_t MatchLength = FDP_ARCHIVE_LZ_MIN_MATCH;
+        while (Position + MatchLength < SrcSize && pSrc[Reference + MatchLength] == pSrc[Position + MatchLength])
+        {
+            MatchLength++;
+        }
+        pOut = FDP_ArchiveLzWriteSequence(pOut, pSrc + Anchor, Position - Anchor, Position - Reference, MatchLength);
+        Position += MatchLength;
+        Anchor = Position;
+    }
+    pOut = FDP_ArchiveLzWriteSequence(pOut, pSrc + Anchor, SrcSize - Anchor, 0, 0);
+    return (uint32_t)(pOut - pDst);
+}
+
+static bool FDP_ArchiveLzReadLength(const uint8_t *pSrc, uint32_t SrcSize, uint32_t *pPosition, uint32_t *pLength,
+                                    uint32_t MaxLength)
+{
+    uint8_t Value;
+    do
+    {
+        if (*pPosition >= SrcSize)
+        {
+            return false;
+        }
+        Value = pSrc[(*pPosition)++];
+        *pLength += Value;
+        if (*pLength > MaxLength)
+        {
+            return false;
+        }
+    } while (Value == 255);
+    return true;
+}
+
+//Fails on anything that doesn't decompress to exactly DstSize bytes
+static bool FDP_ArchiveDecompress(const uint8_t *pSrc, uint32_t SrcSize, uint8_t *pDst, uint32_t DstSize)
+{
+    uint32_t SrcPosition = 0;
+    uint32_t DstPosition = 0;
+    while (SrcPosition < SrcSize)
+    {
+        uint8_t Token = pSrc[SrcPosition++];
+        uint32_t LiteralLength = Token >> 4;
+        if (LiteralLength == 15
+            && FDP_ArchiveLzReadLength(pSrc, SrcSize, &SrcPosition, &LiteralLength, DstSize) == false)
+        {
+            return false;
+        }
+        if (LiteralLength > SrcSize - SrcPosition || LiteralLength > DstSize - DstPosition)
+        {
+            return false;
+        }
+        memcpy(pDst + DstPosition, pSrc + SrcPosition, LiteralLength);
+        SrcPosition += LiteralLength;
+        DstPosition += LiteralLength;
+        if (SrcPosition == SrcSize)
+        {
+            break;
+        }
+        if (SrcSize - SrcPosition < 2)
+        {
+            return false;
+        }
+        uint32_t Offset = pSrc[SrcPosition] | ((uint32_t)pSrc[SrcPosition + 1] << 8);
+        SrcPosition += 2;
+        uint32_t MatchLength = Token & 0xF;
+        if (MatchLength == 15
+            && FDP_ArchiveLzReadLength(pSrc, SrcSize, &SrcPosition, &MatchLength, DstSize) == false)
+        {
+            return false;
+        }
+        MatchLength += FDP_ARCHIVE_LZ_MIN_MATCH;
+        if (Offset == 0 || Offset > DstPosition || MatchLength > DstSize - DstPosition)
+        {
+            return false;
+        }
+        if (Offset >= MatchLength)
+        {
+            memcpy(pDst + DstPosition, pDst + DstPosition - Offset, MatchLength);
+            DstPosition += MatchLength;
+        }
+        else
+        {
+            //Overlapping copy, repeats the last Offset bytes
+            for (uint32_t i = 0; i < MatchLength; i++, DstPosition++)
+            {
+                pDst[DstPosition] = pDst[DstPosition - Offset];
+            }
+        }
+    }
+    return DstPosition == DstSize;
+}
+
+
+//
+// Index
+//
+static bool FDP_ArchiveCheckHeader(const FDP_ARCHIVE_HEADER *pHeader)
+{
+    return memcmp(pHeader->Magic, FDP_ARCHIVE_MAGIC, sizeof(pHeader->Magic)) == 0
+           && pHeader->Version == FDP_ARCHIVE_VERSION
+           && pHeader->PageSize == FDP_ARCHIVE_PAGE_SIZE
+           && pHeader->BlockPageCount == FDP_ARCHIVE_BLOCK_PAGES;
+}
+
+//The trailer has to be in the file, data past it is what an interrupted writer left
+static bool FDP_ArchiveCheckTrailerOffset(const FDP_ARCHIVE_HEADER *pHeader, uint64_t FileSize)
+{
+    return FileSize >= sizeof(FDP_ARCHIVE_HEADER) + sizeof(FDP_ARCHIVE_TRAILER)
+           && pHeader->TrailerOffset >= sizeof(FDP_ARCHIVE_HEADER)
+           && pHeader->TrailerOffset <= FileSize - sizeof(FDP_ARCHIVE_TRAILER)
+           && pHeader->TrailerOffset % 8 == 0;
+}
+
+//The sections are checked one at a time against the bytes left before the
+//trailer, so that huge counts or offsets can't wrap around
+static bool FDP_ArchiveCheckIndex(const FDP_ARCHIVE_HEADER *pHeader, const FDP_ARCHIVE_TRAILER *pTrailer)
+{
+    if (memcmp(pTrailer->Magic, FDP_ARCHIVE_MAGIC, sizeof(pTrailer->Magic)) != 0
+        || pTrailer->IndexOffset < sizeof(FDP_ARCHIVE_HEADER)
+        || pTrailer->IndexOffset > pHeader->TrailerOffset
+        || pTrailer->IndexOffset % 8 != 0)
+    {
+        return false;
+    }
+    uint64_t RemainingSize = pHeader->TrailerOffset - pTrailer->IndexOffset;
+    if (pTrailer->BlockCount > RemainingSize / sizeof(FDP_ARCHIVE_BLOCK_ENTRY))
+    {
+        return false;
+    }
+    RemainingSize -= pTrailer->BlockCount * sizeof(FDP_ARCHIVE_BLOCK_ENTRY);
+    if (pTrailer->StoredPageCount > RemainingSize / sizeof(uint64_t))
+    {
+        return false;
+    }
+    RemainingSize -= pTrailer->StoredPageCount * sizeof(uint64_t);
+    if (pTrailer->SnapshotCount > RemainingSize / sizeof(FDP_ARCHIVE_SNAPSHOT_ENTRY))
+    {
+        return false;
+    }
+    RemainingSize -= (uint64_t)pTrailer->SnapshotCount * sizeof(FDP_ARCHIVE_SNAPSHOT_ENTRY);
+    return RemainingSize == 0;
+}
+
+//Blocks are sorted and contiguous in page ids, PageId has to be stored
+static uint64_t FDP_ArchiveFindBlock(const FDP_ARCHIVE_BLOCK_ENTRY *pBlocks, uint64_t BlockCount, uint64_t PageId)
+{
+    uint64_t Low = 0;
+    uint64_t High = BlockCount;
+    while (High - Low > 1)
+    {
+        uint64_t Middle = (Low + High) / 2;
+        if (pBlocks[Middle].FirstPageId <= PageId)
+        {
+            Low = Middle;
+        }
+        else
+        {
+            High = Middle;
+        }
+    }
+    return Low;
+}
+
+
+//
+// Writer
+//
+static bool FDP_ArchiveWrite(FDP_ARCHIVE_WRITER *pWriter, const void *pBuffer, uint64_t Size)
+{
+    const uint8_t *pCurrent = (const uint8_t*)pBuffer;
+    while (Size > 0 && pWriter->bFailed == false)
+    {
+        ssize_t WriteCount = write(pWriter->Fd, pCurrent, (size_t)MIN(Size, 1ULL << 30));
+        if (WriteCount <= 0)
+        {
+            pWriter->bFailed = true;
+            break;
+        }
+        pCurrent += WriteCount;
+        Size -= (uint64_t)WriteCount;
+        pWriter->FileOffset += (uint64_t)WriteCount;
+    }
+    return pWriter->bFailed == false;
+}
+
+static bool FDP_ArchiveWriteAlign(FDP_ARCHIVE_WRITER *pWriter)
+{
+    static const uint8_t Padding[8] = { 0 };
+    return FDP_ArchiveWrite(pWriter, Padding, FDP_ARCHIVE_ALIGN(pWriter->FileOffset) - pWriter->FileOffset);
+}
+
+//Grow *ppArray so that it holds at least Count elements
+static bool FDP_ArchiveReserve(void **ppArray, uint64_t *pCapacity, uint64_t Count, size_t ElementSize)
+{
+    if (Count <= *pCapacity)
+    {
+        return true;
+    }
+    uint64_t NewCapacity = *pCapacity ? *pCapacity : 64;
+    while (NewCapacity < Count)
+    {
+        NewCapacity *= 2;
+    }
+    void *pNewArray = realloc(*ppArray, NewCapacity * ElementSize);
+    if (pNewArray == NULL)
+    {
+        return false;
+    }
+    *ppArray = pNewArray;
+    *pCapacity = NewCapacity;
+    return true;
+}
+
+static void FDP_ArchiveHashTableInsert(FDP_ARCHIVE_WRITER *pWriter, uint64_t PageId)
+{
+    uint64_t Mask = pWriter->HashTableSize - 1;
+    uint64_t Slot = pWriter->pPageHashes[PageId] & Mask;
+    while (pWriter->pHashTable[Slot] != 0)
+    {
+        Slot = (Slot + 1) & Mask;
+    }
+    pWriter->pHashTable[Slot] = PageId + 1;
+}
+
+//Keep the table at most half full
+static bool FDP_ArchiveHashTableReserve(FDP_ARCHIVE_WRITER *pWriter, uint64_t PageCount)
+{
+    if (PageCount * 2 <= pWriter->HashTableSize)
+    {
+        return true;
+    }
+    uint64_t NewSize = pWriter->HashTableSize ? pWriter->HashTableSize : 1024;
+    while (PageCount * 2 > NewSize)
+    {
+        NewSize *= 2;
+    }
+    uint64_t *pNewHashTable = (uint64_t*)calloc(NewSize, sizeof(uint64_t));
+    if (pNewHashTable == NULL)
+    {
+        return false;
+    }
+    free(pWriter->pHashTable);
+    pWriter->pHashTable = pNewHashTable;
+    pWriter->HashTableSize = NewSize;
+    for (uint64_t PageId = 0; PageId < pWriter->StoredPageCount; PageId++)
+    {
+        FDP_ArchiveHashTableInsert(pWriter, PageId);
+    }
+    return true;
+}
+
+//Return a stored page, from the pending block or read back from the file
+static const uint8_t* FDP_ArchiveLoadStoredPage(FDP_ARCHIVE_WRITER *pWriter, uint64_t PageId)
+{
+    uint64_t FirstPendingPageId = pWriter->StoredPageCount - pWriter->BlockBufferPageCount;
+    if (PageId >= FirstPendingPageId)
+    {
+        return pWriter->pBlockBuffer + (PageId - FirstPendingPageId) * FDP_ARCHIVE_PAGE_SIZE;
+    }
+    uint64_t BlockIndex = FDP_ArchiveFindBlock(pWriter->pBlocks, pWriter->BlockCount, PageId);
+    const FDP_ARCHIVE_BLOCK_ENTRY *pBlock = &pWriter->pBlocks[BlockIndex];
+    if (pWriter->VerifyBlock != BlockIndex)
+    {
+        uint32_t BlockSize = pBlock->PageCount * FDP_ARCHIVE_PAGE_SIZE;
+        bool bCompressed = pBlock->CompressedSize != BlockSize;
+        uint8_t *pReadBuffer = bCompressed ? pWriter->pCompressBuffer : pWriter->pVerifyBlock;
+        pWriter->VerifyBlock = UINT64_MAX;
+        if (pread(pWriter->Fd, pReadBuffer, pBlock->CompressedSize, (off_t)pBlock->Offset) != (ssize_t)pBlock->CompressedSize
+            || (bCompressed && FDP_ArchiveDecompress(pReadBuffer, pBlock->CompressedSize, pWriter->pVerifyBlock, BlockSize) == false))
+        {
+            return NULL;
+        }
+        pWriter->VerifyBlock = BlockIndex;
+    }
+    return pWriter->pVerifyBlock + (PageId - pBlock->FirstPageId) * FDP_ARCHIVE_PAGE_SIZE;
+}
+
+//xxh64 only picks the candidates, a page is shared when its bytes match.
+//Colliding pages are stored separately under the same hash.
+static bool FDP_ArchiveFindPage(FDP_ARCHIVE_WRITER *pWriter, const uint8_t *pPage, uint64_t PageHash, uint64_t *pPageId)
+{
+    if (pWriter->HashTableSize == 0)
+    {
+        return false;
+    }
+    uint64_t Mask = pWriter->HashTableSize - 1;
+    for (uint64_t Slot = PageHash & Mask; pWriter->pHashTable[Slot] != 0; Slot = (Slot + 1) & Mask)
+    {
+        uint64_t PageId = pWriter->pHashTable[Slot] - 1;
+        if (pWriter->pPageHashes[PageId] != PageHash)
+        {
+            continue;
+        }
+        const uint8_t *pStoredPage = FDP_ArchiveLoadStoredPage(pWriter, PageId);
+        if (pStoredPage != NULL && memcmp(pStoredPage, pPage, FDP_ARCHIVE_PAGE_SIZE) == 0)
+        {
+            *pPageId = PageId;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool FDP_ArchiveFlushBlock(FDP_ARCHIVE_WRITER *pWriter)
+{
+    if (pWriter->BlockBufferPageCount == 0)
+    {
+        return true;
+    }
+    if (FDP_ArchiveReserve((void**)&pWriter->pBlocks, &pWriter->BlockCapacity, pWriter->BlockCount + 1,
+                           sizeof(FDP_ARCHIVE_BLOCK_ENTRY)) == false)
+    {
+        //The buffered pages are already counted as stored, the index can't be written anymore
+        pWriter->bFailed = true;
+        return false;
+    }
+    uint32_t BlockSize = pWriter->BlockBufferPageCount * FDP_ARCHIVE_PAGE_SIZE;
+    uint32_t CompressedSize = FDP_ArchiveCompress(pWriter->pBlockBuffer, BlockSize, pWriter->pCompressBuffer);
+    FDP_ARCHIVE_BLOCK_ENTRY *pBlock = &pWriter->pBlocks[pWriter->BlockCount];
+    pBlock->Offset = pWriter->FileOffset;
+    pBlock->FirstPageId = pWriter->StoredPageCount - pWriter->BlockBufferPageCount;
+    pBlock->PageCount = pWriter->BlockBufferPageCount;
+    bool bReturnValue;
+    if (CompressedSize < BlockSize)
+    {
+        pBlock->CompressedSize = CompressedSize;
+        bReturnValue = FDP_ArchiveWrite(pWriter, pWriter->pCompressBuffer, CompressedSize);
+    }
+    else
+    {
+        pBlock->CompressedSize = BlockSize;
+        bReturnValue = FDP_ArchiveWrite(pWriter, pWriter->pBlockBuffer, BlockSize);
+    }
+    pWriter->BlockCount++;
+    pWriter->BlockBufferPageCount = 0;
+    return bReturnValue;
+}
+
+static bool FDP_ArchiveStorePage(FDP_ARCHIVE_WRITER *pWriter, const uint8_t *pPage, uint64_t PageHash)
+{
+    if (FDP_ArchiveReserve((void**)&pWriter->pPageHashes, &pWriter->PageHashCapacity, pWriter->StoredPageCount + 1,
+                           sizeof(uint64_t)) == false
+        || FDP_ArchiveHashTableReserve(pWriter, pWriter->StoredPageCount + 1) == false)
+    {
+        return false;
+    }
+    pWriter->pPageHashes[pWriter->StoredPageCount] = PageHash;
+    FDP_ArchiveHashTableInsert(pWriter, pWriter->StoredPageCount);
+    pWriter->StoredPageCount++;
+    memcpy(pWriter->pBlockBuffer + (uint64_t)pWriter->BlockBufferPageCount * FDP_ARCHIVE_PAGE_SIZE, pPage,
+           FDP_ARCHIVE_PAGE_SIZE);
+    pWriter->BlockBufferPageCount++;
+    if (pWriter->BlockBufferPageCount == FDP_ARCHIVE_BLOCK_PAGES)
+    {
+        return FDP_ArchiveFlushBlock(pWriter);
+    }
+    return true;
+}
+
+//Load the index of an existing archive, the new data goes after its trailer
+static bool FDP_ArchiveLoadIndex(FDP_ARCHIVE_WRITER *pWriter, uint64_t FileSize)
+{
+    FDP_ARCHIVE_HEADER Header;
+    FDP_ARCHIVE_TRAILER Trailer;
+    if (FileSize < sizeof(Header)
+        || pread(pWriter->Fd, &Header, sizeof(Header), 0) != (ssize_t)sizeof(Header)
+        || FDP_ArchiveCheckHeader(&Header) == false)
+    {
+        return false;
+    }
+    pWriter->Header = Header;
+    if (Header.TrailerOffset == 0)
+    {
+        //Nothing was ever closed, nothing to keep
+        pWriter->FileOffset = sizeof(Header);
+        return ftruncate(pWriter->Fd, (off_t)pWriter->FileOffset) == 0
+               && lseek(pWriter->Fd, (off_t)pWriter->FileOffset, SEEK_SET) != (off_t)-1;
+    }
+    if (FDP_ArchiveCheckTrailerOffset(&Header, FileSize) == false
+        || pread(pWriter->Fd, &Trailer, sizeof(Trailer), (off_t)Header.TrailerOffset) != (ssize_t)sizeof(Trailer)
+        || FDP_ArchiveCheckIndex(&Header, &Trailer) == false)
+    {
+        return false;
+    }
+    uint64_t BlocksSize = Trailer.BlockCount * sizeof(FDP_ARCHIVE_BLOCK_ENTRY);
+    uint64_t PageHashesSize = Trailer.StoredPageCount * sizeof(uint64_t);
+    uint64_t SnapshotsSize = (uint64_t)Trailer.SnapshotCount * sizeof(FDP_ARCHIVE_SNAPSHOT_ENTRY);
+    if (FDP_ArchiveReserve((void**)&pWriter->pBlocks, &pWriter->BlockCapacity, Trailer.BlockCount,
+                           sizeof(FDP_ARCHIVE_BLOCK_ENTRY)) == false
+        || FDP_ArchiveReserve((void**)&pWriter->pPageHashes, &pWriter->PageHashCapacity, Trailer.StoredPageCount,
+                              sizeof(uint64_t)) == false)
+    {
+        return false;
+    }
+    uint64_t SnapshotCapacity = pWriter->SnapshotCapacity;
+    if (FDP_ArchiveReserve((void**)&pWriter->pSnapshots, &SnapshotCapacity, Trailer.SnapshotCount,
+                           sizeof(FDP_ARCHIVE_SNAPSHOT_ENTRY)) == false)
+    {
+        return false;
+    }
+    pWriter->SnapshotCapacity = (uint32_t)SnapshotCapacity;
+    if (pread(pWriter->Fd, pWriter->pBlocks, BlocksSize, (off_t)Trailer.IndexOffset) != (ssize_t)BlocksSize
+        || pread(pWriter->Fd, pWriter->pPageHashes, PageHashesSize, (off_t)(Trailer.IndexOffset + BlocksSize)) != (ssize_t)PageHashesSize
+        || pread(pWriter->Fd, pWriter->pSnapshots, SnapshotsSize,
+                 (off_t)(Trailer.IndexOffset + BlocksSize + PageHashesSize)) != (ssize_t)SnapshotsSize)
+    {
+        return false;
+    }
+    pWriter->BlockCount = Trailer.BlockCount;
+    pWriter->StoredPageCount = Trailer.StoredPageCount;
+    pWriter->SnapshotCount = Trailer.SnapshotCount;
+    //Allocating the table inserts the stored pages
+    if (FDP_ArchiveHashTableReserve(pWriter, pWriter->StoredPageCount) == false)
+    {
+        return false;
+    }
+    //Only drops what an interrupted writer left past the trailer
+    pWriter->FileOffset = Header.TrailerOffset + sizeof(Trailer);
+    return ftruncate(pWriter->Fd, (off_t)pWriter->FileOffset) == 0
+           && lseek(pWriter->Fd, (off_t)pWriter->FileOffset, SEEK_SET) != (off_t)-1;
+}
+
+static void FDP_ArchiveFreeWriter(FDP_ARCHIVE_WRITER *pWriter)
+{
+    if (pWriter->Fd != -1)
+    {
+        close(pWriter->Fd);
+    }
+    free(pWriter->pBlocks);
+    free(pWriter->pPageHashes);
+    free(pWriter->pSnapshots);
+    free(pWriter->pHashTable);
+    free(pWriter->pBlockBuffer);
+    free(pWriter->pCompressBuffer);
+    free(pWriter->pVerifyBlock);
+    free(pWriter);
+}
+
+FDP_EXPORTED
+FDP_ARCHIVE_WRITER* FDP_ArchiveOpenWriter(const char *pFilePath)
+{
+    if (pFilePath == NULL)
+    {
+        return NULL;
+    }
+    FDP_ARCHIVE_WRITER *pWriter = (FDP_ARCHIVE_WRITER*)calloc(1, sizeof(FDP_ARCHIVE_WRITER));
+    if (pWriter == NULL)
+    {
+        return NULL;
+    }
+    pWriter->pBlockBuffer = (uint8_t*)malloc(FDP_ARCHIVE_BLOCK_SIZE);
+    pWriter->pCompressBuffer = (uint8_t*)malloc(FDP_ARCHIVE_COMPRESS_BOUND);
+    pWriter->pVerifyBlock = (uint8_t*)malloc(FDP_ARCHIVE_BLOCK_SIZE);
+    pWriter->Fd = open(pFilePath, O_RDWR | O_CREAT, 0644);
+    struct stat FileStat;
+    if (pWriter->pBlockBuffer == NULL || pWriter->pCompressBuffer == NULL || pWriter->pVerifyBlock == NULL
+        || pWriter->Fd == -1
+        || fstat(pWriter->Fd, &FileStat) == -1)
+    {
+        FDP_ArchiveFreeWriter(pWriter);
+        return NULL;
+    }
+    pWriter->VerifyBlock = UINT64_MAX;
+
+    bool bSuccess;
+    if (FileStat.st_size == 0)
+    {
+        FDP_ARCHIVE_HEADER *pHeader = &pWriter->Header;
+        memcpy(pHeader->Magic, FDP_ARCHIVE_MAGIC, sizeof(pHeader->Magic));
+        pHeader->Version = FDP_ARCHIVE_VERSION;
+        pHeader->PageSize = FDP_ARCHIVE_PAGE_SIZE;
+        pHeader->BlockPageCount = FDP_ARCHIVE_BLOCK_PAGES;
+        bSuccess = FDP_ArchiveWrite(pWriter, pHeader, sizeof(FDP_ARCHIVE_HEADER));
+    }
+    else
+    {
+        bSuccess = FDP_ArchiveLoadIndex(pWriter, (uint64_t)FileStat.st_size);
+    }
+    if (bSuccess == false)
+    {
+        FDP_ArchiveFreeWriter(pWriter);
+        return NULL;
+    }
+    return pWriter;
+}
+
+static bool FDP_ArchiveReadCpu(FDP_SHM *pFDP, uint32_t CpuId, FDP_ARCHIVE_CPU_ENTRY *pCpu)
+{
+    uint64_t AllRegisters = FDP_REGISTER_MASK(FDP_ARCHIVE_REGISTER_COUNT) - 1;
+    if (FDP_ReadRegisters(pFDP, CpuId, AllRegisters, pCpu->RegisterValues) == true)
+    {
+        pCpu->ValidMask = AllRegisters;
+        return true;
+    }
+    //Some backends lack a register or two
+    pCpu->ValidMask = 0;
+    for (uint32_t RegisterId = 0; RegisterId < FDP_ARCHIVE_REGISTER_COUNT; RegisterId++)
+    {
+        pCpu->RegisterValues[RegisterId] = 0;
+        if (FDP_ReadRegister(pFDP, CpuId, (FDP_Register)RegisterId, &pCpu->RegisterValues[RegisterId]) == true)
+        {
+            pCpu->ValidMask |= FDP_REGISTER_MASK(RegisterId);
+        }
+    }
+    return pCpu->ValidMask != 0;
+}
+
+__inline static bool FDP_ArchiveIsZeroPage(const uint8_t *pPage)
+{
+    uint64_t Acc = 0;
+    for (uint32_t i = 0; i < FDP_ARCHIVE_PAGE_SIZE; i += sizeof(uint64_t))
+    {
+        uint64_t Value;
+        memcpy(&Value, pPage + i, sizeof(Value));
+        Acc |= Value;
+    }
+    return Acc == 0;
+}
+
+//Fill the page map of a batch. Every page is read, deduplication compares bytes.
+static bool FDP_ArchiveWriteBatch(FDP_ARCHIVE_WRITER *pWriter, FDP_SHM *pFDP, uint8_t *pReadBuffer, uint64_t FirstPage,
+                                  uint32_t PageCount, uint64_t *pPageMap, FDP_ARCHIVE_SNAPSHOT_ENTRY *pSnapshot)
+{
+    bool bBatchRead = FDP_ReadPhysicalMemory(pFDP, pReadBuffer, PageCount * FDP_ARCHIVE_PAGE_SIZE,
+                                             FirstPage * FDP_ARCHIVE_PAGE_SIZE);
+    uint32_t i;
+    for (i = 0; i < PageCount; i++)
+    {
+        uint8_t *pPage = pReadBuffer + (uint64_t)i * FDP_ARCHIVE_PAGE_SIZE;
+        //Slow path, MMIO holes and the like
+        if (bBatchRead == false
+            && FDP_ReadPhysicalMemory(pFDP, pPage, FDP_ARCHIVE_PAGE_SIZE, (FirstPage + i) * FDP_ARCHIVE_PAGE_SIZE) == false)
+        {
+            pPageMap[i] = FDP_ARCHIVE_UNREADABLE_PAGE;
+            continue;
+        }
+        if (FDP_ArchiveIsZeroPage(pPage) == true)
+        {
+            pPageMap[i] = FDP_ARCHIVE_ZERO_PAGE;
+            continue;
+        }
+        uint64_t PageHash = FDP_HashBuffer(FDP_HASH_XXH64, pPage, FDP_ARCHIVE_PAGE_SIZE);
+        if (FDP_ArchiveFindPage(pWriter, pPage, PageHash, &pPageMap[i]) == true)
+        {
+            continue;
+        }
+        pPageMap[i] = pWriter->StoredPageCount;
+        if (FDP_ArchiveStorePage(pWriter, pPage, PageHash) == false)
+        {
+            return false;
+        }
+        pSnapshot->NewPageCount++;
+    }
+
+    for (i = 0; i < PageCount; i++)
+    {
+        pSnapshot->ZeroPageCount += pPageMap[i] == FDP_ARCHIVE_ZERO_PAGE;
+        pSnapshot->UnreadablePageCount += pPageMap[i] == FDP_ARCHIVE_UNREADABLE_PAGE;
+    }
+    return true;
+}
+
+//The guest is paused while its memory is read
+FDP_EXPORTED
+bool FDP_ArchiveWriteSnapshot(FDP_ARCHIVE_WRITER *pWriter, FDP_SHM *pFDP, const char *pName)
+{
+    if (pWriter == NULL || pFDP == NULL || pName == NULL || pName[0] == '\0'
+        || strlen(pName) >= FDP_ARCHIVE_MAX_NAME_SIZE || pWriter->bFailed == true)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < pWriter->SnapshotCount; i++)
+    {
+        if (strcmp(pWriter->pSnapshots[i].Name, pName) == 0)
+        {
+            return false;
+        }
+    }
+    uint64_t SnapshotCapacity = pWriter->SnapshotCapacity;
+    if (FDP_ArchiveReserve((void**)&pWriter->pSnapshots, &SnapshotCapacity, (uint64_t)pWriter->SnapshotCount + 1,
+                           sizeof(FDP_ARCHIVE_SNAPSHOT_ENTRY)) == false)
+    {
+        return false;
+    }
+    pWriter->SnapshotCapacity = (uint32_t)SnapshotCapacity;
+
+    FDP_State State;
+    uint64_t PhysicalMemorySize;
+    uint32_t CpuCount;
+    if (FDP_GetState(pFDP, &State) == false
+        || FDP_GetPhysicalMemorySize(pFDP, &PhysicalMemorySize) == false
+        || FDP_GetCpuCount(pFDP, &CpuCount) == false)
+    {
+        return false;
+    }
+    bool bPaused = (State & FDP_STATE_PAUSED) == 0;
+    if (bPaused == true && FDP_Pause(pFDP) == false)
+    {
+        return false;
+    }
+
+    FDP_ARCHIVE_SNAPSHOT_ENTRY Snapshot;
+    memset(&Snapshot, 0, sizeof(Snapshot));
+    strcpy(Snapshot.Name, pName);
+    Snapshot.Timestamp = (uint64_t)time(NULL);
+    Snapshot.PageCount = PhysicalMemorySize / FDP_ARCHIVE_PAGE_SIZE;
+    Snapshot.CpuCount = CpuCount;
+    bool bReturnValue = false;
+    uint64_t *pPageMap = (uint64_t*)malloc(Snapshot.PageCount * sizeof(uint64_t) + 1);
+    uint8_t *pReadBuffer = (uint8_t*)malloc(FDP_ARCHIVE_BATCH_PAGES * FDP_ARCHIVE_PAGE_SIZE);
+    FDP_ARCHIVE_CPU_ENTRY *pCpus = (FDP_ARCHIVE_CPU_ENTRY*)calloc(CpuCount + 1, sizeof(FDP_ARCHIVE_CPU_ENTRY));
+    if (pPageMap == NULL || pReadBuffer == NULL || pCpus == NULL)
+    {
+        goto Exit;
+    }
+    for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++)
+    {
+        if (FDP_ArchiveReadCpu(pFDP, CpuId, &pCpus[CpuId]) == false)
+        {
+            goto Exit;
+        }
+    }
+    for (uint64_t BatchPage = 0; BatchPage < Snapshot.PageCount; BatchPage += FDP_ARCHIVE_BATCH_PAGES)
+    {
+        uint32_t PageCount = (uint32_t)MIN(FDP_ARCHIVE_BATCH_PAGES, Snapshot.PageCount - BatchPage);
+        if (FDP_ArchiveWriteBatch(pWriter, pFDP, pReadBuffer, BatchPage, PageCount, pPageMap + BatchPage, &Snapshot) == false)
+        {
+            goto Exit;
+        }
+    }
+    //Page maps and CPU records sit between blocks, the pages they use may still be buffered
+    if (FDP_ArchiveWriteAlign(pWriter) == false)
+    {
+        goto Exit;
+    }
+    Snapshot.MapOffset = pWriter->FileOffset;
+    if (FDP_ArchiveWrite(pWriter, pPageMap, Snapshot.PageCount * sizeof(uint64_t)) == false)
+    {
+        goto Exit;
+    }
+    Snapshot.CpuOffset = pWriter->FileOffset;
+    if (FDP_ArchiveWrite(pWriter, pCpus, (uint64_t)CpuCount * sizeof(FDP_ARCHIVE_CPU_ENTRY)) == false)
+    {
+        goto Exit;
+    }
+    pWriter->pSnapshots[pWriter->SnapshotCount++] = Snapshot;
+    bReturnValue = true;
+
+Exit:
+    free(pPageMap);
+    free(pReadBuffer);
+    free(pCpus);
+    if (bPaused == true)
+    {
+        FDP_Resume(pFDP);
+    }
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_ArchiveCloseWriter(FDP_ARCHIVE_WRITER *pWriter)
+{
+    if (pWriter == NULL)
+    {
+        return false;
+    }
+    //The header still points to the previous index, leave it there if anything of the new one is missing
+    if (pWriter->bFailed == true
+        || FDP_ArchiveFlushBlock(pWriter) == false
+        || FDP_ArchiveWriteAlign(pWriter) == false)
+    {
+        FDP_ArchiveFreeWriter(pWriter);
+        return false;
+    }
+    FDP_ARCHIVE_TRAILER Trailer;
+    memset(&Trailer, 0, sizeof(Trailer));
+    Trailer.IndexOffset = pWriter->FileOffset;
+    Trailer.BlockCount = pWriter->BlockCount;
+    Trailer.StoredPageCount = pWriter->StoredPageCount;
+    Trailer.SnapshotCount = pWriter->SnapshotCount;
+    memcpy(Trailer.Magic, FDP_ARCHIVE_MAGIC, sizeof(Trailer.Magic));
+    bool bReturnValue = FDP_ArchiveWrite(pWriter, pWriter->pBlocks, pWriter->BlockCount * sizeof(FDP_ARCHIVE_BLOCK_ENTRY))
+                        && FDP_ArchiveWrite(pWriter, pWriter->pPageHashes, pWriter->StoredPageCount * sizeof(uint64_t))
+                        && FDP_ArchiveWrite(pWriter, pWriter->pSnapshots,
+                                            (uint64_t)pWriter->SnapshotCount * sizeof(FDP_ARCHIVE_SNAPSHOT_ENTRY));
+    pWriter->Header.TrailerOffset = pWriter->FileOffset;
+    bReturnValue = bReturnValue && FDP_ArchiveWrite(pWriter, &Trailer, sizeof(Trailer));
+    //The header moves to the new index once the index is on disk
+    bReturnValue = bReturnValue
+                   && fsync(pWriter->Fd) == 0
+                   && pwrite(pWriter->Fd, &pWriter->Header, sizeof(FDP_ARCHIVE_HEADER), 0) == (ssize_t)sizeof(FDP_ARCHIVE_HEADER)
+                   && fsync(pWriter->Fd) == 0;
+    FDP_ArchiveFreeWriter(pWriter);
+    return bReturnValue;
+}
+
+
+//
+// Reader
+//
+FDP_EXPORTED
+FDP_ARCHIVE* FDP_ArchiveOpen(const char *pFilePath)
+{
+    int Fd = open(pFilePath, O_RDONLY);
+    if (Fd == -1)
+    {
+        return NULL;
+    }
+    struct stat FileStat;
+    if (fstat(Fd, &FileStat) == -1
+        || (uint64_t)FileStat.st_size < sizeof(FDP_ARCHIVE_HEADER) + sizeof(FDP_ARCHIVE_TRAILER))
+    {
+        close(Fd);
+        return NULL;
+    }
+    void *pData = mmap(NULL, (size_t)FileStat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+    close(Fd);
+    if (pData == MAP_FAILED)
+    {
+        return NULL;
+    }
+    FDP_ARCHIVE *pArchive = (FDP_ARCHIVE*)calloc(1, sizeof(FDP_ARCHIVE));
+    if (pArchive == NULL)
+    {
+        munmap(pData, (size_t)FileStat.st_size);
+        return NULL;
+    }
+    pArchive->pData = (const uint8_t*)pData;
+    pArchive->Size = (uint64_t)FileStat.st_size;
+
+    uint64_t PageId = 0;
+    const FDP_ARCHIVE_HEADER *pHeader = (const FDP_ARCHIVE_HEADER*)pArchive->pData;
+    const FDP_ARCHIVE_TRAILER *pTrailer = NULL;
+    if (FDP_ArchiveCheckHeader(pHeader) == false || FDP_ArchiveCheckTrailerOffset(pHeader, pArchive->Size) == false)
+    {
+        goto Fail;
+    }
+    pTrailer = (const FDP_ARCHIVE_TRAILER*)(pArchive->pData + pHeader->TrailerOffset);
+    if (FDP_ArchiveCheckIndex(pHeader, pTrailer) == false)
+    {
+        goto Fail;
+    }
+    pArchive->pBlocks = (const FDP_ARCHIVE_BLOCK_ENTRY*)(pArchive->pData + pTrailer->IndexOffset);
+    pArchive->BlockCount = pTrailer->BlockCount;
+    pArchive->StoredPageCount = pTrailer->StoredPageCount;
+    pArchive->pSnapshots = (const FDP_ARCHIVE_SNAPSHOT_ENTRY*)(pArchive->pData + pTrailer->IndexOffset
+                                                                + pTrailer->BlockCount * sizeof(FDP_ARCHIVE_BLOCK_ENTRY)
+                                                                + pTrailer->StoredPageCount * sizeof(uint64_t));
+    pArchive->SnapshotCount = pTrailer->SnapshotCount;
+    pArchive->CachedBlock = pArchive->BlockCount;
+
+    //Everything referenced from the index has to be inside the file
+    for (uint64_t i = 0; i < pArchive->BlockCount; i++)
+    {
+        const FDP_ARCHIVE_BLOCK_ENTRY *pBlock = &pArchive->pBlocks[i];
+        if (pBlock->FirstPageId != PageId || pBlock->PageCount == 0 || pBlock->PageCount > FDP_ARCHIVE_BLOCK_PAGES
+            || pBlock->CompressedSize > pBlock->PageCount * FDP_ARCHIVE_PAGE_SIZE
+            || pBlock->Offset > pTrailer->IndexOffset || pBlock->CompressedSize > pTrailer->IndexOffset - pBlock->Offset)
+        {
+            goto Fail;
+        }
+        PageId += pBlock->PageCount;
+    }
+    if (PageId != pArchive->StoredPageCount)
+    {
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < pArchive->SnapshotCount; i++)
+    {
+        const FDP_ARCHIVE_SNAPSHOT_ENTRY *pSnapshot = &pArchive->pSnapshots[i];
+        if (memchr(pSnapshot->Name, '\0', sizeof(pSnapshot->Name)) == NULL
+            || pSnapshot->MapOffset % 8 != 0 || pSnapshot->CpuOffset % 8 != 0
+            || pSnapshot->PageCount > pTrailer->IndexOffset / sizeof(uint64_t)
+            || pSnapshot->MapOffset > pTrailer->IndexOffset - pSnapshot->PageCount * sizeof(uint64_t)
+            || pSnapshot->CpuCount > pTrailer->IndexOffset / sizeof(FDP_ARCHIVE_CPU_ENTRY)
+            || pSnapshot->CpuOffset > pTrailer->IndexOffset - (uint64_t)pSnapshot->CpuCount * sizeof(FDP_ARCHIVE_CPU_ENTRY))
+        {
+            goto Fail;
+        }
+    }
+    return pArchive;
+
+Fail:
+    FDP_ArchiveClose(pArchive);
+    return NULL;
+}
+
+FDP_EXPORTED
+void FDP_ArchiveClose(FDP_ARCHIVE *pArchive)
+{
+    if (pArchive == NULL)
+    {
+        return;
+    }
+    munmap((void*)pArchive->pData, (size_t)pArchive->Size);
+    free(pArchive->pBlockCache);
+    free(pArchive);
+}
+
+FDP_EXPORTED
+uint32_t FDP_ArchiveGetSnapshotCount(FDP_ARCHIVE *pArchive)
+{
+    if (pArchive == NULL)
+    {
+        return 0;
+    }
+    return pArchive->SnapshotCount;
+}
+
+FDP_EXPORTED
+uint64_t FDP_ArchiveGetStoredPageCount(FDP_ARCHIVE *pArchive)
+{
+    if (pArchive == NULL)
+    {
+        return 0;
+    }
+    return pArchive->StoredPageCount;
+}
+
+//Return the snapshot index, -1 if not found
+FDP_EXPORTED
+int FDP_ArchiveFindSnapshot(FDP_ARCHIVE *pArchive, const char *pName)
+{
+    if (pArchive == NULL || pName == NULL)
+    {
+        return -1;
+    }
+    for (uint32_t i = 0; i < pArchive->SnapshotCount; i++)
+    {
+        if (strcmp(pArchive->pSnapshots[i].Name, pName) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+FDP_EXPORTED
+bool FDP_ArchiveGetSnapshotInfo(FDP_ARCHIVE *pArchive, uint32_t SnapshotIndex, FDP_ARCHIVE_SNAPSHOT_INFO *pInfo)
+{
+    if (pArchive == NULL || pInfo == NULL || SnapshotIndex >= pArchive->SnapshotCount)
+    {
+        return false;
+    }
+    const FDP_ARCHIVE_SNAPSHOT_ENTRY *pSnapshot = &pArchive->pSnapshots[SnapshotIndex];
+    memset(pInfo, 0, sizeof(FDP_ARCHIVE_SNAPSHOT_INFO));
+    strcpy(pInfo->Name, pSnapshot->Name);
+    pInfo->Timestamp = pSnapshot->Timestamp;
+    pInfo->PageCount = pSnapshot->PageCount;
+    pInfo->NewPageCount = pSnapshot->NewPageCount;
+    pInfo->ZeroPageCount = pSnapshot->ZeroPageCount;
+    pInfo->UnreadablePageCount = pSnapshot->UnreadablePageCount;
+    pInfo->CpuCount = pSnapshot->CpuCount;
+    return true;
+}
+
+//Return the stored page, straight from the mapping for uncompressed blocks.
+//Compressed blocks are decompressed one at a time into the archive cache.
+static const uint8_t* FDP_ArchiveGetPage(FDP_ARCHIVE *pArchive, uint64_t PageId)
+{
+    if (PageId >= pArchive->StoredPageCount)
+    {
+        return NULL;
+    }
+    uint64_t Low = FDP_ArchiveFindBlock(pArchive->pBlocks, pArchive->BlockCount, PageId);
+    const FDP_ARCHIVE_BLOCK_ENTRY *pBlock = &pArchive->pBlocks[Low];
+    uint64_t PageOffset = (PageId - pBlock->FirstPageId) * FDP_ARCHIVE_PAGE_SIZE;
+    if (pBlock->CompressedSize == pBlock->PageCount * FDP_ARCHIVE_PAGE_SIZE)
+    {
+        return pArchive->pData + pBlock->Offset + PageOffset;
+    }
+    if (pArchive->CachedBlock != Low)
+    {
+        if (pArchive->pBlockCache == NULL)
+        {
+            pArchive->pBlockCache = (uint8_t*)malloc(FDP_ARCHIVE_BLOCK_SIZE);
+            if (pArchive->pBlockCache == NULL)
+            {
+                return NULL;
+            }
+        }
+        pArchive->CachedBlock = pArchive->BlockCount;
+        if (FDP_ArchiveDecompress(pArchive->pData + pBlock->Offset, pBlock->CompressedSize, pArchive->pBlockCache,
+                                  pBlock->PageCount * FDP_ARCHIVE_PAGE_SIZE) == false)
+        {
+            return NULL;
+        }
+        pArchive->CachedBlock = Low;
+    }
+    return pArchive->pBlockCache + PageOffset;
+}
+
+//Fails on pages that were unreadable when the snapshot was written
+FDP_EXPORTED
+bool FDP_ArchiveReadPhysicalMemory(FDP_ARCHIVE *pArchive, uint32_t SnapshotIndex, uint8_t *pDstBuffer, uint32_t ReadSize,
+                                   uint64_t PhysicalAddress)
+{
+    if (pArchive == NULL || pDstBuffer == NULL || SnapshotIndex >= pArchive->SnapshotCount)
+    {
+        return false;
+    }
+    const FDP_ARCHIVE_SNAPSHOT_ENTRY *pSnapshot = &pArchive->pSnapshots[SnapshotIndex];
+    const uint64_t *pPageMap = (const uint64_t*)(pArchive->pData + pSnapshot->MapOffset);
+    if (PhysicalAddress > pSnapshot->PageCount * FDP_ARCHIVE_PAGE_SIZE
+        || ReadSize > pSnapshot->PageCount * FDP_ARCHIVE_PAGE_SIZE - PhysicalAddress)
+    {
+        return false;
+    }
+    uint32_t CurrentOffset = 0;
+    while (CurrentOffset < ReadSize)
+    {
+        uint64_t CurrentAddress = PhysicalAddress + CurrentOffset;
+        uint32_t PageOffset = (uint32_t)(CurrentAddress % FDP_ARCHIVE_PAGE_SIZE);
+        uint32_t CopySize = MIN(ReadSize - CurrentOffset, FDP_ARCHIVE_PAGE_SIZE - PageOffset);
+        uint64_t PageId = pPageMap[CurrentAddress / FDP_ARCHIVE_PAGE_SIZE];
+        if (PageId == FDP_ARCHIVE_ZERO_PAGE)
+        {
+            memset(pDstBuffer + CurrentOffset, 0, CopySize);
+        }
+        else
+        {
+            const uint8_t *pPage = FDP_ArchiveGetPage(pArchive, PageId);
+            if (pPage == NULL)
+            {
+                return false;
+            }
+            memcpy(pDstBuffer + CurrentOffset, pPage + PageOffset, CopySize);
+        }
+        CurrentOffset += CopySize;
+    }
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_ArchiveReadRegister(FDP_ARCHIVE *pArchive, uint32_t SnapshotIndex, uint32_t CpuId, FDP_Register RegisterId,
+                             uint64_t *pRegisterValue)
+{
+    if (pArchive == NULL || pRegisterValue == NULL || SnapshotIndex >= pArchive->SnapshotCount
+        || RegisterId >= FDP_ARCHIVE_REGISTER_COUNT)
+    {
+        return false;
+    }
+    const FDP_ARCHIVE_SNAPSHOT_ENTRY *pSnapshot = &pArchive->pSnapshots[SnapshotIndex];
+    if (CpuId >= pSnapshot->CpuCount)
+    {
+        return false;
+    }
+    const FDP_ARCHIVE_CPU_ENTRY *pCpu = (const FDP_ARCHIVE_CPU_ENTRY*)(pArchive->pData + pSnapshot->CpuOffset) + CpuId;
+    if ((pCpu->ValidMask & FDP_REGISTER_MASK(RegisterId)) == 0)
+    {
+        return false;
+    }
+    *pRegisterValue = pCpu->RegisterValues[RegisterId];
+    return true;
+}
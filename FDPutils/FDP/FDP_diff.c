@@ -0,0 +1,653 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "FDP.h"
+#include "FDP_diff.h"
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+#define FDP_DIFF_BATCH_PAGES    256     //Pages read per source access (1MB)
+
+enum
+{
+    FDP_DIFF_SOURCE_LIVE,
+    FDP_DIFF_SOURCE_FILE,
+    FDP_DIFF_SOURCE_MAPPED,
+    FDP_DIFF_SOURCE_BUFFER
+};
+
+struct FDP_DIFF_SOURCE_
+{
+    int             Type;
+    FDP_SHM         *pFDP;
+    int             Fd;
+    const uint8_t   *pData;     //MAPPED and BUFFER sources
+    uint64_t        Size;
+};
+
+enum
+{
+    FDP_DIFF_MODE_COMPARE,          //pOld against pNew
+    FDP_DIFF_MODE_HASH,             //pOld into pOutHashes
+    FDP_DIFF_MODE_COMPARE_HASHES    //pOldHashes against pNew
+};
+
+typedef struct FDP_DIFF_WORKER_
+{
+    pthread_t           Thread;
+    int                 Mode;
+    uint32_t            Flags;
+    FDP_DIFF_SOURCE     *pOld;
+    FDP_DIFF_SOURCE     *pNew;
+    const uint64_t      *pOldHashes;
+    uint64_t            *pOutHashes;
+    uint64_t            FirstPage;
+    uint64_t            EndPage;
+    FDP_DIFF_RESULT     Result;
+    uint64_t            RangeCapacity;
+    bool                bSuccess;
+} FDP_DIFF_WORKER;
+
+
+FDP_EXPORTED
+uint64_t FDP_DiffHashPage(const uint8_t *pPage)
+{
+    return FDP_HashBuffer(FDP_HASH_XXH64, pPage, FDP_DIFF_PAGE_SIZE);
+}
+
+
+//
+// Sources
+//
+static FDP_DIFF_SOURCE* FDP_DiffAllocSource(int Type)
+{
+    FDP_DIFF_SOURCE *pSource = (FDP_DIFF_SOURCE*)calloc(1, sizeof(FDP_DIFF_SOURCE));
+    if (pSource == NULL)
+    {
+        return NULL;
+    }
+    pSource->Type = Type;
+    pSource->Fd = -1;
+    return pSource;
+}
+
+FDP_EXPORTED
+FDP_DIFF_SOURCE* FDP_DiffOpenLive(FDP_SHM *pFDP)
+{
+    if (pFDP == NULL)
+    {
+        return NULL;
+    }
+    uint64_t PhysicalMemorySize = 0;
+    if (FDP_GetPhysicalMemorySize(pFDP, &PhysicalMemorySize) == false)
+    {
+        return NULL;
+    }
+    FDP_DIFF_SOURCE *pSource = FDP_DiffAllocSource(FDP_DIFF_SOURCE_LIVE);
+    if (pSource == NULL)
+    {
+        return NULL;
+    }
+    pSource->pFDP = pFDP;
+    pSource->Size = PhysicalMemorySize;
+    return pSource;
+}
+
+FDP_EXPORTED
+FDP_DIFF_SOURCE* FDP_DiffOpenFile(const char *pFilePath)
+{
+    int Fd = open(pFilePath, O_RDONLY);
+    if (Fd == -1)
+    {
+        return NULL;
+    }
+    struct stat FileStat;
+    if (fstat(Fd, &FileStat) == -1)
+    {
+        close(Fd);
+        return NULL;
+    }
+    FDP_DIFF_SOURCE *pSource = FDP_DiffAllocSource(FDP_DIFF_SOURCE_FILE);
+    if (pSource == NULL)
+    {
+        close(Fd);
+        return NULL;
+    }
+    pSource->Fd = Fd;
+    pSource->Size = (uint64_t)FileStat.st_size;
+    return pSource;
+}
+
+FDP_EXPORTED
+FDP_DIFF_SOURCE* FDP_DiffMapFile(const char *pFilePath)
+{
+    int Fd = open(pFilePath, O_RDONLY);
+    if (Fd == -1)
+    {
+        return NULL;
+    }
+    struct stat FileStat;
+    if (fstat(Fd, &FileStat) == -1 || FileStat.st_size == 0)
+    {
+        close(Fd);
+        return NULL;
+    }
+    void *pData = mmap(NULL, (size_t)FileStat.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+    close(Fd);
+    if (pData == MAP_FAILED)
+    {
+        return NULL;
+    }
+    FDP_DIFF_SOURCE *pSource = FDP_DiffAllocSource(FDP_DIFF_SOURCE_MAPPED);
+    if (pSource == NULL)
+    {
+        munmap(pData, (size_t)FileStat.st_size);
+        return NULL;
+    }
+    pSource->pData = (const uint8_t*)pData;
+    pSource->Size = (uint64_t)FileStat.st_size;
+    return pSource;
+}
+
+FDP_EXPORTED
+FDP_DIFF_SOURCE* FDP_DiffOpenBuffer(const void *pBuffer, uint64_t BufferSize)
+{
+    if (pBuffer == NULL)
+    {
+        return NULL;
+    }
+    FDP_DIFF_SOURCE *pSource = FDP_DiffAllocSource(FDP_DIFF_SOURCE_BUFFER);
+    if (pSource == NULL)
+    {
+        return NULL;
+    }
+    pSource->pData = (const uint8_t*)pBuffer;
+    pSource->Size = BufferSize;
+    return pSource;
+}
+
+FDP_EXPORTED
+void FDP_DiffCloseSource(FDP_DIFF_SOURCE *pSource)
+{
+    if (pSource == NULL)
+    {
+        return;
+    }
+    if (pSource->Type == FDP_DIFF_SOURCE_FILE)
+    {
+        close(pSource->Fd);
+    }
+    else if (pSource->Type == FDP_DIFF_SOURCE_MAPPED)
+    {
+        munmap((void*)pSource->pData, (size_t)pSource->Size);
+    }
+    free(pSource);
+}
+
+FDP_EXPORTED
+uint64_t FDP_DiffGetSourceSize(FDP_DIFF_SOURCE *pSource)
+{
+    if (pSource == NULL)
+    {
+        return 0;
+    }
+    return pSource->Size;
+}
+
+FDP_EXPORTED
+bool FDP_DiffReadSource(FDP_DIFF_SOURCE *pSource, uint8_t *pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress)
+{
+    if (pSource == NULL || PhysicalAddress + ReadSize > pSource->Size)
+    {
+        return false;
+    }
+    switch (pSource->Type)
+    {
+    case FDP_DIFF_SOURCE_LIVE:
+        return FDP_ReadPhysicalMemory(pSource->pFDP, pDstBuffer, ReadSize, PhysicalAddress);
+    case FDP_DIFF_SOURCE_FILE:
+    {
+        uint32_t CurrentOffset = 0;
+        while (CurrentOffset < ReadSize)
+        {
+            ssize_t ReadCount = pread(pSource->Fd, pDstBuffer + CurrentOffset, ReadSize - CurrentOffset,
+                                      (off_t)(PhysicalAddress + CurrentOffset));
+            if (ReadCount <= 0)
+            {
+                return false;
+            }
+            CurrentOffset += (uint32_t)ReadCount;
+        }
+        return true;
+    }
+    case FDP_DIFF_SOURCE_MAPPED:
+    case FDP_DIFF_SOURCE_BUFFER:
+        memcpy(pDstBuffer, pSource->pData + PhysicalAddress, ReadSize);
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+//Return a pointer to PageCount pages starting at FirstPage, either directly in
+//the source mapping or read into pBuffer. Unreadable pages are zero-filled.
+static const uint8_t* FDP_DiffGetPages(FDP_DIFF_SOURCE *pSource, uint8_t *pBuffer, uint64_t FirstPage,
+                                       uint32_t PageCount, uint64_t *pUnreadablePageCount)
+{
+    uint64_t PhysicalAddress = FirstPage * FDP_DIFF_PAGE_SIZE;
+    if (pSource->Type == FDP_DIFF_SOURCE_MAPPED || pSource->Type == FDP_DIFF_SOURCE_BUFFER)
+    {
+        return pSource->pData + PhysicalAddress;
+    }
+    if (FDP_DiffReadSource(pSource, pBuffer, PageCount * FDP_DIFF_PAGE_SIZE, PhysicalAddress) == true)
+    {
+        return pBuffer;
+    }
+    //Slow path, MMIO holes and the like
+    for (uint32_t i = 0; i < PageCount; i++)
+    {
+        uint8_t *pPage = pBuffer + (uint64_t)i * FDP_DIFF_PAGE_SIZE;
+        if (FDP_DiffReadSource(pSource, pPage, FDP_DIFF_PAGE_SIZE, PhysicalAddress + (uint64_t)i * FDP_DIFF_PAGE_SIZE) == false)
+        {
+            memset(pPage, 0, FDP_DIFF_PAGE_SIZE);
+            (*pUnreadablePageCount)++;
+        }
+    }
+    return pBuffer;
+}
+
+
+//Hash PageCount pages starting at FirstPage. Live sources are hashed by the
+//server so only the hashes cross the channel.
+static bool FDP_DiffGetPageHashes(FDP_DIFF_SOURCE *pSource, uint8_t *pBuffer, uint64_t FirstPage, uint32_t PageCount,
+                                  uint64_t *pPageHashes, uint64_t *pUnreadablePageCount)
+{
+    if (pSource->Type == FDP_DIFF_SOURCE_LIVE)
+    {
+        if (FDP_HashPhysicalPages(pSource->pFDP, FDP_HASH_XXH64, FirstPage * FDP_DIFF_PAGE_SIZE, PageCount, pPageHashes) == false)
+        {
+            return false;
+        }
+        //Same as the zero-filled pages of the other sources
+        for (uint32_t i = 0; i < PageCount; i++)
+        {
+            if (pPageHashes[i] == FDP_HASH_UNREADABLE_PAGE)
+            {
+                memset(pBuffer, 0, FDP_DIFF_PAGE_SIZE);
+                pPageHashes[i] = FDP_DiffHashPage(pBuffer);
+                (*pUnreadablePageCount)++;
+            }
+        }
+        return true;
+    }
+    const uint8_t *pPages = FDP_DiffGetPages(pSource, pBuffer, FirstPage, PageCount, pUnreadablePageCount);
+    for (uint32_t i = 0; i < PageCount; i++)
+    {
+        pPageHashes[i] = FDP_DiffHashPage(pPages + (uint64_t)i * FDP_DIFF_PAGE_SIZE);
+    }
+    return true;
+}
+
+//
+// Comparison
+//
+__inline static bool FDP_DiffPageEqual(const uint8_t *pOld, const uint8_t *pNew)
+{
+#ifdef __SSE2__
+    for (uint32_t i = 0; i < FDP_DIFF_PAGE_SIZE; i += 256)
+    {
+        __m128i Acc = _mm_setzero_si128();
+        for (uint32_t j = i; j < i + 256; j += 64)
+        {
+            __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pOld + j)), _mm_loadu_si128((const __m128i*)(pNew + j)));
+            __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pOld + j + 16)), _mm_loadu_si128((const __m128i*)(pNew + j + 16)));
+            __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pOld + j + 32)), _mm_loadu_si128((const __m128i*)(pNew + j + 32)));
+            __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pOld + j + 48)), _mm_loadu_si128((const __m128i*)(pNew + j + 48)));
+            Acc = _mm_or_si128(Acc, _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3)));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(Acc, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+    }
+    return true;
+#else
+    for (uint32_t i = 0; i < FDP_DIFF_PAGE_SIZE; i += 64)
+    {
+        uint64_t a[8], b[8];
+        memcpy(a, pOld + i, sizeof(a));
+        memcpy(b, pNew + i, sizeof(b));
+        uint64_t Acc = 0;
+        for (int j = 0; j < 8; j++)
+        {
+            Acc |= a[j] ^ b[j];
+        }
+        if (Acc != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+static bool FDP_DiffAddRange(FDP_DIFF_RESULT *pResult, uint64_t *pRangeCapacity, uint64_t PhysicalAddress, uint64_t Size)
+{
+    if (pResult->RangeCount > 0)
+    {
+        FDP_DIFF_RANGE *pLast = &pResult->pRanges[pResult->RangeCount - 1];
+        if (pLast->PhysicalAddress + pLast->Size == PhysicalAddress)
+        {
+            pLast->Size += Size;
+            return true;
+        }
+    }
+    if (pResult->RangeCount == *pRangeCapacity)
+    {
+        uint64_t NewCapacity = *pRangeCapacity ? *pRangeCapacity * 2 : 64;
+        FDP_DIFF_RANGE *pNewRanges = (FDP_DIFF_RANGE*)realloc(pResult->pRanges, NewCapacity * sizeof(FDP_DIFF_RANGE));
+        if (pNewRanges == NULL)
+        {
+            return false;
+        }
+        pResult->pRanges = pNewRanges;
+        *pRangeCapacity = NewCapacity;
+    }
+    pResult->pRanges[pResult->RangeCount].PhysicalAddress = PhysicalAddress;
+    pResult->pRanges[pResult->RangeCount].Size = Size;
+    pResult->RangeCount++;
+    return true;
+}
+
+static bool FDP_DiffAddByteRanges(FDP_DIFF_WORKER *pWorker, const uint8_t *pOld, const uint8_t *pNew, uint64_t PageAddress)
+{
+    uint32_t i = 0;
+    while (i < FDP_DIFF_PAGE_SIZE)
+    {
+#ifdef __SSE2__
+        //Skip identical 16-byte blocks
+        while (i + 16 <= FDP_DIFF_PAGE_SIZE)
+        {
+            int EqualMask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pOld + i)),
+                                                             _mm_loadu_si128((const __m128i*)(pNew + i))));
+            if (EqualMask != 0xFFFF)
+            {
+                i += __builtin_ctz(~EqualMask & 0xFFFF);
+                break;
+            }
+            i += 16;
+        }
+#endif
+        while (i < FDP_DIFF_PAGE_SIZE && pOld[i] == pNew[i])
+        {
+            i++;
+        }
+        if (i >= FDP_DIFF_PAGE_SIZE)
+        {
+            break;
+        }
+        uint32_t RunStart = i;
+        while (i < FDP_DIFF_PAGE_SIZE && pOld[i] != pNew[i])
+        {
+            i++;
+        }
+        if (FDP_DiffAddRange(&pWorker->Result, &pWorker->RangeCapacity, PageAddress + RunStart, i - RunStart) == false)
+        {
+            return false;
+        }
+        pWorker->Result.ChangedByteCount += i - RunStart;
+    }
+    return true;
+}
+
+static void* FDP_DiffWorker(void *lpParameter)
+{
+    FDP_DIFF_WORKER *pWorker = (FDP_DIFF_WORKER*)lpParameter;
+    uint8_t *pOldBuffer = (uint8_t*)malloc(FDP_DIFF_BATCH_PAGES * FDP_DIFF_PAGE_SIZE);
+    uint8_t *pNewBuffer = (uint8_t*)malloc(FDP_DIFF_BATCH_PAGES * FDP_DIFF_PAGE_SIZE);
+    if (pOldBuffer == NULL || pNewBuffer == NULL)
+    {
+        goto Exit;
+    }
+
+    for (uint64_t BatchPage = pWorker->FirstPage; BatchPage < pWorker->EndPage; BatchPage += FDP_DIFF_BATCH_PAGES)
+    {
+        uint32_t PageCount = (uint32_t)MIN(FDP_DIFF_BATCH_PAGES, pWorker->EndPage - BatchPage);
+        const uint8_t *pOldPages = NULL;
+        const uint8_t *pNewPages = NULL;
+        uint64_t NewHashes[FDP_DIFF_BATCH_PAGES];
+        if (pWorker->Mode == FDP_DIFF_MODE_HASH)
+        {
+            if (FDP_DiffGetPageHashes(pWorker->pOld, pOldBuffer, BatchPage, PageCount, pWorker->pOutHashes + BatchPage,
+                                      &pWorker->Result.UnreadablePageCount) == false)
+            {
+                goto Exit;
+            }
+            pWorker->Result.ComparedPageCount += PageCount;
+            continue;
+        }
+        if (pWorker->Mode == FDP_DIFF_MODE_COMPARE_HASHES)
+        {
+            if (FDP_DiffGetPageHashes(pWorker->pNew, pNewBuffer, BatchPage, PageCount, NewHashes,
+                                      &pWorker->Result.UnreadablePageCount) == false)
+            {
+                goto Exit;
+            }
+        }
+        else
+        {
+            pOldPages = FDP_DiffGetPages(pWorker->pOld, pOldBuffer, BatchPage, PageCount, &pWorker->Result.UnreadablePageCount);
+            pNewPages = FDP_DiffGetPages(pWorker->pNew, pNewBuffer, BatchPage, PageCount, &pWorker->Result.UnreadablePageCount);
+        }
+
+        for (uint32_t i = 0; i < PageCount; i++)
+        {
+            uint64_t Page = BatchPage + i;
+            uint64_t PageOffset = (uint64_t)i * FDP_DIFF_PAGE_SIZE;
+            bool bChanged = false;
+            if (pWorker->Mode == FDP_DIFF_MODE_COMPARE_HASHES)
+            {
+                bChanged = pWorker->pOldHashes[Page] != NewHashes[i];
+            }
+            else
+            {
+                bChanged = FDP_DiffPageEqual(pOldPages + PageOffset, pNewPages + PageOffset) == false;
+            }
+            pWorker->Result.ComparedPageCount++;
+            if (bChanged == false)
+            {
+                continue;
+            }
+            pWorker->Result.ChangedPageCount++;
+            if (pWorker->Mode == FDP_DIFF_MODE_COMPARE && (pWorker->Flags & FDP_DIFF_BYTE_GRANULARITY))
+            {
+                if (FDP_DiffAddByteRanges(pWorker, pOldPages + PageOffset, pNewPages + PageOffset, Page * FDP_DIFF_PAGE_SIZE) == false)
+                {
+                    goto Exit;
+                }
+            }
+            else
+            {
+                if (FDP_DiffAddRange(&pWorker->Result, &pWorker->RangeCapacity, Page * FDP_DIFF_PAGE_SIZE, FDP_DIFF_PAGE_SIZE) == false)
+                {
+                    goto Exit;
+                }
+            }
+        }
+    }
+    pWorker->bSuccess = true;
+
+Exit:
+    free(pOldBuffer);
+    free(pNewBuffer);
+    return NULL;
+}
+
+static bool FDP_DiffRun(int Mode, FDP_DIFF_SOURCE *pOld, FDP_DIFF_SOURCE *pNew, const uint64_t *pOldHashes,
+                        uint64_t *pOutHashes, uint64_t PageCount, uint32_t Flags, uint32_t ThreadCount,
+                        FDP_DIFF_RESULT *pResult)
+{
+    if (ThreadCount == FDP_DIFF_DEFAULT_THREADS)
+    {
+        long OnlineCpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+        ThreadCount = OnlineCpuCount > 0 ? (uint32_t)OnlineCpuCount : 1;
+    }
+    //No point in having threads with less than one batch to do
+    uint64_t BatchCount = (PageCount + FDP_DIFF_BATCH_PAGES - 1) / FDP_DIFF_BATCH_PAGES;
+    if (ThreadCount > BatchCount)
+    {
+        ThreadCount = BatchCount > 0 ? (uint32_t)BatchCount : 1;
+    }
+
+    FDP_DIFF_WORKER *pWorkers = (FDP_DIFF_WORKER*)calloc(ThreadCount, sizeof(FDP_DIFF_WORKER));
+    if (pWorkers == NULL)
+    {
+        return false;
+    }
+    //Contiguous stripes, batch aligned, so that ranges come out sorted
+    uint64_t BatchesPerThread = (BatchCount + ThreadCount - 1) / ThreadCount;
+    for (uint32_t i = 0; i < ThreadCount; i++)
+    {
+        FDP_DIFF_WORKER *pWorker = &pWorkers[i];
+        pWorker->Mode = Mode;
+        pWorker->Flags = Flags;
+        pWorker->pOld = pOld;
+        pWorker->pNew = pNew;
+        pWorker->pOldHashes = pOldHashes;
+        pWorker->pOutHashes = pOutHashes;
+        pWorker->FirstPage = MIN(PageCount, i * BatchesPerThread * FDP_DIFF_BATCH_PAGES);
+        pWorker->EndPage = MIN(PageCount, (i + 1) * BatchesPerThread * FDP_DIFF_BATCH_PAGES);
+    }
+
+    uint32_t StartedCount = 0;
+    for (uint32_t i = 1; i < ThreadCount; i++)
+    {
+        if (pthread_create(&pWorkers[i].Thread, NULL, FDP_DiffWorker, &pWorkers[i]) != 0)
+        {
+            break;
+        }
+        StartedCount++;
+    }
+    FDP_DiffWorker(&pWorkers[0]);
+    //Threads that failed to start are run inline
+    for (uint32_t i = StartedCount + 1; i < ThreadCount; i++)
+    {
+        FDP_DiffWorker(&pWorkers[i]);
+    }
+    for (uint32_t i = 1; i <= StartedCount; i++)
+    {
+        pthread_join(pWorkers[i].Thread, NULL);
+    }
+
+    bool bReturnValue = true;
+    uint64_t RangeCapacity = 0;
+    memset(pResult, 0, sizeof(FDP_DIFF_RESULT));
+    for (uint32_t i = 0; i < ThreadCount; i++)
+    {
+        FDP_DIFF_WORKER *pWorker = &pWorkers[i];
+        bReturnValue &= pWorker->bSuccess;
+        for (uint64_t j = 0; j < pWorker->Result.RangeCount && bReturnValue; j++)
+        {
+            bReturnValue = FDP_DiffAddRange(pResult, &RangeCapacity, pWorker->Result.pRanges[j].PhysicalAddress,
+                                            pWorker->Result.pRanges[j].Size);
+        }
+        pResult->ComparedPageCount += pWorker->Result.ComparedPageCount;
+        pResult->ChangedPageCount += pWorker->Result.ChangedPageCount;
+        pResult->ChangedByteCount += pWorker->Result.ChangedByteCount;
+        pResult->UnreadablePageCount += pWorker->Result.UnreadablePageCount;
+        free(pWorker->Result.pRanges);
+    }
+    free(pWorkers);
+    if (bReturnValue == false)
+    {
+        FDP_DiffFreeResult(pResult);
+    }
+    return bReturnValue;
+}
+
+FDP_EXPORTED
+bool FDP_DiffCompare(FDP_DIFF_SOURCE *pOldSource, FDP_DIFF_SOURCE *pNewSource, uint32_t Flags, uint32_t ThreadCount,
+                     FDP_DIFF_RESULT *pResult)
+{
+    if (pOldSource == NULL || pNewSource == NULL || pResult == NULL)
+    {
+        return false;
+    }
+    uint64_t OldPageCount = pOldSource->Size / FDP_DIFF_PAGE_SIZE;
+    uint64_t NewPageCount = pNewSource->Size / FDP_DIFF_PAGE_SIZE;
+    uint64_t PageCount = MIN(OldPageCount, NewPageCount);
+    if (FDP_DiffRun(FDP_DIFF_MODE_COMPARE, pOldSource, pNewSource, NULL, NULL, PageCount, Flags, ThreadCount, pResult) == false)
+    {
+        return false;
+    }
+    //Memory only present on one side has changed as a whole
+    uint64_t TailPageCount = (OldPageCount > NewPageCount ? OldPageCount : NewPageCount) - PageCount;
+    if (TailPageCount > 0)
+    {
+        uint64_t RangeCapacity = pResult->RangeCount;
+        if (FDP_DiffAddRange(pResult, &RangeCapacity, PageCount * FDP_DIFF_PAGE_SIZE, TailPageCount * FDP_DIFF_PAGE_SIZE) == false)
+        {
+            FDP_DiffFreeResult(pResult);
+            return false;
+        }
+        pResult->ChangedPageCount += TailPageCount;
+        if (Flags & FDP_DIFF_BYTE_GRANULARITY)
+        {
+            pResult->ChangedByteCount += TailPageCount * FDP_DIFF_PAGE_SIZE;
+        }
+    }
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_DiffComputePageHashes(FDP_DIFF_SOURCE *pSource, uint64_t *pPageHashes, uint64_t PageCount, uint32_t ThreadCount)
+{
+    if (pSource == NULL || pPageHashes == NULL || PageCount > pSource->Size / FDP_DIFF_PAGE_SIZE)
+    {
+        return false;
+    }
+    FDP_DIFF_RESULT Result;
+    if (FDP_DiffRun(FDP_DIFF_MODE_HASH, pSource, NULL, NULL, pPageHashes, PageCount, 0, ThreadCount, &Result) == false)
+    {
+        return false;
+    }
+    FDP_DiffFreeResult(&Result);
+    return true;
+}
+
+FDP_EXPORTED
+bool FDP_DiffCompareHashes(const uint64_t *pOldPageHashes, uint64_t PageCount, FDP_DIFF_SOURCE *pNewSource,
+                           uint32_t ThreadCount, FDP_DIFF_RESULT *pResult)
+{
+    if (pOldPageHashes == NULL || pNewSource == NULL || pResult == NULL || PageCount > pNewSource->Size / FDP_DIFF_PAGE_SIZE)
+    {
+        return false;
+    }
+    return FDP_DiffRun(FDP_DIFF_MODE_COMPARE_HASHES, NULL, pNewSource, pOldPageHashes, NULL, PageCount,
+                       FDP_DIFF_PAGE_GRANULARITY, ThreadCount, pResult);
+}
+
+FDP_EXPORTED
+void FDP_DiffFreeResult(FDP_DIFF_RESULT *pResult)
+{
+    if (pResult == NULL)
+    {
+        return;
+    }
+    free(pResult->pRanges);
+    memset(pResult, 0, sizeof(FDP_DIFF_RESULT));
+}
@@ -71,8 +71,384 @@ extern "C" {
 
 #define    FDP_MAX_BREAKPOINT 255
 
+#define    FDP_INVALID_BREAKPOINT_HANDLE   0
+#define    FDP_MAX_BREAKPOINT_HANDLES      ((1 << 20) - 1)     //Execute breakpoints of FDP_AddExecuteBreakpoint
+
+#define    FDP_COVERAGE_MAX_BLOCKS         FDP_MAX_BREAKPOINT_HANDLES
+#define    FDP_COVERAGE_MAX_RANGES         128     //Backend page breakpoints of the coverage, blocks are grouped in physical ranges
+
+#define    FDP_MAX_REGISTER_MASK_COUNT     64      //FDP_Register ids that fit in a register mask
+#define    FDP_REGISTER_MASK(RegisterId)   (1ULL << (RegisterId))
+
+#define    FDP_SWAP_MAX_SIZE   16
+
+#define    FDP_HIT_LOG_MAX_REGISTERS   6       //Registers a tracepoint can save in each FDP_HIT_RECORD
+#define    FDP_HIT_LOG_DEFAULT_RECORD_COUNT    65536
+
+    enum FDP_TracepointFlags_
+    {
+        FDP_TRACEPOINT_LOG = 0x1,       //Append a FDP_HIT_RECORD to the hit log at each hit
+        FDP_TRACEPOINT_STOP = 0x2,      //Stop the VM after logging, like a regular breakpoint
+    };
+
+#define    FDP_HIT_RECORD_WATCHPOINT   (1ULL << 62)    //RegisterMask of records written by watchpoints
+
+    //RegisterValues of a watchpoint FDP_HIT_RECORD, all 0 when the backend can't tell the access
+    enum FDP_WatchpointRecord_
+    {
+        FDP_WATCHPOINT_RECORD_ADDRESS = 0,  //Linear address of the access
+        FDP_WATCHPOINT_RECORD_SIZE = 1,     //Bytes accessed, 0 when unknown
+        FDP_WATCHPOINT_RECORD_ACCESS = 2,   //FDP_Access of the access
+    };
+
+#define    FDP_MAX_AGGREGATIONS            16
+#define    FDP_AGGREGATION_MAX_KEYS        65536   //Hits on new keys are dropped once an aggregation has MaxKeyCount keys
+
+    //Key of the hits counted by an aggregation
+    enum FDP_AggregationKey_
+    {
+        FDP_AGGREGATE_BREAKPOINT_ID = 0x0,
+        FDP_AGGREGATE_RIP = 0x1,
+        FDP_AGGREGATE_CR3 = 0x2,
+        FDP_AGGREGATE_RETURN_ADDRESS = 0x3,     //uint64_t at [RSP + StackOffset], the return address at a function entry with 0
+    };
+
+#define    FDP_MAX_SNAPSHOTS               32
+#define    FDP_SNAPSHOT_MAX_NAME_SIZE      64      //Including the terminating 0
+#define    FDP_SNAPSHOT_DEVICE_STATE       0x1     //The backend saved the devices, the snapshot restores after the guest ran
+
+#define    FDP_MAX_BREAKPOINT_CONDITIONS   8   //Conditions of a breakpoint, all of them must hold
+
+    enum FDP_ConditionOperand_
+    {
+        FDP_CONDITION_REGISTER = 0x0,   //Value of RegisterId
+        FDP_CONDITION_MEMORY = 0x1,     //Size bytes of virtual memory at [RegisterId + Offset]
+    };
+
+    //Unsigned comparisons of (Operand & Mask) with Value
+    enum FDP_ConditionOperator_
+    {
+        FDP_CONDITION_EQ = 0x0,
+        FDP_CONDITION_NE = 0x1,
+        FDP_CONDITION_LT = 0x2,
+        FDP_CONDITION_LE = 0x3,
+        FDP_CONDITION_GT = 0x4,
+        FDP_CONDITION_GE = 0x5,
+    };
+
+#define    FDP_MAX_PROGRAMS                64
+#define    FDP_PROGRAM_MAX_INSTRUCTIONS    512
+#define    FDP_PROGRAM_MAX_STEPS           65536   //Instructions executed per run, bounds loops
+#define    FDP_PROGRAM_REGISTER_COUNT      11      //r0 result, r1-r5 helper arguments (clobbered by calls), r6-r10
+#define    FDP_PROGRAM_MAP_SIZE            256     //uint64_t slots in the map of each program
+#define    FDP_PROGRAM_MAX_STRING_SIZE     256
+#define    FDP_HIT_RECORD_PROGRAM_OUTPUT   (1ULL << 63)    //RegisterMask of records written by FDP_HELPER_OUTPUT
+
+    //A run starts with r1 = CpuId, r2 = BreakpointId and ends on FDP_OP_EXIT, the VM stops if r0 != 0
+    enum FDP_ProgramOpcode_
+    {
+        //Dst = Dst op Src, or Dst op Imm with FDP_OP_IMM
+        FDP_OP_MOV = 0x00,
+        FDP_OP_ADD = 0x01,
+        FDP_OP_SUB = 0x02,
+        FDP_OP_MUL = 0x03,
+        FDP_OP_DIV = 0x04,      //Unsigned, x / 0 = 0
+        FDP_OP_MOD = 0x05,      //Unsigned, x % 0 = x
+        FDP_OP_AND = 0x06,
+        FDP_OP_OR = 0x07,
+        FDP_OP_XOR = 0x08,
+        FDP_OP_LSH = 0x09,      //Shift counts are taken modulo 64
+        FDP_OP_RSH = 0x0A,
+        FDP_OP_NEG = 0x0B,      //Dst = -Dst
+        //Next instruction is Offset instructions further when Dst op Src (or Imm) holds, unsigned
+        FDP_OP_JA = 0x10,       //Always
+        FDP_OP_JEQ = 0x11,
+        FDP_OP_JNE = 0x12,
+        FDP_OP_JLT = 0x13,
+        FDP_OP_JLE = 0x14,
+        FDP_OP_JGT = 0x15,
+        FDP_OP_JGE = 0x16,
+        FDP_OP_JSET = 0x17,     //Dst & Src != 0
+        FDP_OP_CALL = 0x20,     //r0 = helper Imm (FDP_ProgramHelper)
+        FDP_OP_EXIT = 0x21,
+        FDP_OP_IMM = 0x80,
+    };
+
+    enum FDP_ProgramHelper_
+    {
+        FDP_HELPER_READ_REGISTER = 0x0,     //r0 = FDP_Register r1, r1 = 1 on success
+        FDP_HELPER_READ_MEMORY = 0x1,       //r0 = r2 (1, 2, 4 or 8) bytes at virtual address r1, r1 = 1 on success
+        FDP_HELPER_HASH_STRING = 0x2,       //r0 = FNV-1a of the string at r1, at most r2 bytes, r1 = 1 on success
+        FDP_HELPER_MAP_LOOKUP = 0x3,        //r0 = map[r1], 0 out of range
+        FDP_HELPER_MAP_UPDATE = 0x4,        //map[r1] = r2, r0 = 1 on success
+        FDP_HELPER_MAP_ADD = 0x5,           //map[r1] += r2 atomically, r0 = the new value
+        FDP_HELPER_OUTPUT = 0x6,            //Append r1-r5 to the hit log, r0 = 1 on success
+        FDP_HELPER_GET_TIMESTAMP = 0x7,     //r0 = host monotonic clock, in nanoseconds
+    };
+
+    enum FDP_SwapStatus_
+    {
+        FDP_SWAP_FAILED = 0x0,      //Memory couldn't be read or written
+        FDP_SWAP_DONE = 0x1,        //New bytes written, Old holds the previous content
+        FDP_SWAP_MISMATCH = 0x2,    //bCompare was set and memory didn't match Expected, nothing written
+    };
+
+    enum FDP_WalkListFlags_
+    {
+        FDP_WALK_LIST_SKIP_HEAD = 0x1,      //HeadAddress is a list head, not an element (e.g. PsActiveProcessHead)
+        FDP_WALK_LIST_HEAD_POINTER = 0x2,   //HeadAddress holds a pointer to the first element (e.g. LIST_HEAD lh_first)
+        FDP_WALK_LIST_POINTER32 = 0x4,      //Next pointers are 32-bit
+    };
+
+    enum FDP_MsrStatus_
+    {
+        FDP_MSR_FAILED = 0x0,       //MSR unknown to the CPU, access refused or CpuId out of range
+        FDP_MSR_DONE = 0x1,         //Value read or written
+    };
+
+    enum FDP_WalkListEnd_
+    {
+        FDP_WALK_LIST_END_HEAD = 0x0,       //Back to the head or the first element
+        FDP_WALK_LIST_END_NULL = 0x1,       //NULL next pointer
+        FDP_WALK_LIST_END_MAX_COUNT = 0x2,  //MaxCount elements read, or the reply was full
+        FDP_WALK_LIST_END_READ_ERROR = 0x3, //An element or a next pointer couldn't be read
+    };
+
+    enum FDP_StepEnd_
+    {
+        FDP_STEP_END_COUNT = 0x0,           //StepCount steps made
+        FDP_STEP_END_CONDITION = 0x1,       //All the stop conditions held after the last step
+        FDP_STEP_END_ERROR = 0x2,           //The CPU couldn't be stepped or its registers read
+    };
+
+#define    FDP_MAX_INSTRUCTION_SIZE    15      //Longest x86 instruction, in bytes
+
+    //Stop predicates of FDP_StepUntil, checked after each step
+    enum FDP_StepUntilFlags_
+    {
+        FDP_STEP_UNTIL_RIP_INSIDE = 0x1,    //RIP in [RangeStart, RangeEnd)
+        FDP_STEP_UNTIL_RIP_OUTSIDE = 0x2,   //RIP out of [RangeStart, RangeEnd)
+        FDP_STEP_UNTIL_CR3_CHANGE = 0x4,    //CR3 differs from its value before the first step
+        FDP_STEP_UNTIL_BRANCH = 0x8,        //RIP went backwards or more than FDP_MAX_INSTRUCTION_SIZE bytes forward, rep-prefixed
+                                            //instructions and interrupt entries included
+        FDP_STEP_UNTIL_RETURN = 0x10,       //A RET (or a step to the return address read at RSP before the first step) left RSP
+                                            //above its value before the first step
+        FDP_STEP_UNTIL_ALL = 0x1F,
+    };
+
+    typedef struct FDP_SWAP_ENTRY_
+    {
+        uint64_t    Address;
+        uint32_t    Size;                       //1 to FDP_SWAP_MAX_SIZE
+        uint8_t     bCompare;                   //Only write if memory matches Expected
+        uint8_t     Status;                     //FDP_SwapStatus, filled on return
+        uint16_t    Reserved;
+        uint8_t     Expected[FDP_SWAP_MAX_SIZE];
+        uint8_t     New[FDP_SWAP_MAX_SIZE];
+        uint8_t     Old[FDP_SWAP_MAX_SIZE];     //Filled on return
+    } FDP_SWAP_ENTRY;
+
+    typedef struct FDP_MSR_ENTRY_
+    {
+        uint32_t    CpuId;
+        uint32_t    Status;                     //FDP_MsrStatus, filled on return
+        uint64_t    MsrId;
+        uint64_t    Value;                      //Written value, or filled on return for reads
+    } FDP_MSR_ENTRY;
+
+    typedef struct FDP_BREAKPOINT_ENTRY_
+    {
+        uint32_t            CpuId;
+        int32_t             BreakpointId;       //Requested id, -1 for any. Filled on return, -1 if the breakpoint couldn't be set
+        FDP_BreakpointType  BreakpointType;
+        FDP_Access          BreakpointAccessType;
+        FDP_AddressType     BreakpointAddressType;
+        uint16_t            Reserved;
+        uint64_t            BreakpointAddress;
+        uint64_t            BreakpointLength;
+        uint64_t            BreakpointCr3;
+    } FDP_BREAKPOINT_ENTRY;
+
+    typedef struct FDP_CPU_STATE_ENTRY_
+    {
+        uint8_t     State;                      //FDP_State bits of this CPU
+        uint8_t     Reserved[3];
+        int32_t     BreakpointId;               //Breakpoint that stopped this CPU, -1 if none or unknown
+        uint64_t    Rip;                        //Registers are only read while the CPU is paused, 0 otherwise
+        uint64_t    Rsp;
+        uint64_t    Cr3;
+    } FDP_CPU_STATE_ENTRY;
+
+    typedef struct FDP_STEP_UNTIL_RESULT_
+    {
+        uint32_t            StepCount;          //Steps made
+        uint32_t            EndReason;          //FDP_StepEnd
+        uint32_t            StopFlags;          //FDP_StepUntilFlags that held after the last step
+        uint32_t            Reserved;
+        FDP_CPU_STATE_ENTRY CpuState;           //After the last step
+    } FDP_STEP_UNTIL_RESULT;
+
+    typedef struct FDP_BREAKPOINT_CONDITION_
+    {
+        uint8_t     Operand;                    //FDP_ConditionOperand
+        uint8_t     Operator;                   //FDP_ConditionOperator
+        uint8_t     Size;                       //FDP_CONDITION_MEMORY size: 1, 2, 4 or 8
+        uint8_t     Reserved;
+        uint32_t    RegisterId;                 //FDP_Register, compared or used as the memory base
+        int64_t     Offset;                     //FDP_CONDITION_MEMORY only
+        uint64_t    Mask;                       //Applied to the operand before the comparison
+        uint64_t    Value;
+    } FDP_BREAKPOINT_CONDITION;
+
+    typedef struct FDP_PROGRAM_INSTRUCTION_
+    {
+        uint8_t     Opcode;                     //FDP_ProgramOpcode
+        uint8_t     Dst;                        //Register index
+        uint8_t     Src;                        //Register index, unused with FDP_OP_IMM
+        uint8_t     Reserved;
+        int32_t     Offset;                     //Jump distance from the next instruction
+        int64_t     Imm;
+    } FDP_PROGRAM_INSTRUCTION;
+
+    typedef struct FDP_HIT_RECORD_
+    {
+        uint64_t    Timestamp;                  //Host monotonic clock, in nanoseconds
+        uint64_t    Rip;
+        uint64_t    Cr3;
+        uint32_t    CpuId;
+        int32_t     BreakpointId;
+        uint64_t    RegisterMask;               //Registers saved in RegisterValues, lowest register first
+        uint64_t    RegisterValues[FDP_HIT_LOG_MAX_REGISTERS];
+    } FDP_HIT_RECORD;
+
+    typedef struct FDP_AGGREGATION_ENTRY_
+    {
+        uint64_t    Key;
+        uint64_t    Count;
+    } FDP_AGGREGATION_ENTRY;
+
+    typedef struct FDP_SNAPSHOT_INFO_
+    {
+        char        Name[FDP_SNAPSHOT_MAX_NAME_SIZE];
+        uint64_t    Timestamp;                  //Host monotonic clock at save, in nanoseconds
+        uint64_t    PageCount;                  //Guest physical pages
+        uint64_t    PrivatePageCount;           //Pages not shared with another snapshot, freed by FDP_DeleteSnapshot
+        uint64_t    LastRestorePageCount;       //Pages written back by the last FDP_RestoreSnapshot of this snapshot
+        uint64_t    Flags;                      //FDP_SNAPSHOT_DEVICE_STATE
+    } FDP_SNAPSHOT_INFO;
+
+#define    FDP_XSAVE_AREA_SIZE         2696    //Standard (non compacted) XSAVE layout, up to PKRU
+#define    FDP_XSAVE_HEADER_OFFSET     512     //XSTATE_BV, set to the components returned
+
+    //XSAVE state components, bit n is component n as in XCR0
+    enum FDP_XStateComponent_
+    {
+        FDP_XSTATE_X87 = 0x1,
+        FDP_XSTATE_SSE = 0x2,               //XMM0-15 and MXCSR
+        FDP_XSTATE_AVX = 0x4,               //Upper halves of YMM0-15
+        FDP_XSTATE_BNDREGS = 0x8,
+        FDP_XSTATE_BNDCSR = 0x10,
+        FDP_XSTATE_OPMASK = 0x20,           //k0-k7
+        FDP_XSTATE_ZMM_HI256 = 0x40,        //Upper halves of ZMM0-15
+        FDP_XSTATE_HI16_ZMM = 0x80,         //ZMM16-31
+        FDP_XSTATE_PKRU = 0x200,
+        FDP_XSTATE_ALL = 0x2FF,
+    };
+
+#define    FDP_HASH_PAGE_SIZE          4096
+#define    FDP_HASH_UNREADABLE_PAGE    0xFFFFFFFFFFFFFFFFULL   //Per-page hash of a page that couldn't be read
+
+
+#pragma pack(push, 1)
+    typedef struct FDP_CPU_CTX_
+    {
+        uint64_t        rip;
+
+        uint64_t        rax;
+        uint64_t        rcx;
+        uint64_t        rdx;
+        uint64_t        rbx;
+
+        uint64_t        rsp;
+        uint64_t        rbp;
+        uint64_t        rsi;
+        uint64_t        rdi;
+        uint64_t        r8;
+        uint64_t        r9;
+        uint64_t        r10;
+        uint64_t        r11;
+        uint64_t        r12;
+        uint64_t        r13;
+        uint64_t        r14;
+        uint64_t        r15;
+
+        uint64_t        es;
+        uint64_t        cs;
+        uint64_t        ss;
+        uint64_t        ds;
+        uint64_t        fs;
+        uint64_t        gs;
+
+        uint64_t        rflags;
+
+        uint64_t        cr0;
+        uint64_t        cr2;
+        uint64_t        cr3;
+        uint64_t        cr4;
+        uint64_t        cr8;
+
+        uint64_t        dr0;
+        uint64_t        dr1;
+        uint64_t        dr2;
+        uint64_t        dr3;
+        uint64_t        dr6;
+        uint64_t        dr7;
+
+        uint64_t        gdtrb;
+        uint64_t        gdtrl;
+        uint64_t        idtrb;
+        uint64_t        idtrl;
+
+        volatile uint64_t   Valid;  //Every field is up to date, set by the server while the vCPU is paused
+        volatile uint64_t   Sequence;   //Odd while a writer updates the context, see FDP_GetCpuContext
+    }FDP_CPU_CTX;
+#pragma pack(pop)
 
     typedef __attribute((aligned(1))) struct FDP_SHM_ FDP_SHM;
+    typedef struct FDP_READAHEAD_ FDP_READAHEAD;
+    typedef struct FDP_REGISTER_CACHE_ FDP_REGISTER_CACHE;
+    typedef struct FDP_XSTATE_CACHE_ FDP_XSTATE_CACHE;
+    typedef struct FDP_HIT_LOG_ FDP_HIT_LOG;
+    typedef struct FDP_BREAKPOINT_ACTIONS_ FDP_BREAKPOINT_ACTIONS;
+    typedef struct FDP_BREAKPOINT_TABLE_ FDP_BREAKPOINT_TABLE;
+    typedef struct FDP_SNAPSHOT_STORE_ FDP_SNAPSHOT_STORE;
+
+    typedef struct FDP_READAHEAD_STATS_
+    {
+        uint64_t    ReadCount;              //Virtual reads that went through the cache
+        uint64_t    HitCount;               //Reads served without a round trip
+        uint64_t    PrefetchedPageCount;
+        uint64_t    PrefetchHitPageCount;   //Prefetched pages that were read afterwards
+        uint64_t    BytesSaved;             //Bytes served without a round trip
+    } FDP_READAHEAD_STATS;
+
+    typedef struct FDP_REGISTER_CACHE_STATS_
+    {
+        uint64_t    ReadCount;              //Register reads that went through the cache
+        uint64_t    HitCount;               //Registers served without a round trip
+        uint64_t    WriteCount;             //Register write requests held back until the next flush
+        uint64_t    FlushCount;             //Batched write-back commands sent
+        uint64_t    WritesSaved;            //Write requests that didn't need their own command
+    } FDP_REGISTER_CACHE_STATS;
+
+    typedef struct FDP_HIT_LOG_STATS_
+    {
+        uint64_t    HitCount;               //Tracepoint hits since the log was created
+        uint64_t    LoggedCount;            //Records appended to the log
+        uint64_t    DroppedCount;           //Records lost because the log was full
+        uint64_t    PendingCount;           //Records not drained yet
+        uint32_t    RecordCount;            //Log capacity
+    } FDP_HIT_LOG_STATS;
 
     typedef struct _FDP_SERVER_INTERFACE_T{
         bool bIsRunning;
@@ -104,11 +480,34 @@ extern "C" {
         bool(*pfnRestore)                (void*);
         bool(*pfnReboot)                (void*);
         bool(*pfnInjectInterrupt)       (void*, uint32_t, uint32_t, uint32_t, uint64_t);
+        //Optional, NULL => one pfnReadRegister/pfnWriteRegister call per register in the mask
+        bool(*pfnReadRegisters)         (void*, uint32_t, uint64_t, uint64_t*);
+        bool(*pfnWriteRegisters)        (void*, uint32_t, uint64_t, const uint64_t*);
+        //Optional, standard XSAVE layout, NULL => x87 and SSE only through pfnGetFxState64/pfnSetFxState64
+        bool(*pfnGetXState)             (void*, uint32_t, uint64_t, uint8_t*, uint64_t*);
+        bool(*pfnSetXState)             (void*, uint32_t, uint64_t, const uint8_t*);
+        //Optional, fill each entry Status, NULL => one pfnReadMsr/pfnWriteMsr call per entry
+        bool(*pfnReadMsrs)              (void*, FDP_MSR_ENTRY*, uint32_t);
+        bool(*pfnWriteMsrs)             (void*, FDP_MSR_ENTRY*, uint32_t);
+        //Optional, id of the breakpoint that stopped the CPU or -1, NULL => always -1
+        int(*pfnGetHitBreakpointId)     (void*, uint32_t);
+        //Optional, linear address, size (0 if unknown, 64 bytes are then assumed) and FDP_Access of the access that
+        //hit a page breakpoint, NULL => watchpoints stop on any access to their pages
+        bool(*pfnGetHitAccess)          (void*, uint32_t, uint64_t*, uint32_t*, FDP_Access*);
+        //Optional, sets in the bitmap (one bit per 4K guest physical page, PageCount bits) the pages written by the
+        //guest, its devices or pfnWritePhysicalMemory since the previous call, NULL => snapshot restores compare every page
+        bool(*pfnGetDirtyPages)         (void*, uint64_t*, uint64_t);
+        //Optional, save the device state (timers, interrupt controllers, disks...) as that of snapshot slot SnapshotId
+        //or put it back before the RAM and CPUs of the snapshot, NULL => FDP_RestoreSnapshot is refused once the guest
+        //ran since the snapshot
+        bool(*pfnSaveDeviceState)       (void*, uint32_t);
+        bool(*pfnRestoreDeviceState)    (void*, uint32_t);
     }FDP_SERVER_INTERFACE_T;
 
     // FDP API
 FDP_EXPORTED    FDP_SHM*    FDP_CreateSHM(char *shmName);
 FDP_EXPORTED    FDP_SHM*    FDP_OpenSHM(const char *pShmName);
+FDP_EXPORTED    FDP_CPU_CTX* FDP_CreateCpuSHM(FDP_SHM *pShm, const char *pShmName, uint32_t CpuCount);
 FDP_EXPORTED    bool        FDP_Init(FDP_SHM *pShm);
 FDP_EXPORTED    bool        FDP_Pause(FDP_SHM *pShm);
 FDP_EXPORTED    bool        FDP_Resume(FDP_SHM *pShm);
@@ -119,19 +518,35 @@ FDP_EXPORTED    bool        FDP_WriteVirtualMemory(FDP_SHM *pShm, uint32_t CpuId
 FDP_EXPORTED    uint64_t    FDP_SearchPhysicalMemory(FDP_SHM *pShm, const void *pPatternData, uint32_t PatternSize, uint64_t StartOffset);
 FDP_EXPORTED    bool        FDP_SearchVirtualMemory(FDP_SHM *pFDP, uint32_t CpuId, const void *pPatternData, uint32_t PatternSize, uint64_t StartOffset);
 FDP_EXPORTED    bool        FDP_ReadRegister(FDP_SHM *pShm, uint32_t CpuId, FDP_Register RegisterId, uint64_t *pRegisterValue);
+FDP_EXPORTED    bool        FDP_GetCpuContext(FDP_SHM *pShm, uint32_t CpuId, FDP_CPU_CTX *pCpuCtx);
 FDP_EXPORTED    bool        FDP_WriteRegister(FDP_SHM *pShm, uint32_t CpuId, FDP_Register RegisterId, uint64_t RegisterValue);
+FDP_EXPORTED    bool        FDP_ReadRegisters(FDP_SHM *pShm, uint32_t CpuId, uint64_t RegisterMask, uint64_t *pRegisterValues);
+FDP_EXPORTED    bool        FDP_WriteRegisters(FDP_SHM *pShm, uint32_t CpuId, uint64_t RegisterMask, const uint64_t *pRegisterValues);
 FDP_EXPORTED    bool        FDP_ReadMsr(FDP_SHM *pShm, uint32_t CpuId, uint64_t MsrId, uint64_t *pMsrValue);
 FDP_EXPORTED    bool        FDP_WriteMsr(FDP_SHM *pShm, uint32_t CpuId, uint64_t MsrId, uint64_t MsrValue);
+FDP_EXPORTED    bool        FDP_ReadMsrs(FDP_SHM *pShm, FDP_MSR_ENTRY *pEntries, uint32_t EntryCount);
+FDP_EXPORTED    bool        FDP_WriteMsrs(FDP_SHM *pShm, FDP_MSR_ENTRY *pEntries, uint32_t EntryCount);
 FDP_EXPORTED    int         FDP_SetBreakpoint(FDP_SHM *pShm, uint32_t CpuId, FDP_BreakpointType BreakpointType, uint8_t BreakpointId, FDP_Access BreakpointAccessType, FDP_AddressType BreakpointAddressType, uint64_t BreakpointAddress, uint64_t BreakpointLength, uint64_t BreakpointCr3);
 FDP_EXPORTED    bool        FDP_UnsetBreakpoint(FDP_SHM *pShm, uint8_t BreakpointId);
+FDP_EXPORTED    bool        FDP_SetBreakpoints(FDP_SHM *pShm, FDP_BREAKPOINT_ENTRY *pEntries, uint32_t EntryCount);
+FDP_EXPORTED    bool        FDP_UnsetBreakpoints(FDP_SHM *pShm, const uint8_t *pBreakpointIds, uint32_t BreakpointCount, bool *pbUnset);
+FDP_EXPORTED    bool        FDP_UnsetAllBreakpoints(FDP_SHM *pShm);
+FDP_EXPORTED    bool        FDP_SetBreakpointCondition(FDP_SHM *pShm, int BreakpointId, const FDP_BREAKPOINT_CONDITION *pConditions, uint32_t ConditionCount);
+FDP_EXPORTED    int         FDP_SetConditionalBreakpoint(FDP_SHM *pShm, uint32_t CpuId, FDP_BreakpointType BreakpointType, uint8_t BreakpointId, FDP_Access BreakpointAccessType, FDP_AddressType BreakpointAddressType, uint64_t BreakpointAddress, uint64_t BreakpointLength, uint64_t BreakpointCr3, const FDP_BREAKPOINT_CONDITION *pConditions, uint32_t ConditionCount);
 FDP_EXPORTED    bool        FDP_VirtualToPhysical(FDP_SHM *pShm, uint32_t CpuId, uint64_t VirtualAddress, uint64_t *pPhysicalAddress);
 FDP_EXPORTED    bool        FDP_GetState(FDP_SHM *pShm, FDP_State *pState);
 FDP_EXPORTED    bool        FDP_GetFxState64(FDP_SHM *pShm, uint32_t CpuId, FDP_XSAVE_FORMAT64_T *pFxState64);
 FDP_EXPORTED    bool        FDP_SetFxState64(FDP_SHM *pFDP, uint32_t CpuId, FDP_XSAVE_FORMAT64_T* pFxState64);
+FDP_EXPORTED    bool        FDP_GetXState(FDP_SHM *pShm, uint32_t CpuId, uint64_t ComponentMask, uint8_t *pXsaveArea, uint64_t *pPresentMask);
+FDP_EXPORTED    bool        FDP_SetXState(FDP_SHM *pShm, uint32_t CpuId, uint64_t ComponentMask, const uint8_t *pXsaveArea);
+FDP_EXPORTED    bool        FDP_GetXStateLayout(uint32_t Component, uint32_t *pOffset, uint32_t *pSize);
 FDP_EXPORTED    bool        FDP_SingleStep(FDP_SHM *pShm, uint32_t CpuId);
+FDP_EXPORTED    bool        FDP_SingleStepN(FDP_SHM *pShm, uint32_t CpuId, uint32_t StepCount, uint64_t RegisterMask, const FDP_BREAKPOINT_CONDITION *pStopConditions, uint32_t StopConditionCount, uint64_t *pTrace, uint32_t *pStepCount, uint32_t *pEndReason);
+FDP_EXPORTED    bool        FDP_StepUntil(FDP_SHM *pShm, uint32_t CpuId, uint32_t Flags, uint64_t RangeStart, uint64_t RangeEnd, uint32_t MaxStepCount, FDP_STEP_UNTIL_RESULT *pResult);
 FDP_EXPORTED    bool        FDP_GetPhysicalMemorySize(FDP_SHM *pShm, uint64_t *pPhysicalMemorySize);
 FDP_EXPORTED    bool        FDP_GetCpuCount(FDP_SHM *pShm, uint32_t *pCPUCount);
 FDP_EXPORTED    bool        FDP_GetCpuState(FDP_SHM *pShm, uint32_t CpuId, FDP_State *pState);
+FDP_EXPORTED    bool        FDP_GetAllCpuStates(FDP_SHM *pShm, FDP_State *pState, FDP_CPU_STATE_ENTRY *pCpuStates, uint32_t MaxCpuCount, uint32_t *pCpuCount);
 FDP_EXPORTED    bool        FDP_Reboot(FDP_SHM *pShm);
 FDP_EXPORTED    bool        FDP_Save(FDP_SHM *pShm);
 FDP_EXPORTED    bool        FDP_Restore(FDP_SHM *pShm);
@@ -139,8 +554,56 @@ FDP_EXPORTED    bool        FDP_GetStateChanged(FDP_SHM *pShm);
 FDP_EXPORTED    void        FDP_SetStateChanged(FDP_SHM *pShm);
 FDP_EXPORTED    bool        FDP_InjectInterrupt(FDP_SHM *pShm, uint32_t CpuId, uint32_t uInterruptionCode, uint32_t uErrorCode, uint64_t Cr2Value);
 
+FDP_EXPORTED    uint64_t    FDP_HashBuffer(FDP_HashAlgorithm Algorithm, const uint8_t *pBuffer, uint64_t BufferSize);
+FDP_EXPORTED    bool        FDP_HashPhysicalMemory(FDP_SHM *pShm, FDP_HashAlgorithm Algorithm, uint64_t PhysicalAddress, uint64_t Size, uint64_t *pHash);
+FDP_EXPORTED    bool        FDP_HashVirtualMemory(FDP_SHM *pShm, uint32_t CpuId, FDP_HashAlgorithm Algorithm, uint64_t VirtualAddress, uint64_t Size, uint64_t *pHash);
+FDP_EXPORTED    bool        FDP_HashPhysicalPages(FDP_SHM *pShm, FDP_HashAlgorithm Algorithm, uint64_t PhysicalAddress, uint64_t PageCount, uint64_t *pPageHashes);
+FDP_EXPORTED    bool        FDP_HashVirtualPages(FDP_SHM *pShm, uint32_t CpuId, FDP_HashAlgorithm Algorithm, uint64_t VirtualAddress, uint64_t PageCount, uint64_t *pPageHashes);
+FDP_EXPORTED    bool        FDP_SwapMemory(FDP_SHM *pShm, uint32_t CpuId, FDP_AddressType AddressType, FDP_SWAP_ENTRY *pEntries, uint32_t EntryCount);
+FDP_EXPORTED    bool        FDP_CompareExchangeMemory(FDP_SHM *pShm, uint32_t CpuId, FDP_AddressType AddressType, uint64_t Address, const uint8_t *pExpected, const uint8_t *pNew, uint8_t *pOld, uint32_t Size);
+FDP_EXPORTED    bool        FDP_WalkList(FDP_SHM *pShm, uint32_t CpuId, FDP_AddressType AddressType, uint64_t HeadAddress, uint32_t NextOffset, int32_t RecordOffset, uint32_t RecordSize, uint32_t MaxCount, uint32_t Flags, uint64_t *pNodeAddresses, uint8_t *pRecords, uint32_t *pCount, uint32_t *pEndReason);
+FDP_EXPORTED    bool        FDP_SetReadahead(FDP_SHM *pShm, bool bEnable);
+FDP_EXPORTED    void        FDP_InvalidateReadahead(FDP_SHM *pShm);
+FDP_EXPORTED    bool        FDP_GetReadaheadStats(FDP_SHM *pShm, FDP_READAHEAD_STATS *pStats);
+FDP_EXPORTED    bool        FDP_SetRegisterCache(FDP_SHM *pShm, bool bEnable);
+FDP_EXPORTED    bool        FDP_FlushRegisterCache(FDP_SHM *pShm);
+FDP_EXPORTED    void        FDP_InvalidateRegisterCache(FDP_SHM *pShm);
+FDP_EXPORTED    bool        FDP_GetRegisterCacheStats(FDP_SHM *pShm, FDP_REGISTER_CACHE_STATS *pStats);
+FDP_EXPORTED    bool        FDP_VerifyProgram(const FDP_PROGRAM_INSTRUCTION *pInstructions, uint32_t InstructionCount);
+FDP_EXPORTED    int         FDP_LoadProgram(FDP_SHM *pShm, const FDP_PROGRAM_INSTRUCTION *pInstructions, uint32_t InstructionCount);
+FDP_EXPORTED    bool        FDP_UnloadProgram(FDP_SHM *pShm, int ProgramId);
+FDP_EXPORTED    bool        FDP_AttachProgram(FDP_SHM *pShm, int BreakpointId, int ProgramId);
+FDP_EXPORTED    bool        FDP_ReadProgramMap(FDP_SHM *pShm, int ProgramId, uint32_t FirstIndex, uint32_t Count, uint64_t *pValues);
+FDP_EXPORTED    bool        FDP_AddExecuteBreakpoint(FDP_SHM *pShm, uint64_t PhysicalAddress, uint32_t *pHandle);
+FDP_EXPORTED    bool        FDP_RemoveExecuteBreakpoint(FDP_SHM *pShm, uint32_t Handle);
+FDP_EXPORTED    bool        FDP_GetHitBreakpointHandle(FDP_SHM *pShm, uint32_t CpuId, uint32_t *pHandle);
+FDP_EXPORTED    bool        FDP_SetCoverageBlocks(FDP_SHM *pShm, const uint64_t *pPhysicalAddresses, uint32_t BlockCount);
+FDP_EXPORTED    bool        FDP_GetCoverage(FDP_SHM *pShm, uint8_t *pBitmap, uint32_t BitmapSize, uint32_t *pHitCount);
+FDP_EXPORTED    bool        FDP_ResetCoverage(FDP_SHM *pShm);
+FDP_EXPORTED    bool        FDP_SetTracepoint(FDP_SHM *pShm, int BreakpointId, uint32_t Flags, uint64_t RegisterMask);
+FDP_EXPORTED    uint32_t    FDP_DrainHitLog(FDP_SHM *pShm, FDP_HIT_RECORD *pRecords, uint32_t MaxCount);
+FDP_EXPORTED    bool        FDP_GetHitLogStats(FDP_SHM *pShm, FDP_HIT_LOG_STATS *pStats);
+FDP_EXPORTED    int         FDP_CreateAggregation(FDP_SHM *pShm, uint32_t KeyType, int32_t StackOffset, uint32_t MaxKeyCount);
+FDP_EXPORTED    bool        FDP_DeleteAggregation(FDP_SHM *pShm, int AggregationId);
+FDP_EXPORTED    bool        FDP_AttachAggregation(FDP_SHM *pShm, int BreakpointId, int AggregationId);
+FDP_EXPORTED    bool        FDP_GetAggregation(FDP_SHM *pShm, int AggregationId, bool bReset, FDP_AGGREGATION_ENTRY *pEntries, uint32_t MaxCount, uint32_t *pEntryCount, uint64_t *pDroppedCount);
+FDP_EXPORTED    bool        FDP_ResetAggregation(FDP_SHM *pShm, int AggregationId);
+FDP_EXPORTED    int         FDP_SetWatchpoint(FDP_SHM *pShm, uint32_t CpuId, FDP_Access Access, FDP_AddressType AddressType, uint64_t Address, uint64_t Length, uint64_t Cr3, uint32_t Flags);
+FDP_EXPORTED    bool        FDP_SaveSnapshot(FDP_SHM *pShm, const char *pName);
+FDP_EXPORTED    bool        FDP_RestoreSnapshot(FDP_SHM *pShm, const char *pName);
+FDP_EXPORTED    bool        FDP_DeleteSnapshot(FDP_SHM *pShm, const char *pName);
+FDP_EXPORTED    bool        FDP_ListSnapshots(FDP_SHM *pShm, FDP_SNAPSHOT_INFO *pSnapshots, uint32_t MaxCount, uint32_t *pSnapshotCount);
+
 FDP_EXPORTED    bool        FDP_SetFDPServer(FDP_SHM* pFDP, FDP_SERVER_INTERFACE_T* pFDPServer);
 FDP_EXPORTED    bool        FDP_ServerLoop(FDP_SHM* pFDP);
+FDP_EXPORTED    FDP_HIT_LOG* FDP_CreateHitLogSHM(FDP_SHM *pShm, const char *pShmName, uint32_t RecordCount);
+FDP_EXPORTED    bool        FDP_ServerBreakpointHit(FDP_SHM *pShm, uint32_t CpuId, int BreakpointId);
+FDP_EXPORTED    FDP_BREAKPOINT_TABLE* FDP_CreateBreakpointTable();
+FDP_EXPORTED    void        FDP_DestroyBreakpointTable(FDP_BREAKPOINT_TABLE *pTable);
+FDP_EXPORTED    bool        FDP_BreakpointTableInsert(FDP_BREAKPOINT_TABLE *pTable, uint64_t Address, uint32_t *pHandle, bool *pbNewPage);
+FDP_EXPORTED    bool        FDP_BreakpointTableRemove(FDP_BREAKPOINT_TABLE *pTable, uint32_t Handle, uint64_t *pAddress, bool *pbLastInPage);
+FDP_EXPORTED    uint32_t    FDP_BreakpointTableLookup(FDP_BREAKPOINT_TABLE *pTable, uint64_t Address);
+FDP_EXPORTED    uint32_t    FDP_BreakpointTablePageCount(FDP_BREAKPOINT_TABLE *pTable, uint64_t Address);
 
     uint8_t     FDP_Test(FDP_SHM *pShm);
 
@@ -0,0 +1,56 @@
+#ifndef __FDP_ARCHIVE_H__
+#define __FDP_ARCHIVE_H__
+
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#include "FDP.h"
+
+#define FDP_ARCHIVE_PAGE_SIZE           4096
+#define FDP_ARCHIVE_BLOCK_PAGES         16      //Pages compressed together, the unit of random access
+#define FDP_ARCHIVE_MAX_NAME_SIZE       64
+#define FDP_ARCHIVE_REGISTER_COUNT      (FDP_TR_REGISTER + 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    //An archive holds any number of named snapshots of a guest (physical memory
+    //and registers). Pages with the same bytes are stored once per archive, in
+    //independently compressed blocks of FDP_ARCHIVE_BLOCK_PAGES.
+    //A reader maps the file and keeps the last decompressed block, use one per thread.
+    typedef struct FDP_ARCHIVE_WRITER_ FDP_ARCHIVE_WRITER;
+    typedef struct FDP_ARCHIVE_ FDP_ARCHIVE;
+
+    typedef struct FDP_ARCHIVE_SNAPSHOT_INFO_
+    {
+        char        Name[FDP_ARCHIVE_MAX_NAME_SIZE];
+        uint64_t    Timestamp;              //Seconds since the Epoch
+        uint64_t    PageCount;              //Guest physical pages
+        uint64_t    NewPageCount;           //Pages first stored by this snapshot
+        uint64_t    ZeroPageCount;
+        uint64_t    UnreadablePageCount;
+        uint32_t    CpuCount;
+    } FDP_ARCHIVE_SNAPSHOT_INFO;
+
+//Appends to pFilePath if it is already an archive
+FDP_EXPORTED    FDP_ARCHIVE_WRITER* FDP_ArchiveOpenWriter(const char *pFilePath);
+FDP_EXPORTED    bool                FDP_ArchiveWriteSnapshot(FDP_ARCHIVE_WRITER *pWriter, FDP_SHM *pFDP, const char *pName);
+FDP_EXPORTED    bool                FDP_ArchiveCloseWriter(FDP_ARCHIVE_WRITER *pWriter);
+
+FDP_EXPORTED    FDP_ARCHIVE*        FDP_ArchiveOpen(const char *pFilePath);
+FDP_EXPORTED    void                FDP_ArchiveClose(FDP_ARCHIVE *pArchive);
+FDP_EXPORTED    uint32_t            FDP_ArchiveGetSnapshotCount(FDP_ARCHIVE *pArchive);
+FDP_EXPORTED    int                 FDP_ArchiveFindSnapshot(FDP_ARCHIVE *pArchive, const char *pName);
+FDP_EXPORTED    bool                FDP_ArchiveGetSnapshotInfo(FDP_ARCHIVE *pArchive, uint32_t SnapshotIndex, FDP_ARCHIVE_SNAPSHOT_INFO *pInfo);
+FDP_EXPORTED    bool                FDP_ArchiveReadPhysicalMemory(FDP_ARCHIVE *pArchive, uint32_t SnapshotIndex, uint8_t *pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress);
+FDP_EXPORTED    bool                FDP_ArchiveReadRegister(FDP_ARCHIVE *pArchive, uint32_t SnapshotIndex, uint32_t CpuId, FDP_Register RegisterId, uint64_t *pRegisterValue);
+FDP_EXPORTED    uint64_t            FDP_ArchiveGetStoredPageCount(FDP_ARCHIVE *pArchive);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__FDP_ARCHIVE_H__
@@ -0,0 +1,61 @@
+#ifndef __FDP_DIFF_H__
+#define __FDP_DIFF_H__
+
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#include "FDP.h"
+
+#define FDP_DIFF_PAGE_SIZE          4096
+#define FDP_DIFF_DEFAULT_THREADS    0       //0 => one thread per online CPU
+
+enum FDP_DiffFlags_
+{
+    FDP_DIFF_PAGE_GRANULARITY = 0x0,        //Changed ranges are whole pages
+    FDP_DIFF_BYTE_GRANULARITY = 0x1,        //Changed ranges are exact byte runs
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    //A physical memory image: a live FDP handle, a raw dump file or a mapped snapshot
+    typedef struct FDP_DIFF_SOURCE_ FDP_DIFF_SOURCE;
+
+    typedef struct FDP_DIFF_RANGE_
+    {
+        uint64_t    PhysicalAddress;
+        uint64_t    Size;
+    } FDP_DIFF_RANGE;
+
+    typedef struct FDP_DIFF_RESULT_
+    {
+        FDP_DIFF_RANGE  *pRanges;           //Coalesced, sorted by PhysicalAddress
+        uint64_t        RangeCount;
+        uint64_t        ComparedPageCount;
+        uint64_t        ChangedPageCount;
+        uint64_t        ChangedByteCount;   //Only with FDP_DIFF_BYTE_GRANULARITY
+        uint64_t        UnreadablePageCount;//Read as zeroes on either side
+    } FDP_DIFF_RESULT;
+
+FDP_EXPORTED    FDP_DIFF_SOURCE*    FDP_DiffOpenLive(FDP_SHM *pFDP);
+FDP_EXPORTED    FDP_DIFF_SOURCE*    FDP_DiffOpenFile(const char *pFilePath);
+FDP_EXPORTED    FDP_DIFF_SOURCE*    FDP_DiffMapFile(const char *pFilePath);
+FDP_EXPORTED    FDP_DIFF_SOURCE*    FDP_DiffOpenBuffer(const void *pBuffer, uint64_t BufferSize);
+FDP_EXPORTED    void                FDP_DiffCloseSource(FDP_DIFF_SOURCE *pSource);
+FDP_EXPORTED    uint64_t            FDP_DiffGetSourceSize(FDP_DIFF_SOURCE *pSource);
+FDP_EXPORTED    bool                FDP_DiffReadSource(FDP_DIFF_SOURCE *pSource, uint8_t *pDstBuffer, uint32_t ReadSize, uint64_t PhysicalAddress);
+
+FDP_EXPORTED    bool                FDP_DiffCompare(FDP_DIFF_SOURCE *pOldSource, FDP_DIFF_SOURCE *pNewSource, uint32_t Flags, uint32_t ThreadCount, FDP_DIFF_RESULT *pResult);
+FDP_EXPORTED    uint64_t            FDP_DiffHashPage(const uint8_t *pPage);
+FDP_EXPORTED    bool                FDP_DiffComputePageHashes(FDP_DIFF_SOURCE *pSource, uint64_t *pPageHashes, uint64_t PageCount, uint32_t ThreadCount);
+FDP_EXPORTED    bool                FDP_DiffCompareHashes(const uint64_t *pOldPageHashes, uint64_t PageCount, FDP_DIFF_SOURCE *pNewSource, uint32_t ThreadCount, FDP_DIFF_RESULT *pResult);
+FDP_EXPORTED    void                FDP_DiffFreeResult(FDP_DIFF_RESULT *pResult);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__FDP_DIFF_H__
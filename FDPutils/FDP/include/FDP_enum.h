@@ -57,6 +57,15 @@ enum FDP_Access_
 };
 typedef uint16_t FDP_Access;
 
+enum FDP_HashAlgorithm_
+{
+    FDP_HASH_NONE = 0x0,
+    FDP_HASH_XXH64 = 0x01,
+    FDP_HASH_CRC32C = 0x02,
+    FDP_HASH_ALGORITHM_HACK = 0xFFFF
+};
+typedef uint16_t FDP_HashAlgorithm;
+
 enum FDP_State_
 {
     FDP_STATE_NULL = 0x0,
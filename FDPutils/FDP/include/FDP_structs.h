@@ -27,45 +27,6 @@
 //#include <stdint.h>
 //#include <stdbool.h>
 
-#pragma pack(push, 1)
-typedef struct FDP_CPU_CTX_
-{
-    uint64_t        rip;
-
-    uint64_t        rax;
-    uint64_t        rcx;
-    uint64_t        rdx;
-    uint64_t        rbx;
-
-    uint64_t        rsp;
-    uint64_t        rbp;
-    uint64_t        rsi;
-    uint64_t        rdi;
-    uint64_t        r8;
-    uint64_t        r9;
-    uint64_t        r10;
-    uint64_t        r11;
-    uint64_t        r12;
-    uint64_t        r13;
-    uint64_t        r14;
-    uint64_t        r15;
-
-    uint64_t        es;
-    uint64_t        cs;
-    uint64_t        ss;
-    uint64_t        ds;
-    uint64_t        fs;
-    uint64_t        gs;
-
-    uint64_t        rflags;
-
-    uint64_t        cr0;
-    uint64_t        cr2;
-    uint64_t        cr3;
-    uint64_t        cr4;
-}FDP_CPU_CTX;
-#pragma pack(pop)
-
 
 enum
 {
@@ -99,7 +60,43 @@ enum
     FDPCMD_SAVE,
     FDPCMD_RESTORE,
     FDPCMD_INJECT_INTERRUPT,
-    FDPCMD_TEST
+    FDPCMD_TEST,
+    FDPCMD_HASH_RANGE,
+    FDPCMD_SWAP_MEMORY,
+    FDPCMD_WALK_LIST,
+    FDPCMD_READ_REGISTERS,
+    FDPCMD_WRITE_REGISTERS,
+    FDPCMD_GET_XSTATE,
+    FDPCMD_SET_XSTATE,
+    FDPCMD_READ_MSRS,
+    FDPCMD_WRITE_MSRS,
+    FDPCMD_GET_ALL_CPU_STATES,
+    FDPCMD_SET_TRACEPOINT,
+    FDPCMD_SET_BREAKPOINT_CONDITION,
+    FDPCMD_LOAD_PROGRAM,
+    FDPCMD_UNLOAD_PROGRAM,
+    FDPCMD_ATTACH_PROGRAM,
+    FDPCMD_READ_PROGRAM_MAP,
+    FDPCMD_ADD_EXECUTE_BREAKPOINT,
+    FDPCMD_REMOVE_EXECUTE_BREAKPOINT,
+    FDPCMD_GET_HIT_BREAKPOINT_HANDLE,
+    FDPCMD_SET_BREAKPOINTS,
+    FDPCMD_UNSET_BREAKPOINTS,
+    FDPCMD_UNSET_ALL_BREAKPOINTS,
+    FDPCMD_SINGLE_STEP_N,
+    FDPCMD_STEP_UNTIL,
+    FDPCMD_SET_COVERAGE_BLOCKS,
+    FDPCMD_GET_COVERAGE,
+    FDPCMD_RESET_COVERAGE,
+    FDPCMD_SET_WATCHPOINT,
+    FDPCMD_CREATE_AGGREGATION,
+    FDPCMD_DELETE_AGGREGATION,
+    FDPCMD_ATTACH_AGGREGATION,
+    FDPCMD_GET_AGGREGATION,
+    FDPCMD_SAVE_SNAPSHOT,
+    FDPCMD_RESTORE_SNAPSHOT,
+    FDPCMD_DELETE_SNAPSHOT,
+    FDPCMD_LIST_SNAPSHOTS
 };
 
 typedef struct _FDP_UnsetBreakpoint_req
@@ -146,7 +143,15 @@ typedef __attribute__((aligned(1))) struct FDP_SHM_
     uint8_t OutputBuffer[FDP_MAX_DATA_SIZE];    //Used as temporary output buffer
 
     FDP_SERVER_INTERFACE_T    *pFdpServer;
-    FDP_CPU_CTX                *pCpuShm;
+    FDP_CPU_CTX                *pCpuShm;                    //One context per vCPU
+    uint32_t                CpuShmCount;
+    FDP_READAHEAD           *pReadahead;                //Client side only, see FDP_SetReadahead
+    FDP_REGISTER_CACHE      *pRegisterCache;            //Client side only, see FDP_SetRegisterCache
+    FDP_XSTATE_CACHE        *pXStateCache;              //Client side only, one per vCPU, see FDP_GetXState
+    uint32_t                XStateCacheCount;
+    FDP_HIT_LOG             *pHitLog;                   //Shared by the server and its clients, see FDP_CreateHitLogSHM
+    FDP_BREAKPOINT_ACTIONS  *pBreakpointActions;        //Server side only, see FDP_SetTracepoint
+    FDP_SNAPSHOT_STORE      *pSnapshotStore;            //Server side only, see FDP_SaveSnapshot
 } FDP_SHM;
 
 #define FDP_SHM_SHARED_SIZE sizeof(FDP_SHM_SHARED)
@@ -297,6 +302,248 @@ typedef struct FDP_INJECT_INTERRUPT_PKT_REQ_
     uint64_t Cr2Value;
 } FDP_INJECT_INTERRUPT_PKT_REQ;
 
+#define FDP_HASH_RANGE_PER_PAGE 0x1   //Return one hash per FDP_HASH_PAGE_SIZE chunk
+
+typedef struct FDP_HASH_RANGE_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    FDP_AddressType AddressType;
+    FDP_HashAlgorithm Algorithm;
+    uint8_t Flags;
+    uint64_t Address;
+    uint64_t Size;
+} FDP_HASH_RANGE_PKT_REQ;
+
+typedef struct FDP_SWAP_MEMORY_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    FDP_AddressType AddressType;
+    uint32_t EntryCount;
+    FDP_SWAP_ENTRY Entries[];
+} FDP_SWAP_MEMORY_PKT_REQ;
+
+typedef struct FDP_WALK_LIST_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    FDP_AddressType AddressType;
+    uint64_t HeadAddress;
+    uint64_t StopAddress;   //Walk ends when a next pointer comes back here
+    uint32_t NextOffset;
+    int32_t RecordOffset;
+    uint32_t RecordSize;
+    uint32_t MaxCount;
+    uint32_t Flags;
+} FDP_WALK_LIST_PKT_REQ;
+
+//Followed by Count x (uint64_t NodeAddress, uint8_t Record[RecordSize])
+typedef struct FDP_WALK_LIST_PKT_RSP_
+{
+    uint32_t Count;
+    uint32_t EndReason;
+} FDP_WALK_LIST_PKT_RSP;
+
+//Register values go one per bit set in RegisterMask, lowest FDP_Register first
+typedef struct FDP_READ_REGISTERS_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    uint64_t RegisterMask;
+} FDP_READ_REGISTERS_PKT_REQ;
+
+typedef struct FDP_WRITE_REGISTERS_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    uint64_t RegisterMask;
+    uint64_t RegisterValues[];
+} FDP_WRITE_REGISTERS_PKT_REQ;
+
+//Components travel lowest first, x87 and SSE together as the 512 bytes legacy region
+typedef struct FDP_GET_XSTATE_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    uint64_t ComponentMask;
+    uint64_t KnownMask;             //Components the client holds, only sent back if they changed
+    uint64_t KnownHashes[];         //XXH64 of each known component
+} FDP_GET_XSTATE_PKT_REQ;
+
+//Followed by the components in SentMask
+typedef struct FDP_GET_XSTATE_PKT_RSP_
+{
+    uint64_t PresentMask;           //Components enabled in the vCPU XCR0
+    uint64_t SentMask;
+} FDP_GET_XSTATE_PKT_RSP;
+
+//Followed by the components in ComponentMask
+typedef struct FDP_SET_XSTATE_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    uint64_t ComponentMask;
+} FDP_SET_XSTATE_PKT_REQ;
+
+//Used by FDPCMD_READ_MSRS and FDPCMD_WRITE_MSRS, the reply holds the entries with their Status
+typedef struct FDP_MSRS_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t EntryCount;
+    FDP_MSR_ENTRY Entries[];
+} FDP_MSRS_PKT_REQ;
+
+//The reply holds the entries with their BreakpointId
+typedef struct FDP_SET_BREAKPOINTS_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t EntryCount;
+    FDP_BREAKPOINT_ENTRY Entries[];
+} FDP_SET_BREAKPOINTS_PKT_REQ;
+
+//The reply holds a bool per breakpoint
+typedef struct FDP_UNSET_BREAKPOINTS_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t BreakpointCount;
+    uint8_t BreakpointIds[];
+} FDP_UNSET_BREAKPOINTS_PKT_REQ;
+
+//The stop conditions are checked after each step, the VM stops when all of them hold
+typedef struct FDP_SINGLE_STEP_N_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    uint32_t StepCount;
+    uint8_t bTrace;             //Reply with RIP and the RegisterMask registers after each step
+    uint64_t RegisterMask;
+    uint32_t ConditionCount;
+    FDP_BREAKPOINT_CONDITION Conditions[];
+} FDP_SINGLE_STEP_N_PKT_REQ;
+
+//Followed by the trace of each step
+typedef struct FDP_SINGLE_STEP_N_PKT_RSP_
+{
+    uint32_t StepCount;
+    uint32_t EndReason;
+} FDP_SINGLE_STEP_N_PKT_RSP;
+
+//The reply is a FDP_STEP_UNTIL_RESULT
+typedef struct FDP_STEP_UNTIL_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    uint32_t Flags;
+    uint32_t MaxStepCount;
+    uint64_t RangeStart;
+    uint64_t RangeEnd;
+} FDP_STEP_UNTIL_PKT_REQ;
+
+typedef struct FDP_SET_COVERAGE_BLOCKS_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t BlockCount;
+    uint64_t PhysicalAddresses[];
+} FDP_SET_COVERAGE_BLOCKS_PKT_REQ;
+
+//Followed by the hit bitmap, one bit per block in upload order
+typedef struct FDP_GET_COVERAGE_PKT_RSP_
+{
+    uint32_t BlockCount;
+    uint32_t HitCount;
+} FDP_GET_COVERAGE_PKT_RSP;
+
+typedef struct FDP_SET_WATCHPOINT_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;
+    FDP_Access Access;
+    FDP_AddressType AddressType;
+    uint32_t Flags;
+    uint64_t Address;
+    uint64_t Length;
+    uint64_t Cr3;
+} FDP_SET_WATCHPOINT_PKT_REQ;
+
+typedef struct FDP_AGGREGATION_PKT_REQ_
+{
+    uint8_t Type;
+    int32_t AggregationId;
+    int32_t BreakpointId;       //FDPCMD_ATTACH_AGGREGATION only
+    uint32_t KeyType;           //FDPCMD_CREATE_AGGREGATION only
+    int32_t StackOffset;        //FDPCMD_CREATE_AGGREGATION only
+    uint32_t MaxKeyCount;       //FDPCMD_CREATE_AGGREGATION only
+    bool bReset;                //FDPCMD_GET_AGGREGATION only
+} FDP_AGGREGATION_PKT_REQ;
+
+//Followed by EntryCount FDP_AGGREGATION_ENTRY
+typedef struct FDP_GET_AGGREGATION_PKT_RSP_
+{
+    uint32_t EntryCount;
+    uint64_t DroppedCount;
+} FDP_GET_AGGREGATION_PKT_RSP;
+
+//FDPCMD_SAVE_SNAPSHOT, FDPCMD_RESTORE_SNAPSHOT and FDPCMD_DELETE_SNAPSHOT
+typedef struct FDP_SNAPSHOT_PKT_REQ_
+{
+    uint8_t Type;
+    char Name[FDP_SNAPSHOT_MAX_NAME_SIZE];
+} FDP_SNAPSHOT_PKT_REQ;
+
+//Followed by SnapshotCount FDP_SNAPSHOT_INFO
+typedef struct FDP_LIST_SNAPSHOTS_PKT_RSP_
+{
+    uint32_t SnapshotCount;
+} FDP_LIST_SNAPSHOTS_PKT_RSP;
+
+typedef struct FDP_GET_ALL_CPU_STATES_PKT_RSP_
+{
+    uint8_t State;
+    uint32_t CpuCount;
+    FDP_CPU_STATE_ENTRY CpuStates[];
+} FDP_GET_ALL_CPU_STATES_PKT_RSP;
+
+typedef struct FDP_SET_TRACEPOINT_PKT_REQ_
+{
+    uint8_t Type;
+    int32_t BreakpointId;
+    uint32_t Flags;
+    uint64_t RegisterMask;
+} FDP_SET_TRACEPOINT_PKT_REQ;
+
+typedef struct FDP_SET_BREAKPOINT_CONDITION_PKT_REQ_
+{
+    uint8_t Type;
+    int32_t BreakpointId;
+    uint32_t ConditionCount;
+    FDP_BREAKPOINT_CONDITION Conditions[];
+} FDP_SET_BREAKPOINT_CONDITION_PKT_REQ;
+
+typedef struct FDP_LOAD_PROGRAM_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t InstructionCount;
+    FDP_PROGRAM_INSTRUCTION Instructions[];
+} FDP_LOAD_PROGRAM_PKT_REQ;
+
+typedef struct FDP_PROGRAM_PKT_REQ_
+{
+    uint8_t Type;
+    int32_t ProgramId;
+    int32_t BreakpointId;       //FDPCMD_ATTACH_PROGRAM only
+    uint32_t FirstIndex;        //FDPCMD_READ_PROGRAM_MAP only
+    uint32_t Count;
+} FDP_PROGRAM_PKT_REQ;
+
+typedef struct FDP_BREAKPOINT_HANDLE_PKT_REQ_
+{
+    uint8_t Type;
+    uint32_t CpuId;             //FDPCMD_GET_HIT_BREAKPOINT_HANDLE only
+    uint32_t Handle;            //FDPCMD_REMOVE_EXECUTE_BREAKPOINT only
+    uint64_t PhysicalAddress;   //FDPCMD_ADD_EXECUTE_BREAKPOINT only
+} FDP_BREAKPOINT_HANDLE_PKT_REQ;
+
 typedef struct FDP_SET_FX_STATE_REQ_
 {
     uint8_t Type;
@@ -305,4 +552,23 @@ typedef struct FDP_SET_FX_STATE_REQ_
 }FDP_SET_FX_STATE_REQ;
 #pragma pack(pop)
 
+//Lock-free ring of FDP_HIT_RECORD, written by the vCPUs at tracepoint hits and drained by the client.
+//Each slot Sequence tells whether it is free for the writer at that index or ready for the reader
+typedef struct FDP_HIT_LOG_SLOT_
+{
+    volatile uint64_t Sequence;
+    FDP_HIT_RECORD Record;
+} FDP_HIT_LOG_SLOT;
+
+struct FDP_HIT_LOG_
+{
+    uint32_t RecordCount;               //Power of two
+    volatile bool DrainLock;
+    volatile uint64_t WriteIndex;
+    volatile uint64_t ReadIndex;
+    volatile uint64_t HitCount;
+    volatile uint64_t DroppedCount;
+    FDP_HIT_LOG_SLOT Slots[];
+};
+
 #endif
@@ -53,6 +53,155 @@ FDP_REGISTER = [
     {'name':    "FDP_CR8_REGISTER" ,'value': 0x2d}
 ]
 
+class FDP_SWAP_ENTRY(Structure):
+    _fields_ = [
+        ("Address", c_uint64),
+        ("Size", c_uint32),
+        ("bCompare", c_uint8),
+        ("Status", c_uint8),
+        ("Reserved", c_uint16),
+        ("Expected", c_uint8 * 16),
+        ("New", c_uint8 * 16),
+        ("Old", c_uint8 * 16),
+    ]
+
+class FDP_MSR_ENTRY(Structure):
+    _fields_ = [
+        ("CpuId", c_uint32),
+        ("Status", c_uint32),
+        ("MsrId", c_uint64),
+        ("Value", c_uint64),
+    ]
+
+class FDP_BREAKPOINT_ENTRY(Structure):
+    _fields_ = [
+        ("CpuId", c_uint32),
+        ("BreakpointId", c_int32),
+        ("BreakpointType", c_uint16),
+        ("BreakpointAccessType", c_uint16),
+        ("BreakpointAddressType", c_uint16),
+        ("Reserved", c_uint16),
+        ("BreakpointAddress", c_uint64),
+        ("BreakpointLength", c_uint64),
+        ("BreakpointCr3", c_uint64),
+    ]
+
+class FDP_CPU_STATE_ENTRY(Structure):
+    _fields_ = [
+        ("State", c_uint8),
+        ("Reserved", c_uint8 * 3),
+        ("BreakpointId", c_int32),
+        ("Rip", c_uint64),
+        ("Rsp", c_uint64),
+        ("Cr3", c_uint64),
+    ]
+
+class FDP_STEP_UNTIL_RESULT(Structure):
+    _fields_ = [
+        ("StepCount", c_uint32),
+        ("EndReason", c_uint32),
+        ("StopFlags", c_uint32),
+        ("Reserved", c_uint32),
+        ("CpuState", FDP_CPU_STATE_ENTRY),
+    ]
+
+class FDP_BREAKPOINT_CONDITION(Structure):
+    _fields_ = [
+        ("Operand", c_uint8),
+        ("Operator", c_uint8),
+        ("Size", c_uint8),
+        ("Reserved", c_uint8),
+        ("RegisterId", c_uint32),
+        ("Offset", c_int64),
+        ("Mask", c_uint64),
+        ("Value", c_uint64),
+    ]
+
+class FDP_PROGRAM_INSTRUCTION(Structure):
+    _fields_ = [
+        ("Opcode", c_uint8),
+        ("Dst", c_uint8),
+        ("Src", c_uint8),
+        ("Reserved", c_uint8),
+        ("Offset", c_int32),
+        ("Imm", c_int64),
+    ]
+
+FDP_HIT_LOG_MAX_REGISTERS = 6
+FDP_HIT_RECORD_PROGRAM_OUTPUT = 1 << 63
+FDP_HIT_RECORD_WATCHPOINT = 1 << 62
+
+class FDP_HIT_RECORD(Structure):
+    _fields_ = [
+        ("Timestamp", c_uint64),
+        ("Rip", c_uint64),
+        ("Cr3", c_uint64),
+        ("CpuId", c_uint32),
+        ("BreakpointId", c_int32),
+        ("RegisterMask", c_uint64),
+        ("RegisterValues", c_uint64 * FDP_HIT_LOG_MAX_REGISTERS),
+    ]
+
+class FDP_AGGREGATION_ENTRY(Structure):
+    _fields_ = [
+        ("Key", c_uint64),
+        ("Count", c_uint64),
+    ]
+
+FDP_AGGREGATION_MAX_KEYS = 65536
+
+FDP_MAX_SNAPSHOTS = 32
+FDP_SNAPSHOT_MAX_NAME_SIZE = 64
+FDP_SNAPSHOT_DEVICE_STATE = 0x1
+
+class FDP_SNAPSHOT_INFO(Structure):
+    _fields_ = [
+        ("Name", c_char * FDP_SNAPSHOT_MAX_NAME_SIZE),
+        ("Timestamp", c_uint64),
+        ("PageCount", c_uint64),
+        ("PrivatePageCount", c_uint64),
+        ("LastRestorePageCount", c_uint64),
+        ("Flags", c_uint64),
+    ]
+
+class FDP_HIT_LOG_STATS(Structure):
+    _fields_ = [
+        ("HitCount", c_uint64),
+        ("LoggedCount", c_uint64),
+        ("DroppedCount", c_uint64),
+        ("PendingCount", c_uint64),
+        ("RecordCount", c_uint32),
+    ]
+
+class FDP_READAHEAD_STATS(Structure):
+    _fields_ = [
+        ("ReadCount", c_uint64),
+        ("HitCount", c_uint64),
+        ("PrefetchedPageCount", c_uint64),
+        ("PrefetchHitPageCount", c_uint64),
+        ("BytesSaved", c_uint64),
+    ]
+
+class FDP_REGISTER_CACHE_STATS(Structure):
+    _fields_ = [
+        ("ReadCount", c_uint64),
+        ("HitCount", c_uint64),
+        ("WriteCount", c_uint64),
+        ("FlushCount", c_uint64),
+        ("WritesSaved", c_uint64),
+    ]
+
+class FDP_CPU_CTX(Structure):
+    _pack_ = 1
+    _fields_ = [(Name, c_uint64) for Name in (
+        "rip", "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+        "es", "cs", "ss", "ds", "fs", "gs", "rflags",
+        "cr0", "cr2", "cr3", "cr4", "cr8",
+        "dr0", "dr1", "dr2", "dr3", "dr6", "dr7",
+        "gdtrb", "gdtrl", "idtrb", "idtrl",
+        "Valid", "Sequence")]
+
 class FDP(object):
     """ Fast Debug Protocol client object.
 
@@ -60,6 +209,7 @@ class FDP(object):
     """
 
     FDP_MAX_BREAKPOINT = 256
+    FDP_MAX_BREAKPOINT_HANDLES = (1 << 20) - 1
 
     FDP_NO_CR3      = 0x0
 
@@ -88,11 +238,126 @@ class FDP(object):
     FDP_STATE_DEBUGGER_ALERTED = 0x4
     FDP_STATE_HARD_BREAKPOINT_HIT = 0x8
 
+    # FDP_HashAlgorithm
+    FDP_HASH_XXH64  = 0x01
+    FDP_HASH_CRC32C = 0x02
+
+    FDP_HASH_PAGE_SIZE          = 4096
+    FDP_HASH_UNREADABLE_PAGE    = 0xFFFFFFFFFFFFFFFF
+
+    FDP_SWAP_MAX_SIZE   = 16
+
+    # FDP_SwapStatus
+    FDP_SWAP_FAILED     = 0x0
+    FDP_SWAP_DONE       = 0x1
+    FDP_SWAP_MISMATCH   = 0x2
+
+    # FDP_MsrStatus
+    FDP_MSR_FAILED      = 0x0
+    FDP_MSR_DONE        = 0x1
+
+    # FDP_ConditionOperand
+    FDP_CONDITION_REGISTER  = 0x0
+    FDP_CONDITION_MEMORY    = 0x1
+
+    # FDP_ConditionOperator, unsigned
+    FDP_CONDITION_EQ    = 0x0
+    FDP_CONDITION_NE    = 0x1
+    FDP_CONDITION_LT    = 0x2
+    FDP_CONDITION_LE    = 0x3
+    FDP_CONDITION_GT    = 0x4
+    FDP_CONDITION_GE    = 0x5
+
+    # FDP_ProgramOpcode
+    FDP_OP_MOV  = 0x00
+    FDP_OP_ADD  = 0x01
+    FDP_OP_SUB  = 0x02
+    FDP_OP_MUL  = 0x03
+    FDP_OP_DIV  = 0x04
+    FDP_OP_MOD  = 0x05
+    FDP_OP_AND  = 0x06
+    FDP_OP_OR   = 0x07
+    FDP_OP_XOR  = 0x08
+    FDP_OP_LSH  = 0x09
+    FDP_OP_RSH  = 0x0A
+    FDP_OP_NEG  = 0x0B
+    FDP_OP_JA   = 0x10
+    FDP_OP_JEQ  = 0x11
+    FDP_OP_JNE  = 0x12
+    FDP_OP_JLT  = 0x13
+    FDP_OP_JLE  = 0x14
+    FDP_OP_JGT  = 0x15
+    FDP_OP_JGE  = 0x16
+    FDP_OP_JSET = 0x17
+    FDP_OP_CALL = 0x20
+    FDP_OP_EXIT = 0x21
+    FDP_OP_IMM  = 0x80
+
+    # FDP_ProgramHelper
+    FDP_HELPER_READ_REGISTER    = 0x0
+    FDP_HELPER_READ_MEMORY      = 0x1
+    FDP_HELPER_HASH_STRING      = 0x2
+    FDP_HELPER_MAP_LOOKUP       = 0x3
+    FDP_HELPER_MAP_UPDATE       = 0x4
+    FDP_HELPER_MAP_ADD          = 0x5
+    FDP_HELPER_OUTPUT           = 0x6
+    FDP_HELPER_GET_TIMESTAMP    = 0x7
+
+    FDP_PROGRAM_MAP_SIZE    = 256
+
+    # FDP_TracepointFlags
+    FDP_TRACEPOINT_LOG  = 0x1
+    FDP_TRACEPOINT_STOP = 0x2
+
+    # FDP_AggregationKey
+    FDP_AGGREGATE_BREAKPOINT_ID     = 0x0
+    FDP_AGGREGATE_RIP               = 0x1
+    FDP_AGGREGATE_CR3               = 0x2
+    FDP_AGGREGATE_RETURN_ADDRESS    = 0x3
+
+    # FDP_WalkListFlags
+    FDP_WALK_LIST_SKIP_HEAD     = 0x1
+    FDP_WALK_LIST_HEAD_POINTER  = 0x2
+    FDP_WALK_LIST_POINTER32     = 0x4
+
+    # FDP_WalkListEnd
+    FDP_WALK_LIST_END_HEAD          = 0x0
+    FDP_WALK_LIST_END_NULL          = 0x1
+    FDP_WALK_LIST_END_MAX_COUNT     = 0x2
+    FDP_WALK_LIST_END_READ_ERROR    = 0x3
+
+    # FDP_SingleStepN end reasons
+    FDP_STEP_END_COUNT      = 0x0
+    FDP_STEP_END_CONDITION  = 0x1
+    FDP_STEP_END_ERROR      = 0x2
+
+    # FDP_StepUntil stop predicates
+    FDP_STEP_UNTIL_RIP_INSIDE   = 0x1
+    FDP_STEP_UNTIL_RIP_OUTSIDE  = 0x2
+    FDP_STEP_UNTIL_CR3_CHANGE   = 0x4
+    FDP_STEP_UNTIL_BRANCH       = 0x8
+    FDP_STEP_UNTIL_RETURN       = 0x10
+
+    # XSAVE state components (XCR0 bits)
+    FDP_XSTATE_X87          = 0x1
+    FDP_XSTATE_SSE          = 0x2
+    FDP_XSTATE_AVX          = 0x4
+    FDP_XSTATE_BNDREGS      = 0x8
+    FDP_XSTATE_BNDCSR       = 0x10
+    FDP_XSTATE_OPMASK       = 0x20
+    FDP_XSTATE_ZMM_HI256    = 0x40
+    FDP_XSTATE_HI16_ZMM     = 0x80
+    FDP_XSTATE_PKRU         = 0x200
+    FDP_XSTATE_ALL          = 0x2FF
+
+    FDP_XSAVE_AREA_SIZE     = 2696
+
     FDP_CPU0 = 0
 
     def __init__(self, Name):
 
         self.pFDP = 0
+        self.CoverageBlockCount = 0
         self.fdpdll = PyFDP.FDP_DLL_HANDLE
 
         FDP_Register = c_uint32
@@ -100,6 +365,7 @@ class FDP(object):
         FDP_Access = c_uint16
         FDP_AddressType = c_uint16
         FDP_State = c_uint8
+        FDP_HashAlgorithm = c_uint16
 
         self.pRegisterValue = pointer(c_uint64(0))
         self.pMsrValue = pointer(c_uint64(0))
@@ -131,14 +397,28 @@ class FDP(object):
         self.fdpdll.FDP_ReadRegister.argtypes = [c_void_p, c_uint32, FDP_Register, POINTER(c_uint64)]
         self.fdpdll.FDP_WriteRegister.restype = c_bool
         self.fdpdll.FDP_WriteRegister.argtypes = [c_void_p, c_uint32, FDP_Register, c_uint64]
+        self.fdpdll.FDP_ReadRegisters.restype = c_bool
+        self.fdpdll.FDP_ReadRegisters.argtypes = [c_void_p, c_uint32, c_uint64, POINTER(c_uint64)]
+        self.fdpdll.FDP_WriteRegisters.restype = c_bool
+        self.fdpdll.FDP_WriteRegisters.argtypes = [c_void_p, c_uint32, c_uint64, POINTER(c_uint64)]
         self.fdpdll.FDP_ReadMsr.restype = c_bool
         self.fdpdll.FDP_ReadMsr.argtypes = [c_void_p, c_uint32, c_uint64, POINTER(c_uint64)]
         self.fdpdll.FDP_WriteMsr.restype = c_bool
         self.fdpdll.FDP_WriteMsr.argtypes = [c_void_p, c_uint32, c_uint64, c_uint64]
+        self.fdpdll.FDP_ReadMsrs.restype = c_bool
+        self.fdpdll.FDP_ReadMsrs.argtypes = [c_void_p, POINTER(FDP_MSR_ENTRY), c_uint32]
+        self.fdpdll.FDP_WriteMsrs.restype = c_bool
+        self.fdpdll.FDP_WriteMsrs.argtypes = [c_void_p, POINTER(FDP_MSR_ENTRY), c_uint32]
         self.fdpdll.FDP_SetBreakpoint.restype = c_int
         self.fdpdll.FDP_SetBreakpoint.argtypes = [c_void_p, c_uint32, FDP_BreakpointType, c_uint8, FDP_Access, FDP_AddressType, c_uint64, c_uint64, c_uint64]
         self.fdpdll.FDP_UnsetBreakpoint.restype = c_bool
         self.fdpdll.FDP_UnsetBreakpoint.argtypes = [c_void_p, c_uint8]
+        self.fdpdll.FDP_SetBreakpoints.restype = c_bool
+        self.fdpdll.FDP_SetBreakpoints.argtypes = [c_void_p, POINTER(FDP_BREAKPOINT_ENTRY), c_uint32]
+        self.fdpdll.FDP_UnsetBreakpoints.restype = c_bool
+        self.fdpdll.FDP_UnsetBreakpoints.argtypes = [c_void_p, POINTER(c_uint8), c_uint32, POINTER(c_bool)]
+        self.fdpdll.FDP_UnsetAllBreakpoints.restype = c_bool
+        self.fdpdll.FDP_UnsetAllBreakpoints.argtypes = [c_void_p]
         self.fdpdll.FDP_VirtualToPhysical.restype = c_bool
         self.fdpdll.FDP_VirtualToPhysical.argtypes = [c_void_p, c_uint32, c_uint64, POINTER(c_uint64)]
         self.fdpdll.FDP_GetState.restype = c_bool
@@ -147,26 +427,116 @@ class FDP(object):
         self.fdpdll.FDP_GetFxState64.argtypes = [c_void_p, c_uint32, c_void_p]
         self.fdpdll.FDP_SetFxState64.restype = c_bool
         self.fdpdll.FDP_SetFxState64.argtypes = [c_void_p, c_uint32, c_void_p]
+        self.fdpdll.FDP_GetXState.restype = c_bool
+        self.fdpdll.FDP_GetXState.argtypes = [c_void_p, c_uint32, c_uint64, POINTER(c_uint8), POINTER(c_uint64)]
+        self.fdpdll.FDP_SetXState.restype = c_bool
+        self.fdpdll.FDP_SetXState.argtypes = [c_void_p, c_uint32, c_uint64, POINTER(c_uint8)]
+        self.fdpdll.FDP_GetXStateLayout.restype = c_bool
+        self.fdpdll.FDP_GetXStateLayout.argtypes = [c_uint32, POINTER(c_uint32), POINTER(c_uint32)]
         self.fdpdll.FDP_SingleStep.restype = c_bool
         self.fdpdll.FDP_SingleStep.argtypes = [c_void_p, c_uint32]
+        self.fdpdll.FDP_StepUntil.restype = c_bool
+        self.fdpdll.FDP_StepUntil.argtypes = [c_void_p, c_uint32, c_uint32, c_uint64, c_uint64, c_uint32, POINTER(FDP_STEP_UNTIL_RESULT)]
+        self.fdpdll.FDP_SingleStepN.restype = c_bool
+        self.fdpdll.FDP_SingleStepN.argtypes = [c_void_p, c_uint32, c_uint32, c_uint64, POINTER(FDP_BREAKPOINT_CONDITION), c_uint32, POINTER(c_uint64), POINTER(c_uint32), POINTER(c_uint32)]
         self.fdpdll.FDP_GetPhysicalMemorySize.restype = c_bool
         self.fdpdll.FDP_GetPhysicalMemorySize.argtypes = [c_void_p, POINTER(c_uint64)]
         self.fdpdll.FDP_GetCpuCount.restype = c_bool
         self.fdpdll.FDP_GetCpuCount.argtypes = [c_void_p, POINTER(c_uint32)]
         self.fdpdll.FDP_GetCpuState.restype = c_bool
         self.fdpdll.FDP_GetCpuState.argtypes = [c_void_p, c_uint32, POINTER(FDP_State)]
+        self.fdpdll.FDP_GetAllCpuStates.restype = c_bool
+        self.fdpdll.FDP_GetAllCpuStates.argtypes = [c_void_p, POINTER(FDP_State), POINTER(FDP_CPU_STATE_ENTRY), c_uint32, POINTER(c_uint32)]
+        self.fdpdll.FDP_SetBreakpointCondition.restype = c_bool
+        self.fdpdll.FDP_SetBreakpointCondition.argtypes = [c_void_p, c_int, POINTER(FDP_BREAKPOINT_CONDITION), c_uint32]
+        self.fdpdll.FDP_VerifyProgram.restype = c_bool
+        self.fdpdll.FDP_VerifyProgram.argtypes = [POINTER(FDP_PROGRAM_INSTRUCTION), c_uint32]
+        self.fdpdll.FDP_LoadProgram.restype = c_int
+        self.fdpdll.FDP_LoadProgram.argtypes = [c_void_p, POINTER(FDP_PROGRAM_INSTRUCTION), c_uint32]
+        self.fdpdll.FDP_UnloadProgram.restype = c_bool
+        self.fdpdll.FDP_UnloadProgram.argtypes = [c_void_p, c_int]
+        self.fdpdll.FDP_AttachProgram.restype = c_bool
+        self.fdpdll.FDP_AttachProgram.argtypes = [c_void_p, c_int, c_int]
+        self.fdpdll.FDP_ReadProgramMap.restype = c_bool
+        self.fdpdll.FDP_ReadProgramMap.argtypes = [c_void_p, c_int, c_uint32, c_uint32, POINTER(c_uint64)]
+        self.fdpdll.FDP_AddExecuteBreakpoint.restype = c_bool
+        self.fdpdll.FDP_AddExecuteBreakpoint.argtypes = [c_void_p, c_uint64, POINTER(c_uint32)]
+        self.fdpdll.FDP_RemoveExecuteBreakpoint.restype = c_bool
+        self.fdpdll.FDP_RemoveExecuteBreakpoint.argtypes = [c_void_p, c_uint32]
+        self.fdpdll.FDP_GetHitBreakpointHandle.restype = c_bool
+        self.fdpdll.FDP_GetHitBreakpointHandle.argtypes = [c_void_p, c_uint32, POINTER(c_uint32)]
+        self.fdpdll.FDP_SetCoverageBlocks.restype = c_bool
+        self.fdpdll.FDP_SetCoverageBlocks.argtypes = [c_void_p, POINTER(c_uint64), c_uint32]
+        self.fdpdll.FDP_GetCoverage.restype = c_bool
+        self.fdpdll.FDP_GetCoverage.argtypes = [c_void_p, POINTER(c_uint8), c_uint32, POINTER(c_uint32)]
+        self.fdpdll.FDP_ResetCoverage.restype = c_bool
+        self.fdpdll.FDP_ResetCoverage.argtypes = [c_void_p]
+        self.fdpdll.FDP_SetTracepoint.restype = c_bool
+        self.fdpdll.FDP_SetTracepoint.argtypes = [c_void_p, c_int, c_uint32, c_uint64]
+        self.fdpdll.FDP_DrainHitLog.restype = c_uint32
+        self.fdpdll.FDP_DrainHitLog.argtypes = [c_void_p, POINTER(FDP_HIT_RECORD), c_uint32]
+        self.fdpdll.FDP_GetHitLogStats.restype = c_bool
+        self.fdpdll.FDP_GetHitLogStats.argtypes = [c_void_p, POINTER(FDP_HIT_LOG_STATS)]
+        self.fdpdll.FDP_CreateAggregation.restype = c_int
+        self.fdpdll.FDP_CreateAggregation.argtypes = [c_void_p, c_uint32, c_int32, c_uint32]
+        self.fdpdll.FDP_DeleteAggregation.restype = c_bool
+        self.fdpdll.FDP_DeleteAggregation.argtypes = [c_void_p, c_int]
+        self.fdpdll.FDP_AttachAggregation.restype = c_bool
+        self.fdpdll.FDP_AttachAggregation.argtypes = [c_void_p, c_int, c_int]
+        self.fdpdll.FDP_GetAggregation.restype = c_bool
+        self.fdpdll.FDP_GetAggregation.argtypes = [c_void_p, c_int, c_bool, POINTER(FDP_AGGREGATION_ENTRY), c_uint32, POINTER(c_uint32), POINTER(c_uint64)]
+        self.fdpdll.FDP_ResetAggregation.restype = c_bool
+        self.fdpdll.FDP_ResetAggregation.argtypes = [c_void_p, c_int]
+        self.fdpdll.FDP_SetWatchpoint.restype = c_int
+        self.fdpdll.FDP_SetWatchpoint.argtypes = [c_void_p, c_uint32, c_uint16, c_uint16, c_uint64, c_uint64, c_uint64, c_uint32]
         self.fdpdll.FDP_Reboot.restype = c_bool
         self.fdpdll.FDP_Reboot.argtypes = [c_void_p]
         self.fdpdll.FDP_Save.restype = c_bool
         self.fdpdll.FDP_Save.argtypes = [c_void_p]
         self.fdpdll.FDP_Restore.restype = c_bool
         self.fdpdll.FDP_Restore.argtypes = [c_void_p]
+        self.fdpdll.FDP_SaveSnapshot.restype = c_bool
+        self.fdpdll.FDP_SaveSnapshot.argtypes = [c_void_p, c_char_p]
+        self.fdpdll.FDP_RestoreSnapshot.restype = c_bool
+        self.fdpdll.FDP_RestoreSnapshot.argtypes = [c_void_p, c_char_p]
+        self.fdpdll.FDP_DeleteSnapshot.restype = c_bool
+        self.fdpdll.FDP_DeleteSnapshot.argtypes = [c_void_p, c_char_p]
+        self.fdpdll.FDP_ListSnapshots.restype = c_bool
+        self.fdpdll.FDP_ListSnapshots.argtypes = [c_void_p, POINTER(FDP_SNAPSHOT_INFO), c_uint32, POINTER(c_uint32)]
         self.fdpdll.FDP_GetStateChanged.restype = c_bool
         self.fdpdll.FDP_GetStateChanged.argtypes = [c_void_p]
         self.fdpdll.FDP_SetStateChanged.restype = c_void_p
         self.fdpdll.FDP_SetStateChanged.argtypes = [c_void_p]
         self.fdpdll.FDP_InjectInterrupt.restype = c_bool
         self.fdpdll.FDP_InjectInterrupt.argtypes = [c_void_p, c_uint32, c_uint32, c_uint32, c_uint64]
+        self.fdpdll.FDP_SetReadahead.restype = c_bool
+        self.fdpdll.FDP_SetReadahead.argtypes = [c_void_p, c_bool]
+        self.fdpdll.FDP_InvalidateReadahead.restype = None
+        self.fdpdll.FDP_InvalidateReadahead.argtypes = [c_void_p]
+        self.fdpdll.FDP_GetReadaheadStats.restype = c_bool
+        self.fdpdll.FDP_GetReadaheadStats.argtypes = [c_void_p, POINTER(FDP_READAHEAD_STATS)]
+        self.fdpdll.FDP_SetRegisterCache.restype = c_bool
+        self.fdpdll.FDP_SetRegisterCache.argtypes = [c_void_p, c_bool]
+        self.fdpdll.FDP_FlushRegisterCache.restype = c_bool
+        self.fdpdll.FDP_FlushRegisterCache.argtypes = [c_void_p]
+        self.fdpdll.FDP_InvalidateRegisterCache.restype = None
+        self.fdpdll.FDP_InvalidateRegisterCache.argtypes = [c_void_p]
+        self.fdpdll.FDP_GetRegisterCacheStats.restype = c_bool
+        self.fdpdll.FDP_GetRegisterCacheStats.argtypes = [c_void_p, POINTER(FDP_REGISTER_CACHE_STATS)]
+        self.fdpdll.FDP_SwapMemory.restype = c_bool
+        self.fdpdll.FDP_SwapMemory.argtypes = [c_void_p, c_uint32, FDP_AddressType, POINTER(FDP_SWAP_ENTRY), c_uint32]
+        self.fdpdll.FDP_HashPhysicalMemory.restype = c_bool
+        self.fdpdll.FDP_HashPhysicalMemory.argtypes = [c_void_p, FDP_HashAlgorithm, c_uint64, c_uint64, POINTER(c_uint64)]
+        self.fdpdll.FDP_HashVirtualMemory.restype = c_bool
+        self.fdpdll.FDP_HashVirtualMemory.argtypes = [c_void_p, c_uint32, FDP_HashAlgorithm, c_uint64, c_uint64, POINTER(c_uint64)]
+        self.fdpdll.FDP_HashPhysicalPages.restype = c_bool
+        self.fdpdll.FDP_HashPhysicalPages.argtypes = [c_void_p, FDP_HashAlgorithm, c_uint64, c_uint64, POINTER(c_uint64)]
+        self.fdpdll.FDP_HashVirtualPages.restype = c_bool
+        self.fdpdll.FDP_HashVirtualPages.argtypes = [c_void_p, c_uint32, FDP_HashAlgorithm, c_uint64, c_uint64, POINTER(c_uint64)]
+        self.fdpdll.FDP_GetCpuContext.restype = c_bool
+        self.fdpdll.FDP_GetCpuContext.argtypes = [c_void_p, c_uint32, POINTER(FDP_CPU_CTX)]
+        self.fdpdll.FDP_WalkList.restype = c_bool
+        self.fdpdll.FDP_WalkList.argtypes = [c_void_p, c_uint32, FDP_AddressType, c_uint64, c_uint32, c_int32, c_uint32, c_uint32, c_uint32, POINTER(c_uint64), POINTER(c_uint8), POINTER(c_uint32), POINTER(c_uint32)]
 
         pName = cast(pointer(create_string_buffer(Name.encode())), c_char_p)
         self.pFDP = self.fdpdll.FDP_OpenSHM(pName)
@@ -177,9 +547,11 @@ class FDP(object):
 
         # create registers attributes
 
+        self.RegisterIds = {}
         for reg in FDP_REGISTER:
             enum = reg["value"]
             name = self.__fix_names__(reg['name'])
+            self.RegisterIds[name] = enum
             def get_property(enum):
                 def read(self): return self.ReadRegister(enum)
                 def write(self, value) : self.WriteRegister(enum, value)
@@ -198,12 +570,46 @@ class FDP(object):
             return self.pRegisterValue[0]
         return None
 
+    def GetCpuContext(self, CpuId=FDP_CPU0):
+        """ Return a consistent snapshot of the main registers of a paused CPU as a dict, or None """
+        CpuCtx = FDP_CPU_CTX()
+        if self.fdpdll.FDP_GetCpuContext(self.pFDP, CpuId, byref(CpuCtx)) == True:
+            return dict((Field[0], getattr(CpuCtx, Field[0])) for Field in CpuCtx._fields_[:-2])
+        return None
+
     def WriteRegister(self, RegisterId, RegisterValue, CpuId=FDP_CPU0):
         """ Store the given value into the specified register
         RegisterId must be a member of FDP.FDP_REGISTER
         """
         return self.fdpdll.FDP_WriteRegister(self.pFDP, CpuId, RegisterId, c_uint64(RegisterValue))
 
+    def __register_mask__(self, Registers):
+        RegisterIds = sorted(set(self.RegisterIds.get(Register, Register) for Register in Registers))
+        RegisterMask = 0
+        for RegisterId in RegisterIds:
+            RegisterMask |= 1 << RegisterId
+        return RegisterMask, RegisterIds
+
+    def ReadRegisters(self, Registers, CpuId=FDP_CPU0):
+        """ Return the values of several registers of the same CPU in a single request, as a dict
+        Registers are members of FDP.FDP_REGISTER or register names (e.g. 'rax'), the dict is keyed the same way
+        """
+        RegisterMask, RegisterIds = self.__register_mask__(Registers)
+        RegisterValues = (c_uint64 * len(RegisterIds))()
+        if self.fdpdll.FDP_ReadRegisters(self.pFDP, CpuId, c_uint64(RegisterMask), RegisterValues) == True:
+            Values = dict(zip(RegisterIds, RegisterValues))
+            return dict((Register, Values[self.RegisterIds.get(Register, Register)]) for Register in Registers)
+        return None
+
+    def WriteRegisters(self, Registers, CpuId=FDP_CPU0):
+        """ Store several registers of the same CPU in a single request
+        Registers is a dict keyed by members of FDP.FDP_REGISTER or register names (e.g. 'rax')
+        """
+        Values = dict((self.RegisterIds.get(Register, Register), Value) for Register, Value in Registers.items())
+        RegisterMask, RegisterIds = self.__register_mask__(Values)
+        RegisterValues = (c_uint64 * len(RegisterIds))(*[Values[RegisterId] for RegisterId in RegisterIds])
+        return self.fdpdll.FDP_WriteRegisters(self.pFDP, CpuId, c_uint64(RegisterMask), RegisterValues)
+
     def ReadMsr(self, MsrId, CpuId=FDP_CPU0):
         """ Return the value stored in the Model-specific register (MSR) indexed by MsrId
         MSR typically don't have an enum Id since there are vendor specific.
@@ -218,6 +624,56 @@ class FDP(object):
         """
         return self.fdpdll.FDP_WriteMsr(self.pFDP, CpuId, c_uint64(MsrId), c_uint64(MsrValue))
 
+    def ReadMsrs(self, Msrs, CpuId=FDP_CPU0):
+        """ Read several Model-specific registers (MSR) in a single request.
+
+        * Msrs: list of MsrId, or (CpuId, MsrId) tuples to read MSRs of other CPUs.
+
+        Return a list of values, None for each MSR that couldn't be read.
+        """
+        Entries = (FDP_MSR_ENTRY * len(Msrs))()
+        for i, Msr in enumerate(Msrs):
+            Entries[i].CpuId, Entries[i].MsrId = Msr if isinstance(Msr, tuple) else (CpuId, Msr)
+        self.fdpdll.FDP_ReadMsrs(self.pFDP, Entries, len(Msrs))
+        return [Entry.Value if Entry.Status == self.FDP_MSR_DONE else None for Entry in Entries]
+
+    def WriteMsrs(self, Msrs, CpuId=FDP_CPU0):
+        """ Write several Model-specific registers (MSR) in a single request, in order.
+
+        * Msrs: list of (MsrId, MsrValue), or (CpuId, MsrId, MsrValue) tuples.
+
+        Return a list of booleans, one per MSR.
+        """
+        Entries = (FDP_MSR_ENTRY * len(Msrs))()
+        for i, Msr in enumerate(Msrs):
+            Entries[i].CpuId, Entries[i].MsrId, Entries[i].Value = Msr if len(Msr) == 3 else (CpuId,) + tuple(Msr)
+        self.fdpdll.FDP_WriteMsrs(self.pFDP, Entries, len(Msrs))
+        return [Entry.Status == self.FDP_MSR_DONE for Entry in Entries]
+
+    def GetXState(self, ComponentMask=FDP_XSTATE_ALL, CpuId=FDP_CPU0):
+        """ Return (PresentMask, XsaveArea) where XsaveArea holds the requested components in the standard XSAVE layout.
+        PresentMask tells which components the CPU has enabled. Components that didn't change since the
+        previous call aren't transferred again.
+        """
+        XsaveArea = (c_uint8 * self.FDP_XSAVE_AREA_SIZE)()
+        PresentMask = c_uint64(0)
+        if self.fdpdll.FDP_GetXState(self.pFDP, CpuId, c_uint64(ComponentMask), XsaveArea, byref(PresentMask)) == True:
+            return PresentMask.value, bytes(bytearray(XsaveArea))
+        return None
+
+    def SetXState(self, XsaveArea, ComponentMask, CpuId=FDP_CPU0):
+        """ Write the components in ComponentMask from XsaveArea (standard XSAVE layout) """
+        XsaveArea = (c_uint8 * self.FDP_XSAVE_AREA_SIZE).from_buffer_copy(bytes(XsaveArea).ljust(self.FDP_XSAVE_AREA_SIZE, b"\x00"))
+        return self.fdpdll.FDP_SetXState(self.pFDP, CpuId, c_uint64(ComponentMask), XsaveArea)
+
+    def GetXStateLayout(self, Component):
+        """ Return (Offset, Size) of XSAVE component number Component (bit index) in the XSAVE area, or None """
+        Offset = c_uint32(0)
+        Size = c_uint32(0)
+        if self.fdpdll.FDP_GetXStateLayout(Component, byref(Offset), byref(Size)) == True:
+            return Offset.value, Size.value
+        return None
+
     def Pause(self):
         """ Suspend the target virtual machine """
         return self.fdpdll.FDP_Pause(self.pFDP)
@@ -236,6 +692,31 @@ class FDP(object):
         """ Restore the previously stored virtual machine state (CPU+memory). """
         return self.fdpdll.FDP_Restore(self.pFDP)
 
+    def SaveSnapshot(self, Name):
+        """ Save the guest RAM and CPU state under Name, replacing a snapshot with the same name. Pages unchanged
+        since the last snapshot saved or restored are shared with it. Return True on success """
+        return self.fdpdll.FDP_SaveSnapshot(self.pFDP, Name.encode())
+
+    def RestoreSnapshot(self, Name):
+        """ Restore the guest RAM and CPU state saved by SaveSnapshot. Return True on success.
+        Without FDP_SNAPSHOT_DEVICE_STATE in its Flags, a snapshot is refused once the guest ran since it was saved or restored. """
+        return self.fdpdll.FDP_RestoreSnapshot(self.pFDP, Name.encode())
+
+    def DeleteSnapshot(self, Name):
+        """ Free the snapshot, the pages it shares stay with the other snapshots. Return True on success """
+        return self.fdpdll.FDP_DeleteSnapshot(self.pFDP, Name.encode())
+
+    def ListSnapshots(self):
+        """ Return a list of dicts (Name, Timestamp, PageCount, PrivatePageCount, LastRestorePageCount, Flags), or None on failure.
+        PrivatePageCount pages are freed by DeleteSnapshot, LastRestorePageCount pages were written back by the last RestoreSnapshot. """
+        Snapshots = (FDP_SNAPSHOT_INFO * FDP_MAX_SNAPSHOTS)()
+        SnapshotCount = c_uint32(0)
+        if self.fdpdll.FDP_ListSnapshots(self.pFDP, Snapshots, FDP_MAX_SNAPSHOTS, byref(SnapshotCount)) == False:
+            return None
+        return [dict(Name=Info.Name.decode(), Timestamp=Info.Timestamp, PageCount=Info.PageCount,
+                     PrivatePageCount=Info.PrivatePageCount,
+                     LastRestorePageCount=Info.LastRestorePageCount, Flags=Info.Flags) for Info in Snapshots[:SnapshotCount.value]]
+
     def Reboot(self):
         """ Reboot the target virtual machine """
         return self.fdpdll.FDP_Reboot(self.pFDP)
@@ -244,6 +725,35 @@ class FDP(object):
         """ Single step a paused execution """
         return self.fdpdll.FDP_SingleStep(self.pFDP, CpuId)
 
+    def SingleStepN(self, StepCount, Registers=[], StopConditions=[], CpuId=FDP_CPU0):
+        """ Single step a paused execution StepCount times in a single request, or until all StopConditions hold.
+        StopConditions are built by RegisterCondition and MemoryCondition.
+        Return (list of (Rip, {Register: Value}) after each step, EndReason) or None on failure.
+        """
+        RegisterMask, RegisterIds = self.__register_mask__(Registers)
+        ValueCount = 1 + len(RegisterIds)
+        Trace = (c_uint64 * (StepCount * ValueCount))()
+        Conditions = (FDP_BREAKPOINT_CONDITION * len(StopConditions))(*StopConditions)
+        Count = c_uint32(0)
+        EndReason = c_uint32(0)
+        if self.fdpdll.FDP_SingleStepN(self.pFDP, CpuId, StepCount, c_uint64(RegisterMask), Conditions, len(StopConditions), Trace, byref(Count), byref(EndReason)) == False:
+            return None
+        Steps = []
+        for i in range(Count.value):
+            Values = dict(zip(RegisterIds, Trace[i * ValueCount + 1:(i + 1) * ValueCount]))
+            Steps.append((Trace[i * ValueCount], dict((Register, Values[self.RegisterIds.get(Register, Register)]) for Register in Registers)))
+        return (Steps, EndReason.value)
+
+    def StepUntil(self, Flags, RangeStart=0, RangeEnd=0, MaxStepCount=0x100000, CpuId=FDP_CPU0):
+        """ Single step a paused execution until one of the FDP.FDP_STEP_UNTIL_* Flags holds, e.g. FDP_STEP_UNTIL_RETURN to step out
+        or FDP_STEP_UNTIL_RIP_OUTSIDE with a module range. The stepping is done by the server.
+        Return a FDP_STEP_UNTIL_RESULT (StepCount, EndReason, StopFlags, CpuState) or None on failure.
+        """
+        Result = FDP_STEP_UNTIL_RESULT()
+        if self.fdpdll.FDP_StepUntil(self.pFDP, CpuId, Flags, c_uint64(RangeStart), c_uint64(RangeEnd), MaxStepCount, byref(Result)) == False:
+            return None
+        return Result
+
     def ReadVirtualMemory(self, VirtualAddress, ReadSize, CpuId=FDP_CPU0):
         """ Attempt to read a VM virtual memory buffer. 
         Check CR3 to know which process's memory your're reading
@@ -318,6 +828,209 @@ class FDP(object):
         """ Remove the selected breakoint. Return True on success """
         return self.fdpdll.FDP_UnsetBreakpoint(self.pFDP, c_uint8(BreakpointId))
 
+    def SetBreakpoints(self, Breakpoints, CpuId=FDP_CPU0):
+        """ Set several breakpoints in a single request.
+
+        * Breakpoints: list of (BreakpointType, BreakpointAccessType, BreakpointAddressType, BreakpointAddress, BreakpointLength, BreakpointCr3)
+          tuples, see SetBreakpoint. A seventh item requests a breakpoint id, e.g. to re-arm breakpoints under their previous ids.
+
+        Return a list of breakpoint ids, None for each breakpoint that couldn't be set.
+        """
+        Entries = (FDP_BREAKPOINT_ENTRY * len(Breakpoints))()
+        for i, Breakpoint in enumerate(Breakpoints):
+            Entries[i].CpuId = CpuId
+            Entries[i].BreakpointId = Breakpoint[6] if len(Breakpoint) > 6 else -1
+            (Entries[i].BreakpointType, Entries[i].BreakpointAccessType, Entries[i].BreakpointAddressType,
+             Entries[i].BreakpointAddress, Entries[i].BreakpointLength, Entries[i].BreakpointCr3) = Breakpoint[:6]
+        self.fdpdll.FDP_SetBreakpoints(self.pFDP, Entries, len(Breakpoints))
+        return [Entry.BreakpointId if Entry.BreakpointId >= 0 else None for Entry in Entries]
+
+    def UnsetBreakpoints(self, BreakpointIds):
+        """ Remove several breakpoints in a single request. Return a list of booleans, one per breakpoint """
+        Ids = (c_uint8 * len(BreakpointIds))(*BreakpointIds)
+        Unset = (c_bool * len(BreakpointIds))()
+        self.fdpdll.FDP_UnsetBreakpoints(self.pFDP, Ids, len(BreakpointIds), Unset)
+        return list(Unset)
+
+    def RegisterCondition(self, Register, Operator, Value, Mask=0xFFFFFFFFFFFFFFFF):
+        """ Return a breakpoint condition comparing (Register & Mask) to Value, e.g. (FDP.FDP_CR3_REGISTER, FDP.FDP_CONDITION_EQ, Cr3) """
+        return FDP_BREAKPOINT_CONDITION(self.FDP_CONDITION_REGISTER, Operator, 0, 0, self.RegisterIds.get(Register, Register), 0, Mask, Value)
+
+    def MemoryCondition(self, Register, Offset, Size, Operator, Value, Mask=0xFFFFFFFFFFFFFFFF):
+        """ Return a breakpoint condition comparing the Size (1, 2, 4 or 8) bytes at virtual address [Register + Offset] to Value """
+        return FDP_BREAKPOINT_CONDITION(self.FDP_CONDITION_MEMORY, Operator, Size, 0, self.RegisterIds.get(Register, Register), Offset, Mask, Value)
+
+    def SetBreakpointCondition(self, BreakpointId, Conditions):
+        """ Only stop on the breakpoint when all Conditions hold, they are evaluated by the VMM at each hit.
+        Conditions are built by RegisterCondition and MemoryCondition, up to 8 of them. An empty list removes them.
+        Return True on success
+        """
+        Entries = (FDP_BREAKPOINT_CONDITION * len(Conditions))(*Conditions)
+        return self.fdpdll.FDP_SetBreakpointCondition(self.pFDP, BreakpointId, Entries, len(Conditions))
+
+    def __program__(self, Instructions):
+        return (FDP_PROGRAM_INSTRUCTION * len(Instructions))(*[FDP_PROGRAM_INSTRUCTION(Opcode, Dst, Src, 0, Offset, Imm) for Opcode, Dst, Src, Offset, Imm in Instructions])
+
+    def VerifyProgram(self, Instructions):
+        """ Return True if the server would accept the program, see LoadProgram """
+        return self.fdpdll.FDP_VerifyProgram(self.__program__(Instructions), len(Instructions))
+
+    def LoadProgram(self, Instructions):
+        """ Load a breakpoint program in the server, return its id or None on failure.
+
+        Instructions are (Opcode, Dst, Src, Offset, Imm) tuples, with FDP.FDP_OP_* opcodes, e.g.
+        (FDP.FDP_OP_ADD | FDP.FDP_OP_IMM, 6, 0, 0, 1) for r6 += 1. A run starts with r1 = CpuId and
+        r2 = BreakpointId, FDP.FDP_OP_CALL calls the FDP.FDP_HELPER_* helper Imm with arguments r1-r5,
+        the VM only stops if r0 != 0 on FDP.FDP_OP_EXIT.
+        """
+        ProgramId = self.fdpdll.FDP_LoadProgram(self.pFDP, self.__program__(Instructions), len(Instructions))
+        if ProgramId >= 0:
+            return ProgramId
+        return None
+
+    def UnloadProgram(self, ProgramId):
+        """ Detach the program from its breakpoints and free it. Return True on success """
+        return self.fdpdll.FDP_UnloadProgram(self.pFDP, ProgramId)
+
+    def AttachProgram(self, BreakpointId, ProgramId):
+        """ Run the program at each hit of the breakpoint, ProgramId None detaches it. Return True on success """
+        return self.fdpdll.FDP_AttachProgram(self.pFDP, BreakpointId, -1 if ProgramId is None else ProgramId)
+
+    def ReadProgramMap(self, ProgramId, FirstIndex=0, Count=FDP_PROGRAM_MAP_SIZE):
+        """ Return Count values of the program map from FirstIndex, or None on failure """
+        Values = (c_uint64 * Count)()
+        if self.fdpdll.FDP_ReadProgramMap(self.pFDP, ProgramId, FirstIndex, Count, Values) == True:
+            return list(Values)
+        return None
+
+    def AddExecuteBreakpoint(self, PhysicalAddress):
+        """ Break on the execution of PhysicalAddress, return a handle or None on failure.
+
+        Unlike SetBreakpoint there can be up to FDP_MAX_BREAKPOINT_HANDLES of them, the breakpoints
+        of a page share one page breakpoint. Add them while the VM is paused.
+        """
+        Handle = c_uint32(0)
+        if self.fdpdll.FDP_AddExecuteBreakpoint(self.pFDP, PhysicalAddress, byref(Handle)) == True:
+            return Handle.value
+        return None
+
+    def RemoveExecuteBreakpoint(self, Handle):
+        """ Remove a breakpoint of AddExecuteBreakpoint. Return True on success """
+        return self.fdpdll.FDP_RemoveExecuteBreakpoint(self.pFDP, Handle)
+
+    def GetHitBreakpointHandle(self, CpuId=FDP_CPU0):
+        """ Return the handle of the execute breakpoint that stopped the CPU, or None """
+        Handle = c_uint32(0)
+        if self.fdpdll.FDP_GetHitBreakpointHandle(self.pFDP, CpuId, byref(Handle)) == True:
+            return Handle.value
+        return None
+
+    def SetCoverageBlocks(self, PhysicalAddresses):
+        """ Arm one-shot execute breakpoints on the physical addresses of basic blocks, replacing the previous ones.
+        A hit marks the block and disarms it without stopping the VM. An empty list disarms the coverage.
+        Return True on success
+        """
+        self.CoverageBlockCount = len(PhysicalAddresses)
+        Addresses = (c_uint64 * len(PhysicalAddresses))(*PhysicalAddresses)
+        return self.fdpdll.FDP_SetCoverageBlocks(self.pFDP, Addresses, len(PhysicalAddresses))
+
+    def GetCoverage(self):
+        """ Return the hit bitmap as bytes, bit n is the n-th block given to SetCoverageBlocks, or None on failure """
+        Bitmap = (c_uint8 * max((self.CoverageBlockCount + 7) // 8, 1))()
+        HitCount = c_uint32(0)
+        if self.fdpdll.FDP_GetCoverage(self.pFDP, Bitmap, len(Bitmap), byref(HitCount)) == False:
+            return None
+        return bytes(Bitmap[:(self.CoverageBlockCount + 7) // 8])
+
+    def ResetCoverage(self):
+        """ Clear the hit bitmap and arm every block again. Return True on success """
+        return self.fdpdll.FDP_ResetCoverage(self.pFDP)
+
+    def SetTracepoint(self, BreakpointId, Flags=FDP_TRACEPOINT_LOG, Registers=()):
+        """ Turn an existing breakpoint into a tracepoint. Return True on success
+
+        * Flags: FDP.FDP_TRACEPOINT_LOG appends each hit to the hit log and lets the VM run,
+          add FDP.FDP_TRACEPOINT_STOP to stop the VM too. 0 turns it back into a regular breakpoint.
+        * Registers: up to 6 members of FDP.FDP_REGISTER or register names saved with each hit, RIP and CR3 always are.
+        """
+        RegisterMask, RegisterIds = self.__register_mask__(Registers)
+        return self.fdpdll.FDP_SetTracepoint(self.pFDP, BreakpointId, Flags, c_uint64(RegisterMask))
+
+    def DrainHitLog(self, MaxCount=4096):
+        """ Return the tracepoint hits logged since the last call, oldest first, as a list of dicts.
+        Saved registers are in "Registers", keyed by register id. Records written by programs have
+        the r1-r5 values of FDP.FDP_HELPER_OUTPUT in "Output" instead. Watchpoint records have the
+        "Address", "Size" and "Access" of the access instead, 0 when the backend can't tell.
+        """
+        Records = (FDP_HIT_RECORD * MaxCount)()
+        Count = self.fdpdll.FDP_DrainHitLog(self.pFDP, Records, MaxCount)
+        Hits = []
+        for Record in Records[:Count]:
+            Hit = {
+                "Timestamp": Record.Timestamp,
+                "CpuId": Record.CpuId,
+                "BreakpointId": Record.BreakpointId,
+                "Rip": Record.Rip,
+                "Cr3": Record.Cr3,
+            }
+            if Record.RegisterMask == FDP_HIT_RECORD_PROGRAM_OUTPUT:
+                Hit["Output"] = list(Record.RegisterValues[:5])
+            elif Record.RegisterMask == FDP_HIT_RECORD_WATCHPOINT:
+                Hit["Address"], Hit["Size"], Hit["Access"] = Record.RegisterValues[:3]
+            else:
+                RegisterIds = [RegisterId for RegisterId in range(64) if Record.RegisterMask & (1 << RegisterId)]
+                Hit["Registers"] = dict(zip(RegisterIds, Record.RegisterValues))
+            Hits.append(Hit)
+        return Hits
+
+    def CreateAggregation(self, KeyType=FDP_AGGREGATE_RIP, StackOffset=0, MaxKeyCount=4096):
+        """ Create a server-side hit counter keyed by KeyType. Return the aggregation id, -1 on failure.
+
+        * KeyType: FDP.FDP_AGGREGATE_BREAKPOINT_ID, FDP.FDP_AGGREGATE_RIP, FDP.FDP_AGGREGATE_CR3 or
+          FDP.FDP_AGGREGATE_RETURN_ADDRESS, the uint64 at RSP + StackOffset (the caller at a function entry with 0)
+        * MaxKeyCount: hits on new keys past it are counted as dropped
+        """
+        return self.fdpdll.FDP_CreateAggregation(self.pFDP, KeyType, StackOffset, MaxKeyCount)
+
+    def DeleteAggregation(self, AggregationId):
+        """ Detach the aggregation from its breakpoints and free it. Return True on success """
+        return self.fdpdll.FDP_DeleteAggregation(self.pFDP, AggregationId)
+
+    def AttachAggregation(self, BreakpointId, AggregationId):
+        """ Count each hit of the breakpoint without stopping the VM (unless the breakpoint is a tracepoint with
+        FDP.FDP_TRACEPOINT_STOP), AggregationId None detaches it. Return True on success """
+        return self.fdpdll.FDP_AttachAggregation(self.pFDP, BreakpointId, -1 if AggregationId is None else AggregationId)
+
+    def GetAggregation(self, AggregationId, Reset=False):
+        """ Return ({Key: Count}, DroppedCount), or None on failure. Reset clears the counts in the same request. """
+        Entries = (FDP_AGGREGATION_ENTRY * FDP_AGGREGATION_MAX_KEYS)()
+        EntryCount = c_uint32(0)
+        DroppedCount = c_uint64(0)
+        if self.fdpdll.FDP_GetAggregation(self.pFDP, AggregationId, Reset, Entries, FDP_AGGREGATION_MAX_KEYS, byref(EntryCount), byref(DroppedCount)) == False:
+            return None
+        return dict((Entry.Key, Entry.Count) for Entry in Entries[:EntryCount.value]), DroppedCount.value
+
+    def ResetAggregation(self, AggregationId):
+        """ Clear the counts of the aggregation. Return True on success """
+        return self.fdpdll.FDP_ResetAggregation(self.pFDP, AggregationId)
+
+    def SetWatchpoint(self, Address, Length, Access=FDP_WRITE_BP, AddressType=FDP_VIRTUAL_ADDRESS, Flags=0, Cr3=FDP_NO_CR3, CpuId=FDP_CPU0):
+        """ Watch [Address, Address + Length) with a page breakpoint, the hits outside of the range are dropped
+        by the server. Return the breakpoint id, -1 on failure. Unset it with UnsetBreakpoint.
+
+        * Access: FDP.FDP_READ_BP, FDP.FDP_WRITE_BP and/or FDP.FDP_EXECUTE_BP
+        * Flags: 0 stops the VM at each access, FDP.FDP_TRACEPOINT_LOG logs each access to the hit log
+          (see DrainHitLog) and lets the VM run, add FDP.FDP_TRACEPOINT_STOP to stop the VM too.
+        """
+        return self.fdpdll.FDP_SetWatchpoint(self.pFDP, CpuId, Access, AddressType, c_uint64(Address), c_uint64(Length), c_uint64(Cr3), Flags)
+
+    def GetHitLogStats(self):
+        """ Return the hit log statistics as a dict, or None if the server has no hit log. """
+        Stats = FDP_HIT_LOG_STATS()
+        if self.fdpdll.FDP_GetHitLogStats(self.pFDP, byref(Stats)) == True:
+            return dict((Field[0], getattr(Stats, Field[0])) for Field in Stats._fields_)
+        return None
+
     def GetState(self):
         """ Return the bitfield state of an system execution break (all CPUs considered):
 
@@ -342,6 +1055,23 @@ class FDP(object):
             return self.pState[0]
         return None
 
+    def GetAllCpuStates(self):
+        """ Return (State, CpuStates) in a single request, or None on failure.
+
+        CpuStates holds one dict per CPU with its "State" bitfield, the "BreakpointId" that
+        stopped it (-1 if none or unknown) and its "Rip", "Rsp" and "Cr3" (0 while running).
+        """
+        CpuCount = c_uint32(64)
+        while True:
+            CpuStates = (FDP_CPU_STATE_ENTRY * CpuCount.value)()
+            if self.fdpdll.FDP_GetAllCpuStates(self.pFDP, self.pState, CpuStates, len(CpuStates), byref(CpuCount)) == True:
+                break
+            # Only retry when there are more CPUs than entries
+            if CpuCount.value <= len(CpuStates):
+                return None
+        CpuStates = CpuStates[:CpuCount.value]
+        return self.pState[0], [{Field: getattr(Entry, Field) for Field in ("State", "BreakpointId", "Rip", "Rsp", "Cr3")} for Entry in CpuStates]
+
     def GetPhysicalMemorySize(self):
         """ return the target VM physical memory size, or None on failure """
         pPhysicalMemorySize = pointer(c_uint64(0))
@@ -375,11 +1105,121 @@ class FDP(object):
         """
         return self.fdpdll.FDP_InjectInterrupt(self.pFDP, CpuId, InterruptionCode, ErrorCode, c_uint64(Cr2Value))
 
+    def SetReadahead(self, bEnable):
+        """ Enable or disable the virtual memory read cache.
+        While the VM is stopped, sequential ReadVirtualMemory calls make the library prefetch the following pages.
+        """
+        return self.fdpdll.FDP_SetReadahead(self.pFDP, bEnable)
+
+    def InvalidateReadahead(self):
+        """ Drop cached pages, needed if the VM memory was changed by someone else than this client. """
+        self.fdpdll.FDP_InvalidateReadahead(self.pFDP)
+
+    def GetReadaheadStats(self):
+        """ Return the read cache statistics as a dict, or None if readahead is disabled. """
+        Stats = FDP_READAHEAD_STATS()
+        if self.fdpdll.FDP_GetReadaheadStats(self.pFDP, byref(Stats)) == True:
+            return dict((Field[0], getattr(Stats, Field[0])) for Field in Stats._fields_)
+        return None
+
+    def SetRegisterCache(self, bEnable):
+        """ Enable or disable the register cache.
+        While the VM is stopped, register values are kept and register writes are sent as one batch
+        right before anything that depends on them (Resume, SingleStep, virtual memory accesses...).
+        """
+        return self.fdpdll.FDP_SetRegisterCache(self.pFDP, bEnable)
+
+    def FlushRegisterCache(self):
+        """ Send pending register writes now, return False if one of them failed. """
+        return self.fdpdll.FDP_FlushRegisterCache(self.pFDP)
+
+    def InvalidateRegisterCache(self):
+        """ Drop cached registers, needed if they were changed by someone else than this client. """
+        self.fdpdll.FDP_InvalidateRegisterCache(self.pFDP)
+
+    def GetRegisterCacheStats(self):
+        """ Return the register cache statistics as a dict, or None if the cache is disabled. """
+        Stats = FDP_REGISTER_CACHE_STATS()
+        if self.fdpdll.FDP_GetRegisterCacheStats(self.pFDP, byref(Stats)) == True:
+            return dict((Field[0], getattr(Stats, Field[0])) for Field in Stats._fields_)
+        return None
+
+    def SwapMemory(self, Swaps, AddressType=FDP_PHYSICAL_ADDRESS, CpuId=FDP_CPU0):
+        """ Atomically replace small memory chunks (up to 16 bytes each), the VM doesn't run in between.
+
+        * Swaps: list of (Address, NewBytes) or (Address, NewBytes, ExpectedBytes) tuples.
+          With ExpectedBytes, NewBytes is only written if memory still holds ExpectedBytes.
+
+        Return a list of (Status, OldBytes), Status being a FDP.FDP_SWAP_* value.
+        Raise ValueError if NewBytes isn't 1 to FDP_SWAP_MAX_SIZE bytes or ExpectedBytes has another size.
+        """
+        for Swap in Swaps:
+            if len(Swap[1]) == 0 or len(Swap[1]) > self.FDP_SWAP_MAX_SIZE:
+                raise ValueError("SwapMemory: {} bytes at {:#x}, 1 to {} expected".format(len(Swap[1]), Swap[0], self.FDP_SWAP_MAX_SIZE))
+            if len(Swap) > 2 and len(Swap[2]) != len(Swap[1]):
+                raise ValueError("SwapMemory: {} expected bytes for {} new bytes at {:#x}".format(len(Swap[2]), len(Swap[1]), Swap[0]))
+        Entries = (FDP_SWAP_ENTRY * len(Swaps))()
+        for i, Swap in enumerate(Swaps):
+            Entries[i].Address = Swap[0]
+            Entries[i].Size = len(Swap[1])
+            memmove(Entries[i].New, Swap[1], len(Swap[1]))
+            if len(Swap) > 2:
+                Entries[i].bCompare = 1
+                memmove(Entries[i].Expected, Swap[2], len(Swap[2]))
+        self.fdpdll.FDP_SwapMemory(self.pFDP, CpuId, AddressType, Entries, len(Swaps))
+        return [(Entry.Status, bytes(Entry.Old[:Entry.Size])) for Entry in Entries]
+
+    def HashPhysicalMemory(self, PhysicalAddress, Size, Algorithm=FDP_HASH_XXH64):
+        """ Return the hash of a VM physical memory range, computed by the server, or None on failure. """
+        pHash = pointer(c_uint64(0))
+        if self.fdpdll.FDP_HashPhysicalMemory(self.pFDP, Algorithm, c_uint64(PhysicalAddress), c_uint64(Size), pHash) == True:
+            return pHash[0]
+        return None
+
+    def HashVirtualMemory(self, VirtualAddress, Size, Algorithm=FDP_HASH_XXH64, CpuId=FDP_CPU0):
+        """ Return the hash of a VM virtual memory range, computed by the server, or None on failure. """
+        pHash = pointer(c_uint64(0))
+        if self.fdpdll.FDP_HashVirtualMemory(self.pFDP, CpuId, Algorithm, c_uint64(VirtualAddress), c_uint64(Size), pHash) == True:
+            return pHash[0]
+        return None
+
+    def HashPhysicalPages(self, PhysicalAddress, PageCount, Algorithm=FDP_HASH_XXH64):
+        """ Return a list with one hash per 4K page, FDP.FDP_HASH_UNREADABLE_PAGE for pages that couldn't be read.
+        Compare it with a previous list to only fetch the pages that changed.
+        """
+        PageHashes = (c_uint64 * PageCount)()
+        if self.fdpdll.FDP_HashPhysicalPages(self.pFDP, Algorithm, c_uint64(PhysicalAddress), c_uint64(PageCount), PageHashes) == True:
+            return list(PageHashes)
+        return None
+
+    def HashVirtualPages(self, VirtualAddress, PageCount, Algorithm=FDP_HASH_XXH64, CpuId=FDP_CPU0):
+        """ Same as HashPhysicalPages on VM virtual memory. """
+        PageHashes = (c_uint64 * PageCount)()
+        if self.fdpdll.FDP_HashVirtualPages(self.pFDP, CpuId, Algorithm, c_uint64(VirtualAddress), c_uint64(PageCount), PageHashes) == True:
+            return list(PageHashes)
+        return None
+
+    def WalkList(self, HeadAddress, NextOffset, RecordOffset=0, RecordSize=0, MaxCount=0x10000, Flags=0, AddressType=FDP_VIRTUAL_ADDRESS, CpuId=FDP_CPU0):
+        """ Follow a linked list in the VM memory, the pointer chasing is done by the server.
+
+        * NextOffset: offset of the next pointer in a node
+        * RecordOffset, RecordSize: bytes read for each node, relative to the node address (RecordOffset can be negative)
+        * Flags: FDP.FDP_WALK_LIST_* flags, e.g. FDP_WALK_LIST_SKIP_HEAD for a LIST_ENTRY head
+
+        Return (list of (NodeAddress, RecordBytes), EndReason) or None on failure.
+        """
+        NodeAddresses = (c_uint64 * MaxCount)()
+        Records = (c_uint8 * max(MaxCount * RecordSize, 1))()
+        Count = c_uint32(0)
+        EndReason = c_uint32(0)
+        if self.fdpdll.FDP_WalkList(self.pFDP, CpuId, AddressType, c_uint64(HeadAddress), NextOffset, RecordOffset, RecordSize, MaxCount, Flags, NodeAddresses, Records, byref(Count), byref(EndReason)) == False:
+            return None
+        Nodes = [(NodeAddresses[i], bytes(Records[i * RecordSize:(i + 1) * RecordSize])) for i in range(Count.value)]
+        return (Nodes, EndReason.value)
+
     def UnsetAllBreakpoint(self):
-        """ Remove every set breakpionts """
-        for i in range(0,FDP.FDP_MAX_BREAKPOINT):
-            self.UnsetBreakpoint(i)
-        return True
+        """ Remove every set breakpionts, execute breakpoints included, in a single request """
+        return self.fdpdll.FDP_UnsetAllBreakpoints(self.pFDP)
 
     def WaitForStateChanged(self):
         """ wait for the VM state to change """
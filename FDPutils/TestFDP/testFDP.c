@@ -26,12 +26,16 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "utils.h"
 #include "FDP.h"
+#include "FDP_diff.h"
+#include "FDP_archive.h"
 
 int iTimerDelay = 2;
 bool TimerGo = false;
@@ -1207,145 +1211,1921 @@ bool testSingleStepSpeed(FDP_SHM* pFDP){
     return true;
 }
 
+bool testSingleStepN(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+    bool bReturnValue = false;
+    const uint32_t StepCount = 100000;
+    uint64_t RegisterMask = FDP_REGISTER_MASK(FDP_RSP_REGISTER) | FDP_REGISTER_MASK(FDP_CR3_REGISTER);
+    uint64_t* pTrace = (uint64_t*)malloc(StepCount * 3 * sizeof(uint64_t));
+    uint32_t DoneCount = 0;
+    uint32_t EndReason = 0;
+    uint64_t RipValue = 0;
+
+    if (pTrace == NULL || FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    struct timespec Start;
+    struct timespec End;
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    if (FDP_SingleStepN(pFDP, 0, StepCount, RegisterMask, NULL, 0, pTrace, &DoneCount, &EndReason) == false
+        || EndReason != FDP_STEP_END_COUNT
+        || DoneCount != StepCount){
+        printf("Failed to FDP_SingleStepN !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &RipValue) == false
+        || RipValue != pTrace[(StepCount - 1) * 3]){
+        printf("Trace doesn't end at RIP !\n");
+        goto Fail;
+    }
+
+    //Always true, stops after the first step
+    FDP_BREAKPOINT_CONDITION Condition;
+    memset(&Condition, 0, sizeof(Condition));
+    Condition.Operand = FDP_CONDITION_REGISTER;
+    Condition.Operator = FDP_CONDITION_EQ;
+    Condition.RegisterId = FDP_RIP_REGISTER;
+    Condition.Mask = 0;
+    Condition.Value = 0;
+    if (FDP_SingleStepN(pFDP, 0, StepCount, 0, &Condition, 1, pTrace, &DoneCount, &EndReason) == false
+        || EndReason != FDP_STEP_END_CONDITION
+        || DoneCount != 1){
+        printf("Stop condition ignored !\n");
+        goto Fail;
+    }
+    double Seconds = (End.tv_sec - Start.tv_sec) + (End.tv_nsec - Start.tv_nsec) / 1e9;
+    printf("%d steps/s ", (int)(StepCount / Seconds));
+    bReturnValue = true;
+Fail:
+    free(pTrace);
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testStepUntil(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+    bool bReturnValue = false;
+    FDP_STEP_UNTIL_RESULT Result;
+    uint64_t RipValue = 0;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    if (FDP_StepUntil(pFDP, 0, FDP_STEP_UNTIL_BRANCH, 0, 0, 100000, &Result) == false
+        || Result.EndReason != FDP_STEP_END_CONDITION
+        || Result.StopFlags != FDP_STEP_UNTIL_BRANCH){
+        printf("No branch found !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &RipValue) == false
+        || RipValue != Result.CpuState.Rip
+        || (Result.CpuState.State & FDP_STATE_PAUSED) == 0){
+        printf("Wrong final state !\n");
+        goto Fail;
+    }
+    //Any step leaves a one byte range
+    if (FDP_StepUntil(pFDP, 0, FDP_STEP_UNTIL_RIP_OUTSIDE, RipValue, RipValue + 1, 100000, &Result) == false
+        || Result.EndReason != FDP_STEP_END_CONDITION
+        || Result.StepCount != 1){
+        printf("Failed to leave the range !\n");
+        goto Fail;
+    }
+    if (FDP_StepUntil(pFDP, 0, 0, 0, 0, 1000, &Result) == false
+        || Result.EndReason != FDP_STEP_END_COUNT
+        || Result.StepCount != 1000){
+        printf("Step budget not honored !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
 bool testSaveRestore(FDP_SHM* pFDP)
 {
     printf("%s ...", __FUNCTION__);
 
     if (FDP_Pause(pFDP) == false){
         printf("Failed to pause !\n");
-        system("pause");
+        system("pause");
+        return false;
+    }
+
+    if (FDP_Save(pFDP) == false){
+        printf("Failed to save !\n");
+        return false;
+    }
+
+    uint64_t OriginalRipValue;
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &OriginalRipValue) == false){
+        printf("Failed to FDP_ReadRegister\n");
+        return false;
+    }
+
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+
+    for (int i = 0; i < 10; i++){
+        usleep(1000 * 3000);
+
+        if (FDP_Restore(pFDP) == false){
+            printf("Failed to FDP_Restore !\n");
+            return false;
+        }
+
+        uint64_t NewRipValue;
+        if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &NewRipValue) == false){
+            printf("Failed to FDP_ReadRegister\n");
+            return false;
+        }
+
+        if (OriginalRipValue != NewRipValue){
+            printf("OriginalRipValue != NewRipValue\n");
+            return false;
+        }
+
+        if (FDP_Resume(pFDP) == false){
+            printf("Failed to FDP_Resume !\n");
+            return false;
+
+        }
+
+        //Wait for Rip change
+        uint64_t OldRipValue;
+        uint64_t RipValue;
+        FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &OldRipValue);
+        while (true){
+            FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &RipValue);
+            if (RipValue != OldRipValue){
+                break;
+            }
+        }
+
+    }
+
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to FDP_Resume !\n");
+        return false;
+    }
+
+    printf("[OK]\n");
+    return true;
+}
+
+bool testReadAllPhysicalMemory(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint64_t PhysicalAddress = 0;
+    char Buffer[4096];
+    uint64_t PhysicalMaxAddress = 0;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_GetPhysicalMemorySize(pFDP, &PhysicalMaxAddress) == false){
+        printf("Failed to FDP_GetPhysicalMemorySize\n");
+        return false;
+    }
+    while (PhysicalAddress < PhysicalMaxAddress){
+        if (FDP_ReadPhysicalMemory(pFDP, (uint8_t *)Buffer, sizeof(Buffer), PhysicalAddress) == false){
+            //Some PhysicalAddress aren't readeable
+            //printf("Failed to FDP_ReadPhysicalMemory (%p)\n", PhysicalAddress);
+            //return false;
+        }
+        PhysicalAddress += sizeof(Buffer);
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+
+    printf("[OK]\n");
+    return true;
+}
+
+
+bool testReadWriteAllPhysicalMemory(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint64_t PhysicalAddress = 0;
+    char Buffer[4096];
+    uint64_t PhysicalMaxAddress = 0;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_GetPhysicalMemorySize(pFDP, &PhysicalMaxAddress) == false){
+        printf("Failed to FDP_GetPhysicalMemorySize\n");
+        return false;
+    }
+
+    while (PhysicalAddress < PhysicalMaxAddress){
+        if (FDP_ReadPhysicalMemory(pFDP, (uint8_t *)Buffer, sizeof(Buffer), PhysicalAddress) == true){
+            FDP_WritePhysicalMemory(pFDP, (uint8_t *)Buffer, sizeof(Buffer), PhysicalAddress);
+        }
+        PhysicalAddress += sizeof(Buffer);
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+
+    printf("[OK]\n");
+    return true;
+}
+
+
+bool testPhysicalMemoryDiff(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint64_t PhysicalAddress = 4096 * 12;
+    uint8_t OriginalBuffer[4096];
+    uint8_t GarbageBuffer[4096];
+    uint64_t *pPageHashes = NULL;
+    uint64_t PageCount;
+    FDP_DIFF_SOURCE *pSource = NULL;
+    FDP_DIFF_RESULT Result;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    pSource = FDP_DiffOpenLive(pFDP);
+    if (pSource == NULL){
+        printf("Failed to FDP_DiffOpenLive !\n");
+        goto Fail;
+    }
+    PageCount = FDP_DiffGetSourceSize(pSource) / FDP_DIFF_PAGE_SIZE;
+    pPageHashes = (uint64_t*)malloc(PageCount * sizeof(uint64_t));
+    if (pPageHashes == NULL){
+        printf("Failed to malloc !\n");
+        goto Fail;
+    }
+    if (FDP_DiffComputePageHashes(pSource, pPageHashes, PageCount, FDP_DIFF_DEFAULT_THREADS) == false){
+        printf("Failed to FDP_DiffComputePageHashes !\n");
+        goto Fail;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress) == false){
+        printf("Failed to read physical memory !\n");
+        goto Fail;
+    }
+    memcpy(GarbageBuffer, OriginalBuffer, sizeof(GarbageBuffer));
+    GarbageBuffer[0x123] ^= 0xFF;
+    if (FDP_WritePhysicalMemory(pFDP, GarbageBuffer, sizeof(GarbageBuffer), PhysicalAddress) == false){
+        printf("Failed to write physical memory !\n");
+        goto Fail;
+    }
+    if (FDP_DiffCompareHashes(pPageHashes, PageCount, pSource, FDP_DIFF_DEFAULT_THREADS, &Result) == false){
+        printf("Failed to FDP_DiffCompareHashes !\n");
+        FDP_WritePhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress);
+        goto Fail;
+    }
+    FDP_WritePhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress);
+    if (Result.RangeCount != 1
+        || Result.pRanges[0].PhysicalAddress != PhysicalAddress
+        || Result.pRanges[0].Size != FDP_DIFF_PAGE_SIZE){
+        printf("Diff doesn't match the modified page !\n");
+        FDP_DiffFreeResult(&Result);
+        goto Fail;
+    }
+    FDP_DiffFreeResult(&Result);
+    bReturnValue = true;
+Fail:
+    free(pPageHashes);
+    if (pSource != NULL){
+        FDP_DiffCloseSource(pSource);
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+
+bool testSnapshotArchive(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    const char *pArchivePath = "/tmp/testSnapshotArchive.fdpa";
+    uint64_t PhysicalAddress = 4096 * 12;
+    uint8_t OriginalBuffer[4096];
+    uint8_t GarbageBuffer[4096];
+    uint8_t ArchiveBuffer[4096];
+    uint64_t Cr3;
+    uint64_t ArchiveCr3;
+    FDP_ARCHIVE_WRITER *pWriter = NULL;
+    FDP_ARCHIVE *pArchive = NULL;
+    FDP_ARCHIVE_SNAPSHOT_INFO Info;
+    bool bReturnValue = false;
+
+    unlink(pArchivePath);
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_CR3_REGISTER, &Cr3) == false){
+        printf("Failed to read the guest state !\n");
+        goto Fail;
+    }
+    pWriter = FDP_ArchiveOpenWriter(pArchivePath);
+    if (pWriter == NULL){
+        printf("Failed to FDP_ArchiveOpenWriter !\n");
+        goto Fail;
+    }
+    if (FDP_ArchiveWriteSnapshot(pWriter, pFDP, "before") == false){
+        printf("Failed to FDP_ArchiveWriteSnapshot !\n");
+        goto Fail;
+    }
+    memcpy(GarbageBuffer, OriginalBuffer, sizeof(GarbageBuffer));
+    GarbageBuffer[0x123] ^= 0xFF;
+    if (FDP_WritePhysicalMemory(pFDP, GarbageBuffer, sizeof(GarbageBuffer), PhysicalAddress) == false){
+        printf("Failed to write physical memory !\n");
+        goto Fail;
+    }
+    if (FDP_ArchiveWriteSnapshot(pWriter, pFDP, "after") == false){
+        printf("Failed to FDP_ArchiveWriteSnapshot !\n");
+        FDP_WritePhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress);
+        goto Fail;
+    }
+    FDP_WritePhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress);
+    bReturnValue = FDP_ArchiveCloseWriter(pWriter);
+    pWriter = NULL;
+    if (bReturnValue == false){
+        printf("Failed to FDP_ArchiveCloseWriter !\n");
+        goto Fail;
+    }
+    bReturnValue = false;
+
+    pArchive = FDP_ArchiveOpen(pArchivePath);
+    if (pArchive == NULL || FDP_ArchiveGetSnapshotCount(pArchive) != 2){
+        printf("Failed to FDP_ArchiveOpen !\n");
+        goto Fail;
+    }
+    //Only the modified page is new in the second snapshot
+    if (FDP_ArchiveGetSnapshotInfo(pArchive, 1, &Info) == false || Info.NewPageCount != 1){
+        printf("Second snapshot isn't deduplicated !\n");
+        goto Fail;
+    }
+    if (FDP_ArchiveReadPhysicalMemory(pArchive, 0, ArchiveBuffer, sizeof(ArchiveBuffer), PhysicalAddress) == false
+        || memcmp(ArchiveBuffer, OriginalBuffer, sizeof(ArchiveBuffer)) != 0
+        || FDP_ArchiveReadPhysicalMemory(pArchive, 1, ArchiveBuffer, sizeof(ArchiveBuffer), PhysicalAddress) == false
+        || memcmp(ArchiveBuffer, GarbageBuffer, sizeof(ArchiveBuffer)) != 0){
+        printf("Archived memory doesn't match !\n");
+        goto Fail;
+    }
+    if (FDP_ArchiveReadRegister(pArchive, 0, 0, FDP_CR3_REGISTER, &ArchiveCr3) == false || ArchiveCr3 != Cr3){
+        printf("Archived CR3 doesn't match !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (pWriter != NULL){
+        FDP_ArchiveCloseWriter(pWriter);
+    }
+    FDP_ArchiveClose(pArchive);
+    unlink(pArchivePath);
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+
+bool testHashMemory(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint8_t Buffer[4096 * 16];
+    uint64_t PageHashes[16];
+    uint64_t Hash;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, Buffer, sizeof(Buffer), 0) == false){
+        printf("Failed to read physical memory !\n");
+        goto Fail;
+    }
+    if (FDP_HashPhysicalMemory(pFDP, FDP_HASH_XXH64, 0, sizeof(Buffer), &Hash) == false
+        || Hash != FDP_HashBuffer(FDP_HASH_XXH64, Buffer, sizeof(Buffer))){
+        printf("Bad xxh64 hash !\n");
+        goto Fail;
+    }
+    if (FDP_HashPhysicalMemory(pFDP, FDP_HASH_CRC32C, 0x123, 0x1234, &Hash) == false
+        || Hash != FDP_HashBuffer(FDP_HASH_CRC32C, Buffer + 0x123, 0x1234)){
+        printf("Bad crc32c hash !\n");
+        goto Fail;
+    }
+    if (FDP_HashPhysicalPages(pFDP, FDP_HASH_XXH64, 0, 16, PageHashes) == false){
+        printf("Failed to FDP_HashPhysicalPages !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 16; i++){
+        if (PageHashes[i] != FDP_HashBuffer(FDP_HASH_XXH64, Buffer + i * 4096, 4096)){
+            printf("Bad hash for page %d !\n", i);
+            goto Fail;
+        }
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+
+bool testSwapMemory(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint64_t PhysicalAddress = 4096 * 12;
+    uint8_t OriginalBuffer[64];
+    uint8_t CurrentBuffer[64];
+    FDP_SWAP_ENTRY SwapEntries[4];
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress) == false){
+        printf("Failed to read physical memory !\n");
+        goto Fail;
+    }
+    memset(SwapEntries, 0, sizeof(SwapEntries));
+    for (int i = 0; i < 4; i++){
+        SwapEntries[i].Address = PhysicalAddress + i * 16;
+        SwapEntries[i].Size = 1;
+        SwapEntries[i].New[0] = 0xCC;
+    }
+    if (FDP_SwapMemory(pFDP, 0, FDP_PHYSICAL_ADDRESS, SwapEntries, 4) == false){
+        printf("Failed to FDP_SwapMemory !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 4; i++){
+        if (SwapEntries[i].Status != FDP_SWAP_DONE || SwapEntries[i].Old[0] != OriginalBuffer[i * 16]){
+            printf("Bad swap entry %d !\n", i);
+            goto Fail;
+        }
+    }
+    //Memory holds 0xCC now, a compare against the original byte must fail
+    if (OriginalBuffer[0] != 0xCC
+        && FDP_CompareExchangeMemory(pFDP, 0, FDP_PHYSICAL_ADDRESS, PhysicalAddress, OriginalBuffer, OriginalBuffer, NULL, 1) == true){
+        printf("FDP_CompareExchangeMemory ignored Expected !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 4; i++){
+        SwapEntries[i].bCompare = true;
+        SwapEntries[i].Expected[0] = 0xCC;
+        SwapEntries[i].New[0] = OriginalBuffer[i * 16];
+    }
+    if (FDP_SwapMemory(pFDP, 0, FDP_PHYSICAL_ADDRESS, SwapEntries, 4) == false){
+        printf("Failed to FDP_SwapMemory !\n");
+        goto Fail;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, CurrentBuffer, sizeof(CurrentBuffer), PhysicalAddress) == false
+        || memcmp(CurrentBuffer, OriginalBuffer, sizeof(CurrentBuffer)) != 0){
+        printf("Memory not restored !\n");
+        FDP_WritePhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress);
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+
+bool testReadahead(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint64_t VirtualAddress;
+    uint8_t ReferenceBuffer[4096 * 4];
+    uint8_t Buffer[64];
+    FDP_READAHEAD_STATS Stats;
+    bool bReturnValue = false;
+
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &VirtualAddress) == false){
+        printf("Failed to read MSR_LSTAR !\n");
+        return false;
+    }
+    VirtualAddress &= 0xFFFFFFFFFFFFF000;
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadVirtualMemory(pFDP, 0, ReferenceBuffer, sizeof(ReferenceBuffer), VirtualAddress) == false){
+        printf("Failed to read VirtualMemory !\n");
+        goto Fail;
+    }
+    if (FDP_SetReadahead(pFDP, true) == false){
+        printf("Failed to FDP_SetReadahead !\n");
+        goto Fail;
+    }
+    for (uint32_t Offset = 0; Offset < sizeof(ReferenceBuffer); Offset += sizeof(Buffer)){
+        if (FDP_ReadVirtualMemory(pFDP, 0, Buffer, sizeof(Buffer), VirtualAddress + Offset) == false
+            || memcmp(Buffer, ReferenceBuffer + Offset, sizeof(Buffer)) != 0){
+            printf("Bad cached read at +0x%x !\n", Offset);
+            goto Fail;
+        }
+    }
+    if (FDP_GetReadaheadStats(pFDP, &Stats) == false || Stats.HitCount == 0){
+        printf("Nothing served from the cache !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    FDP_SetReadahead(pFDP, false);
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK] %llu/%llu hits\n", (unsigned long long)Stats.HitCount, (unsigned long long)Stats.ReadCount);
+    }
+    return bReturnValue;
+}
+
+
+bool testWalkList(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    //Circular list of 3 nodes behind a LIST_ENTRY-like head, all in one physical page
+    uint64_t PhysicalAddress = 4096 * 12;
+    uint8_t OriginalBuffer[4096];
+    uint64_t NodeList[4 * 4];
+    uint64_t NodeAddresses[8];
+    uint64_t Records[8];
+    uint32_t Count;
+    uint32_t EndReason;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress) == false){
+        printf("Failed to read physical memory !\n");
+        goto Fail;
+    }
+    //Node i is at PhysicalAddress + i * 32: { Next, Record }, node 0 is the head
+    for (int i = 0; i < 4; i++){
+        NodeList[i * 4] = PhysicalAddress + ((i + 1) % 4) * 32;
+        NodeList[i * 4 + 1] = 0x1000 + i;
+    }
+    if (FDP_WritePhysicalMemory(pFDP, (uint8_t*)NodeList, sizeof(NodeList), PhysicalAddress) == false){
+        printf("Failed to write physical memory !\n");
+        goto Fail;
+    }
+    if (FDP_WalkList(pFDP, 0, FDP_PHYSICAL_ADDRESS, PhysicalAddress, 0, 8, sizeof(uint64_t), 8, FDP_WALK_LIST_SKIP_HEAD,
+                     NodeAddresses, (uint8_t*)Records, &Count, &EndReason) == false){
+        printf("Failed to FDP_WalkList !\n");
+        goto Restore;
+    }
+    if (Count != 3 || EndReason != FDP_WALK_LIST_END_HEAD){
+        printf("Bad walk: %u nodes, end %u !\n", Count, EndReason);
+        goto Restore;
+    }
+    for (uint32_t i = 0; i < Count; i++){
+        if (NodeAddresses[i] != PhysicalAddress + (i + 1) * 32 || Records[i] != 0x1000 + i + 1){
+            printf("Bad node %u !\n", i);
+            goto Restore;
+        }
+    }
+    bReturnValue = true;
+Restore:
+    FDP_WritePhysicalMemory(pFDP, OriginalBuffer, sizeof(OriginalBuffer), PhysicalAddress);
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+
+bool testCpuContexts(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    uint32_t CpuCount;
+    uint64_t OriginalRax;
+    uint64_t RegisterValue;
+    bool bReturnValue = false;
+
+    if (FDP_GetCpuCount(pFDP, &CpuCount) == false){
+        printf("Failed to FDP_GetCpuCount !\n");
+        return false;
+    }
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++){
+        if (FDP_ReadRegister(pFDP, CpuId, FDP_CS_REGISTER, &RegisterValue) == false || RegisterValue == 0
+            || FDP_ReadRegister(pFDP, CpuId, FDP_GDTRB_REGISTER, &RegisterValue) == false || RegisterValue == 0
+            || FDP_ReadRegister(pFDP, CpuId, FDP_RFLAGS_REGISTER, &RegisterValue) == false || (RegisterValue & 0x2) == 0){
+            printf("Bad segment/descriptor registers on CPU %u !\n", CpuId);
+            goto Fail;
+        }
+        //A write must be seen by the next read of the same vCPU
+        if (FDP_ReadRegister(pFDP, CpuId, FDP_RAX_REGISTER, &OriginalRax) == false
+            || FDP_WriteRegister(pFDP, CpuId, FDP_RAX_REGISTER, OriginalRax ^ 0x5A5A) == false){
+            printf("Failed to write RAX on CPU %u !\n", CpuId);
+            goto Fail;
+        }
+        FDP_ReadRegister(pFDP, CpuId, FDP_RAX_REGISTER, &RegisterValue);
+        FDP_WriteRegister(pFDP, CpuId, FDP_RAX_REGISTER, OriginalRax);
+        if (RegisterValue != (OriginalRax ^ 0x5A5A)){
+            printf("Stale RAX on CPU %u !\n", CpuId);
+            goto Fail;
+        }
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK] %u CPUs\n", CpuCount);
+    }
+    return bReturnValue;
+}
+
+
+bool testGetCpuContext(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_CPU_CTX CpuCtx;
+    uint64_t Rip;
+    uint64_t Rsp;
+    uint64_t Cr3;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_GetCpuContext(pFDP, 0, &CpuCtx) == false){
+        printf("Failed to FDP_GetCpuContext !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &Rip) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_RSP_REGISTER, &Rsp) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_CR3_REGISTER, &Cr3) == false){
+        printf("Failed to FDP_ReadRegister !\n");
+        goto Fail;
+    }
+    if (CpuCtx.rip != Rip || CpuCtx.rsp != Rsp || CpuCtx.cr3 != Cr3){
+        printf("Snapshot doesn't match the registers !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+
+bool testReadWriteRegisters(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    const uint64_t RegisterMask = FDP_REGISTER_MASK(FDP_RAX_REGISTER) | FDP_REGISTER_MASK(FDP_RBX_REGISTER)
+                                  | FDP_REGISTER_MASK(FDP_RIP_REGISTER) | FDP_REGISTER_MASK(FDP_CR3_REGISTER);
+    const uint64_t WriteMask = FDP_REGISTER_MASK(FDP_RAX_REGISTER) | FDP_REGISTER_MASK(FDP_RBX_REGISTER);
+    uint64_t RegisterValues[4];
+    uint64_t OriginalValues[2];
+    uint64_t NewValues[2] = { 0xDEADBEEFCAFEBABE, 0x0123456789ABCDEF };
+    uint64_t Rax;
+    uint64_t Rbx;
+    uint64_t Rip;
+    uint64_t Cr3;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    //Values come lowest FDP_Register first: rax, rbx, rip, cr3
+    if (FDP_ReadRegisters(pFDP, 0, RegisterMask, RegisterValues) == false){
+        printf("Failed to FDP_ReadRegisters !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RAX_REGISTER, &Rax) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_RBX_REGISTER, &Rbx) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &Rip) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_CR3_REGISTER, &Cr3) == false){
+        printf("Failed to FDP_ReadRegister !\n");
+        goto Fail;
+    }
+    if (RegisterValues[0] != Rax || RegisterValues[1] != Rbx || RegisterValues[2] != Rip || RegisterValues[3] != Cr3){
+        printf("FDP_ReadRegisters doesn't match FDP_ReadRegister !\n");
+        goto Fail;
+    }
+    OriginalValues[0] = Rax;
+    OriginalValues[1] = Rbx;
+    if (FDP_WriteRegisters(pFDP, 0, WriteMask, NewValues) == false){
+        printf("Failed to FDP_WriteRegisters !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegisters(pFDP, 0, RegisterMask, RegisterValues) == false
+        || RegisterValues[0] != NewValues[0] || RegisterValues[1] != NewValues[1] || RegisterValues[2] != Rip){
+        printf("FDP_WriteRegisters didn't write the registers !\n");
+        FDP_WriteRegisters(pFDP, 0, WriteMask, OriginalValues);
+        goto Fail;
+    }
+    if (FDP_WriteRegisters(pFDP, 0, WriteMask, OriginalValues) == false){
+        printf("Failed to restore the registers !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testRegisterCache(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_REGISTER_CACHE_STATS Stats;
+    uint64_t OriginalRbx;
+    uint64_t Rbx;
+    bool bRbxChanged = false;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_SetRegisterCache(pFDP, true) == false){
+        printf("Failed to FDP_SetRegisterCache !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RBX_REGISTER, &OriginalRbx) == false
+        || FDP_ReadRegister(pFDP, 0, FDP_RBX_REGISTER, &Rbx) == false
+        || Rbx != OriginalRbx){
+        printf("Failed to FDP_ReadRegister !\n");
+        goto Fail;
+    }
+    //Both writes go out in a single command
+    bRbxChanged = true;
+    if (FDP_WriteRegister(pFDP, 0, FDP_RBX_REGISTER, 0xDEADBEEF) == false
+        || FDP_WriteRegister(pFDP, 0, FDP_RBX_REGISTER, 0xCAFEBABE) == false){
+        printf("Failed to FDP_WriteRegister !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RBX_REGISTER, &Rbx) == false || Rbx != 0xCAFEBABE){
+        printf("Pending write not visible !\n");
+        goto Fail;
+    }
+    if (FDP_FlushRegisterCache(pFDP) == false){
+        printf("Failed to FDP_FlushRegisterCache !\n");
+        goto Fail;
+    }
+    FDP_InvalidateRegisterCache(pFDP);
+    if (FDP_ReadRegister(pFDP, 0, FDP_RBX_REGISTER, &Rbx) == false || Rbx != 0xCAFEBABE){
+        printf("Write wasn't flushed !\n");
+        goto Fail;
+    }
+    if (FDP_GetRegisterCacheStats(pFDP, &Stats) == false
+        || Stats.HitCount < 2 || Stats.WriteCount != 2 || Stats.FlushCount != 1 || Stats.WritesSaved != 1){
+        printf("Unexpected register cache stats !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (bRbxChanged){
+        FDP_WriteRegister(pFDP, 0, FDP_RBX_REGISTER, OriginalRbx);
+    }
+    FDP_SetRegisterCache(pFDP, false);
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testXState(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_XSAVE_FORMAT64_T FxState;
+    uint8_t XsaveArea[FDP_XSAVE_AREA_SIZE];
+    uint8_t XsaveArea2[FDP_XSAVE_AREA_SIZE];
+    uint64_t PresentMask = 0;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    memset(XsaveArea, 0, sizeof(XsaveArea));
+    memset(XsaveArea2, 0, sizeof(XsaveArea2));
+    if (FDP_GetXState(pFDP, 0, FDP_XSTATE_ALL, XsaveArea, &PresentMask) == false){
+        printf("Failed to FDP_GetXState !\n");
+        goto Fail;
+    }
+    if ((PresentMask & (FDP_XSTATE_X87 | FDP_XSTATE_SSE)) != (FDP_XSTATE_X87 | FDP_XSTATE_SSE)){
+        printf("x87/SSE state not present !\n");
+        goto Fail;
+    }
+    if (FDP_GetFxState64(pFDP, 0, &FxState) == false
+        || memcmp(FxState.XmmRegisters, XsaveArea + 160, sizeof(FxState.XmmRegisters)) != 0){
+        printf("XMM registers don't match FDP_GetFxState64 !\n");
+        goto Fail;
+    }
+    //Nothing changed, the second read comes from the client copy
+    if (FDP_GetXState(pFDP, 0, FDP_XSTATE_ALL, XsaveArea2, NULL) == false
+        || memcmp(XsaveArea, XsaveArea2, sizeof(XsaveArea)) != 0){
+        printf("Second FDP_GetXState differs !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+#define TEST_MAX_CPU 64
+bool testReadWriteMsrs(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    const uint64_t MsrIds[] = { MSR_EFER, MSR_STAR, MSR_LSTAR, MSR_GS_BASE, MSR_KERNEL_GS_BASE };
+    const uint32_t MsrCount = sizeof(MsrIds) / sizeof(MsrIds[0]);
+    FDP_MSR_ENTRY MsrEntries[TEST_MAX_CPU * 5];
+    FDP_MSR_ENTRY LstarEntry;
+    uint32_t CpuCount = 0;
+    uint64_t MsrValue;
+    bool bLstarChanged = false;
+    bool bReturnValue = false;
+
+    if (FDP_GetCpuCount(pFDP, &CpuCount) == false || CpuCount == 0){
+        printf("Failed to FDP_GetCpuCount !\n");
+        return false;
+    }
+    if (CpuCount > TEST_MAX_CPU){
+        CpuCount = TEST_MAX_CPU;
+    }
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    //Every MSR of every CPU in a single request
+    for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++){
+        for (uint32_t i = 0; i < MsrCount; i++){
+            MsrEntries[CpuId * MsrCount + i].CpuId = CpuId;
+            MsrEntries[CpuId * MsrCount + i].MsrId = MsrIds[i];
+        }
+    }
+    if (FDP_ReadMsrs(pFDP, MsrEntries, CpuCount * MsrCount) == false){
+        printf("Failed to FDP_ReadMsrs !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < CpuCount * MsrCount; i++){
+        if (FDP_ReadMsr(pFDP, MsrEntries[i].CpuId, MsrEntries[i].MsrId, &MsrValue) == false
+            || MsrValue != MsrEntries[i].Value){
+            printf("MSR %llx of CPU %u doesn't match FDP_ReadMsr !\n", (unsigned long long)MsrEntries[i].MsrId, MsrEntries[i].CpuId);
+            goto Fail;
+        }
+    }
+
+    LstarEntry = MsrEntries[2];
+    LstarEntry.Value = TEST_MSR_VALUE;
+    bLstarChanged = true;
+    if (FDP_WriteMsrs(pFDP, &LstarEntry, 1) == false
+        || FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &MsrValue) == false
+        || MsrValue != TEST_MSR_VALUE){
+        printf("Failed to FDP_WriteMsrs !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    //Puts back the original LSTAR
+    if (bLstarChanged == true && FDP_WriteMsrs(pFDP, &MsrEntries[2], 1) == false){
+        printf("Failed to restore MSR_LSTAR !\n");
+        bReturnValue = false;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testGetAllCpuStates(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_CPU_STATE_ENTRY CpuStates[TEST_MAX_CPU];
+    uint32_t CpuCount = 0;
+    uint32_t ExpectedCpuCount = 0;
+    FDP_State State = 0;
+    FDP_State CpuState = 0;
+    uint64_t Rip = 0;
+    bool bReturnValue = false;
+
+    if (FDP_GetCpuCount(pFDP, &ExpectedCpuCount) == false){
+        printf("Failed to FDP_GetCpuCount !\n");
+        return false;
+    }
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_GetAllCpuStates(pFDP, &State, CpuStates, TEST_MAX_CPU, &CpuCount) == false
+        || CpuCount != ExpectedCpuCount){
+        printf("Failed to FDP_GetAllCpuStates !\n");
+        goto Fail;
+    }
+    if ((State & FDP_STATE_PAUSED) == 0){
+        printf("VM not paused !\n");
+        goto Fail;
+    }
+    for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++){
+        if (FDP_GetCpuState(pFDP, CpuId, &CpuState) == false
+            || CpuState != CpuStates[CpuId].State){
+            printf("State of CPU %u doesn't match FDP_GetCpuState !\n", CpuId);
+            goto Fail;
+        }
+        if ((CpuState & FDP_STATE_PAUSED)
+            && (FDP_ReadRegister(pFDP, CpuId, FDP_RIP_REGISTER, &Rip) == false || Rip != CpuStates[CpuId].Rip)){
+            printf("RIP of CPU %u doesn't match FDP_ReadRegister !\n", CpuId);
+            goto Fail;
+        }
+    }
+    bReturnValue = true;
+Fail:
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testTracepoint(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_HIT_RECORD Records[256];
+    FDP_HIT_LOG_STATS Stats;
+    FDP_State State = 0;
+    uint64_t SyscallEntry = 0;
+    uint32_t RecordCount = 0;
+    int BreakpointId = -1;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false){
+        printf("Failed to read MSR_LSTAR !\n");
+        goto Fail;
+    }
+    //Drop what previous runs left
+    while (FDP_DrainHitLog(pFDP, Records, 256) > 0);
+    BreakpointId = FDP_SetBreakpoint(pFDP, 0, FDP_SOFTHBP, -1, FDP_EXECUTE_BP, FDP_VIRTUAL_ADDRESS, SyscallEntry, 1, FDP_NO_CR3);
+    if (BreakpointId < 0){
+        printf("Failed to insert breakpoint !\n");
+        goto Fail;
+    }
+    if (FDP_SetTracepoint(pFDP, BreakpointId, FDP_TRACEPOINT_LOG, FDP_REGISTER_MASK(FDP_RAX_REGISTER)) == false){
+        printf("Failed to FDP_SetTracepoint !\n");
+        goto Fail;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(1000 * 1000);
+
+    //The guest must still be running
+    if (FDP_GetState(pFDP, &State) == false
+        || (State & (FDP_STATE_PAUSED | FDP_STATE_BREAKPOINT_HIT))){
+        printf("Tracepoint stopped the VM (state %02x) !\n", State);
+        goto Fail;
+    }
+    RecordCount = FDP_DrainHitLog(pFDP, Records, 256);
+    if (RecordCount == 0){
+        printf("No hit logged !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < RecordCount; i++){
+        if (Records[i].Rip != SyscallEntry
+            || Records[i].BreakpointId != BreakpointId
+            || Records[i].RegisterMask != FDP_REGISTER_MASK(FDP_RAX_REGISTER)
+            || (i > 0 && Records[i].Timestamp < Records[i - 1].Timestamp && Records[i].CpuId == Records[i - 1].CpuId)){
+            printf("Bad hit record %u !\n", i);
+            goto Fail;
+        }
+    }
+    if (FDP_GetHitLogStats(pFDP, &Stats) == false
+        || Stats.HitCount < RecordCount
+        || Stats.LoggedCount < RecordCount){
+        printf("Bad hit log stats !\n");
+        goto Fail;
+    }
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (BreakpointId >= 0){
+        FDP_UnsetBreakpoint(pFDP, BreakpointId);
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testConditionalBreakpoint(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_BREAKPOINT_CONDITION Condition;
+    FDP_State State = 0;
+    uint64_t SyscallEntry = 0;
+    uint64_t Rip = 0;
+    int BreakpointId = -1;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false){
+        printf("Failed to read MSR_LSTAR !\n");
+        goto Fail;
+    }
+    //No syscall has this number
+    memset(&Condition, 0, sizeof(Condition));
+    Condition.Operand = FDP_CONDITION_REGISTER;
+    Condition.Operator = FDP_CONDITION_EQ;
+    Condition.RegisterId = FDP_RAX_REGISTER;
+    Condition.Mask = 0xFFFFFFFFFFFFFFFF;
+    Condition.Value = 0xDEADBEEF;
+    BreakpointId = FDP_SetConditionalBreakpoint(pFDP, 0, FDP_SOFTHBP, -1, FDP_EXECUTE_BP, FDP_VIRTUAL_ADDRESS, SyscallEntry, 1, FDP_NO_CR3, &Condition, 1);
+    if (BreakpointId < 0){
+        printf("Failed to FDP_SetConditionalBreakpoint !\n");
+        goto Fail;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(1000 * 1000);
+    if (FDP_GetState(pFDP, &State) == false
+        || (State & (FDP_STATE_PAUSED | FDP_STATE_BREAKPOINT_HIT))){
+        printf("False condition stopped the VM (state %02x) !\n", State);
+        goto Fail;
+    }
+
+    //Always true once [RSP] is readable
+    Condition.Operand = FDP_CONDITION_MEMORY;
+    Condition.RegisterId = FDP_RSP_REGISTER;
+    Condition.Size = 8;
+    Condition.Mask = 0;
+    Condition.Value = 0;
+    if (FDP_SetBreakpointCondition(pFDP, BreakpointId, &Condition, 1) == false){
+        printf("Failed to FDP_SetBreakpointCondition !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 100; i++){
+        if (FDP_GetState(pFDP, &State) == false){
+            printf("Failed to get state !\n");
+            goto Fail;
+        }
+        if (State & FDP_STATE_BREAKPOINT_HIT){
+            break;
+        }
+        usleep(1000 * 10);
+    }
+    if ((State & FDP_STATE_BREAKPOINT_HIT) == 0){
+        printf("True condition didn't stop the VM !\n");
+        goto Fail;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &Rip) == false
+        || Rip != SyscallEntry){
+        printf("Stopped at %p instead of %p !\n", (void*)Rip, (void*)SyscallEntry);
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (BreakpointId >= 0){
+        FDP_UnsetBreakpoint(pFDP, BreakpointId);
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testBreakpointProgram(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    //Counts syscalls in map[0], stops on syscall number 0xDEADBEEF only
+    FDP_PROGRAM_INSTRUCTION Program[] = {
+        { FDP_OP_MOV | FDP_OP_IMM, 1, 0, 0, 0, 0 },
+        { FDP_OP_MOV | FDP_OP_IMM, 2, 0, 0, 0, 1 },
+        { FDP_OP_CALL, 0, 0, 0, 0, FDP_HELPER_MAP_ADD },
+        { FDP_OP_MOV | FDP_OP_IMM, 1, 0, 0, 0, FDP_RAX_REGISTER },
+        { FDP_OP_CALL, 0, 0, 0, 0, FDP_HELPER_READ_REGISTER },
+        { FDP_OP_MOV, 6, 0, 0, 0, 0 },
+        { FDP_OP_MOV | FDP_OP_IMM, 0, 0, 0, 0, 0 },
+        { FDP_OP_JNE | FDP_OP_IMM, 6, 0, 0, 1, 0xDEADBEEF },
+        { FDP_OP_MOV | FDP_OP_IMM, 0, 0, 0, 0, 1 },
+        { FDP_OP_EXIT, 0, 0, 0, 0, 0 },
+    };
+    FDP_State State = 0;
+    uint64_t SyscallEntry = 0;
+    uint64_t SyscallCount = 0;
+    int BreakpointId = -1;
+    int ProgramId = -1;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false){
+        printf("Failed to read MSR_LSTAR !\n");
+        goto Fail;
+    }
+    ProgramId = FDP_LoadProgram(pFDP, Program, sizeof(Program) / sizeof(Program[0]));
+    if (ProgramId < 0){
+        printf("Failed to FDP_LoadProgram !\n");
+        goto Fail;
+    }
+    BreakpointId = FDP_SetBreakpoint(pFDP, 0, FDP_SOFTHBP, -1, FDP_EXECUTE_BP, FDP_VIRTUAL_ADDRESS, SyscallEntry, 1, FDP_NO_CR3);
+    if (BreakpointId < 0){
+        printf("Failed to insert breakpoint !\n");
+        goto Fail;
+    }
+    if (FDP_AttachProgram(pFDP, BreakpointId, ProgramId) == false){
+        printf("Failed to FDP_AttachProgram !\n");
+        goto Fail;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(1000 * 1000);
+    if (FDP_GetState(pFDP, &State) == false
+        || (State & (FDP_STATE_PAUSED | FDP_STATE_BREAKPOINT_HIT))){
+        printf("Program stopped the VM (state %02x) !\n", State);
+        goto Fail;
+    }
+    if (FDP_ReadProgramMap(pFDP, ProgramId, 0, 1, &SyscallCount) == false
+        || SyscallCount == 0){
+        printf("No syscall counted !\n");
+        goto Fail;
+    }
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (BreakpointId >= 0){
+        FDP_UnsetBreakpoint(pFDP, BreakpointId);
+    }
+    if (ProgramId >= 0){
+        FDP_UnloadProgram(pFDP, ProgramId);
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+#define TEST_EXECUTE_BREAKPOINT_COUNT 4096
+bool testExecuteBreakpoint(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    //One breakpoint on the syscall entry, the others every 4 bytes of the next pages
+    static uint64_t aAddresses[TEST_EXECUTE_BREAKPOINT_COUNT];
+    static uint32_t aHandles[TEST_EXECUTE_BREAKPOINT_COUNT];
+    uint32_t HandleCount = 0;
+    FDP_State State = 0;
+    uint64_t SyscallEntry = 0;
+    uint64_t SyscallEntryPhysical = 0;
+    uint32_t CpuCount = 0;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false
+        || FDP_VirtualToPhysical(pFDP, 0, SyscallEntry, &SyscallEntryPhysical) == false
+        || FDP_GetCpuCount(pFDP, &CpuCount) == false){
+        printf("Failed to find the syscall entry !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < TEST_EXECUTE_BREAKPOINT_COUNT; i++){
+        aAddresses[i] = i == 0 ? SyscallEntryPhysical : (SyscallEntryPhysical & 0xFFFFFFFFFFFFF000) + 4096 + (i - 1) * 4;
+        if (FDP_AddExecuteBreakpoint(pFDP, aAddresses[i], &aHandles[i]) == false){
+            printf("Failed to FDP_AddExecuteBreakpoint(%p) !\n", (void*)aAddresses[i]);
+            goto Fail;
+        }
+        HandleCount++;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 100; i++){
+        if (FDP_GetState(pFDP, &State) == false){
+            printf("Failed to get state !\n");
+            goto Fail;
+        }
+        if (State & FDP_STATE_BREAKPOINT_HIT){
+            break;
+        }
+        usleep(1000 * 10);
+    }
+    if ((State & FDP_STATE_BREAKPOINT_HIT) == 0){
+        printf("No execute breakpoint was hit !\n");
+        goto Fail;
+    }
+    //The stopped CPU has to be on the physical address of its breakpoint
+    for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++){
+        uint32_t Handle = FDP_INVALID_BREAKPOINT_HANDLE;
+        uint64_t Rip = 0;
+        uint64_t PhysicalRip = 0;
+        if (FDP_GetHitBreakpointHandle(pFDP, CpuId, &Handle) == false){
+            continue;
+        }
+        if (FDP_ReadRegister(pFDP, CpuId, FDP_RIP_REGISTER, &Rip) == false
+            || FDP_VirtualToPhysical(pFDP, CpuId, Rip, &PhysicalRip) == false){
+            printf("Failed to read CPU %d RIP !\n", CpuId);
+            goto Fail;
+        }
+        for (uint32_t i = 0; i < HandleCount; i++){
+            if (aHandles[i] == Handle){
+                if (aAddresses[i] != PhysicalRip){
+                    printf("Handle %08x is %p, CPU %d stopped at %p !\n", Handle, (void*)aAddresses[i], CpuId, (void*)PhysicalRip);
+                    goto Fail;
+                }
+                bReturnValue = true;
+            }
+        }
+    }
+    if (bReturnValue == false){
+        printf("No CPU stopped on a known handle !\n");
+    }
+Fail:
+    for (uint32_t i = 0; i < HandleCount; i++){
+        if (FDP_RemoveExecuteBreakpoint(pFDP, aHandles[i]) == false){
+            printf("Failed to FDP_RemoveExecuteBreakpoint(%08x) !\n", aHandles[i]);
+            bReturnValue = false;
+        }
+    }
+    if (HandleCount > 0 && FDP_RemoveExecuteBreakpoint(pFDP, aHandles[0]) == true){
+        printf("Removed handle %08x twice !\n", aHandles[0]);
+        bReturnValue = false;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
+
+bool testSetUnsetBreakpoints(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    //Soft breakpoints on the first bytes of the syscall entry, set and unset in one command each
+    FDP_BREAKPOINT_ENTRY Entries[10];
+    uint8_t BreakpointIds[10];
+    bool bUnset[10];
+    FDP_State State = 0;
+    uint64_t SyscallEntry = 0;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
         return false;
     }
-
-    if (FDP_Save(pFDP) == false){
-        printf("Failed to save !\n");
-        return false;
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false){
+        printf("Failed to read MSR_LSTAR !\n");
+        goto Fail;
+    }
+    memset(Entries, 0, sizeof(Entries));
+    for (int i = 0; i < 10; i++){
+        Entries[i].BreakpointId = -1;
+        Entries[i].BreakpointType = FDP_SOFTHBP;
+        Entries[i].BreakpointAccessType = FDP_EXECUTE_BP;
+        Entries[i].BreakpointAddressType = FDP_VIRTUAL_ADDRESS;
+        Entries[i].BreakpointAddress = SyscallEntry + i;
+        Entries[i].BreakpointLength = 1;
+        Entries[i].BreakpointCr3 = FDP_NO_CR3;
+    }
+    if (FDP_SetBreakpoints(pFDP, Entries, 10) == false){
+        printf("Failed to FDP_SetBreakpoints !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 10; i++){
+        BreakpointIds[i] = (uint8_t)Entries[i].BreakpointId;
+    }
+    if (FDP_UnsetBreakpoints(pFDP, BreakpointIds, 10, bUnset) == false){
+        printf("Failed to FDP_UnsetBreakpoints !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 10; i++){
+        if (bUnset[i] == false){
+            printf("Breakpoint %d wasn't unset !\n", BreakpointIds[i]);
+            goto Fail;
+        }
     }
 
-    uint64_t OriginalRipValue;
-    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &OriginalRipValue) == false){
-        printf("Failed to FDP_ReadRegister\n");
-        return false;
+    //The entries still hold the ids of the first set, the breakpoints come back under them
+    if (FDP_SetBreakpoints(pFDP, Entries, 10) == false){
+        printf("Failed to FDP_SetBreakpoints !\n");
+        goto Fail;
+    }
+    for (int i = 0; i < 10; i++){
+        if (Entries[i].BreakpointId != BreakpointIds[i]){
+            printf("Breakpoint %d came back as %d !\n", BreakpointIds[i], Entries[i].BreakpointId);
+            goto Fail;
+        }
     }
 
+    //Unset all has to remove them too
+    if (FDP_UnsetAllBreakpoints(pFDP) == false){
+        printf("Failed to FDP_UnsetAllBreakpoints !\n");
+        goto Fail;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(1000 * 1000);
+    if (FDP_GetState(pFDP, &State) == false
+        || (State & FDP_STATE_BREAKPOINT_HIT)){
+        printf("Removed breakpoint stopped the VM (state %02x) !\n", State);
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    FDP_UnsetAllBreakpoints(pFDP);
     if (FDP_Resume(pFDP) == false){
         printf("Failed to resume !\n");
         return false;
     }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
 
-    for (int i = 0; i < 10; i++){
-        usleep(1000 * 3000);
+#define TEST_COVERAGE_BLOCK_COUNT 100000
+//KUSER_SHARED_DATA.InterruptTime, the guest clock doesn't advance while the VM is paused
+#define TEST_COVERAGE_GUEST_TIME_ADDRESS 0xFFFFF78000000008
 
-        if (FDP_Restore(pFDP) == false){
-            printf("Failed to FDP_Restore !\n");
-            return false;
-        }
+static bool testCoverageGuestTime(FDP_SHM* pFDP, uint64_t* pGuestTime)
+{
+    return FDP_ReadVirtualMemory(pFDP, 0, (uint8_t*)pGuestTime, sizeof(*pGuestTime), TEST_COVERAGE_GUEST_TIME_ADDRESS);
+}
 
-        uint64_t NewRipValue;
-        if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &NewRipValue) == false){
-            printf("Failed to FDP_ReadRegister\n");
-            return false;
-        }
+//Guest time (100ns units) per wall clock time, in percent
+static uint64_t testCoverageGuestShare(uint64_t GuestTime, struct timespec* pStart, struct timespec* pEnd)
+{
+    uint64_t WallTime = (uint64_t)(pEnd->tv_sec - pStart->tv_sec) * 10000000 + (pEnd->tv_nsec - pStart->tv_nsec) / 100;
+    return WallTime > 0 ? GuestTime * 100 / WallTime : 0;
+}
 
-        if (OriginalRipValue != NewRipValue){
-            printf("OriginalRipValue != NewRipValue\n");
-            return false;
-        }
+//Blocks every 4 bytes from the syscall entry page, found for one second by coverage then by breakpoints stopping the VM.
+//The share of that second the guest got tells the overhead of each approach
+bool testCoverage(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
 
-        if (FDP_Resume(pFDP) == false){
-            printf("Failed to FDP_Resume !\n");
-            return false;
+    static uint64_t aAddresses[TEST_COVERAGE_BLOCK_COUNT];
+    static uint32_t aHandles[TEST_COVERAGE_BLOCK_COUNT];
+    static uint8_t aBitmap[(TEST_COVERAGE_BLOCK_COUNT + 7) / 8];
+    uint32_t HandleCount = 0;
+    uint32_t CoverageHitCount = 0;
+    uint32_t StopHitCount = 0;
+    uint32_t BitCount = 0;
+    uint64_t SyscallEntry = 0;
+    uint64_t SyscallEntryPhysical = 0;
+    uint32_t CpuCount = 0;
+    uint64_t GuestStart = 0;
+    uint64_t GuestEnd = 0;
+    uint64_t CoverageGuestShare = 0;
+    uint64_t StopGuestShare = 0;
+    struct timespec Start;
+    struct timespec Now;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false
+        || FDP_VirtualToPhysical(pFDP, 0, SyscallEntry, &SyscallEntryPhysical) == false
+        || FDP_GetCpuCount(pFDP, &CpuCount) == false){
+        printf("Failed to find the syscall entry !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < TEST_COVERAGE_BLOCK_COUNT; i++){
+        aAddresses[i] = (SyscallEntryPhysical & 0xFFFFFFFFFFFFF000) + i * 4;
+    }
+    aAddresses[0] = SyscallEntryPhysical;
 
+    if (FDP_SetCoverageBlocks(pFDP, aAddresses, TEST_COVERAGE_BLOCK_COUNT) == false){
+        printf("Failed to FDP_SetCoverageBlocks !\n");
+        goto Fail;
+    }
+    if (testCoverageGuestTime(pFDP, &GuestStart) == false){
+        printf("Failed to read the guest time !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    //Polled like a fuzzer would, each get drops the ranges already covered
+    for (int i = 0; i < 100; i++){
+        usleep(10 * 1000);
+        if (FDP_GetCoverage(pFDP, NULL, 0, NULL) == false){
+            printf("Failed to FDP_GetCoverage !\n");
+            goto Fail;
         }
+    }
+    if (FDP_Pause(pFDP) == false
+        || FDP_GetCoverage(pFDP, aBitmap, sizeof(aBitmap), &CoverageHitCount) == false){
+        printf("Failed to FDP_GetCoverage !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    if (testCoverageGuestTime(pFDP, &GuestEnd) == false){
+        printf("Failed to read the guest time !\n");
+        goto Fail;
+    }
+    CoverageGuestShare = testCoverageGuestShare(GuestEnd - GuestStart, &Start, &Now);
+    for (uint32_t i = 0; i < TEST_COVERAGE_BLOCK_COUNT; i++){
+        BitCount += (aBitmap[i / 8] >> (i % 8)) & 1;
+    }
+    if (CoverageHitCount == 0 || BitCount != CoverageHitCount || (aBitmap[0] & 1) == 0){
+        printf("%d hits for %d bits, syscall entry %s !\n", CoverageHitCount, BitCount, (aBitmap[0] & 1) ? "hit" : "not hit");
+        goto Fail;
+    }
+    if (FDP_ResetCoverage(pFDP) == false
+        || FDP_GetCoverage(pFDP, aBitmap, sizeof(aBitmap), &BitCount) == false
+        || BitCount != 0
+        || FDP_SetCoverageBlocks(pFDP, NULL, 0) == false){
+        printf("Failed to reset the coverage !\n");
+        goto Fail;
+    }
 
-        //Wait for Rip change
-        uint64_t OldRipValue;
-        uint64_t RipValue;
-        FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &OldRipValue);
-        while (true){
-            FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &RipValue);
-            if (RipValue != OldRipValue){
-                break;
+    //Same blocks, each hit stops the VM and its breakpoint is removed by the client
+    for (uint32_t i = 0; i < TEST_COVERAGE_BLOCK_COUNT; i++){
+        if (FDP_AddExecuteBreakpoint(pFDP, aAddresses[i], &aHandles[i]) == false){
+            printf("Failed to FDP_AddExecuteBreakpoint(%p) !\n", (void*)aAddresses[i]);
+            goto Fail;
+        }
+        HandleCount++;
+    }
+    if (testCoverageGuestTime(pFDP, &GuestStart) == false){
+        printf("Failed to read the guest time !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    do{
+        FDP_State State = 0;
+        if (FDP_Resume(pFDP) == false){
+            printf("Failed to resume !\n");
+            goto Fail;
+        }
+        do{
+            clock_gettime(CLOCK_MONOTONIC, &Now);
+            if (FDP_GetState(pFDP, &State) == false){
+                printf("Failed to get state !\n");
+                goto Fail;
+            }
+        } while ((State & FDP_STATE_BREAKPOINT_HIT) == 0 && Now.tv_sec - Start.tv_sec < 1);
+        FDP_Pause(pFDP);
+        for (uint32_t CpuId = 0; CpuId < CpuCount; CpuId++){
+            uint32_t Handle = FDP_INVALID_BREAKPOINT_HANDLE;
+            if (FDP_GetHitBreakpointHandle(pFDP, CpuId, &Handle) && FDP_RemoveExecuteBreakpoint(pFDP, Handle)){
+                StopHitCount++;
             }
         }
-
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+    } while (Now.tv_sec - Start.tv_sec < 1 || (Now.tv_sec - Start.tv_sec == 1 && Now.tv_nsec < Start.tv_nsec));
+    if (testCoverageGuestTime(pFDP, &GuestEnd) == false){
+        printf("Failed to read the guest time !\n");
+        goto Fail;
+    }
+    StopGuestShare = testCoverageGuestShare(GuestEnd - GuestStart, &Start, &Now);
+
+    printf("coverage %d blocks/s guest ran %d%%, stop per hit %d blocks/s guest ran %d%% ", CoverageHitCount,
+           (int)CoverageGuestShare, StopHitCount, (int)StopGuestShare);
+    if (CoverageHitCount < StopHitCount){
+        printf("Coverage is slower !\n");
+        goto Fail;
+    }
+    if (CoverageGuestShare < StopGuestShare){
+        printf("Coverage slows the guest more !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    FDP_SetCoverageBlocks(pFDP, NULL, 0);
+    for (uint32_t i = 0; i < HandleCount; i++){
+        FDP_RemoveExecuteBreakpoint(pFDP, aHandles[i]);
     }
-
     if (FDP_Resume(pFDP) == false){
-        printf("Failed to FDP_Resume !\n");
+        printf("Failed to resume !\n");
         return false;
     }
-
-    printf("[OK]\n");
-    return true;
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
 }
 
-bool testReadAllPhysicalMemory(FDP_SHM* pFDP)
+//KUSER_SHARED_DATA.InterruptTime, written at each clock tick like the rest of its page
+#define TEST_WATCHPOINT_ADDRESS 0xFFFFF78000000008
+#define TEST_WATCHPOINT_LENGTH 12
+
+bool testWatchpoint(FDP_SHM* pFDP)
 {
     printf("%s ...", __FUNCTION__);
 
-    uint64_t PhysicalAddress = 0;
-    char Buffer[4096];
-    uint64_t PhysicalMaxAddress = 0;
+    FDP_HIT_RECORD Records[256];
+    FDP_State State = 0;
+    uint32_t RecordCount = 0;
+    int BreakpointId = -1;
+    bool bReturnValue = false;
 
     if (FDP_Pause(pFDP) == false){
         printf("Failed to pause !\n");
         return false;
     }
-    if (FDP_GetPhysicalMemorySize(pFDP, &PhysicalMaxAddress) == false){
-        printf("Failed to FDP_GetPhysicalMemorySize\n");
-        return false;
+    //Drop what previous runs left
+    while (FDP_DrainHitLog(pFDP, Records, 256) > 0);
+    BreakpointId = FDP_SetWatchpoint(pFDP, 0, FDP_WRITE_BP, FDP_VIRTUAL_ADDRESS, TEST_WATCHPOINT_ADDRESS,
+                                     TEST_WATCHPOINT_LENGTH, FDP_NO_CR3, FDP_TRACEPOINT_LOG);
+    if (BreakpointId < 0){
+        printf("Failed to FDP_SetWatchpoint !\n");
+        goto Fail;
     }
-    while (PhysicalAddress < PhysicalMaxAddress){
-        if (FDP_ReadPhysicalMemory(pFDP, (uint8_t *)Buffer, sizeof(Buffer), PhysicalAddress) == false){
-            //Some PhysicalAddress aren't readeable
-            //printf("Failed to FDP_ReadPhysicalMemory (%p)\n", PhysicalAddress);
-            //return false;
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(1000 * 1000);
+
+    //The guest must still be running
+    if (FDP_GetState(pFDP, &State) == false
+        || (State & (FDP_STATE_PAUSED | FDP_STATE_BREAKPOINT_HIT))){
+        printf("Watchpoint stopped the VM (state %02x) !\n", State);
+        goto Fail;
+    }
+    RecordCount = FDP_DrainHitLog(pFDP, Records, 256);
+    if (RecordCount == 0){
+        printf("No access logged !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < RecordCount; i++){
+        uint64_t Address = Records[i].RegisterValues[FDP_WATCHPOINT_RECORD_ADDRESS];
+        uint64_t Size = Records[i].RegisterValues[FDP_WATCHPOINT_RECORD_SIZE];
+        uint64_t Access = Records[i].RegisterValues[FDP_WATCHPOINT_RECORD_ACCESS];
+        //A backend without access information logs every hit on the page with zeros
+        if (Records[i].BreakpointId != BreakpointId
+            || Records[i].RegisterMask != FDP_HIT_RECORD_WATCHPOINT
+            || (Access != 0 && (Access & FDP_WRITE_BP) == 0)
+            || (Access != 0 && (Address + (Size != 0 ? Size : 1) <= TEST_WATCHPOINT_ADDRESS
+                                || Address >= TEST_WATCHPOINT_ADDRESS + TEST_WATCHPOINT_LENGTH))){
+            printf("Bad watchpoint record %u (%p) !\n", i, (void*)Address);
+            goto Fail;
         }
-        PhysicalAddress += sizeof(Buffer);
+    }
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (BreakpointId >= 0){
+        FDP_UnsetBreakpoint(pFDP, BreakpointId);
     }
     if (FDP_Resume(pFDP) == false){
         printf("Failed to resume !\n");
         return false;
     }
-
-    printf("[OK]\n");
-    return true;
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
 }
 
+#define TEST_AGGREGATION_MAX_KEYS 4096
 
-bool testReadWriteAllPhysicalMemory(FDP_SHM* pFDP)
+bool testAggregation(FDP_SHM* pFDP)
 {
     printf("%s ...", __FUNCTION__);
 
-    uint64_t PhysicalAddress = 0;
-    char Buffer[4096];
-    uint64_t PhysicalMaxAddress = 0;
+    static FDP_AGGREGATION_ENTRY aEntries[TEST_AGGREGATION_MAX_KEYS];
+    FDP_State State = 0;
+    uint64_t SyscallEntry = 0;
+    uint64_t HitCount = 0;
+    uint64_t DroppedCount = 0;
+    uint32_t EntryCount = 0;
+    int BreakpointId = -1;
+    int AggregationId = -1;
+    struct timespec Start, End;
+    bool bReturnValue = false;
 
     if (FDP_Pause(pFDP) == false){
         printf("Failed to pause !\n");
         return false;
     }
-    if (FDP_GetPhysicalMemorySize(pFDP, &PhysicalMaxAddress) == false){
-        printf("Failed to FDP_GetPhysicalMemorySize\n");
-        return false;
+    if (FDP_ReadMsr(pFDP, 0, MSR_LSTAR, &SyscallEntry) == false){
+        printf("Failed to read MSR_LSTAR !\n");
+        goto Fail;
+    }
+    //Which processes make syscalls
+    AggregationId = FDP_CreateAggregation(pFDP, FDP_AGGREGATE_CR3, 0, TEST_AGGREGATION_MAX_KEYS);
+    if (AggregationId < 0){
+        printf("Failed to FDP_CreateAggregation !\n");
+        goto Fail;
+    }
+    BreakpointId = FDP_SetBreakpoint(pFDP, 0, FDP_SOFTHBP, -1, FDP_EXECUTE_BP, FDP_VIRTUAL_ADDRESS, SyscallEntry, 1, FDP_NO_CR3);
+    if (BreakpointId < 0){
+        printf("Failed to insert breakpoint !\n");
+        goto Fail;
+    }
+    if (FDP_AttachAggregation(pFDP, BreakpointId, AggregationId) == false){
+        printf("Failed to FDP_AttachAggregation !\n");
+        goto Fail;
     }
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(1000 * 1000);
 
-    while (PhysicalAddress < PhysicalMaxAddress){
-        if (FDP_ReadPhysicalMemory(pFDP, (uint8_t *)Buffer, sizeof(Buffer), PhysicalAddress) == true){
-            FDP_WritePhysicalMemory(pFDP, (uint8_t *)Buffer, sizeof(Buffer), PhysicalAddress);
+    //The guest must still be running
+    if (FDP_GetState(pFDP, &State) == false
+        || (State & (FDP_STATE_PAUSED | FDP_STATE_BREAKPOINT_HIT))){
+        printf("Aggregation stopped the VM (state %02x) !\n", State);
+        goto Fail;
+    }
+    if (FDP_GetAggregation(pFDP, AggregationId, true, aEntries, TEST_AGGREGATION_MAX_KEYS, &EntryCount, &DroppedCount) == false){
+        printf("Failed to FDP_GetAggregation !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    for (uint32_t i = 0; i < EntryCount; i++){
+        if (aEntries[i].Count == 0){
+            printf("Bad aggregation entry %u !\n", i);
+            goto Fail;
         }
-        PhysicalAddress += sizeof(Buffer);
+        HitCount += aEntries[i].Count;
+    }
+    if (HitCount == 0){
+        printf("No hit counted !\n");
+        goto Fail;
+    }
+    printf(" %llu syscalls from %u CR3 (%.0f/s, %llu dropped) ", (unsigned long long)HitCount, EntryCount,
+           HitCount / ((End.tv_sec - Start.tv_sec) + (End.tv_nsec - Start.tv_nsec) / 1e9), (unsigned long long)DroppedCount);
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    bReturnValue = true;
+Fail:
+    if (BreakpointId >= 0){
+        FDP_UnsetBreakpoint(pFDP, BreakpointId);
+    }
+    if (AggregationId >= 0){
+        FDP_DeleteAggregation(pFDP, AggregationId);
     }
     if (FDP_Resume(pFDP) == false){
         printf("Failed to resume !\n");
         return false;
     }
-
-    printf("[OK]\n");
-    return true;
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
 }
 
+bool testSnapshots(FDP_SHM* pFDP)
+{
+    printf("%s ...", __FUNCTION__);
+
+    FDP_SNAPSHOT_INFO aSnapshots[FDP_MAX_SNAPSHOTS];
+    uint32_t SnapshotCount = 0;
+    FDP_SNAPSHOT_INFO* pBase = NULL;
+    FDP_SNAPSHOT_INFO* pLater = NULL;
+    uint64_t SavedRip = 0;
+    uint64_t RestoredRip = 0;
+    uint8_t SavedPage[4096];
+    uint8_t RestoredPage[4096];
+    struct timespec Start, End;
+    bool bReturnValue = false;
+
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        return false;
+    }
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &SavedRip) == false){
+        printf("Failed to read RIP !\n");
+        goto Fail;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, SavedPage, sizeof(SavedPage), 4096 * 12) == false){
+        printf("Failed to FDP_ReadPhysicalMemory !\n");
+        goto Fail;
+    }
+    if (FDP_SaveSnapshot(pFDP, "testSnapshots.base") == false){
+        printf("Failed to FDP_SaveSnapshot !\n");
+        goto Fail;
+    }
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        goto Fail;
+    }
+    usleep(100 * 1000);
+    if (FDP_Pause(pFDP) == false){
+        printf("Failed to pause !\n");
+        goto Fail;
+    }
+    //Most of the RAM must be shared with the first snapshot
+    if (FDP_SaveSnapshot(pFDP, "testSnapshots.later") == false){
+        printf("Failed to FDP_SaveSnapshot !\n");
+        goto Fail;
+    }
+    if (FDP_ListSnapshots(pFDP, aSnapshots, FDP_MAX_SNAPSHOTS, &SnapshotCount) == false){
+        printf("Failed to FDP_ListSnapshots !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < SnapshotCount; i++){
+        if (strcmp(aSnapshots[i].Name, "testSnapshots.base") == 0){
+            pBase = &aSnapshots[i];
+        }
+        if (strcmp(aSnapshots[i].Name, "testSnapshots.later") == 0){
+            pLater = &aSnapshots[i];
+        }
+    }
+    if (pBase == NULL || pLater == NULL || pLater->PrivatePageCount * 2 > pLater->PageCount){
+        printf("Snapshot pages not shared !\n");
+        goto Fail;
+    }
+    //The guest ran since the first snapshot, its devices must go back with it
+    if ((pBase->Flags & FDP_SNAPSHOT_DEVICE_STATE) == 0){
+        printf("Device state not saved !\n");
+        goto Fail;
+    }
+    for (uint32_t i = 0; i < sizeof(RestoredPage); i++){
+        RestoredPage[i] = ~SavedPage[i];
+    }
+    if (FDP_WritePhysicalMemory(pFDP, RestoredPage, sizeof(RestoredPage), 4096 * 12) == false){
+        printf("Failed to FDP_WritePhysicalMemory !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    if (FDP_RestoreSnapshot(pFDP, "testSnapshots.base") == false){
+        printf("Failed to FDP_RestoreSnapshot !\n");
+        goto Fail;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    if (FDP_ReadRegister(pFDP, 0, FDP_RIP_REGISTER, &RestoredRip) == false || RestoredRip != SavedRip){
+        printf("RIP not restored !\n");
+        goto Fail;
+    }
+    if (FDP_ReadPhysicalMemory(pFDP, RestoredPage, sizeof(RestoredPage), 4096 * 12) == false
+        || memcmp(RestoredPage, SavedPage, sizeof(SavedPage)) != 0){
+        printf("RAM not restored !\n");
+        goto Fail;
+    }
+    printf(" %llu/%llu private pages, restored in %.1f ms ", (unsigned long long)pLater->PrivatePageCount,
+           (unsigned long long)pLater->PageCount,
+           ((End.tv_sec - Start.tv_sec) * 1e9 + (End.tv_nsec - Start.tv_nsec)) / 1e6);
+    bReturnValue = true;
+Fail:
+    FDP_DeleteSnapshot(pFDP, "testSnapshots.base");
+    FDP_DeleteSnapshot(pFDP, "testSnapshots.later");
+    if (FDP_Resume(pFDP) == false){
+        printf("Failed to resume !\n");
+        return false;
+    }
+    if (bReturnValue == true){
+        printf("[OK]\n");
+    }
+    return bReturnValue;
+}
 
 /*#define EPROCESS_ACTIVEPROCESSLIST_OFF 0x2F0
 #define EPROCESS_PROCESSNAME_OFF 0x448
@@ -1460,16 +3240,8 @@ bool MonitorProcessList(FDP_SHM *pFDP){
 
 uint64_t FDP_VirutalChecksum(FDP_SHM *pFDP, uint64_t VirtualAddress, uint32_t DataSize)
 {
-    uint64_t ChecksumResult = 0xDEADDEADDEADDEAD;
-    uint64_t Buffer[4096 / 8];
-    for (uint32_t i = 0; i < (DataSize / 4096); i++){
-        printf(".");
-        FDP_ReadVirtualMemory(pFDP, 0, (uint8_t*)Buffer, 4096, VirtualAddress + (i * 4096));
-
-        for (int j = 0; j < (4096 / 8); j++){
-            ChecksumResult = (ChecksumResult ^ Buffer[j]);
-        }
-    }
+    uint64_t ChecksumResult = 0;
+    FDP_HashVirtualMemory(pFDP, 0, FDP_HASH_XXH64, VirtualAddress, DataSize, &ChecksumResult);
     return ChecksumResult;
 }
 
@@ -1713,6 +3485,10 @@ int testFDP(char *pVMName) {
             goto Fail;
         if (testSingleStepSpeed(pFDP) == false)
             goto Fail;
+        if (testSingleStepN(pFDP) == false)
+            goto Fail;
+        if (testStepUntil(pFDP) == false)
+            goto Fail;
         if (testReadWriteMSR(pFDP) == false)
             goto Fail;
         if (testSetCr3(pFDP) == false)
@@ -1757,6 +3533,50 @@ int testFDP(char *pVMName) {
             goto Fail;
         if (testReadWriteAllPhysicalMemory(pFDP) == false)
             goto Fail;
+        if (testPhysicalMemoryDiff(pFDP) == false)
+            goto Fail;
+        if (testSnapshotArchive(pFDP) == false)
+            goto Fail;
+        if (testHashMemory(pFDP) == false)
+            goto Fail;
+        if (testSwapMemory(pFDP) == false)
+            goto Fail;
+        if (testReadahead(pFDP) == false)
+            goto Fail;
+        if (testWalkList(pFDP) == false)
+            goto Fail;
+        if (testCpuContexts(pFDP) == false)
+            goto Fail;
+        if (testGetCpuContext(pFDP) == false)
+            goto Fail;
+        if (testReadWriteRegisters(pFDP) == false)
+            goto Fail;
+        if (testRegisterCache(pFDP) == false)
+            goto Fail;
+        if (testXState(pFDP) == false)
+            goto Fail;
+        if (testReadWriteMsrs(pFDP) == false)
+            goto Fail;
+        if (testGetAllCpuStates(pFDP) == false)
+            goto Fail;
+        if (testTracepoint(pFDP) == false)
+            goto Fail;
+        if (testConditionalBreakpoint(pFDP) == false)
+            goto Fail;
+        if (testBreakpointProgram(pFDP) == false)
+            goto Fail;
+        if (testExecuteBreakpoint(pFDP) == false)
+            goto Fail;
+        if (testSetUnsetBreakpoints(pFDP) == false)
+            goto Fail;
+        if (testCoverage(pFDP) == false)
+            goto Fail;
+        if (testWatchpoint(pFDP) == false)
+            goto Fail;
+        if (testAggregation(pFDP) == false)
+            goto Fail;
+        if (testSnapshots(pFDP) == false)
+            goto Fail;
         if (testLargeVirtualPageSyscallBP(pFDP) == false)
             goto Fail;
         if (testLargePhysicalPageSyscallBP(pFDP) == false)
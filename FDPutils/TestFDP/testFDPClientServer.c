@@ -1,6 +1,9 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <pthread.h>
@@ -81,6 +84,17 @@ bool FDP_ClientServerTest()
     FDPServerInterface.pfnReadRegister = FDP_DummyReadRegister;
     FDPServerInterface.pfnWriteRegister = FDP_DummyWriteRegister;
     FDPServerInterface.pfnGetCpuCount = FDP_DummyGetCpuCount;
+    FDPServerInterface.pfnReadRegisters = NULL;
+    FDPServerInterface.pfnWriteRegisters = NULL;
+    FDPServerInterface.pfnGetXState = NULL;
+    FDPServerInterface.pfnSetXState = NULL;
+    FDPServerInterface.pfnReadMsrs = NULL;
+    FDPServerInterface.pfnWriteMsrs = NULL;
+    FDPServerInterface.pfnGetHitBreakpointId = NULL;
+    FDPServerInterface.pfnGetHitAccess = NULL;
+    FDPServerInterface.pfnGetDirtyPages = NULL;
+    FDPServerInterface.pfnSaveDeviceState = NULL;
+    FDPServerInterface.pfnRestoreDeviceState = NULL;
     FDP_SHM* pFDPServer = FDP_CreateSHM("FDP_TEST");
 
     if (pFDPServer == NULL)
@@ -131,8 +145,415 @@ bool FDP_ClientServerTest()
 }
 
 
+//Synthetic guest for the snapshot restore benchmark, its RAM is only backed once written
+#define BENCH_PAGE_SIZE             4096ULL
+#define BENCH_DIRTY_PAGES           300     //Pages written by the guest between two restores
+#define BENCH_SEEDED_SIZE           (64ULL * 1024 * 1024)
+#define BENCH_MIN_DURATION          3.0
+
+typedef struct BENCH_GUEST_
+{
+    uint8_t *pMemory;
+    uint64_t MemorySize;
+    uint64_t *pDirtyBitmap;
+    uint64_t aRegisters[FDP_MAX_REGISTER_MASK_COUNT];
+    uint64_t WrittenPageCount;
+    uint64_t aWrittenAddresses[BENCH_DIRTY_PAGES];  //Bytes written by the last Bench_RunGuest
+    bool bRunning;
+    uint64_t DeviceTicks;                           //Stands for the device state, moves while the guest runs
+    uint64_t aSnapshotDeviceTicks[FDP_MAX_SNAPSHOTS];
+} BENCH_GUEST;
+
+BENCH_GUEST BenchGuest;
+
+void Bench_MarkDirty(uint64_t PhysicalAddress, uint64_t Size)
+{
+    for (uint64_t Page = PhysicalAddress / BENCH_PAGE_SIZE; Page < (PhysicalAddress + Size + BENCH_PAGE_SIZE - 1) / BENCH_PAGE_SIZE; Page++)
+    {
+        BenchGuest.pDirtyBitmap[Page / 64] |= 1ULL << (Page % 64);
+    }
+}
+
+bool Bench_GetState(void* pUserHandle, uint8_t* pState)
+{
+    *pState = BenchGuest.bRunning ? 0 : FDP_STATE_PAUSED;
+    return true;
+}
+
+bool Bench_Resume(void* pUserHandle)
+{
+    BenchGuest.bRunning = true;
+    return true;
+}
+
+bool Bench_Pause(void* pUserHandle)
+{
+    BenchGuest.bRunning = false;
+    return true;
+}
+
+bool Bench_ReadRegister(void* pUserHandle, uint32_t CpuId, FDP_Register RegisterId, uint64_t* pRegisterValue)
+{
+    *pRegisterValue = BenchGuest.aRegisters[RegisterId];
+    return true;
+}
+
+bool Bench_WriteRegister(void* pUserHandle, uint32_t CpuId, FDP_Register RegisterId, uint64_t RegisterValue)
+{
+    BenchGuest.aRegisters[RegisterId] = RegisterValue;
+    return true;
+}
+
+bool Bench_ReadMsr(void* pUserHandle, uint32_t CpuId, uint64_t MsrId, uint64_t* pMsrValue)
+{
+    *pMsrValue = 0;
+    return true;
+}
+
+bool Bench_WriteMsr(void* pUserHandle, uint32_t CpuId, uint64_t MsrId, uint64_t MsrValue)
+{
+    return true;
+}
+
+bool Bench_GetFxState64(void* pUserHandle, uint32_t CpuId, uint8_t* pFxState, uint32_t* pFxStateSize)
+{
+    memset(pFxState, 0, sizeof(FDP_XSAVE_FORMAT64_T));
+    *pFxStateSize = sizeof(FDP_XSAVE_FORMAT64_T);
+    return true;
+}
+
+bool Bench_SetFxState64(void* pUserHandle, uint32_t CpuId, uint8_t* pFxState, uint32_t FxStateSize)
+{
+    return true;
+}
+
+bool Bench_GetCpuCount(void* pUserHandle, uint32_t* pCpuCount)
+{
+    *pCpuCount = 1;
+    return true;
+}
+
+bool Bench_GetMemorySize(void* pUserHandle, uint64_t* pMemorySize)
+{
+    *pMemorySize = BenchGuest.MemorySize;
+    return true;
+}
+
+bool Bench_ReadPhysicalMemory(void* pUserHandle, uint8_t* pDstBuffer, uint64_t PhysicalAddress, uint32_t ReadSize)
+{
+    if (PhysicalAddress + ReadSize > BenchGuest.MemorySize)
+    {
+        return false;
+    }
+    memcpy(pDstBuffer, BenchGuest.pMemory + PhysicalAddress, ReadSize);
+    return true;
+}
+
+bool Bench_WritePhysicalMemory(void* pUserHandle, uint8_t* pSrcBuffer, uint64_t PhysicalAddress, uint32_t WriteSize)
+{
+    if (PhysicalAddress + WriteSize > BenchGuest.MemorySize)
+    {
+        return false;
+    }
+    memcpy(BenchGuest.pMemory + PhysicalAddress, pSrcBuffer, WriteSize);
+    Bench_MarkDirty(PhysicalAddress, WriteSize);
+    BenchGuest.WrittenPageCount += WriteSize / BENCH_PAGE_SIZE;
+    return true;
+}
+
+bool Bench_GetDirtyPages(void* pUserHandle, uint64_t* pBitmap, uint64_t PageCount)
+{
+    for (uint64_t i = 0; i < (PageCount + 63) / 64; i++)
+    {
+        pBitmap[i] |= BenchGuest.pDirtyBitmap[i];
+        BenchGuest.pDirtyBitmap[i] = 0;
+    }
+    return true;
+}
+
+bool Bench_SaveDeviceState(void* pUserHandle, uint32_t SnapshotId)
+{
+    BenchGuest.aSnapshotDeviceTicks[SnapshotId] = BenchGuest.DeviceTicks;
+    return true;
+}
+
+bool Bench_RestoreDeviceState(void* pUserHandle, uint32_t SnapshotId)
+{
+    BenchGuest.DeviceTicks = BenchGuest.aSnapshotDeviceTicks[SnapshotId];
+    return true;
+}
+
+//Stands for one fuzzing iteration, the guest writes pages all over its RAM
+void Bench_RunGuest()
+{
+    for (int i = 0; i < BENCH_DIRTY_PAGES; i++)
+    {
+        uint64_t Address = ((((uint64_t)rand() << 31) | rand()) % (BenchGuest.MemorySize / BENCH_PAGE_SIZE)) * BENCH_PAGE_SIZE
+                           + rand() % BENCH_PAGE_SIZE;
+        BenchGuest.pMemory[Address] = (uint8_t)(rand() | 1);
+        BenchGuest.aWrittenAddresses[i] = Address;
+        Bench_MarkDirty(Address, 1);
+    }
+    BenchGuest.aRegisters[FDP_RIP_REGISTER] += 0x10;
+    BenchGuest.DeviceTicks++;
+}
+
+//Every byte written by the last iteration must be back to its seeded value
+bool Bench_CheckRestored()
+{
+    for (int i = 0; i < BENCH_DIRTY_PAGES; i++)
+    {
+        uint64_t Address = BenchGuest.aWrittenAddresses[i];
+        uint8_t Expected = Address < BENCH_SEEDED_SIZE ? (uint8_t)(Address / BENCH_PAGE_SIZE) : 0;
+        if (BenchGuest.pMemory[Address] != Expected)
+        {
+            return false;
+        }
+    }
+    return BenchGuest.aRegisters[FDP_RIP_REGISTER] == 0xFFFFF80000001000ULL && BenchGuest.DeviceTicks == 0;
+}
+
+void* Bench_RestoreClient(void* lpParameter)
+{
+    FDP_SERVER_INTERFACE_T* pServerInterface = (FDP_SERVER_INTERFACE_T*)lpParameter;
+    while (pServerInterface->bIsRunning == false)
+    {
+        usleep(1000);
+    }
+    FDP_SHM* pFDPClient = FDP_OpenSHM("FDP_BENCH");
+    if (pFDPClient == NULL || FDP_SaveSnapshot(pFDPClient, "bench") == false)
+    {
+        printf("Failed to FDP_SaveSnapshot\n");
+        exit(1);
+    }
+    const char* aModes[] = { "compare", "dirty" };
+    for (int Mode = 0; Mode < 2; Mode++)
+    {
+        pServerInterface->pfnGetDirtyPages = Mode == 1 ? Bench_GetDirtyPages : NULL;
+        //The first restore arms the dirty tracking
+        FDP_RestoreSnapshot(pFDPClient, "bench");
+        uint64_t RestoreCount = 0;
+        struct timespec Start, End;
+        double Duration = 0;
+        BenchGuest.WrittenPageCount = 0;
+        //The guest runs between two restores, only the restores are timed
+        while (Duration < BENCH_MIN_DURATION)
+        {
+            if (FDP_Resume(pFDPClient) == false || FDP_Pause(pFDPClient) == false)
+            {
+                printf("Failed to run the guest\n");
+                exit(1);
+            }
+            Bench_RunGuest();
+            clock_gettime(CLOCK_MONOTONIC, &Start);
+            if (FDP_RestoreSnapshot(pFDPClient, "bench") == false || Bench_CheckRestored() == false)
+            {
+                printf("Failed to FDP_RestoreSnapshot (%s)\n", aModes[Mode]);
+                exit(1);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &End);
+            RestoreCount++;
+            Duration += (End.tv_sec - Start.tv_sec) + (End.tv_nsec - Start.tv_nsec) / 1e9;
+        }
+        printf("%-8s %llu MB guest, %d dirty pages: %.1f restores/sec, %llu pages written per restore\n", aModes[Mode],
+               (unsigned long long)(BenchGuest.MemorySize >> 20), BENCH_DIRTY_PAGES, RestoreCount / Duration,
+               (unsigned long long)(BenchGuest.WrittenPageCount / RestoreCount));
+    }
+    exit(0);
+    return NULL;
+}
+
+bool FDP_SnapshotRestoreBenchmark(uint64_t MemorySize)
+{
+    static FDP_SERVER_INTERFACE_T FDPServerInterface;
+    memset(&FDPServerInterface, 0, sizeof(FDPServerInterface));
+    FDPServerInterface.pfnGetState = Bench_GetState;
+    FDPServerInterface.pfnResume = Bench_Resume;
+    FDPServerInterface.pfnPause = Bench_Pause;
+    FDPServerInterface.pfnReadRegister = Bench_ReadRegister;
+    FDPServerInterface.pfnWriteRegister = Bench_WriteRegister;
+    FDPServerInterface.pfnReadMsr = Bench_ReadMsr;
+    FDPServerInterface.pfnWriteMsr = Bench_WriteMsr;
+    FDPServerInterface.pfnGetFxState64 = Bench_GetFxState64;
+    FDPServerInterface.pfnSetFxState64 = Bench_SetFxState64;
+    FDPServerInterface.pfnGetCpuCount = Bench_GetCpuCount;
+    FDPServerInterface.pfnGetMemorySize = Bench_GetMemorySize;
+    FDPServerInterface.pfnReadPhysicalMemory = Bench_ReadPhysicalMemory;
+    FDPServerInterface.pfnWritePhysicalMemory = Bench_WritePhysicalMemory;
+    FDPServerInterface.pfnSaveDeviceState = Bench_SaveDeviceState;
+    FDPServerInterface.pfnRestoreDeviceState = Bench_RestoreDeviceState;
+
+    BenchGuest.MemorySize = MemorySize;
+    BenchGuest.pMemory = (uint8_t*)mmap(NULL, MemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    BenchGuest.pDirtyBitmap = (uint64_t*)calloc((MemorySize / BENCH_PAGE_SIZE + 63) / 64, sizeof(uint64_t));
+    if (BenchGuest.pMemory == MAP_FAILED || BenchGuest.pDirtyBitmap == NULL)
+    {
+        printf("Failed to allocate the guest memory\n");
+        return false;
+    }
+    for (uint64_t Address = 0; Address < BENCH_SEEDED_SIZE && Address < MemorySize; Address += BENCH_PAGE_SIZE)
+    {
+        memset(BenchGuest.pMemory + Address, (uint8_t)(Address / BENCH_PAGE_SIZE), BENCH_PAGE_SIZE);
+    }
+    BenchGuest.aRegisters[FDP_RIP_REGISTER] = 0xFFFFF80000001000ULL;
+
+    FDP_SHM* pFDPServer = FDP_CreateSHM("FDP_BENCH");
+    if (pFDPServer == NULL
+        || FDP_CreateCpuSHM(pFDPServer, "FDP_BENCH", 1) == NULL
+        || FDP_SetFDPServer(pFDPServer, &FDPServerInterface) == false)
+    {
+        printf("Failed to create the FDP server\n");
+        return false;
+    }
+    pthread_t threadClient = 0;
+    if (pthread_create(&threadClient, NULL, Bench_RestoreClient, &FDPServerInterface) != 0)
+    {
+        printf("Failed to phread_create\n");
+        return false;
+    }
+    return FDP_ServerLoop(pFDPServer);
+}
+
+
+//Execute breakpoint hit dispatch benchmark, the breakpoints are spread over BENCH_DISPATCH_PAGES pages so each
+//count uses the same backend page breakpoints
+#define BENCH_DISPATCH_BASE         0x100000ULL
+#define BENCH_DISPATCH_PAGES        128
+#define BENCH_DISPATCH_HITS         2000000
+
+int aBenchDispatchPageIds[BENCH_DISPATCH_PAGES];
+int BenchDispatchNextId = 0;
+
+int Bench_SetBreakpoint(void* pUserHandle, uint32_t CpuId, FDP_BreakpointType BreakpointType, uint8_t BreakpointId,
+                        FDP_Access BreakpointAccessType, FDP_AddressType BreakpointAddressType, uint64_t BreakpointAddress,
+                        uint64_t BreakpointLength, uint64_t BreakpointCr3)
+{
+    uint64_t Page = (BreakpointAddress - BENCH_DISPATCH_BASE) / BENCH_PAGE_SIZE;
+    if (BreakpointType != FDP_PAGEHBP || Page >= BENCH_DISPATCH_PAGES)
+    {
+        return -1;
+    }
+    aBenchDispatchPageIds[Page] = BenchDispatchNextId++ % FDP_MAX_BREAKPOINT;
+    return aBenchDispatchPageIds[Page];
+}
+
+bool Bench_UnsetBreakpoint(void* pUserHandle, uint8_t BreakpointId)
+{
+    return true;
+}
+
+bool Bench_VirtualToPhysical(void* pUserHandle, uint32_t CpuId, uint64_t VirtualAddress, uint64_t* pPhysicalAddress)
+{
+    *pPhysicalAddress = VirtualAddress;
+    return true;
+}
+
+uint64_t Bench_DispatchAddress(uint32_t BreakpointIndex)
+{
+    return BENCH_DISPATCH_BASE + (BreakpointIndex % BENCH_DISPATCH_PAGES) * BENCH_PAGE_SIZE
+           + (BreakpointIndex / BENCH_DISPATCH_PAGES) * 8;
+}
+
+//Plays the backend: each exit on a breakpoint page goes through FDP_ServerBreakpointHit, half of them on a
+//breakpoint and the others on the next byte, which has to let the guest go on
+void* Bench_DispatchClient(void* lpParameter)
+{
+    FDP_SHM* pFDPServer = (FDP_SHM*)lpParameter;
+    while (pFDPServer->pFdpServer->bIsRunning == false)
+    {
+        usleep(1000);
+    }
+    FDP_SHM* pFDPClient = FDP_OpenSHM("FDP_DISPATCH");
+    if (pFDPClient == NULL)
+    {
+        printf("Failed to FDP_OpenSHM\n");
+        exit(1);
+    }
+    uint32_t aBreakpointCounts[] = { 128, 4096, 65536 };
+    double aHitsPerSecond[3];
+    uint32_t BreakpointCount = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        for (; BreakpointCount < aBreakpointCounts[i]; BreakpointCount++)
+        {
+            uint32_t Handle = 0;
+            if (FDP_AddExecuteBreakpoint(pFDPClient, Bench_DispatchAddress(BreakpointCount), &Handle) == false)
+            {
+                printf("Failed to FDP_AddExecuteBreakpoint\n");
+                exit(1);
+            }
+        }
+        uint32_t StopCount = 0;
+        struct timespec Start, End;
+        clock_gettime(CLOCK_MONOTONIC, &Start);
+        for (uint32_t j = 0; j < BENCH_DISPATCH_HITS; j++)
+        {
+            uint32_t BreakpointIndex = (j / 2 * 7919) % BreakpointCount;
+            BenchGuest.aRegisters[FDP_RIP_REGISTER] = Bench_DispatchAddress(BreakpointIndex) + (j & 1);
+            if (FDP_ServerBreakpointHit(pFDPServer, 0, aBenchDispatchPageIds[BreakpointIndex % BENCH_DISPATCH_PAGES]))
+            {
+                StopCount++;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &End);
+        if (StopCount != BENCH_DISPATCH_HITS / 2)
+        {
+            printf("%u hits stopped the VM instead of %u\n", StopCount, BENCH_DISPATCH_HITS / 2);
+            exit(1);
+        }
+        aHitsPerSecond[i] = BENCH_DISPATCH_HITS / ((End.tv_sec - Start.tv_sec) + (End.tv_nsec - Start.tv_nsec) / 1e9);
+        printf("%6u execute breakpoints: %.1f M hits/sec\n", BreakpointCount, aHitsPerSecond[i] / 1e6);
+    }
+    //The dispatch has to stay well under a microsecond as breakpoints are added
+    exit(aHitsPerSecond[2] < 1e6 ? 1 : 0);
+    return NULL;
+}
+
+bool FDP_BreakpointDispatchBenchmark()
+{
+    static FDP_SERVER_INTERFACE_T FDPServerInterface;
+    memset(&FDPServerInterface, 0, sizeof(FDPServerInterface));
+    FDPServerInterface.pfnGetState = Bench_GetState;
+    FDPServerInterface.pfnReadRegister = Bench_ReadRegister;
+    FDPServerInterface.pfnWriteRegister = Bench_WriteRegister;
+    FDPServerInterface.pfnGetCpuCount = Bench_GetCpuCount;
+    FDPServerInterface.pfnGetMemorySize = Bench_GetMemorySize;
+    FDPServerInterface.pfnSetBreakpoint = Bench_SetBreakpoint;
+    FDPServerInterface.pfnUnsetBreakpoint = Bench_UnsetBreakpoint;
+    FDPServerInterface.pfnVirtualToPhysical = Bench_VirtualToPhysical;
+
+    BenchGuest.MemorySize = BENCH_DISPATCH_BASE + BENCH_DISPATCH_PAGES * BENCH_PAGE_SIZE;
+    FDP_SHM* pFDPServer = FDP_CreateSHM("FDP_DISPATCH");
+    if (pFDPServer == NULL
+        || FDP_CreateCpuSHM(pFDPServer, "FDP_DISPATCH", 1) == NULL
+        || FDP_SetFDPServer(pFDPServer, &FDPServerInterface) == false)
+    {
+        printf("Failed to create the FDP server\n");
+        return false;
+    }
+    pthread_t threadClient = 0;
+    if (pthread_create(&threadClient, NULL, Bench_DispatchClient, pFDPServer) != 0)
+    {
+        printf("Failed to phread_create\n");
+        return false;
+    }
+    return FDP_ServerLoop(pFDPServer);
+}
+
+
+//testFDPClientServer restore [GuestSizeInGB] benchmarks FDP_RestoreSnapshot, testFDPClientServer dispatch the
+//execute breakpoint hits
 int main(int argc, char* argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "restore") == 0)
+    {
+        uint64_t GuestSizeInGB = argc > 2 ? strtoull(argv[2], NULL, 0) : 4;
+        return FDP_SnapshotRestoreBenchmark(GuestSizeInGB << 30) ? 0 : 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "dispatch") == 0)
+    {
+        return FDP_BreakpointDispatchBenchmark() ? 0 : 1;
+    }
     FDP_ClientServerTest();
     return 0;
 }
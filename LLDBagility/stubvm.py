@@ -74,6 +74,18 @@ class STUBVM(object):
             self.stub.NO_CR3,
         )
         assert 0 <= cr3bp_id <= 254
+        # MOV to CR3 only runs at CPL0, but not necessarily from the kernel
+        # address range checked below: let the VMM skip those writes instead
+        # of stopping the VM just to single-step them
+        if hasattr(self.stub, "SetBreakpointCondition"):
+            self.stub.SetBreakpointCondition(
+                cr3bp_id,
+                [
+                    self.stub.RegisterCondition(
+                        "rip", self.stub.FDP_CONDITION_GE, VM_MIN_KERNEL_ADDRESS
+                    )
+                ],
+            )
         # resume the VM execution until reaching kernel code
         while True:
             self.stub.Resume()
@@ -92,10 +104,12 @@ class STUBVM(object):
         def _get_gs_base(self):
             logger.debug("_get_gs_base()")
 
-            gs_base = self.read_msr64(MSR_IA32_GS_BASE)
+            gs_base, kernel_gs_base = self.read_msrs64(
+                [MSR_IA32_GS_BASE, MSR_IA32_KERNEL_GS_BASE]
+            )
             logger.debug(">  MSR_IA32_GS_BASE: 0x{:016x}".format(gs_base))
             if not _in_kernel_space(gs_base):
-                gs_base = self.read_msr64(MSR_IA32_KERNEL_GS_BASE)
+                gs_base = kernel_gs_base
                 logger.debug(">  MSR_IA32_KERNEL_GS_BASE: 0x{:016x}".format(gs_base))
             return gs_base
 
@@ -169,6 +183,15 @@ class STUBVM(object):
         logger.debug("read_msr64(msr=0x{:x})".format(msr))
         return self.stub.ReadMsr(msr, CpuId=self.stub.CPU0)
 
+    @lldbagilityutils.indented(logger)
+    @lldbagilityutils.synchronized
+    def read_msrs64(self, msrs):
+        logger.debug("read_msrs64()")
+        # all MSRs in a single request when the stub supports it
+        if not hasattr(self.stub, "ReadMsrs"):
+            return [self.read_msr64(msr) for msr in msrs]
+        return self.stub.ReadMsrs(msrs, CpuId=self.stub.CPU0)
+
     @lldbagilityutils.indented(logger)
     @lldbagilityutils.synchronized
     def write_msr64(self, msr, val):
@@ -192,7 +215,15 @@ class STUBVM(object):
     @lldbagilityutils.synchronized
     def read_registers(self, regs):
         logger.debug("read_registers()")
-        return {reg: self.read_register(reg) for reg in regs}
+        # all registers in a single request when the stub supports it
+        vals = self.stub.ReadRegisters(regs) if hasattr(self.stub, "ReadRegisters") else None
+        if vals is None:
+            return {reg: self.read_register(reg) for reg in regs}
+        if "rip" in vals and self._return_incremented_at_next_read_register_rip:
+            logger.debug(">  _return_incremented_at_next_read_register_rip")
+            self._return_incremented_at_next_read_register_rip = False
+            vals["rip"] += 1
+        return vals
 
     @lldbagilityutils.indented(logger)
     @lldbagilityutils.synchronized
@@ -210,8 +241,13 @@ class STUBVM(object):
     @lldbagilityutils.synchronized
     def write_registers(self, regs):
         logger.debug("write_registers()")
-        for reg, val in regs.items():
-            self.write_register(reg, val)
+        if not hasattr(self.stub, "WriteRegisters"):
+            for reg, val in regs.items():
+                self.write_register(reg, val)
+            return
+        if "rflags" in regs:
+            self.write_register("rflags", regs["rflags"])
+        self.stub.WriteRegisters({reg: val for reg, val in regs.items() if reg != "rflags"})
 
     @lldbagilityutils.indented(logger)
     @lldbagilityutils.synchronized
@@ -591,6 +627,10 @@ class FDPSTUB(FDP):
             "VMs with more than one CPU are not fully supported by FDP! "
             "Decrease the number of processors in the VM settings"
         )
+        # LLDB reads stacks and code in small ascending chunks
+        self.SetReadahead(True)
+        # LLDB re-reads registers at each stop and writes DR0-DR7 one at a time
+        self.SetRegisterCache(True)
 
 
 class VMSNSTUB(VMSN):